@@ -25,6 +25,20 @@ ConditionalGRBM::ConditionalGRBM(size_t v_size, size_t h_size, size_t x_size) {
     params.initParamsRandom(-0.001, 0.001);
 }
 
+ConditionalGRBM::ConditionalGRBM(size_t v_size, size_t h_size, size_t x_size, size_t f_size) {
+    vSize = v_size;
+    hSize = h_size;
+    xSize = x_size;
+    fSize = f_size;
+
+    // ノード確保
+    nodes = ConditionalGRBMNode(v_size, h_size, x_size);
+
+    // パラメータ初期化
+    params = ConditionalGRBMParamator(v_size, h_size, x_size, f_size);
+    params.initParamsRandom(-0.001, 0.001);
+}
+
 
 // 可視変数の数を返す
 size_t ConditionalGRBM::getVisibleSize() {
@@ -41,6 +55,11 @@ size_t ConditionalGRBM::getCondSize() {
     return xSize;
 }
 
+// 可視変数-条件変数間の因子の数を返す
+size_t ConditionalGRBM::getFactorSize() {
+    return fSize;
+}
+
 // 規格化を返します
 double ConditionalGRBM::getNormalConstant() {
     // 未実装なので保留
@@ -70,12 +89,10 @@ double ConditionalGRBM::actHidJ(int hindex) {
 double ConditionalGRBM::lambda(int vindex) {
     double lam = params.b(vindex);
 
-    // TODO: 条件変数からの影響受けるようにしたい
-    // FIXME: 因子化しないと計算量やばい
-//    for (int k = 0; k < xSize; k++) {
-//        lam += params.vxW(vindex, k) * nodes.x(k);
-//    }
-
+    // 条件変数からの影響(因子経由)
+    if (fSize > 0) {
+        lam += params.vfW.row(vindex).dot(params.xfW.transpose() * nodes.x);
+    }
 
     // TODO: Eigen使ってるから内積計算で高速化できる
     for (int j = 0; j < hSize; j++) {
@@ -123,6 +140,27 @@ double ConditionalGRBM::mu(int hindex) {
     return mu;
 }
 
+// 条件変数による隠れ変数の実効バイアス(バッチの各列)
+Eigen::MatrixXd ConditionalGRBM::condHiddenBias(const Eigen::MatrixXd & x_batch) {
+    Eigen::MatrixXd bias = params.xhW.transpose() * x_batch;
+    bias.colwise() += params.c;
+    return bias;
+}
+
+// 条件変数による可視変数の実効バイアス(バッチの各列)
+Eigen::MatrixXd ConditionalGRBM::condVisibleBias(const Eigen::MatrixXd & x_batch) {
+    Eigen::MatrixXd bias(vSize, x_batch.cols());
+    if (fSize > 0) {
+        Eigen::MatrixXd factor = params.xfW.transpose() * x_batch;
+        bias.noalias() = params.vfW * factor;
+    }
+    else {
+        bias.setZero();
+    }
+    bias.colwise() += params.b;
+    return bias;
+}
+
 // muの可視変数に関する全ての実現値の総和
 double ConditionalGRBM::sumExpMu(int hindex) {
     // {0, 1}での実装
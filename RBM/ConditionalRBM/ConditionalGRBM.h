@@ -8,6 +8,7 @@ private:
     size_t vSize = 0;
     size_t hSize = 0;
     size_t xSize = 0;
+    size_t fSize = 0;
 
 public:
     ConditionalGRBMParamator params;
@@ -16,6 +17,7 @@ public:
 public:
     ConditionalGRBM();
     ConditionalGRBM(size_t v_size, size_t h_size, size_t x_size);
+    ConditionalGRBM(size_t v_size, size_t h_size, size_t x_size, size_t f_size);
     ~ConditionalGRBM();
 
     // 可視変数の数を返す
@@ -27,6 +29,9 @@ public:
     // 条件変数の数を返す
     size_t getCondSize();
 
+    // 可視変数-条件変数間の因子の数を返す
+    size_t getFactorSize();
+
     // 規格化を返します
     double getNormalConstant();
 
@@ -43,6 +48,10 @@ public:
     // 二乗の項は無視
     double lambda(int vindex);
 
+    // 条件変数による可視変数の実効バイアスb + vfW xfW^T x(バッチの各列)
+    // 密なvxWは画像サイズの2乗になるので因子を経由する
+    Eigen::MatrixXd condVisibleBias(const Eigen::MatrixXd & x_batch);
+
     // exp(lambda)の可視変数に関する全ての実現値の総和
     // Gaussian Unitでは使いません
     double sumExpLambda(int vindex);
@@ -56,6 +65,10 @@ public:
     // 隠れ変数に関する外部磁場と相互作用
     double mu(int hindex);
 
+    // 条件変数による隠れ変数の実効バイアスc + xhW^T x(バッチの各列)
+    // 条件変数はCDのチェイン中で変わらないので, 一度求めて使いまわす
+    Eigen::MatrixXd condHiddenBias(const Eigen::MatrixXd & x_batch);
+
     // exp(mu)の可視変数に関する全ての実現値の総和
     double sumExpMu(int hindex);
 
@@ -20,6 +20,15 @@ ConditionalGRBMParamator::ConditionalGRBMParamator(size_t v_size, size_t h_size,
     initParams();
 }
 
+ConditionalGRBMParamator::ConditionalGRBMParamator(size_t v_size, size_t h_size, size_t x_size, size_t f_size) {
+    vSize = v_size;
+    hSize = h_size;
+    xSize = x_size;
+    fSize = f_size;
+
+    initParams();
+}
+
 void ConditionalGRBMParamator::initParams() {
     b.resize(vSize);
     b.setConstant(0.0);
@@ -29,8 +38,10 @@ void ConditionalGRBMParamator::initParams() {
     c.setConstant(0.0);
     hvW.resize(hSize, vSize);
     hvW.setConstant(0.0);
-    //vxW.resize(vSize, xSize);
-    //vxW.setConstant(0.0);
+    vfW.resize(vSize, fSize);
+    vfW.setConstant(0.0);
+    xfW.resize(xSize, fSize);
+    xfW.setConstant(0.0);
     xhW.resize(xSize, hSize);
     xhW.setConstant(0.0);
 }
@@ -39,7 +50,8 @@ void ConditionalGRBMParamator::initParamsRandom(double range_min, double range_m
     b.resize(vSize);
     c.resize(hSize);
     hvW.resize(hSize, vSize);
-    //vxW.resize(vSize, xSize);
+    vfW.resize(vSize, fSize);
+    xfW.resize(xSize, fSize);
     xhW.resize(xSize, hSize);
 
     std::random_device rd;
@@ -53,9 +65,9 @@ void ConditionalGRBMParamator::initParamsRandom(double range_min, double range_m
             hvW(j, i) = dist(mt) * 100;
         }
 
-        //for (int k = 0; k < xSize; k++) {
-        //    vxW(i, k) = dist(mt);
-        //}
+        for (int f = 0; f < fSize; f++) {
+            vfW(i, f) = dist(mt);
+        }
     }
 
     for (int j = 0; j < hSize; j++) {
@@ -66,6 +78,13 @@ void ConditionalGRBMParamator::initParamsRandom(double range_min, double range_m
         }
     }
 
+    // 因子は両側とも0だと勾配も0のまま
+    for (int k = 0; k < xSize; k++) {
+        for (int f = 0; f < fSize; f++) {
+            xfW(k, f) = dist(mt);
+        }
+    }
+
     // XXX: 逆分散は乱数使うと危ない
     lambda.resize(vSize);
     lambda.setConstant(100.0);  // 逆分散は非負制約がある, 逆分散 = 10 -> 分散0.1
@@ -7,11 +7,13 @@ private:
     size_t vSize;
     size_t hSize;
     size_t xSize;
+    size_t fSize = 0;
 public:
     Eigen::VectorXd b;  // 可視変数のバイアス
     Eigen::VectorXd c;  // 隠れ変数のバイアス
     Eigen::MatrixXd hvW;  // 可視変数-隠れ変数間のカップリング
-    Eigen::MatrixXd vxW;  // 可視変数-条件変数間のカップリング
+    Eigen::MatrixXd vfW;  // 可視変数-因子間のカップリング(可視変数-条件変数間はvfW xfW^Tに因子化)
+    Eigen::MatrixXd xfW;  // 条件変数-因子間のカップリング
     Eigen::MatrixXd xhW;  // 隠れ変数-条件変数間のカップリング
     Eigen::VectorXd lambda;  // 可視変数の逆分散
 
@@ -19,6 +21,7 @@ public:
 public:
     ConditionalGRBMParamator();
     ConditionalGRBMParamator(size_t vsize, size_t hsize, size_t x_size);
+    ConditionalGRBMParamator(size_t vsize, size_t hsize, size_t x_size, size_t f_size);
     ~ConditionalGRBMParamator();
 
     // 可視変数の総数を返す
@@ -30,6 +33,9 @@ public:
     // 条件変数の総数を返す
     inline size_t getCondSize();
 
+    // 可視変数-条件変数間の因子の数を返す
+    inline size_t getFactorSize();
+
     // 可視変数のバイアスを返す
     inline double getVisibleBias(int vindex);
 
@@ -76,6 +82,11 @@ inline size_t ConditionalGRBMParamator::getCondSize() {
     return xSize;
 }
 
+// 可視変数-条件変数間の因子の数を返す
+inline size_t ConditionalGRBMParamator::getFactorSize() {
+    return fSize;
+}
+
 // 可視変数のバイアスを返す
 inline double ConditionalGRBMParamator::getVisibleBias(int vindex) {
     return b(vindex);
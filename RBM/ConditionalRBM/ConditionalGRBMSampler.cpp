@@ -85,3 +85,64 @@ Eigen::VectorXd & ConditionalGRBMSampler::updateByBlockedGibbsSamplingHidden(Con
 
     return rbm.nodes.h;
 }
+
+void ConditionalGRBMSampler::maskedSampling(ConditionalGRBM & rbm, const Eigen::MatrixXd & cond_batch, const Eigen::MatrixXd & observed, const Eigen::Matrix<bool, Eigen::Dynamic, Eigen::Dynamic> & mask,
+    int sweep_size, int burn_in, std::mt19937 & engine, Eigen::MatrixXd & samples, Eigen::MatrixXd & means) {
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    std::normal_distribution<double> normal(0.0, 1.0);
+
+    auto v_size = observed.rows();
+    auto batch_size = observed.cols();
+
+    // conditional part of mu does not change over sweeps
+    Eigen::MatrixXd cond_mu = rbm.condHiddenBias(cond_batch);
+    Eigen::MatrixXd cond_lambda = rbm.condVisibleBias(cond_batch);
+
+    Eigen::VectorXd sigma = rbm.params.lambda.cwiseInverse().cwiseSqrt();
+
+    // free units start at the mean for h = 0
+    samples = observed;
+    for (int n = 0; n < batch_size; n++) {
+        for (int i = 0; i < v_size; i++) {
+            if (!mask(i, n)) samples(i, n) = cond_lambda(i, n) / rbm.params.lambda(i);
+        }
+    }
+
+    Eigen::MatrixXd mean_sum = Eigen::MatrixXd::Zero(v_size, batch_size);
+    int mean_count = 0;
+
+    Eigen::MatrixXd mu_batch, h_batch(rbm.getHiddenSize(), batch_size), lambda_batch;
+    for (int s = 0; s < sweep_size; s++) {
+        mu_batch = cond_mu;
+        mu_batch.noalias() += rbm.params.hvW * samples;
+
+        for (int n = 0; n < batch_size; n++) {
+            for (int j = 0; j < mu_batch.rows(); j++) {
+                h_batch(j, n) = uniform(engine) < 1.0 / (1.0 + exp(-mu_batch(j, n))) ? 1.0 : 0.0;
+            }
+        }
+
+        lambda_batch = cond_lambda;
+        lambda_batch.noalias() += rbm.params.hvW.transpose() * h_batch;
+
+        bool accumulate = s >= burn_in;
+        for (int n = 0; n < batch_size; n++) {
+            for (int i = 0; i < v_size; i++) {
+                if (mask(i, n)) continue;
+
+                double mean = lambda_batch(i, n) / rbm.params.lambda(i);
+                samples(i, n) = mean + sigma(i) * normal(engine);
+                if (accumulate) mean_sum(i, n) += mean;
+            }
+        }
+        if (accumulate) mean_count++;
+    }
+
+    means = observed;
+    for (int n = 0; n < batch_size; n++) {
+        for (int i = 0; i < v_size; i++) {
+            if (mask(i, n)) continue;
+            means(i, n) = mean_count > 0 ? mean_sum(i, n) / mean_count : samples(i, n);
+        }
+    }
+}
@@ -1,6 +1,7 @@
 ﻿#pragma once
 #include "ConditionalRBMSamplerBase.h"
 #include "ConditionalGRBM.h"
+#include <random>
 
 
 class ConditionalGRBMSampler : ConditionalRBMSamplerBase {
@@ -39,5 +40,11 @@ public:
     // 隠れ層すべてをギブスサンプリングで更新
     Eigen::VectorXd & updateByBlockedGibbsSamplingHidden(ConditionalRBMBase & rbm) { return updateByBlockedGibbsSamplingHidden(reinterpret_cast<ConditionalGRBM &>(rbm)); };
     Eigen::VectorXd & updateByBlockedGibbsSamplingHidden(ConditionalGRBM & rbm);
+
+    // 一部の可視変数を観測値で固定した条件付きサンプリング(バッチの各列が1つの要求)
+    // cond_batchは条件変数 x バッチ, observedとmaskは可視変数 x バッチ, maskが真の成分は固定
+    // samplesに最後のサンプル, meansにburn_in以降のE[v | h]の平均が入る
+    void maskedSampling(ConditionalGRBM & rbm, const Eigen::MatrixXd & cond_batch, const Eigen::MatrixXd & observed, const Eigen::Matrix<bool, Eigen::Dynamic, Eigen::Dynamic> & mask,
+        int sweep_size, int burn_in, std::mt19937 & engine, Eigen::MatrixXd & samples, Eigen::MatrixXd & means);
 };
 
@@ -1,6 +1,7 @@
 ﻿#include "ConditionalGRBMTrainer.h"
 #include "ConditionalGRBM.h"
 #include "ConditionalGRBMSampler.h"
+#include "ConditionalRBMMath.h"
 #include <vector>
 #include <numeric>
 #include <random>
@@ -8,6 +9,8 @@
 
 ConditionalGRBMTrainer::ConditionalGRBMTrainer()
 {
+	std::random_device rd;
+	randEngine = std::mt19937(rd());
 }
 
 
@@ -17,6 +20,9 @@ ConditionalGRBMTrainer::~ConditionalGRBMTrainer()
 
 
 ConditionalGRBMTrainer::ConditionalGRBMTrainer(ConditionalGRBM & rbm) {
+	std::random_device rd;
+	randEngine = std::mt19937(rd());
+
 	initMomentum(rbm);
 	initGradient(rbm);
 	initDataMean(rbm);
@@ -28,7 +34,8 @@ void ConditionalGRBMTrainer::initMomentum(ConditionalGRBM & rbm) {
 	momentum.vLambda.setConstant(rbm.getVisibleSize(), 0.0);
 	momentum.hBias.setConstant(rbm.getHiddenSize(), 0.0);
 	momentum.hvWeight.setConstant(rbm.getHiddenSize(), rbm.getVisibleSize(), 0.0);
-	//momentum.vxWeight.setConstant(rbm.getVisibleSize(), rbm.getCondSize(), 0.0);
+	momentum.vfWeight.setConstant(rbm.getVisibleSize(), rbm.getFactorSize(), 0.0);
+	momentum.xfWeight.setConstant(rbm.getCondSize(), rbm.getFactorSize(), 0.0);
 	momentum.xhWeight.setConstant(rbm.getCondSize(), rbm.getHiddenSize(), 0.0);
 }
 
@@ -37,7 +44,8 @@ void ConditionalGRBMTrainer::initMomentum() {
 	momentum.vLambda.setConstant(0.0);
 	momentum.hBias.setConstant(0.0);
 	momentum.hvWeight.setConstant(0.0);
-	//momentum.vxWeight.setConstant(0.0);
+	momentum.vfWeight.setConstant(0.0);
+	momentum.xfWeight.setConstant(0.0);
 	momentum.xhWeight.setConstant(0.0);
 }
 
@@ -46,7 +54,8 @@ void ConditionalGRBMTrainer::initGradient(ConditionalGRBM & rbm) {
 	gradient.vLambda.setConstant(rbm.getVisibleSize(), 0.0);
 	gradient.hBias.setConstant(rbm.getHiddenSize(), 0.0);
 	gradient.hvWeight.setConstant(rbm.getHiddenSize(), rbm.getVisibleSize(), 0.0);
-	// gradient.vxWeight.setConstant(rbm.getVisibleSize(), rbm.getCondSize(), 0.0);
+	gradient.vfWeight.setConstant(rbm.getVisibleSize(), rbm.getFactorSize(), 0.0);
+	gradient.xfWeight.setConstant(rbm.getCondSize(), rbm.getFactorSize(), 0.0);
 	gradient.xhWeight.setConstant(rbm.getCondSize(), rbm.getHiddenSize(), 0.0);
 }
 
@@ -55,7 +64,8 @@ void ConditionalGRBMTrainer::initGradient() {
 	gradient.vLambda.setConstant(0.0);
 	gradient.hBias.setConstant(0.0);
 	gradient.hvWeight.setConstant(0.0);
-	//gradient.vxWeight.setConstant(0.0);
+	gradient.vfWeight.setConstant(0.0);
+	gradient.xfWeight.setConstant(0.0);
 	gradient.xhWeight.setConstant(0.0);
 }
 
@@ -64,7 +74,8 @@ void ConditionalGRBMTrainer::initDataMean(ConditionalGRBM & rbm) {
 	dataMean.vLambda.setConstant(rbm.getVisibleSize(), 0.0);
 	dataMean.hBias.setConstant(rbm.getHiddenSize(), 0.0);
 	dataMean.hvWeight.setConstant(rbm.getHiddenSize(), rbm.getVisibleSize(), 0.0);
-	//dataMean.vxWeight.setConstant(rbm.getVisibleSize(), rbm.getCondSize(), 0.0);
+	dataMean.vfWeight.setConstant(rbm.getVisibleSize(), rbm.getFactorSize(), 0.0);
+	dataMean.xfWeight.setConstant(rbm.getCondSize(), rbm.getFactorSize(), 0.0);
 	dataMean.xhWeight.setConstant(rbm.getCondSize(), rbm.getHiddenSize(), 0.0);
 }
 
@@ -73,7 +84,8 @@ void ConditionalGRBMTrainer::initDataMean() {
 	dataMean.vLambda.setConstant(0.0);
 	dataMean.hBias.setConstant(0.0);
 	dataMean.hvWeight.setConstant(0.0);
-	//dataMean.vxWeight.setConstant(0.0);
+	dataMean.vfWeight.setConstant(0.0);
+	dataMean.xfWeight.setConstant(0.0);
 	dataMean.xhWeight.setConstant(0.0);
 }
 
@@ -82,7 +94,8 @@ void ConditionalGRBMTrainer::initRBMExpected(ConditionalGRBM & rbm) {
 	rbmExpected.vLambda.setConstant(rbm.getVisibleSize(), 0.0);
 	rbmExpected.hBias.setConstant(rbm.getHiddenSize(), 0.0);
 	rbmExpected.hvWeight.setConstant(rbm.getHiddenSize(), rbm.getVisibleSize(), 0.0);
-	//rbmExpected.vxWeight.setConstant(rbm.getVisibleSize(), rbm.getCondSize(), 0.0);
+	rbmExpected.vfWeight.setConstant(rbm.getVisibleSize(), rbm.getFactorSize(), 0.0);
+	rbmExpected.xfWeight.setConstant(rbm.getCondSize(), rbm.getFactorSize(), 0.0);
 	rbmExpected.xhWeight.setConstant(rbm.getCondSize(), rbm.getHiddenSize(), 0.0);
 }
 
@@ -91,7 +104,8 @@ void ConditionalGRBMTrainer::initRBMExpected() {
 	rbmExpected.vLambda.setConstant(0.0);
 	rbmExpected.hBias.setConstant(0.0);
 	rbmExpected.hvWeight.setConstant(0.0);
-	//rbmExpected.vxWeight.setConstant(0.0);
+	rbmExpected.vfWeight.setConstant(0.0);
+	rbmExpected.xfWeight.setConstant(0.0);
 	rbmExpected.xhWeight.setConstant(0.0);
 }
 
@@ -110,9 +124,7 @@ void ConditionalGRBMTrainer::trainOnce(ConditionalGRBM & rbm, std::vector<std::v
 
 	// ミニバッチ学習のためにデータインデックスをシャッフルする
 	std::iota(data_indexes.begin(), data_indexes.end(), 0);
-	std::random_device rnd;
-	std::mt19937 mt(rnd());
-	std::shuffle(data_indexes.begin(), data_indexes.end(), mt);
+	std::shuffle(data_indexes.begin(), data_indexes.end(), randEngine);
 
 	// ミニバッチ
 	// バッチサイズの確認
@@ -134,6 +146,9 @@ void ConditionalGRBMTrainer::trainOnce(ConditionalGRBM & rbm, std::vector<std::v
 }
 
 void ConditionalGRBMTrainer::calcContrastiveDivergence(ConditionalGRBM & rbm, std::vector<std::vector<double>> & dataset, std::vector<std::vector<double>> & cond_dataset, std::vector<int> & data_indexes) {
+	// ミニバッチと条件変数による実効バイアス
+	makeBatch(rbm, dataset, cond_dataset, data_indexes);
+
 	// データ平均の計算
 	calcDataMean(rbm, dataset, cond_dataset, data_indexes);
 
@@ -144,105 +159,97 @@ void ConditionalGRBMTrainer::calcContrastiveDivergence(ConditionalGRBM & rbm, st
 	calcGradient(rbm, data_indexes);
 }
 
+void ConditionalGRBMTrainer::makeBatch(ConditionalGRBM & rbm, std::vector<std::vector<double>> & dataset, std::vector<std::vector<double>> & cond_dataset, std::vector<int> & data_indexes) {
+	auto batch_size = data_indexes.size();
+	dataBatch.resize(rbm.getVisibleSize(), batch_size);
+	condBatch.resize(rbm.getCondSize(), batch_size);
+	for (int n = 0; n < batch_size; n++) {
+		auto & data = dataset[data_indexes[n]];
+		auto & cond_data = cond_dataset[data_indexes[n]];
+		dataBatch.col(n) = Eigen::Map<Eigen::VectorXd>(data.data(), data.size());
+		condBatch.col(n) = Eigen::Map<Eigen::VectorXd>(cond_data.data(), cond_data.size());
+	}
+
+	// c + xhW^T xはCDのスイープ中で変わらないので一回だけ
+	condBias = rbm.condHiddenBias(condBatch);
+	condVisBias = rbm.condVisibleBias(condBatch);
+	condFactor = rbm.params.xfW.transpose() * condBatch;
+}
+
 void ConditionalGRBMTrainer::calcDataMean(ConditionalGRBM & rbm, std::vector<std::vector<double>> & dataset, std::vector<std::vector<double>> & cond_dataset, std::vector<int> & data_indexes) {
 	// 0埋め初期化
 	initDataMean();
 
-	for (auto & n : data_indexes) {
-		std::cout << "index:" << n << std::endl;
-
-		auto & data = dataset[n];
-		auto & cond_data = cond_dataset[n];
-		Eigen::VectorXd vect = Eigen::Map<Eigen::VectorXd>(data.data(), data.size());
-		rbm.nodes.v = vect;
-		Eigen::VectorXd cond_vect = Eigen::Map<Eigen::VectorXd>(cond_data.data(), cond_data.size());
-		rbm.nodes.x = cond_vect;
-
-		dataMean.vBias += vect;
-
-		// Gausiann Unit限定 
-		for (int i = 0; i < rbm.getVisibleSize(); i++) {
-			dataMean.vLambda(i) += vect(i) * vect(i) / 2.0;  // Gausiann Unit限定 
-		}
-
-		for (int j = 0; j < rbm.getHiddenSize(); j++) {
-			dataMean.hBias(j) += rbm.actHidJ(j);
-		}
-
-		for (int h_counter = 0; h_counter < rbm.getHiddenSize(); h_counter++) {
-			for (int x_counter = 0; x_counter < rbm.getCondSize(); x_counter++) {
-				// 計算使いまわしています
-				dataMean.xhWeight(x_counter, h_counter) += cond_vect(x_counter) * dataMean.hBias(h_counter);
-			}
-
-			for (int v_counter = 0; v_counter < rbm.getVisibleSize(); v_counter++) {
-				// 計算使いまわしています
-				dataMean.hvWeight(h_counter, v_counter) += dataMean.vBias(v_counter) * dataMean.hBias(h_counter);
-			}
-		}
-
-	}
-
-	dataMean.vBias /= static_cast<double>(data_indexes.size());
-	dataMean.vLambda /= static_cast<double>(data_indexes.size());
-	dataMean.hBias /= static_cast<double>(data_indexes.size());
-	dataMean.hvWeight /= static_cast<double>(data_indexes.size());
-	//dataMean.vxWeight /= static_cast<double>(data_indexes.size());
-	dataMean.xhWeight /= static_cast<double>(data_indexes.size());
+	// E[h | v, x]
+	Eigen::MatrixXd hidden_batch = condBias;
+	hidden_batch.noalias() += rbm.params.hvW * dataBatch;
+	hidden_batch = hidden_batch.unaryExpr([](double mu) { return ConditionalRBMMath::sigmoid(mu); });
+
+	auto batch_size = static_cast<double>(data_indexes.size());
+	dataMean.vBias = dataBatch.rowwise().sum() / batch_size;
+	dataMean.vLambda = dataBatch.array().square().rowwise().sum() / 2.0 / batch_size;  // Gausiann Unit限定
+	dataMean.hBias = hidden_batch.rowwise().sum() / batch_size;
+	dataMean.hvWeight.noalias() = hidden_batch * dataBatch.transpose() / batch_size;
+	dataMean.xhWeight.noalias() = condBatch * hidden_batch.transpose() / batch_size;
+
+	// 因子化した可視変数-条件変数間: <v (xfW^T x)^T>, <x (vfW^T v)^T>
+	dataMean.vfWeight.noalias() = dataBatch * condFactor.transpose() / batch_size;
+	Eigen::MatrixXd vis_factor = rbm.params.vfW.transpose() * dataBatch;
+	dataMean.xfWeight.noalias() = condBatch * vis_factor.transpose() / batch_size;
 }
 
 void ConditionalGRBMTrainer::calcRBMExpected(ConditionalGRBM & rbm, std::vector<std::vector<double>> & dataset, std::vector<std::vector<double>> & cond_dataset, std::vector<int> & data_indexes) {
 	// 0埋め初期化
 	initRBMExpected();
 
-	for (auto & n : data_indexes) {
-		auto & data = dataset[n];
-		auto & cond_data = cond_dataset[n];
-		Eigen::VectorXd vect = Eigen::Map<Eigen::VectorXd>(data.data(), data.size());
-		Eigen::VectorXd cond_vect = Eigen::Map<Eigen::VectorXd>(cond_data.data(), cond_data.size());
-
-		// ConditionalGRBMの初期値設定
-		rbm.nodes.v = vect;
-		rbm.nodes.x = cond_vect;
-
-		for (int j = 0; j < rbm.getHiddenSize(); j++) {
-			rbm.nodes.h(j) = rbm.actHidJ(j);
-		}
-
-		// CD-K
-		ConditionalGRBMSampler sampler;
-		for (int k = 0; k < cdk; k++) {
-			sampler.updateByBlockedGibbsSamplingVisible(rbm);
-			sampler.updateByBlockedGibbsSamplingHidden(rbm);
+	auto batch_size = static_cast<int>(data_indexes.size());
+	Eigen::VectorXd sigma = rbm.params.lambda.cwiseInverse().cwiseSqrt();
+
+	// サンプル毎に乱数列をずらす
+	std::vector<std::mt19937> engines;
+	for (int n = 0; n < batch_size; n++) engines.emplace_back(randEngine());
+
+	// 初期値はデータとE[h | v, x]
+	Eigen::MatrixXd visible_batch = dataBatch;
+	Eigen::MatrixXd hidden_batch = condBias;
+	hidden_batch.noalias() += rbm.params.hvW * visible_batch;
+	hidden_batch = hidden_batch.unaryExpr([](double mu) { return ConditionalRBMMath::sigmoid(mu); });
+
+	// CD-K(各スイープは行列積とサンプル毎のサンプリング)
+	Eigen::MatrixXd lambda_batch, mu_batch;
+	for (int k = 0; k < cdk; k++) {
+		lambda_batch = condVisBias;
+		lambda_batch.noalias() += rbm.params.hvW.transpose() * hidden_batch;
+
+#pragma omp parallel for schedule(static)
+		for (int n = 0; n < batch_size; n++) {
+			std::normal_distribution<double> dist(0.0, 1.0);
+			for (int i = 0; i < visible_batch.rows(); i++) {
+				visible_batch(i, n) = lambda_batch(i, n) / rbm.params.lambda(i) + sigma(i) * dist(engines[n]);
+			}
 		}
 
-		// 結果を格納
-		rbmExpected.vBias += rbm.nodes.v;
-		rbmExpected.hBias += rbm.nodes.h;
+		mu_batch = condBias;
+		mu_batch.noalias() += rbm.params.hvW * visible_batch;
 
-		for (int h_counter = 0; h_counter < rbm.getHiddenSize(); h_counter++) {
-			// 計算使いまわせるところは使いまわします
-			for (int x_counter = 0; x_counter < rbm.getCondSize(); x_counter++) {
-				rbmExpected.xhWeight(x_counter, h_counter) += cond_vect(x_counter) * rbmExpected.hBias(h_counter);
-			}
-
-			for (int v_counter = 0; v_counter < rbm.getVisibleSize(); v_counter++) {
-				rbmExpected.hvWeight(h_counter, v_counter) += rbmExpected.hBias(h_counter) * rbmExpected.vBias(v_counter);
+#pragma omp parallel for schedule(static)
+		for (int n = 0; n < batch_size; n++) {
+			std::uniform_real_distribution<double> dist(0.0, 1.0);
+			for (int j = 0; j < hidden_batch.rows(); j++) {
+				hidden_batch(j, n) = dist(engines[n]) < ConditionalRBMMath::sigmoid(mu_batch(j, n)) ? 1.0 : 0.0;
 			}
 		}
-
-		// Gausiann Unit限定 
-		for (int i = 0; i < rbm.getVisibleSize(); i++) {
-			rbmExpected.vLambda(i) += rbm.nodes.v(i) * rbm.nodes.v(i) / 2.0;
-		}
 	}
 
-	rbmExpected.vBias /= static_cast<double>(data_indexes.size());
-	rbmExpected.vLambda /= static_cast<double>(data_indexes.size());
-	rbmExpected.hBias /= static_cast<double>(data_indexes.size());
-	rbmExpected.hvWeight /= static_cast<double>(data_indexes.size());
-	//rbmExpected.vxWeight /= static_cast<double>(data_indexes.size());
-	rbmExpected.xhWeight /= static_cast<double>(data_indexes.size());
+	// 結果を格納
+	rbmExpected.vBias = visible_batch.rowwise().sum() / batch_size;
+	rbmExpected.vLambda = visible_batch.array().square().rowwise().sum() / 2.0 / batch_size;  // Gausiann Unit限定
+	rbmExpected.hBias = hidden_batch.rowwise().sum() / batch_size;
+	rbmExpected.hvWeight.noalias() = hidden_batch * visible_batch.transpose() / batch_size;
+	rbmExpected.xhWeight.noalias() = condBatch * hidden_batch.transpose() / batch_size;
+	rbmExpected.vfWeight.noalias() = visible_batch * condFactor.transpose() / batch_size;
+	Eigen::MatrixXd vis_factor = rbm.params.vfW.transpose() * visible_batch;
+	rbmExpected.xfWeight.noalias() = condBatch * vis_factor.transpose() / batch_size;
 }
 
 // 勾配の計算
@@ -258,12 +265,11 @@ void ConditionalGRBMTrainer::calcGradient(ConditionalGRBM & rbm, std::vector<int
 			gradient.hvWeight(h_counter, v_counter) = dataMean.hvWeight(h_counter, v_counter) - rbmExpected.hvWeight(h_counter, v_counter);
 		}
 
-		//        for (int k = 0; k < rbm.getCondSize(); k++) {
-		//            gradient.vxWeight(v_counter, k) = dataMean.visible(v_counter) * dataMean.conditional(k) - rbmExpected.visible(v_counter) * rbmExpected.conditional(k);
-		//        }
-
 	}
 
+	gradient.vfWeight = dataMean.vfWeight - rbmExpected.vfWeight;
+	gradient.xfWeight = dataMean.xfWeight - rbmExpected.xfWeight;
+
 	for (int h_counter = 0; h_counter < rbm.getHiddenSize(); h_counter++) {
 		gradient.hBias(h_counter) = dataMean.hBias(h_counter) - rbmExpected.hBias(h_counter);
 
@@ -282,12 +288,11 @@ void ConditionalGRBMTrainer::updateMomentum(ConditionalGRBM & rbm) {
 		for (int h_counter = 0; h_counter < rbm.getHiddenSize(); h_counter++) {
 			momentum.hvWeight(h_counter, v_counter) = momentumRate * momentum.hvWeight(h_counter, v_counter) + learningRate * gradient.hvWeight(h_counter, v_counter);
 		}
-
-		for (int x_counter = 0; x_counter < rbm.getCondSize(); x_counter++) {
-			//momentum.vxWeight(v_counter, x_counter) = momentumRate * momentum.vxWeight(v_counter, x_counter) + learningRate * gradient.vxWeight(v_counter, x_counter);
-		}
 	}
 
+	momentum.vfWeight = momentumRate * momentum.vfWeight + learningRate * gradient.vfWeight;
+	momentum.xfWeight = momentumRate * momentum.xfWeight + learningRate * gradient.xfWeight;
+
 	for (int h_counter = 0; h_counter < rbm.getHiddenSize(); h_counter++) {
 		momentum.hBias(h_counter) = momentumRate * momentum.hBias(h_counter) + learningRate * gradient.hBias(h_counter);
 
@@ -306,12 +311,11 @@ void ConditionalGRBMTrainer::updateParams(ConditionalGRBM & rbm) {
 		for (int h_counter = 0; h_counter < rbm.getHiddenSize(); h_counter++) {
 			rbm.params.hvW(h_counter, v_counter) += momentum.hvWeight(h_counter, v_counter);
 		}
-
-		//        for (int x_counter = 0; x_counter < rbm.getCondSize(); x_counter++) {
-		//            rbm.params.vxW(v_counter, x_counter) += momentum.vxWeight(v_counter, x_counter);
-		//        }
 	}
 
+	rbm.params.vfW += momentum.vfWeight;
+	rbm.params.xfW += momentum.xfWeight;
+
 	for (int h_counter = 0; h_counter < rbm.getHiddenSize(); h_counter++) {
 		rbm.params.c(h_counter) += momentum.hBias(h_counter);
 
@@ -3,6 +3,7 @@
 #include "ConditionalGRBM.h"
 #include "Eigen/Core"
 #include <vector>
+#include <random>
 
 
 class ConditionalGRBMTrainer : ConditionalRBMTrainerBase {
@@ -11,7 +12,8 @@ class ConditionalGRBMTrainer : ConditionalRBMTrainerBase {
         Eigen::VectorXd vLambda;
         Eigen::VectorXd hBias;
         Eigen::MatrixXd hvWeight;
-        Eigen::MatrixXd vxWeight;
+        Eigen::MatrixXd vfWeight;
+        Eigen::MatrixXd xfWeight;
         Eigen::MatrixXd xhWeight;
     };
 
@@ -20,7 +22,8 @@ class ConditionalGRBMTrainer : ConditionalRBMTrainerBase {
         Eigen::VectorXd vLambda;
         Eigen::VectorXd hBias;
         Eigen::MatrixXd hvWeight;
-        Eigen::MatrixXd vxWeight;
+        Eigen::MatrixXd vfWeight;
+        Eigen::MatrixXd xfWeight;
         Eigen::MatrixXd xhWeight;
     };
 
@@ -29,7 +32,8 @@ class ConditionalGRBMTrainer : ConditionalRBMTrainerBase {
 		Eigen::VectorXd vLambda;
 		Eigen::VectorXd hBias;
 		Eigen::MatrixXd hvWeight;
-		Eigen::MatrixXd vxWeight;
+		Eigen::MatrixXd vfWeight;
+		Eigen::MatrixXd xfWeight;
 		Eigen::MatrixXd xhWeight;
 	};
 
@@ -38,7 +42,8 @@ class ConditionalGRBMTrainer : ConditionalRBMTrainerBase {
 		Eigen::VectorXd vLambda;
 		Eigen::VectorXd hBias;
 		Eigen::MatrixXd hvWeight;
-		Eigen::MatrixXd vxWeight;
+		Eigen::MatrixXd vfWeight;
+		Eigen::MatrixXd xfWeight;
 		Eigen::MatrixXd xhWeight;
 	};
 
@@ -48,6 +53,18 @@ private:
     DataMean dataMean;
     RBMExpected rbmExpected;
 
+    // ミニバッチの条件変数による隠れ変数の実効バイアス(隠れ変数 x バッチ)
+    // calcDataMeanで求め, calcRBMExpectedのスイープで使いまわす
+    Eigen::MatrixXd condBias;
+
+    // 条件変数による可視変数の実効バイアスと因子の値xfW^T x(因子 x バッチ)
+    Eigen::MatrixXd condVisBias;
+    Eigen::MatrixXd condFactor;
+
+    // ミニバッチの可視変数, 条件変数(変数 x バッチ)
+    Eigen::MatrixXd dataBatch;
+    Eigen::MatrixXd condBatch;
+
 
 public:
     int epoch = 0;
@@ -55,6 +72,7 @@ public:
     int cdk = 0;
     double learningRate = 0.01;
     double momentumRate = 0.9;
+    std::mt19937 randEngine = std::mt19937();
 
 public:
     ConditionalGRBMTrainer();
@@ -103,6 +121,9 @@ public:
     void calcContrastiveDivergence(ConditionalRBMBase & rbm, std::vector<std::vector<double>> & dataset, std::vector<std::vector<double>> & cond_dataset, std::vector<int> & data_indexes) { calcContrastiveDivergence(reinterpret_cast<ConditionalGRBM &>(rbm), dataset, cond_dataset, data_indexes); }
     void calcContrastiveDivergence(ConditionalGRBM & rbm, std::vector<std::vector<double>> & dataset, std::vector<std::vector<double>> & cond_dataset, std::vector<int> & data_indexes);
 
+    // ミニバッチを行列にまとめ, 条件変数による実効バイアスを求める
+    void makeBatch(ConditionalGRBM & rbm, std::vector<std::vector<double>> & dataset, std::vector<std::vector<double>> & cond_dataset, std::vector<int> & data_indexes);
+
     // データ平均の計算
     void calcDataMean(ConditionalRBMBase & rbm, std::vector<std::vector<double>> & dataset, std::vector<std::vector<double>> & cond_dataset, std::vector<int> & data_indexes) { calcDataMean(reinterpret_cast<ConditionalGRBM &>(rbm), dataset, cond_dataset, data_indexes); }
     void calcDataMean(ConditionalGRBM & rbm, std::vector<std::vector<double>> & dataset, std::vector<std::vector<double>> & cond_dataset, std::vector<int> & data_indexes);
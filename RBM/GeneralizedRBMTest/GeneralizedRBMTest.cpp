@@ -21,6 +21,7 @@ TEST(RBMTest, NormalConstantTestBeforeTrain) {
 
 TEST(RBMTest, ParamsTest) {
 	GeneralizedRBM general_rbm(1, 1);
+	general_rbm.visibleValueSet = { 0.0, 1.0 };  // 以下の判定は{0, 1}値を前提とする
 	auto reset_params = [&] {
 		general_rbm.params.b.setConstant(0);
 		general_rbm.params.c.setConstant(0);
@@ -122,3 +123,56 @@ TEST(RBMTest, ParamsTest) {
 	p = general_rbm.condProbHid(0, 0.0);
 
 }
+
+TEST(RBMTest, EnergyBatchTest) {
+	GeneralizedRBM general_rbm(3, 2);
+	general_rbm.setHiddenMin(-1.0);
+	general_rbm.setHiddenMax(1.0);
+	general_rbm.setHiddenDivSize(2);
+	general_rbm.params.initParamsRandom(-1.0, 1.0);
+
+	// 全配位を1つのバッチに並べる
+	auto v_size = general_rbm.getVisibleSize();
+	auto h_size = general_rbm.getHiddenSize();
+	std::vector<int> v_state(v_size, general_rbm.visibleValueSet.size());
+	std::vector<int> h_state(h_size, general_rbm.hiddenValueSet.size());
+	StateCounter<std::vector<int>> v_counter(v_state);
+	StateCounter<std::vector<int>> h_counter(h_state);
+	auto batch_size = v_counter.getMaxCount() * h_counter.getMaxCount();
+	Eigen::MatrixXd v_batch(batch_size, v_size);
+	Eigen::MatrixXd h_batch(batch_size, h_size);
+
+	for (int n = 0; n < batch_size; n++) {
+		v_counter.innerCounter = n / h_counter.getMaxCount();
+		h_counter.innerCounter = n % h_counter.getMaxCount();
+		auto v = v_counter.getState();
+		auto h = h_counter.getState();
+		for (int i = 0; i < v_size; i++) v_batch(n, i) = general_rbm.visibleValueSet[v[i]];
+		for (int j = 0; j < h_size; j++) h_batch(n, j) = general_rbm.hiddenValueSet[h[j]];
+	}
+
+	// sum exp(-E) = Z
+	auto energy = general_rbm.getEnergyBatch(v_batch, h_batch);
+	auto z = (-energy).array().exp().sum();
+	ASSERT_NEAR(general_rbm.getNormalConstant(), z, 1e-8 * z);
+
+	// 一括計算と単体計算が一致するか
+	general_rbm.nodes.v = v_batch.row(batch_size - 1).transpose();
+	general_rbm.nodes.h = h_batch.row(batch_size - 1).transpose();
+	ASSERT_NEAR(energy(batch_size - 1), general_rbm.getEnergy(), 1e-10);
+}
+
+TEST(RBMTest, MeanFieldFreeEnergyTest) {
+	GeneralizedRBM general_rbm(8, 5);
+	general_rbm.setHiddenMin(-1.0);
+	general_rbm.setHiddenMax(1.0);
+	general_rbm.setHiddenDivSize(2);
+	general_rbm.params.initParamsRandom(-0.2, 0.2);
+
+	// 結合が弱ければTAP近似はほぼ厳密
+	MeanField<GeneralizedRBM> mean_field;
+	mean_field.init(general_rbm);
+	mean_field.iterate(general_rbm);
+	auto exact = -log(general_rbm.getNormalConstant());
+	ASSERT_NEAR(exact, mean_field.getFreeEnergy(general_rbm), 1e-2);
+}
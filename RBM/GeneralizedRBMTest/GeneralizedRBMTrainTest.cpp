@@ -67,4 +67,708 @@ TEST(GeneralizeRBMTrainTest, TrainExactTest) {
 	ASSERT_FALSE(isnan(w));
 	ASSERT_FALSE(isinf(w));
 
-}
\ No newline at end of file
+}
+
+TEST(GeneralizeRBMTrainTest, TrainExactPackedTest) {
+	int vsize = 10;
+	int hsize = 5;
+	auto rbm = GeneralizedRBM(vsize, hsize);
+	rbm.params.initParamsXavier(0);
+
+	auto dataset = std::vector< std::vector<double>>();
+	dataset.push_back(std::vector<double>{ -1, 1, -1, 1, -1, 1, -1, 1, -1, 1 });
+	dataset.push_back(std::vector<double>{ 1, 1, 1, 1, -1, 1, -1, 1, -1, 1 });
+	dataset.push_back(std::vector<double>{ -1, 1, -1, 1, 1, 1, 1, 1, -1, 1 });
+	dataset.push_back(std::vector<double>{ -1, 1, -1, 1, -1, 1, 1, 1, 1, 1 });
+	dataset.push_back(std::vector<double>{ -1, -1, -1, 1, -1, -1, -1, 1, -1, -1 });
+	dataset.push_back(dataset[0]);
+	dataset.push_back(dataset[0]);
+	dataset.push_back(dataset[3]);
+	auto packed_dataset = PackedDataset(dataset);
+	auto unique_dataset = PackedDataset::unique(dataset);
+	ASSERT_EQ(unique_dataset.size(), 5);
+	ASSERT_EQ(unique_dataset.weight(0), 3.0);
+	ASSERT_EQ(unique_dataset.totalWeight(), 8.0);
+
+	auto rbm_packed = rbm;
+	auto rbm_unique = rbm;
+	auto rbm_train = Trainer<GeneralizedRBM, OptimizerType::AdaMax>(rbm);
+	auto rbm_train_packed = Trainer<GeneralizedRBM, OptimizerType::AdaMax>(rbm_packed);
+	auto rbm_train_unique = Trainer<GeneralizedRBM, OptimizerType::AdaMax>(rbm_unique);
+	rbm_train.batchSize = 8;
+
+	ASSERT_NEAR(rbm_train.logLikeliHood(rbm, dataset), rbm_train_packed.logLikeliHood(rbm_packed, packed_dataset), 1e-8);
+	ASSERT_NEAR(rbm_train.logLikeliHood(rbm, dataset), rbm_train_unique.logLikeliHood(rbm_unique, unique_dataset), 1e-8);
+
+	// packed and weighted unique rows must give the same full-batch update as the dense one
+	for (int e = 0; e < 3; e++) {
+		rbm_train.trainOnceExact(rbm, dataset);
+		rbm_train_packed.trainOnceExact(rbm_packed, packed_dataset);
+		rbm_train_unique.trainOnceExact(rbm_unique, unique_dataset);
+	}
+
+	ASSERT_TRUE(rbm.params.b.isApprox(rbm_packed.params.b, 1e-8));
+	ASSERT_TRUE(rbm.params.c.isApprox(rbm_packed.params.c, 1e-8));
+	ASSERT_TRUE(rbm.params.w.isApprox(rbm_packed.params.w, 1e-8));
+	ASSERT_TRUE(rbm.params.b.isApprox(rbm_unique.params.b, 1e-8));
+	ASSERT_TRUE(rbm.params.c.isApprox(rbm_unique.params.c, 1e-8));
+	ASSERT_TRUE(rbm.params.w.isApprox(rbm_unique.params.w, 1e-8));
+}
+
+TEST(GeneralizeRBMTrainTest, TrainExactFixedTest) {
+	auto rbm = GeneralizedRBM(6, 3);
+	rbm.setHiddenMin(-1.0);
+	rbm.setHiddenMax(1.0);
+	rbm.setHiddenDivSize(2);
+	rbm.params.initParamsXavier(0);
+
+	auto dataset = std::vector< std::vector<double>>();
+	dataset.push_back(std::vector<double>{ -1, 1, -1, 1, -1, 1 });
+	dataset.push_back(std::vector<double>{ 1, 1, 1, 1, -1, 1 });
+	dataset.push_back(std::vector<double>{ -1, 1, -1, 1, 1, 1 });
+	dataset.push_back(std::vector<double>{ -1, 1, -1, 1, -1, 1 });
+	auto unique_dataset = PackedDataset::unique(dataset);
+
+	auto rbm_fixed = FixedGeneralizedRBM<6, 3>(rbm);
+	ASSERT_NEAR(rbm.getNormalConstant(), rbm_fixed.getNormalConstant(), 1e-8 * rbm.getNormalConstant());
+	ASSERT_NEAR(rbm.probVis(dataset[1]), rbm_fixed.probVis(dataset[1]), 1e-10);
+
+	auto rbm_train = Trainer<GeneralizedRBM, OptimizerType::AdaMax>(rbm);
+	auto rbm_train_fixed = Trainer<FixedGeneralizedRBM<6, 3>, OptimizerType::AdaMax>(rbm_fixed);
+	ASSERT_NEAR(rbm_train.logLikeliHood(rbm, unique_dataset), rbm_train_fixed.logLikeliHood(rbm_fixed, unique_dataset), 1e-8);
+
+	// the fixed-size model must follow the same exact updates as the dynamic one
+	for (int e = 0; e < 3; e++) {
+		rbm_train.trainOnceExact(rbm, unique_dataset);
+		rbm_train_fixed.trainOnceExact(rbm_fixed, unique_dataset);
+	}
+
+	auto rbm_back = rbm;
+	rbm_fixed.copyTo(rbm_back);
+	ASSERT_TRUE(rbm.params.b.isApprox(rbm_back.params.b, 1e-8));
+	ASSERT_TRUE(rbm.params.c.isApprox(rbm_back.params.c, 1e-8));
+	ASSERT_TRUE(rbm.params.w.isApprox(rbm_back.params.w, 1e-8));
+}
+
+TEST(GeneralizeRBMTrainTest, TrainCDSinglePrecisionTest) {
+	auto rbm = GeneralizedRBM(8, 4);
+	rbm.setHiddenMin(-1.0);
+	rbm.setHiddenMax(1.0);
+	rbm.setHiddenDivSize(2);
+	rbm.params.initParamsXavier(0);
+
+	auto dataset = std::vector< std::vector<double>>();
+	dataset.push_back(std::vector<double>{ -1, 1, -1, 1, -1, 1, -1, 1 });
+	dataset.push_back(std::vector<double>{ 1, 1, 1, 1, -1, 1, -1, 1 });
+	dataset.push_back(std::vector<double>{ -1, 1, -1, 1, 1, 1, 1, 1 });
+	dataset.push_back(std::vector<double>{ -1, -1, -1, 1, -1, -1, -1, 1 });
+
+	// with cdk = 0 the model side is E[h | v] of the data, so float sampling must match double closely
+	auto rbm_single = rbm;
+	auto rbm_train = Trainer<GeneralizedRBM, OptimizerType::Default>(rbm);
+	auto rbm_train_single = Trainer<GeneralizedRBM, OptimizerType::Default>(rbm_single);
+	rbm_train.cdk = rbm_train_single.cdk = 0;
+	rbm_train.batchSize = rbm_train_single.batchSize = dataset.size();
+	rbm_train.randDevice = rbm_train_single.randDevice = std::mt19937(0);
+	rbm_train_single.singlePrecision = true;
+
+	for (int e = 0; e < 3; e++) {
+		rbm_train.trainOnceCD(rbm, dataset);
+		rbm_train_single.trainOnceCD(rbm_single, dataset);
+	}
+
+	ASSERT_LT((rbm.params.b - rbm_single.params.b).cwiseAbs().maxCoeff(), 1e-6);
+	ASSERT_LT((rbm.params.c - rbm_single.params.c).cwiseAbs().maxCoeff(), 1e-6);
+	ASSERT_LT((rbm.params.w - rbm_single.params.w).cwiseAbs().maxCoeff(), 1e-6);
+
+	// the sampled path must stay finite
+	rbm_train_single.cdk = 1;
+	rbm_train_single.trainOnceCD(rbm_single, dataset);
+	ASSERT_TRUE(rbm_single.params.w.allFinite());
+}
+
+TEST(GeneralizeRBMTrainTest, TrainExactLowRankTest) {
+	auto rbm = GeneralizedLowRankRBM(6, 4, 2);
+	rbm.setHiddenMin(-1.0);
+	rbm.setHiddenMax(1.0);
+	rbm.setHiddenDivSize(2);
+	rbm.params.initParamsXavier(0);
+
+	// dense model with W = wv wh^T
+	auto rbm_dense = GeneralizedRBM(6, 4);
+	rbm_dense.setHiddenMin(-1.0);
+	rbm_dense.setHiddenMax(1.0);
+	rbm_dense.setHiddenDivSize(2);
+	rbm_dense.params.b = rbm.params.b;
+	rbm_dense.params.c = rbm.params.c;
+	rbm_dense.params.w = rbm.params.getWeightMatrix();
+
+	rbm.nodes.v = rbm_dense.nodes.v = Eigen::VectorXd::LinSpaced(6, -1.0, 1.0);
+	rbm.nodes.h = rbm_dense.nodes.h = Eigen::VectorXd::LinSpaced(4, 1.0, -1.0);
+	ASSERT_TRUE(rbm.muVect().isApprox(rbm_dense.params.c + rbm_dense.params.w.transpose() * rbm_dense.nodes.v, 1e-12));
+	ASSERT_TRUE(rbm.lambdaVect().isApprox(rbm_dense.params.b + rbm_dense.params.w * rbm_dense.nodes.h, 1e-12));
+
+	auto dataset = std::vector< std::vector<double>>();
+	dataset.push_back(std::vector<double>{ -1, 1, -1, 1, -1, 1 });
+	dataset.push_back(std::vector<double>{ 1, 1, 1, 1, -1, 1 });
+	dataset.push_back(std::vector<double>{ -1, 1, -1, 1, 1, 1 });
+	dataset.push_back(std::vector<double>{ -1, -1, -1, 1, -1, -1 });
+
+	auto z = rbm.getNormalConstant();
+	ASSERT_NEAR(z, rbm_dense.getNormalConstant(), 1e-8 * z);
+	ASSERT_NEAR(rbm.probVis(dataset[1], z), rbm_dense.probVis(dataset[1], z), 1e-12);
+
+	// one exact step: the factor updates must be the dense update projected onto the factors
+	auto wv = rbm.params.wv;
+	auto wh = rbm.params.wh;
+	auto w = rbm_dense.params.w;
+	auto rbm_train = Trainer<GeneralizedLowRankRBM, OptimizerType::Default>(rbm);
+	auto rbm_train_dense = Trainer<GeneralizedRBM, OptimizerType::Default>(rbm_dense);
+	rbm_train.batchSize = dataset.size();
+	rbm_train.trainOnceExact(rbm, dataset);
+	rbm_train_dense.trainOnceExact(rbm_dense, dataset);
+
+	Eigen::MatrixXd dw = rbm_dense.params.w - w;
+	ASSERT_TRUE(rbm.params.b.isApprox(rbm_dense.params.b, 1e-10));
+	ASSERT_TRUE(rbm.params.c.isApprox(rbm_dense.params.c, 1e-10));
+	ASSERT_LT((rbm.params.wv - wv - dw * wh).cwiseAbs().maxCoeff(), 1e-12);
+	ASSERT_LT((rbm.params.wh - wh - dw.transpose() * wv).cwiseAbs().maxCoeff(), 1e-12);
+
+	// the sampled path must stay finite
+	rbm_train.cdk = 1;
+	rbm_train.trainOnceCD(rbm, dataset);
+	ASSERT_TRUE(rbm.params.wv.allFinite());
+	ASSERT_TRUE(rbm.params.wh.allFinite());
+}
+
+TEST(GeneralizeRBMTrainTest, TrainCDConvolutionalTest) {
+	int channels = 2, height = 6, width = 7, filters = 3, filter_size = 3;
+	auto rbm = ConvolutionalGRBM(channels, height, width, filters, filter_size);
+	rbm.params.initParamsRandom(-0.5, 0.5, 0);
+	int hidden_height = rbm.getHiddenHeight(), hidden_width = rbm.getHiddenWidth();
+
+	// the equivalent dense coupling (visible x hidden)
+	Eigen::MatrixXd w = Eigen::MatrixXd::Zero(rbm.getVisibleSize(), rbm.getHiddenSize());
+	Eigen::VectorXd b(rbm.getVisibleSize()), c(rbm.getHiddenSize());
+	for (int k = 0; k < filters; k++) {
+		for (int y = 0; y < hidden_height; y++) {
+			for (int x = 0; x < hidden_width; x++) {
+				int j = (k * hidden_height + y) * hidden_width + x;
+				c(j) = rbm.params.c(k);
+				for (int ch = 0; ch < channels; ch++) {
+					for (int dy = 0; dy < filter_size; dy++) {
+						for (int dx = 0; dx < filter_size; dx++) {
+							w((ch * height + y + dy) * width + x + dx, j) = rbm.params.getWeight(k, ch, dy, dx);
+						}
+					}
+				}
+			}
+		}
+	}
+	for (int i = 0; i < rbm.getVisibleSize(); i++) b(i) = rbm.params.b(i / (height * width));
+
+	rbm.nodes.v = Eigen::VectorXd::LinSpaced(rbm.getVisibleSize(), -1.0, 1.0);
+	rbm.nodes.h = Eigen::VectorXd::LinSpaced(rbm.getHiddenSize(), 1.0, 0.0);
+	ASSERT_TRUE(rbm.muVect().isApprox(c + w.transpose() * rbm.nodes.v, 1e-12));
+	ASSERT_TRUE(rbm.lambdaVect().isApprox(b + w * rbm.nodes.h, 1e-12));
+
+	// probabilistic max-pooling: at most one unit on per block
+	auto pooled = ConvolutionalGRBM(1, 5, 5, 2, 2, 2);
+	pooled.params.initParamsRandom(-1.0, 1.0, 0);
+	pooled.nodes.v = Eigen::VectorXd::LinSpaced(pooled.getVisibleSize(), -1.0, 1.0);
+	Eigen::VectorXd probs, sample;
+	pooled.actHidden(pooled.muVect(), probs);
+	ASSERT_LT(pooled.poolVect(probs).maxCoeff(), 1.0);
+	Sampler<ConvolutionalGRBM> sampler(std::mt19937(0));
+	sampler.sampleHidden(pooled, pooled.muVect(), sample);
+	ASSERT_LE(pooled.poolVect(sample).maxCoeff(), 1.0);
+
+	auto dataset = std::vector< std::vector<double>>(4, std::vector<double>(rbm.getVisibleSize()));
+	std::mt19937 mt(0);
+	std::normal_distribution<double> dist(0.0, 1.0);
+	for (auto & data : dataset) for (auto & value : data) value = dist(mt);
+
+	auto rbm_train = Trainer<ConvolutionalGRBM, OptimizerType::Adam>(rbm);
+	rbm_train.batchSize = dataset.size();
+	rbm_train.epoch = 3;
+	rbm_train.trainCD(rbm, dataset);
+	ASSERT_TRUE(rbm.params.w.allFinite());
+	ASSERT_TRUE(std::isfinite(rbm_train.reconstructionError(rbm, dataset)));
+}
+
+TEST(GeneralizeRBMTrainTest, MaskedSamplingTest) {
+	auto rbm = GeneralizedRBM(4, 3);
+	rbm.setHiddenMin(-1.0);
+	rbm.setHiddenMax(1.0);
+	rbm.setHiddenDivSize(2);
+	rbm.params.initParamsRandom(-1.0, 1.0, 0);
+
+	// v0, v1 observed, v2, v3 free
+	const int batch_size = 400;
+	Eigen::MatrixXd observed = Eigen::MatrixXd::Zero(4, batch_size);
+	observed.row(0).setConstant(1.0);
+	observed.row(1).setConstant(-1.0);
+	MaskedSampler<GeneralizedRBM>::MaskMatrix mask(4, batch_size);
+	mask.topRows(2).setConstant(true);
+	mask.bottomRows(2).setConstant(false);
+
+	auto sampler = MaskedSampler<GeneralizedRBM>(std::mt19937(0));
+	sampler.sweepSize = 50;
+	sampler.burnIn = 10;
+	sampler.run(rbm, observed, mask);
+	ASSERT_TRUE(sampler.samples.topRows(2) == observed.topRows(2));
+	ASSERT_TRUE(sampler.means.topRows(2) == observed.topRows(2));
+	ASSERT_TRUE((sampler.samples.bottomRows(2).array().abs() == 1.0).all());
+
+	// compare E[v_i | v0, v1] with the enumerated conditional
+	Eigen::Vector2d exact = Eigen::Vector2d::Zero();
+	double total = 0.0;
+	for (double v2 : { -1.0, 1.0 }) {
+		for (double v3 : { -1.0, 1.0 }) {
+			auto data = std::vector<double>{ 1.0, -1.0, v2, v3 };
+			auto p = rbm.probVis(data, 1.0);
+			exact += p * Eigen::Vector2d(v2, v3);
+			total += p;
+		}
+	}
+	exact /= total;
+	Eigen::Vector2d estimated = sampler.means.bottomRows(2).rowwise().mean();
+	ASSERT_LT((estimated - exact).cwiseAbs().maxCoeff(), 0.05);
+
+	// Gaussian visible: free units are real valued and finite
+	auto rbm_gauss = GBRBM(4, 3);
+	auto sampler_gauss = MaskedSampler<GBRBM>(std::mt19937(0));
+	sampler_gauss.sweepSize = 5;
+	sampler_gauss.run(rbm_gauss, observed, mask);
+	ASSERT_TRUE(sampler_gauss.samples.topRows(2) == observed.topRows(2));
+	ASSERT_TRUE(sampler_gauss.means.allFinite());
+	ASSERT_GT((sampler_gauss.samples.bottomRows(2).array() != 0.0).count(), 0);
+}
+
+TEST(GeneralizeRBMTrainTest, TrainExactGaussianTest) {
+	auto rbm = GBRBM(1, 3);
+	rbm.params.w << 0.8, -0.5, 0.3;
+	rbm.params.b << 0.2;
+	rbm.params.c << -0.1, 0.4, 0.0;
+	rbm.params.lambda << 2.0;
+
+	// log Z against quadrature over v and a sum over h
+	double z = 0.0, ev = 0.0;
+	const double dv = 1e-3;
+	for (double v = -12.0; v < 12.0; v += dv) {
+		for (int state = 0; state < 8; state++) {
+			Eigen::Vector3d h(state & 1, (state >> 1) & 1, (state >> 2) & 1);
+			auto p = exp(-rbm.params.lambda(0) * v * v / 2.0 + rbm.params.b(0) * v + rbm.params.c.dot(h) + v * rbm.params.w.row(0).dot(h)) * dv;
+			z += p;
+			ev += p * v;
+		}
+	}
+	ASSERT_NEAR(rbm.getLogNormalConstant(), log(z), 1e-6);
+
+	auto moments = GaussianExact::moments(rbm.params.b, rbm.params.c, rbm.params.w, rbm.params.lambda, std::vector<double>{ 0.0, 1.0 });
+	ASSERT_NEAR(moments.visible(0), ev / z, 1e-6);
+
+	// exact training increases the true log-likelihood
+	auto dataset = std::vector< std::vector<double>>{ { 1.0 }, { 1.2 }, { -0.3 }, { 0.9 } };
+	auto rbm_train = Trainer<GBRBM, OptimizerType::Default>(rbm);
+	auto before = rbm_train.logLikeliHood(rbm, dataset);
+	rbm_train.epoch = 20;
+	rbm_train.trainExact(rbm, dataset);
+	ASSERT_GT(rbm_train.logLikeliHood(rbm, dataset), before);
+
+	// multi-valued hidden units: the Gray-code walk matches a direct sum
+	auto rbm_gen = GeneralizedGRBM(3, 4);
+	rbm_gen.setHiddenMin(-1.0);
+	rbm_gen.setHiddenMax(1.0);
+	rbm_gen.setHiddenDiveSize(2);
+	rbm_gen.params.w = Eigen::MatrixXd::Random(3, 4) * 0.5;
+	rbm_gen.params.c = Eigen::VectorXd::Random(4);
+	auto values = rbm_gen.splitHiddenSet();
+	double log_sum = -std::numeric_limits<double>::infinity();
+	for (int state = 0; state < 81; state++) {
+		Eigen::VectorXd h(4);
+		for (int j = 0, q = state; j < 4; j++, q /= 3) h(j) = values[q % 3];
+		Eigen::VectorXd a = rbm_gen.params.b + rbm_gen.params.w * h;
+		auto s = rbm_gen.params.c.dot(h) + a.cwiseAbs2().cwiseQuotient(rbm_gen.params.lambda).sum() / 2.0;
+		log_sum = std::max(log_sum, s) + log1p(exp(-std::abs(log_sum - s)));
+	}
+	log_sum += 0.5 * (2.0 * 3.14159265358979323846 * rbm_gen.params.lambda.cwiseInverse().array()).log().sum();
+	ASSERT_NEAR(rbm_gen.getLogNormalConstant(), log_sum, 1e-9);
+}
+
+TEST(GeneralizeRBMTrainTest, TrainBatchGaussianTest) {
+	auto rbm = GBRBM(2, 3);
+	rbm.params.w.setConstant(0.1);
+	rbm.params.lambda.setConstant(1.0);
+
+	// data concentrated around (1, -1): the precision has to grow
+	std::mt19937 mt(0);
+	std::normal_distribution<double> dist(0.0, 0.3);
+	auto dataset = std::vector<std::vector<double>>(200);
+	for (auto & data : dataset) data = { 1.0 + dist(mt), -1.0 + dist(mt) };
+
+	auto rbm_train = Trainer<GBRBM, OptimizerType::AdaMax>(rbm);
+	rbm_train.batchSize = 50;
+	rbm_train.cdk = 1;
+	rbm_train.persistent = true;
+	rbm_train.epoch = 3000;
+	auto before = rbm_train.logLikeliHood(rbm, dataset);
+	rbm_train.train(rbm, dataset);
+
+	ASSERT_TRUE(rbm.params.w.allFinite());
+	ASSERT_TRUE((rbm.params.lambda.array() > 1.0).all());
+	ASSERT_GT(rbm_train.logLikeliHood(rbm, dataset), before);
+}
+
+TEST(GeneralizeRBMTrainTest, FullSparseKernelTest) {
+	auto params = GeneralizedFullSparseRBMParamator(3, 2);
+	params.b = Eigen::VectorXd::Random(3);
+	params.c = Eigen::VectorXd::Random(2);
+	params.w = Eigen::MatrixXd::Random(3, 2);
+	params.sparseC = Eigen::VectorXd::Random(2);
+	params.sparseW = Eigen::MatrixXd::Random(3, 2) * 0.5;
+	auto values = std::vector<double>{ -1.0, 0.0, 0.5, 1.0 };
+	auto kernel = GeneralizedFullSparseRBMKernel(params, values);
+
+	Eigen::MatrixXd v_batch(3, 3);
+	v_batch << 0, 1, 1,
+		1, 0, 1,
+		0, 0, 1;
+	Eigen::MatrixXd field_batch, log_z, hidden, sparse;
+	kernel.fields(v_batch, field_batch);
+	kernel.logNormalizer(field_batch, log_z);
+	kernel.moments(field_batch, hidden, sparse);
+	auto log_marginal = kernel.logMarginal(v_batch);
+
+	// scalar reference: separate passes for mu and mu*, then a sum over every hidden configuration
+	for (int n = 0; n < 3; n++) {
+		Eigen::VectorXd v = v_batch.col(n);
+		double marginal = 0.0;
+		for (int state = 0; state < 16; state++) {
+			Eigen::Vector2d h(values[state % 4], values[state / 4]);
+			double energy = -params.b.dot(v);
+			for (int j = 0; j < 2; j++) {
+				auto mu_j = params.c(j) + params.w.col(j).dot(v);
+				auto mu_star_j = exp(params.sparseC(j) + params.sparseW.col(j).dot(v));
+				energy += -mu_j * h(j) + mu_star_j * std::abs(h(j));
+			}
+			marginal += exp(-energy);
+		}
+		ASSERT_NEAR(log_marginal(n), log(marginal), 1e-9);
+
+		for (int j = 0; j < 2; j++) {
+			auto mu_j = params.c(j) + params.w.col(j).dot(v);
+			auto mu_star_j = exp(params.sparseC(j) + params.sparseW.col(j).dot(v));
+			ASSERT_NEAR(field_batch(j, n), mu_j, 1e-12);
+			ASSERT_NEAR(field_batch(2 + j, n), mu_star_j, 1e-12);
+
+			double z = 0.0, e_h = 0.0, e_sparse = 0.0;
+			for (auto h : values) {
+				auto p = exp(mu_j * h - mu_star_j * std::abs(h));
+				z += p;
+				e_h += h * p;
+				e_sparse += -mu_star_j * std::abs(h) * p;
+			}
+			ASSERT_NEAR(log_z(j, n), log(z), 1e-12);
+			ASSERT_NEAR(hidden(j, n), e_h / z, 1e-12);
+			ASSERT_NEAR(sparse(j, n), e_sparse / z, 1e-12);
+		}
+	}
+
+	// the visible sweep keeps its incrementally updated fields in step with a fresh GEMM
+	std::mt19937 mt(0);
+	Eigen::MatrixXd h_batch, raw_batch, raw_check;
+	kernel.sampleHidden(field_batch, mt, h_batch);
+	Eigen::VectorXd v = v_batch.col(0);
+	kernel.rawFields(v_batch.col(0), raw_batch);
+	Eigen::VectorXd raw_field = raw_batch.col(0);
+	for (int sweep = 0; sweep < 20; sweep++) {
+		kernel.sampleVisible(h_batch.col(0), mt, v, raw_field);
+	}
+	kernel.rawFields(v, raw_check);
+	ASSERT_TRUE(raw_field.isApprox(raw_check.col(0), 1e-12));
+}
+
+TEST(GeneralizeRBMTrainTest, BinaryCheckpointTest) {
+	auto rbm = GeneralizedRBM(6, 4);
+	rbm.setHiddenMin(-1.0);
+	rbm.setHiddenMax(1.0);
+	rbm.setHiddenDivSize(3);
+	rbm.params.initParamsRandom(-0.5, 0.5, 7);
+	auto path = std::string("binary_checkpoint_test.ckpt");
+	rbmckpt::saveModel(rbm, path);
+
+	// the arrays are read in place from the mapping
+	{
+		rbmckpt::Reader reader(path);
+		ASSERT_EQ(reader.modelType(), "GeneralizedRBM");
+		auto w = reader.matrix("w");
+		ASSERT_EQ(reinterpret_cast<uintptr_t>(w.data()) % rbmckpt::Alignment, 0u);
+		ASSERT_TRUE(w == rbm.params.w);
+		ASSERT_EQ(reader.vector("hiddenValues").size(), 4);
+	}
+
+	auto restored = GeneralizedRBM(6, 4);
+	rbmckpt::loadModel(restored, path);
+	ASSERT_TRUE(restored.params.w == rbm.params.w);
+	ASSERT_TRUE(restored.params.b == rbm.params.b);
+	ASSERT_TRUE(restored.params.c == rbm.params.c);
+	ASSERT_EQ(restored.getHiddenDivSize(), 3u);
+	ASSERT_EQ(restored.splitHiddenSet(), rbm.splitHiddenSet());
+
+	// wrong shape and wrong model type are rejected
+	auto other_shape = GeneralizedRBM(5, 4);
+	ASSERT_THROW(rbmckpt::loadModel(other_shape, path), std::runtime_error);
+	auto other_model = GBRBM(6, 4);
+	ASSERT_THROW(rbmckpt::loadModel(other_model, path), std::runtime_error);
+
+	// a flipped byte in the payload fails the checksum
+	{
+		std::fstream fs(path, std::ios::in | std::ios::out | std::ios::binary);
+		fs.seekg(-8, std::ios::end);
+		char byte;
+		fs.read(&byte, 1);
+		byte ^= 0x10;
+		fs.seekp(-8, std::ios::end);
+		fs.write(&byte, 1);
+	}
+	ASSERT_THROW(rbmckpt::Reader reader(path), std::runtime_error);
+	std::remove(path.c_str());
+}
+
+TEST(GeneralizeRBMTrainTest, ResumeTrainingTest) {
+	auto rbm = GeneralizedRBM(6, 3);
+	rbm.setHiddenMin(-1.0);
+	rbm.setHiddenMax(1.0);
+	rbm.setHiddenDivSize(2);
+	rbm.params.initParamsXavier(0);
+
+	auto dataset = std::vector< std::vector<double>>();
+	dataset.push_back(std::vector<double>{ -1, 1, -1, 1, -1, 1 });
+	dataset.push_back(std::vector<double>{ 1, 1, 1, 1, -1, 1 });
+	dataset.push_back(std::vector<double>{ -1, 1, -1, 1, 1, 1 });
+	dataset.push_back(std::vector<double>{ -1, -1, -1, 1, -1, -1 });
+
+	auto make_trainer = [](GeneralizedRBM & rbm, unsigned seed) {
+		auto trainer = Trainer<GeneralizedRBM, OptimizerType::AdaMax>(rbm);
+		trainer.batchSize = 2;
+		trainer.cdk = 2;
+		trainer.replicaSize = 3;
+		trainer.randDevice = std::mt19937(seed);
+		return trainer;
+	};
+
+	// uninterrupted run
+	auto rbm_full = rbm;
+	auto trainer_full = make_trainer(rbm_full, 5);
+	for (int e = 0; e < 6; e++) {
+		trainer_full.trainOncePT(rbm_full, dataset);
+	}
+
+	// preempted after 3 epochs; the checkpoint is written from a snapshot on another thread
+	auto path = std::string("resume_training_test.ckpt");
+	std::remove(path.c_str());
+	{
+		auto rbm_first = rbm;
+		auto trainer_first = make_trainer(rbm_first, 5);
+		CheckpointScheduler<GeneralizedRBM, Trainer<GeneralizedRBM, OptimizerType::AdaMax>> scheduler(path, 3);
+		for (int e = 0; e < 3; e++) {
+			trainer_first.trainOncePT(rbm_first, dataset);
+			if (scheduler.isCheckpointEpoch(e, 6)) scheduler.publish(rbm_first, trainer_first, e);
+		}
+		scheduler.wait();
+	}
+
+	// a fresh process with a different seed resumes from the checkpoint without redoing epochs
+	auto rbm_resumed = GeneralizedRBM(6, 3);
+	auto trainer_resumed = make_trainer(rbm_resumed, 99);
+	CheckpointScheduler<GeneralizedRBM, Trainer<GeneralizedRBM, OptimizerType::AdaMax>> scheduler(path, 3);
+	auto start = scheduler.resume(rbm_resumed, trainer_resumed);
+	ASSERT_EQ(start, 3);
+	for (int e = start; e < 6; e++) {
+		trainer_resumed.trainOncePT(rbm_resumed, dataset);
+	}
+
+	ASSERT_TRUE(rbm_resumed.params.b == rbm_full.params.b);
+	ASSERT_TRUE(rbm_resumed.params.c == rbm_full.params.c);
+	ASSERT_TRUE(rbm_resumed.params.w == rbm_full.params.w);
+	ASSERT_EQ(rbm_resumed.splitHiddenSet(), rbm_full.splitHiddenSet());
+	std::remove(path.c_str());
+}
+
+TEST(GeneralizeRBMTrainTest, HostedModelViewTest) {
+	auto rbm = GeneralizedRBM(5, 3);
+	rbm.setHiddenMin(-1.0);
+	rbm.setHiddenMax(1.0);
+	rbm.setHiddenDivSize(2);
+	rbm.params.initParamsRandom(-0.5, 0.5, 3);
+	auto path = std::string("hosted_model_test.ckpt");
+	rbmckpt::saveModel(rbm, path);
+
+	ModelHost<GeneralizedRBMView> host(path);
+	auto view = host.current();
+	ASSERT_EQ(view->getVisibleSize(), 5u);
+	ASSERT_EQ(view->getHiddenSize(), 3u);
+
+	// the view agrees with the owning model
+	Eigen::MatrixXd v_batch(5, 2);
+	v_batch.col(0) << -1, 1, -1, 1, 1;
+	v_batch.col(1) << 1, 1, -1, -1, 1;
+	auto log_marginal = view->logMarginal(v_batch);
+	auto z = rbm.getNormalConstant();
+	for (int n = 0; n < v_batch.cols(); n++) {
+		std::vector<double> data(v_batch.col(n).data(), v_batch.col(n).data() + v_batch.rows());
+		ASSERT_NEAR(log_marginal(n) - log(z), log(rbm.probVis(data, z)), 1e-10);
+	}
+
+	Eigen::MatrixXd mu_batch, h_batch;
+	view->muBatch(v_batch, mu_batch);
+	view->actHiddenBatch(mu_batch, h_batch);
+	rbm.nodes.v = v_batch.col(0);
+	for (int j = 0; j < 3; j++) ASSERT_NEAR(h_batch(j, 0), rbm.actHidJ(j), 1e-12);
+
+	auto sampler = Sampler<GeneralizedRBMView>(std::mt19937(0));
+	Eigen::MatrixXd h_sample, v_sample;
+	sampler.sampleHiddenBatch(*view, v_batch, h_sample);
+	sampler.sampleVisibleBatch(*view, h_sample, v_sample);
+	ASSERT_TRUE((v_sample.array().abs() == 1.0).all());
+
+	// nothing new published
+	ASSERT_FALSE(host.refresh());
+
+	// publishing a new version swaps the hosted view; the old view stays readable
+	auto next = rbm;
+	next.params.w *= 2.0;
+	rbmckpt::saveModel(next, path);
+	ASSERT_TRUE(host.refresh());
+	ASSERT_EQ(host.getVersion(), 1u);
+	ASSERT_TRUE(host.current()->w == next.params.w);
+	ASSERT_TRUE(view->w == rbm.params.w);
+
+	GeneralizedRBM restored;
+	host.current()->copyTo(restored);
+	ASSERT_TRUE(restored.params.w == next.params.w);
+	ASSERT_EQ(restored.splitHiddenSet(), rbm.splitHiddenSet());
+	std::remove(path.c_str());
+}
+
+TEST(GeneralizeRBMTrainTest, DataParallelTrainTest) {
+	// workers are threads here, each attaching its own mapping exactly like a separate process would
+	auto path = std::string("data_parallel_test.shm");
+	int workers = 3;
+
+	// all-reduce split into several chunks by a small capacity
+	SharedMemoryCommunicator::create(path, workers, 4);
+	std::vector<std::vector<double>> reduced(workers);
+	{
+		std::vector<std::thread> threads;
+		for (int r = 0; r < workers; r++) {
+			threads.emplace_back([&, r] {
+				SharedMemoryCommunicator comm(path, r, workers);
+				std::vector<double> data(10);
+				for (int i = 0; i < 10; i++) data[i] = 100.0 * r + i;
+				comm.allReduceSum(data.data(), data.size());
+				reduced[r] = data;
+			});
+		}
+		for (auto & thread : threads) thread.join();
+	}
+	for (int r = 0; r < workers; r++) {
+		for (int i = 0; i < 10; i++) ASSERT_EQ(reduced[r][i], 300.0 + 3.0 * i);
+	}
+
+	// exact training on shards reproduces single-worker training on the whole dataset
+	auto dataset = std::vector<std::vector<double>>{
+		{ 0, 1, 0, 1, 0 }, { 1, 1, 1, 1, 0 }, { 0, 1, 0, 1, 1 }, { 0, 0, 0, 1, 0 }, { 1, 0, 1, 0, 1 }, { 1, 1, 0, 0, 1 }
+	};
+	auto rbm = GeneralizedRBM(5, 3);
+	rbm.params.initParamsRandom(-0.5, 0.5, 1);
+
+	auto rbm_single = rbm;
+	auto trainer_single = Trainer<GeneralizedRBM, OptimizerType::AdaMax>(rbm_single);
+	for (int e = 0; e < 20; e++) trainer_single.trainOnceExact(rbm_single, dataset);
+
+	SharedMemoryCommunicator::create(path, workers);
+	std::vector<GeneralizedRBM> models(workers, rbm);
+	{
+		std::vector<std::thread> threads;
+		for (int r = 0; r < workers; r++) {
+			threads.emplace_back([&, r] {
+				SharedMemoryCommunicator comm(path, r, workers);
+				// uneven shards: the mean is weighted by each worker's batch size
+				int bounds[] = { 0, 3, 4, 6 };
+				auto shard = std::vector<std::vector<double>>(dataset.begin() + bounds[r], dataset.begin() + bounds[r + 1]);
+				auto trainer = Trainer<GeneralizedRBM, OptimizerType::AdaMax>(models[r]);
+				trainer.communicator = &comm;
+				for (int e = 0; e < 20; e++) trainer.trainOnceExact(models[r], shard);
+			});
+		}
+		for (auto & thread : threads) thread.join();
+	}
+	for (int r = 0; r < workers; r++) {
+		ASSERT_TRUE(models[r].params.w == models[0].params.w);
+		ASSERT_TRUE(models[r].params.b == models[0].params.b);
+		ASSERT_TRUE(models[r].params.c == models[0].params.c);
+	}
+	ASSERT_TRUE(models[0].params.w.isApprox(rbm_single.params.w, 1e-10));
+	ASSERT_TRUE(models[0].params.b.isApprox(rbm_single.params.b, 1e-10));
+
+	// PCD: chains stay per worker, parameters stay in lockstep
+	auto rbm_gauss = GBRBM(2, 3);
+	rbm_gauss.params.w.setConstant(0.1);
+	std::vector<GBRBM> gauss_models(workers, rbm_gauss);
+	{
+		std::vector<std::thread> threads;
+		for (int r = 0; r < workers; r++) {
+			threads.emplace_back([&, r] {
+				SharedMemoryCommunicator comm(path, r, workers);
+				std::mt19937 mt(r);
+				std::normal_distribution<double> dist(0.0, 0.3);
+				auto shard = std::vector<std::vector<double>>(40);
+				for (auto & data : shard) data = { 1.0 + dist(mt), -1.0 + dist(mt) };
+
+				auto trainer = Trainer<GBRBM, OptimizerType::AdaMax>(gauss_models[r]);
+				trainer.communicator = &comm;
+				trainer.randDevice = std::mt19937(r);
+				trainer.batchSize = 10;
+				trainer.cdk = 1;
+				trainer.persistent = true;
+				trainer.epoch = 50;
+				trainer.train(gauss_models[r], shard);
+			});
+		}
+		for (auto & thread : threads) thread.join();
+	}
+	for (int r = 0; r < workers; r++) {
+		ASSERT_TRUE(gauss_models[r].params.w.allFinite());
+		ASSERT_TRUE(gauss_models[r].params.w == gauss_models[0].params.w);
+		ASSERT_TRUE(gauss_models[r].params.lambda == gauss_models[0].params.lambda);
+	}
+	ASSERT_FALSE(gauss_models[0].params.w.isApprox(rbm_gauss.params.w));
+	std::remove(path.c_str());
+}
+
+TEST(GeneralizeRBMTrainTest, TrainAsyncTest) {
+	auto dataset = std::vector<std::vector<double>>{
+		{ 1, 1, 1, -1, -1, -1 }, { 1, 1, 1, -1, -1, -1 }, { -1, -1, -1, 1, 1, 1 }, { -1, -1, -1, 1, 1, 1 }, { 1, 1, -1, -1, -1, -1 }
+	};
+	auto rbm = GeneralizedRBM(6, 5);
+	rbm.params.initParamsRandom(-0.01, 0.01, 0);
+
+	auto rbm_train = Trainer<GeneralizedRBM, OptimizerType::Default>(rbm);
+	rbm_train.randDevice = std::mt19937(0);
+	rbm_train.asyncThreads = 4;
+	rbm_train.asyncBlockSize = 2;  // several locks, one of them covering a partial block
+	rbm_train.batchSize = 2;
+	rbm_train.cdk = 1;
+	rbm_train.learningRate = 0.05;
+	rbm_train.epoch = 2000;
+
+	auto before = rbm_train.logLikeliHood(rbm, dataset);
+	rbm_train.trainAsync(rbm, dataset);
+
+	ASSERT_TRUE(rbm.params.w.allFinite());
+	ASSERT_TRUE(rbm.params.b.allFinite());
+	ASSERT_TRUE(rbm.params.c.allFinite());
+	ASSERT_GT(rbm_train.logLikeliHood(rbm, dataset), before + 1.0);
+}
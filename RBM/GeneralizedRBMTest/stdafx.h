@@ -12,5 +12,9 @@
 #include <gtest/gtest.h>
 #include <iostream>
 #include <numeric>
+#include <cmath>
+
+using std::isnan;
+using std::isinf;
 
 // TODO: プログラムに必要な追加ヘッダーをここで参照してください
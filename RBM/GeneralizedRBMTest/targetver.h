@@ -5,4 +5,6 @@
 // 以前の Windows プラットフォーム用にアプリケーションをビルドする場合は、WinSDKVer.h をインクルードし、
 // SDKDDKVer.h をインクルードする前に、サポート対象とするプラットフォームを示すように _WIN32_WINNT マクロを設定します。
 
+#ifdef _WIN32
 #include <SDKDDKVer.h>
+#endif
@@ -0,0 +1,191 @@
+﻿#pragma once
+#include <string>
+#include <vector>
+#include <map>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+
+namespace rbmbench {
+
+	// 最適化で計算が消されないように値を書き込む先
+	inline void keep(double value) {
+		static volatile double sink;
+		sink = value;
+	}
+
+	// 1ワークロード分の計測結果
+	struct BenchResult {
+		std::string name;  // ワークロード名
+		std::string model;  // モデル種別
+		int vSize = 0;
+		int hSize = 0;
+		long long iterations = 0;  // 1回の計測で回した回数
+		int repeats = 0;  // 計測回数
+		double medianNs = 0.0;  // 1回あたりの時間(中央値)
+		double minNs = 0.0;
+		double maxNs = 0.0;
+		double baselineNs = 0.0;  // ベースラインの中央値(無ければ0)
+
+		// ベースラインとの比較キー
+		std::string key() const {
+			return name + "/" + model + "/" + std::to_string(vSize) + "x" + std::to_string(hSize);
+		}
+
+		// ベースライン比(1より大きければ遅くなった)
+		double ratio() const {
+			return baselineNs > 0.0 ? medianNs / baselineNs : 0.0;
+		}
+	};
+
+	// ワークロードを計測し, 結果をCSVで入出力する
+	class BenchRunner {
+	public:
+		int repeats = 5;  // 計測回数(中央値を取る)
+		double minTime = 0.05;  // 1回の計測で最低限回す時間[sec]
+		long long maxIterations = 1000000;
+		std::string filter = "";  // ワークロード名に含まれる文字列で絞り込む
+
+	protected:
+		std::vector<BenchResult> _results;
+
+	public:
+		BenchRunner() = default;
+		~BenchRunner() = default;
+
+		// 絞り込み条件に合うか
+		bool isEnabled(const std::string & name, const std::string & model) {
+			return filter.empty() || (name + "/" + model).find(filter) != std::string::npos;
+		}
+
+		// bodyを繰り返し呼んで1回あたりの時間を計測
+		// setupは計測ごとに呼ばれ, 時間には含まれない
+		void run(const std::string & name, const std::string & model, int v_size, int h_size, std::function<void()> body, std::function<void()> setup = nullptr) {
+			if (!isEnabled(name, model)) return;
+
+			auto measure = [&](long long iterations) {
+				if (setup) setup();
+				auto start = std::chrono::steady_clock::now();
+				for (long long n = 0; n < iterations; n++) body();
+				return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			};
+
+			// ウォームアップを兼ねて回数を決める
+			long long iterations = 1;
+			auto elapsed = measure(iterations);
+			while (elapsed < minTime && iterations < maxIterations) {
+				iterations = elapsed > 0.0 ? std::min(maxIterations, std::max(iterations * 2, static_cast<long long>(iterations * minTime / elapsed * 1.2))) : iterations * 10;
+				elapsed = measure(iterations);
+			}
+
+			std::vector<double> samples(repeats);
+			for (auto & sample : samples) {
+				sample = measure(iterations) * 1e9 / iterations;
+			}
+			std::sort(samples.begin(), samples.end());
+
+			BenchResult result;
+			result.name = name;
+			result.model = model;
+			result.vSize = v_size;
+			result.hSize = h_size;
+			result.iterations = iterations;
+			result.repeats = repeats;
+			result.medianNs = samples[samples.size() / 2];
+			result.minNs = samples.front();
+			result.maxNs = samples.back();
+			_results.push_back(result);
+
+			std::cerr << result.key() << ": " << result.medianNs << " ns" << std::endl;
+		}
+
+		std::vector<BenchResult> & getResults() {
+			return _results;
+		}
+
+		// ベースライン(以前の出力CSV)を読み込んで比較値を埋める
+		void applyBaseline(const std::string & path) {
+			auto baseline = readCsv(path);
+			std::map<std::string, double> median_map;
+			for (auto & result : baseline) {
+				median_map[result.key()] = result.medianNs;
+			}
+
+			for (auto & result : _results) {
+				auto it = median_map.find(result.key());
+				if (it != median_map.end()) result.baselineNs = it->second;
+			}
+		}
+
+		// ベースライン比がthresholdを超えて遅くなったワークロード数を返す
+		int countRegressions(double threshold) {
+			return static_cast<int>(std::count_if(_results.begin(), _results.end(), [&](BenchResult & result) {
+				return result.baselineNs > 0.0 && result.ratio() > 1.0 + threshold;
+			}));
+		}
+
+		// ベースラインとの比較表を出力
+		void printComparison(std::ostream & stream, double threshold) {
+			for (auto & result : _results) {
+				if (result.baselineNs <= 0.0) continue;
+
+				auto ratio = result.ratio();
+				auto status = ratio > 1.0 + threshold ? "SLOWER" : ratio < 1.0 - threshold ? "FASTER" : "same";
+				stream << result.key() << "\t" << result.baselineNs << " -> " << result.medianNs << " ns\t" << ratio << "\t" << status << "\n";
+			}
+		}
+
+		// CSVで出力
+		void writeCsv(std::ostream & stream) {
+			stream << "name,model,v_size,h_size,iterations,repeats,median_ns,min_ns,max_ns,baseline_ns,ratio" << "\n";
+			for (auto & result : _results) {
+				stream << result.name << "," << result.model << "," << result.vSize << "," << result.hSize << ","
+					<< result.iterations << "," << result.repeats << "," << result.medianNs << "," << result.minNs << ","
+					<< result.maxNs << "," << result.baselineNs << "," << result.ratio() << "\n";
+			}
+		}
+
+		void writeCsv(const std::string & path) {
+			std::ofstream file(path);
+			if (!file) throw std::runtime_error("cannot open " + path);
+			writeCsv(file);
+		}
+
+		// writeCsv()で出力したファイルを読み込む
+		static std::vector<BenchResult> readCsv(const std::string & path) {
+			std::ifstream file(path);
+			if (!file) throw std::runtime_error("cannot open " + path);
+
+			std::vector<BenchResult> results;
+			std::string line;
+			std::getline(file, line);  // ヘッダ
+			while (std::getline(file, line)) {
+				if (line.empty()) continue;
+
+				std::vector<std::string> cols;
+				std::stringstream ss(line);
+				std::string col;
+				while (std::getline(ss, col, ',')) cols.push_back(col);
+				if (cols.size() < 9) throw std::runtime_error("invalid benchmark file: " + path);
+
+				BenchResult result;
+				result.name = cols[0];
+				result.model = cols[1];
+				result.vSize = std::stoi(cols[2]);
+				result.hSize = std::stoi(cols[3]);
+				result.iterations = std::stoll(cols[4]);
+				result.repeats = std::stoi(cols[5]);
+				result.medianNs = std::stod(cols[6]);
+				result.minNs = std::stod(cols[7]);
+				result.maxNs = std::stod(cols[8]);
+				results.push_back(result);
+			}
+
+			return results;
+		}
+	};
+}
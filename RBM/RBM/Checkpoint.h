@@ -0,0 +1,458 @@
+﻿#pragma once
+#include "Eigen/Core"
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <memory>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// バイナリチェックポイント(パラメータ, 学習状態)
+// [ヘッダ 64B][エントリ表 96B x 個数][配列...(64Bアラインメント, 列優先のdouble)]
+// チェックサムはエントリ表以降のFNV-1a, 読み込みはmmapしてEigen::Mapで参照する(コピーなし)
+// JSON(serialize)はエクスポート用に残す
+// 学習の再開にはsaveTraining/loadTraining(モデル, トレーナー, オプティマイザ, 乱数, チェイン)を使う
+namespace rbmckpt {
+	const char Magic[8] = { 'R', 'B', 'M', 'C', 'K', 'P', 'T', '\0' };
+	const uint32_t Version = 1;
+	const uint64_t Alignment = 64;
+
+	enum class Kind : uint32_t {
+		Float64 = 0,
+		Bytes = 1,
+	};
+
+	struct FileHeader {
+		char magic[8];
+		uint32_t version;
+		uint32_t entryCount;
+		uint64_t fileSize;
+		uint64_t checksum;
+		char modelType[32];
+	};
+	static_assert(sizeof(FileHeader) == 64, "FileHeader must be 64 bytes");
+
+	struct Entry {
+		char name[56];
+		uint32_t kind;
+		uint32_t reserved;
+		uint64_t rows;
+		uint64_t cols;
+		uint64_t offset;  // ファイル先頭からの位置
+		uint64_t bytes;
+	};
+	static_assert(sizeof(Entry) == 96, "Entry must be 96 bytes");
+
+	inline uint64_t fnv1a(const char * data, size_t size, uint64_t hash = 14695981039346656037ULL) {
+		for (size_t k = 0; k < size; k++) {
+			hash ^= static_cast<unsigned char>(data[k]);
+			hash *= 1099511628211ULL;
+		}
+		return hash;
+	}
+
+	inline uint64_t alignUp(uint64_t value) {
+		return (value + Alignment - 1) / Alignment * Alignment;
+	}
+
+	// 一時ファイルを置き換える(同じディレクトリ内なのでアトミック)
+	inline void replaceFile(const std::string & tmp_path, const std::string & path) {
+#ifdef _WIN32
+		if (!MoveFileExA(tmp_path.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING)) throw std::runtime_error("rbmckpt: cannot replace " + path);
+#else
+		if (std::rename(tmp_path.c_str(), path.c_str()) != 0) throw std::runtime_error("rbmckpt: cannot replace " + path);
+#endif
+	}
+
+	class Writer {
+	protected:
+		struct Item {
+			std::string name;
+			Kind kind;
+			uint64_t rows;
+			uint64_t cols;
+			const char * data;
+			uint64_t bytes;
+		};
+
+		std::string _modelType;
+		std::vector<Item> _items;
+		std::vector<std::unique_ptr<std::vector<char>>> _owned;  // スカラー等の実体
+
+	public:
+		Writer() = default;
+		~Writer() = default;
+
+		void setModelType(const std::string & model_type) {
+			if (model_type.size() >= sizeof(FileHeader::modelType)) throw std::runtime_error("rbmckpt: model type too long");
+			_modelType = model_type;
+		}
+
+		// 配列を登録(コピーしないので書き出しまで保持すること)
+		void add(const std::string & name, const double * data, uint64_t rows, uint64_t cols) {
+			push(name, Kind::Float64, rows, cols, reinterpret_cast<const char *>(data), rows * cols * sizeof(double));
+		}
+		void add(const std::string & name, const Eigen::MatrixXd & value) {
+			add(name, value.data(), value.rows(), value.cols());
+		}
+		void add(const std::string & name, const Eigen::VectorXd & value) {
+			add(name, value.data(), value.rows(), 1);
+		}
+		void add(const std::string & name, Eigen::MatrixXd && value) = delete;
+		void add(const std::string & name, Eigen::VectorXd && value) = delete;
+
+		// 値をコピーして登録
+		void addVector(const std::string & name, const std::vector<double> & value) {
+			auto & owned = own(reinterpret_cast<const char *>(value.data()), value.size() * sizeof(double));
+			push(name, Kind::Float64, value.size(), 1, owned.data(), owned.size());
+		}
+		void addScalar(const std::string & name, double value) {
+			addVector(name, std::vector<double>{ value });
+		}
+		void addBytes(const std::string & name, const std::string & value) {
+			auto & owned = own(value.data(), value.size());
+			push(name, Kind::Bytes, value.size(), 1, owned.data(), owned.size());
+		}
+
+		// 書き出す(一時ファイルに書いてから置き換える)
+		void write(const std::string & path) const {
+			auto tmp_path = path + ".tmp";
+			std::ofstream ofs(tmp_path, std::ios::binary | std::ios::trunc);
+			if (!ofs) throw std::runtime_error("rbmckpt: cannot open " + tmp_path);
+
+			// 配置を決める
+			std::vector<Entry> entries(_items.size());
+			uint64_t position = alignUp(sizeof(FileHeader) + sizeof(Entry) * _items.size());
+			for (size_t k = 0; k < _items.size(); k++) {
+				auto & entry = entries[k];
+				std::memset(&entry, 0, sizeof(Entry));
+				std::memcpy(entry.name, _items[k].name.data(), _items[k].name.size());
+				entry.kind = static_cast<uint32_t>(_items[k].kind);
+				entry.rows = _items[k].rows;
+				entry.cols = _items[k].cols;
+				entry.offset = position;
+				entry.bytes = _items[k].bytes;
+				position = alignUp(position + entry.bytes);
+			}
+
+			FileHeader header;
+			std::memset(&header, 0, sizeof(FileHeader));
+			std::memcpy(header.magic, Magic, sizeof(Magic));
+			header.version = Version;
+			header.entryCount = static_cast<uint32_t>(entries.size());
+			header.fileSize = position;
+			std::memcpy(header.modelType, _modelType.data(), _modelType.size());
+
+			// ヘッダは最後に書き直す
+			ofs.write(reinterpret_cast<const char *>(&header), sizeof(FileHeader));
+			auto hash = fnv1a(reinterpret_cast<const char *>(entries.data()), sizeof(Entry) * entries.size());
+			ofs.write(reinterpret_cast<const char *>(entries.data()), sizeof(Entry) * entries.size());
+
+			const std::vector<char> padding(Alignment, 0);
+			uint64_t written = sizeof(FileHeader) + sizeof(Entry) * entries.size();
+			for (size_t k = 0; k < _items.size(); k++) {
+				auto gap = entries[k].offset - written;
+				hash = fnv1a(padding.data(), gap, hash);
+				ofs.write(padding.data(), gap);
+				hash = fnv1a(_items[k].data, _items[k].bytes, hash);
+				ofs.write(_items[k].data, _items[k].bytes);
+				written = entries[k].offset + entries[k].bytes;
+			}
+			hash = fnv1a(padding.data(), position - written, hash);
+			ofs.write(padding.data(), position - written);
+
+			header.checksum = hash;
+			ofs.seekp(0);
+			ofs.write(reinterpret_cast<const char *>(&header), sizeof(FileHeader));
+			ofs.close();
+			if (!ofs) throw std::runtime_error("rbmckpt: write failed " + tmp_path);
+
+			replaceFile(tmp_path, path);
+		}
+
+	protected:
+		void push(const std::string & name, Kind kind, uint64_t rows, uint64_t cols, const char * data, uint64_t bytes) {
+			if (name.empty() || name.size() >= sizeof(Entry::name)) throw std::runtime_error("rbmckpt: invalid entry name " + name);
+			for (auto & item : _items) {
+				if (item.name == name) throw std::runtime_error("rbmckpt: duplicate entry " + name);
+			}
+			_items.push_back(Item{ name, kind, rows, cols, data, bytes });
+		}
+
+		std::vector<char> & own(const char * data, size_t size) {
+			_owned.emplace_back(new std::vector<char>(data, data + size));
+			return *_owned.back();
+		}
+	};
+
+	// mmapで読み込む(配列はファイルを直接参照するので, Readerより長く持たないこと)
+	class Reader {
+	protected:
+		const char * _data = nullptr;
+		size_t _size = 0;
+#ifdef _WIN32
+		HANDLE _file = INVALID_HANDLE_VALUE;
+		HANDLE _mapping = nullptr;
+#else
+		int _fd = -1;
+#endif
+
+	public:
+		explicit Reader(const std::string & path, bool verify = true) {
+			open(path);
+			try {
+				validate(verify);
+			}
+			catch (...) {
+				close();
+				throw;
+			}
+		}
+		Reader(const Reader &) = delete;
+		Reader & operator=(const Reader &) = delete;
+		~Reader() {
+			close();
+		}
+
+		const FileHeader & header() const {
+			return *reinterpret_cast<const FileHeader *>(_data);
+		}
+
+		std::string modelType() const {
+			return std::string(header().modelType, strnlen(header().modelType, sizeof(FileHeader::modelType)));
+		}
+
+		bool has(const std::string & name) const {
+			return lookup(name) != nullptr;
+		}
+
+		Eigen::Map<const Eigen::MatrixXd> matrix(const std::string & name) const {
+			auto & entry = find(name, Kind::Float64);
+			return Eigen::Map<const Eigen::MatrixXd>(reinterpret_cast<const double *>(_data + entry.offset), entry.rows, entry.cols);
+		}
+
+		Eigen::Map<const Eigen::VectorXd> vector(const std::string & name) const {
+			auto & entry = find(name, Kind::Float64);
+			return Eigen::Map<const Eigen::VectorXd>(reinterpret_cast<const double *>(_data + entry.offset), entry.rows * entry.cols);
+		}
+
+		double scalar(const std::string & name) const {
+			auto & entry = find(name, Kind::Float64);
+			if (entry.rows * entry.cols != 1) throw std::runtime_error("rbmckpt: not a scalar " + name);
+			return *reinterpret_cast<const double *>(_data + entry.offset);
+		}
+
+		std::string bytes(const std::string & name) const {
+			auto & entry = find(name, Kind::Bytes);
+			return std::string(_data + entry.offset, entry.bytes);
+		}
+
+	protected:
+		const Entry * entries() const {
+			return reinterpret_cast<const Entry *>(_data + sizeof(FileHeader));
+		}
+
+		const Entry * lookup(const std::string & name) const {
+			for (uint32_t k = 0; k < header().entryCount; k++) {
+				if (name == std::string(entries()[k].name, strnlen(entries()[k].name, sizeof(Entry::name)))) return &entries()[k];
+			}
+			return nullptr;
+		}
+
+		const Entry & find(const std::string & name, Kind kind) const {
+			auto entry = lookup(name);
+			if (entry == nullptr) throw std::runtime_error("rbmckpt: missing entry " + name);
+			if (entry->kind != static_cast<uint32_t>(kind)) throw std::runtime_error("rbmckpt: wrong kind " + name);
+			return *entry;
+		}
+
+		void validate(bool verify) const {
+			if (_size < sizeof(FileHeader) || std::memcmp(header().magic, Magic, sizeof(Magic)) != 0) throw std::runtime_error("rbmckpt: not a checkpoint");
+			if (header().version != Version) throw std::runtime_error("rbmckpt: unsupported version " + std::to_string(header().version));
+			if (header().fileSize != _size) throw std::runtime_error("rbmckpt: truncated checkpoint");
+			if (sizeof(FileHeader) + sizeof(Entry) * static_cast<uint64_t>(header().entryCount) > _size) throw std::runtime_error("rbmckpt: broken entry table");
+			for (uint32_t k = 0; k < header().entryCount; k++) {
+				auto & entry = entries()[k];
+				if (entry.offset % Alignment != 0 || entry.offset + entry.bytes > _size) throw std::runtime_error("rbmckpt: broken entry");
+				if (entry.kind == static_cast<uint32_t>(Kind::Float64) && entry.rows * entry.cols * sizeof(double) != entry.bytes) throw std::runtime_error("rbmckpt: broken entry");
+			}
+			if (verify && fnv1a(_data + sizeof(FileHeader), _size - sizeof(FileHeader)) != header().checksum) throw std::runtime_error("rbmckpt: checksum mismatch");
+		}
+
+		void open(const std::string & path) {
+#ifdef _WIN32
+			_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+			if (_file == INVALID_HANDLE_VALUE) throw std::runtime_error("rbmckpt: cannot open " + path);
+			LARGE_INTEGER size;
+			GetFileSizeEx(_file, &size);
+			_size = static_cast<size_t>(size.QuadPart);
+			_mapping = _size > 0 ? CreateFileMappingA(_file, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+			_data = _mapping ? static_cast<const char *>(MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+#else
+			_fd = ::open(path.c_str(), O_RDONLY);
+			if (_fd < 0) throw std::runtime_error("rbmckpt: cannot open " + path);
+			struct stat st;
+			fstat(_fd, &st);
+			_size = static_cast<size_t>(st.st_size);
+			if (_size > 0) {
+				auto mapped = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, _fd, 0);
+				_data = mapped == MAP_FAILED ? nullptr : static_cast<const char *>(mapped);
+			}
+#endif
+			if (_data == nullptr) {
+				close();
+				throw std::runtime_error("rbmckpt: cannot map " + path);
+			}
+		}
+
+		void close() {
+#ifdef _WIN32
+			if (_data) UnmapViewOfFile(_data);
+			if (_mapping) CloseHandle(_mapping);
+			if (_file != INVALID_HANDLE_VALUE) CloseHandle(_file);
+			_mapping = nullptr;
+			_file = INVALID_HANDLE_VALUE;
+#else
+			if (_data) munmap(const_cast<char *>(_data), _size);
+			if (_fd >= 0) ::close(_fd);
+			_fd = -1;
+#endif
+			_data = nullptr;
+		}
+	};
+
+	namespace detail {
+		// 隠れ変数の値の設定を持つモデル(Generalized系)
+		template <class RBM>
+		auto writeHiddenConfig(Writer & writer, RBM & rbm, int) -> decltype(rbm.getHiddenDivSize(), rbm.getHiddenMin(), rbm.getHiddenMax(), rbm.splitHiddenSet(), void()) {
+			writer.addScalar("hiddenMin", rbm.getHiddenMin());
+			writer.addScalar("hiddenMax", rbm.getHiddenMax());
+			writer.addScalar("hiddenDivSize", static_cast<double>(rbm.getHiddenDivSize()));
+			writer.addVector("hiddenValues", rbm.splitHiddenSet());
+		}
+		template <class RBM>
+		void writeHiddenConfig(Writer &, RBM &, long) {}
+
+		template <class RBM>
+		auto writeRealFlag(Writer & writer, RBM & rbm, int) -> decltype(rbm.isRealHiddenValue(), void()) {
+			writer.addScalar("hiddenRealFlag", rbm.isRealHiddenValue() ? 1.0 : 0.0);
+		}
+		template <class RBM>
+		void writeRealFlag(Writer &, RBM &, long) {}
+
+		// 分割数の設定はモデルによって名前が違う(setHiddenDivSize, setHiddenDiveSize)
+		template <class RBM>
+		auto setDivSize(RBM & rbm, size_t div_size, int) -> decltype(rbm.setHiddenDivSize(div_size), void()) {
+			rbm.setHiddenDivSize(div_size);
+		}
+		template <class RBM>
+		auto setDivSize(RBM & rbm, size_t div_size, long) -> decltype(rbm.setHiddenDiveSize(div_size), void()) {
+			rbm.setHiddenDiveSize(div_size);
+		}
+
+		template <class RBM>
+		auto readHiddenConfig(Reader & reader, RBM & rbm, int) -> decltype(setDivSize(rbm, 1, 0), rbm.setHiddenMin(0.0), rbm.setHiddenMax(1.0), void()) {
+			if (!reader.has("hiddenDivSize")) return;
+			rbm.setHiddenMin(reader.scalar("hiddenMin"));
+			rbm.setHiddenMax(reader.scalar("hiddenMax"));
+			setDivSize(rbm, static_cast<size_t>(reader.scalar("hiddenDivSize")), 0);
+		}
+		template <class RBM>
+		void readHiddenConfig(Reader &, RBM &, long) {}
+
+		template <class RBM>
+		auto readRealFlag(Reader & reader, RBM & rbm, int) -> decltype(rbm.setRealHiddenValue(true), void()) {
+			if (reader.has("hiddenRealFlag")) rbm.setRealHiddenValue(reader.scalar("hiddenRealFlag") != 0.0);
+		}
+		template <class RBM>
+		void readRealFlag(Reader &, RBM &, long) {}
+	}
+
+	// モデル(パラメータと隠れ変数の値の設定)をチェックポイントに登録
+	template <class RBM>
+	void addModel(Writer & writer, RBM & rbm) {
+		rbm.params.writeCheckpoint(writer);
+		detail::writeHiddenConfig(writer, rbm, 0);
+		detail::writeRealFlag(writer, rbm, 0);
+	}
+
+	// モデルを復元(同じ形で構築済みのモデルに読み込む)
+	template <class RBM>
+	void readModel(Reader & reader, RBM & rbm) {
+		rbm.params.readCheckpoint(reader);
+		detail::readHiddenConfig(reader, rbm, 0);
+		detail::readRealFlag(reader, rbm, 0);
+	}
+
+	// モデルだけのチェックポイント
+	template <class RBM>
+	void saveModel(RBM & rbm, const std::string & path) {
+		Writer writer;
+		addModel(writer, rbm);
+		writer.write(path);
+	}
+
+	template <class RBM>
+	void loadModel(RBM & rbm, const std::string & path) {
+		Reader reader(path);
+		readModel(reader, rbm);
+	}
+
+	// 乱数エンジンの状態(標準のテキスト表現)
+	template <class ENGINE>
+	void addEngine(Writer & writer, const std::string & name, const ENGINE & engine) {
+		std::ostringstream oss;
+		oss << engine;
+		writer.addBytes(name, oss.str());
+	}
+
+	template <class ENGINE>
+	void readEngine(Reader & reader, const std::string & name, ENGINE & engine) {
+		std::istringstream iss(reader.bytes(name));
+		iss >> engine;
+		if (!iss) throw std::runtime_error("rbmckpt: broken engine state " + name);
+	}
+
+	// 学習状態(モデルとトレーナー)を登録
+	// トレーナーはオプティマイザのモーメント, 乱数, 持続的なチェインを自分で登録する
+	template <class RBM, class TRAINER>
+	void addTraining(Writer & writer, RBM & rbm, TRAINER & trainer) {
+		addModel(writer, rbm);
+		trainer.writeCheckpoint(writer, rbm);
+	}
+
+	// 学習状態を復元(同じ形のモデルと同じ型のトレーナーに読み込む)
+	template <class RBM, class TRAINER>
+	void readTraining(Reader & reader, RBM & rbm, TRAINER & trainer) {
+		readModel(reader, rbm);
+		trainer.readCheckpoint(reader, rbm);
+	}
+
+	template <class RBM, class TRAINER>
+	void saveTraining(RBM & rbm, TRAINER & trainer, const std::string & path) {
+		Writer writer;
+		addTraining(writer, rbm, trainer);
+		writer.write(path);
+	}
+
+	template <class RBM, class TRAINER>
+	void loadTraining(RBM & rbm, TRAINER & trainer, const std::string & path) {
+		Reader reader(path);
+		readTraining(reader, rbm, trainer);
+	}
+}
@@ -0,0 +1,90 @@
+﻿#pragma once
+#include "Checkpoint.h"
+#include <string>
+#include <memory>
+#include <future>
+#include <fstream>
+
+// 学習状態(モデル, トレーナー, オプティマイザ, 乱数, チェイン)のチェックポイントを定期的に書き出す
+// publish()はモデルとトレーナーをコピーするだけで, 書き出し(一時ファイルに書いてから置き換え)は別スレッドで行う
+// 書き出し中に次のpublish()が来たら前の書き出しを待つ(スナップショットは高々1つ)
+template <class RBM, class TRAINER>
+class CheckpointScheduler {
+public:
+	int interval = 1;  // チェックポイントを取るエポック間隔
+
+protected:
+	struct Snapshot {
+		RBM rbm;
+		TRAINER trainer;
+	};
+
+	std::string _path;
+	std::future<void> _pending;
+
+public:
+	CheckpointScheduler(const std::string & path, int interval = 1);
+	~CheckpointScheduler();
+
+	// このエポックでチェックポイントを取るか
+	bool isCheckpointEpoch(int epoch, int epoch_size);
+
+	// スナップショットを取って書き出しを投入(epochは終えたエポック, 再開はepoch + 1から)
+	void publish(RBM & rbm, TRAINER & trainer, int epoch);
+
+	// 投入済みの書き出しが終わるまで待つ(書き出しの例外はここで投げる)
+	void wait();
+
+	// チェックポイントがあれば復元して再開するエポックを返す(無ければ0)
+	int resume(RBM & rbm, TRAINER & trainer);
+};
+
+
+template <class RBM, class TRAINER>
+CheckpointScheduler<RBM, TRAINER>::CheckpointScheduler(const std::string & path, int interval) : interval(interval), _path(path) {
+}
+
+template <class RBM, class TRAINER>
+CheckpointScheduler<RBM, TRAINER>::~CheckpointScheduler() {
+	try {
+		wait();
+	}
+	catch (...) {
+	}
+}
+
+template <class RBM, class TRAINER>
+bool CheckpointScheduler<RBM, TRAINER>::isCheckpointEpoch(int epoch, int epoch_size) {
+	return epoch == epoch_size - 1 || (epoch + 1) % interval == 0;
+}
+
+template <class RBM, class TRAINER>
+void CheckpointScheduler<RBM, TRAINER>::publish(RBM & rbm, TRAINER & trainer, int epoch) {
+	wait();
+
+	// 書き出しタスクが所有するコピー(Writerは配列をコピーしないので書き出しまで保持する)
+	auto snapshot = std::make_shared<Snapshot>(Snapshot{ rbm, trainer });
+	auto path = _path;
+
+	_pending = std::async(std::launch::async, [snapshot, path, epoch] {
+		rbmckpt::Writer writer;
+		rbmckpt::addTraining(writer, snapshot->rbm, snapshot->trainer);
+		writer.addScalar("checkpoint.nextEpoch", static_cast<double>(epoch + 1));
+		writer.write(path);
+	});
+}
+
+template <class RBM, class TRAINER>
+void CheckpointScheduler<RBM, TRAINER>::wait() {
+	if (_pending.valid()) _pending.get();
+}
+
+template <class RBM, class TRAINER>
+int CheckpointScheduler<RBM, TRAINER>::resume(RBM & rbm, TRAINER & trainer) {
+	wait();
+	if (!std::ifstream(_path, std::ios::binary)) return 0;
+
+	rbmckpt::Reader reader(_path);
+	rbmckpt::readTraining(reader, rbm, trainer);
+	return static_cast<int>(reader.scalar("checkpoint.nextEpoch"));
+}
@@ -0,0 +1,254 @@
+﻿#pragma once
+#include "Eigen/Core"
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <initializer_list>
+#include <atomic>
+#include <thread>
+#include <fstream>
+#include <algorithm>
+#include <stdexcept>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// データ並列学習のワーカー間通信
+// 各ワーカーは自分のデータ分割で勾配を計算し, オプティマイザの前に全ワーカーの勾配をall-reduceする
+// 全ワーカーが同じ初期値と同じ平均勾配で更新するので, パラメータは全ワーカーで一致し続ける
+// 実装はプロセス間共有メモリ(SharedMemoryCommunicator), TCP等はこのインターフェースを実装すればよい
+class Communicator {
+protected:
+	std::vector<double> _buffer;  // allReduceMeanの詰め込み用
+
+public:
+	virtual ~Communicator() = default;
+
+	// ワーカー番号(0 ... getSize() - 1)
+	virtual int getRank() const = 0;
+
+	// ワーカー数
+	virtual int getSize() const = 0;
+
+	// 全ワーカーの配列の要素ごとの和で置き換える(全ワーカーで同じ順に呼ぶこと)
+	virtual void allReduceSum(double * data, size_t size) = 0;
+
+	// 全ワーカーがここに来るまで待つ
+	virtual void barrier() = 0;
+
+	// weightで重み付けした全ワーカーの平均で置き換える(ワーカーごとのバッチサイズが違ってもよい)
+	// 1回のall-reduceにまとめるために詰めなおす, 重みの合計を返す
+	template <class... ARRAYS>
+	double allReduceMean(double weight, ARRAYS &... arrays) {
+		size_t size = 1;
+		for (auto s : { static_cast<size_t>(arrays.size())... }) size += s;
+		_buffer.resize(size);
+
+		size_t offset = 0;
+		(void)std::initializer_list<int>{ (pack(weight, arrays, offset), 0)... };
+		_buffer[offset] = weight;
+
+		allReduceSum(_buffer.data(), _buffer.size());
+
+		auto total_weight = _buffer[offset];
+		if (total_weight <= 0.0) throw std::runtime_error("Communicator: total weight must be positive");
+		offset = 0;
+		(void)std::initializer_list<int>{ (unpack(total_weight, arrays, offset), 0)... };
+		return total_weight;
+	}
+
+protected:
+	template <class ARRAY>
+	void pack(double weight, const ARRAY & array, size_t & offset) {
+		Eigen::Map<Eigen::ArrayXd>(_buffer.data() + offset, array.size()) = weight * Eigen::Map<const Eigen::ArrayXd>(array.data(), array.size());
+		offset += array.size();
+	}
+
+	template <class ARRAY>
+	void unpack(double total_weight, ARRAY & array, size_t & offset) {
+		Eigen::Map<Eigen::ArrayXd>(array.data(), array.size()) = Eigen::Map<const Eigen::ArrayXd>(_buffer.data() + offset, array.size()) / total_weight;
+		offset += array.size();
+	}
+};
+
+
+// 同一ホストのワーカープロセス間で共有メモリファイルを介してall-reduceする
+// 起動側がcreate()でファイルを1度だけ作り, 各ワーカーは(パス, 番号, ワーカー数)で接続する
+// Linuxでは/dev/shm以下のパスにすればディスクに書かれない
+// all-reduceは容量ごとに区切り, 各ワーカーが自分のスロットに書く -> 担当区間をランク順に合計 -> 結果を読む
+// (リングall-reduceのreduce-scatter/all-gatherを共有メモリで行う形, 合計順が固定なので全ワーカーでビット単位で一致する)
+class SharedMemoryCommunicator : public Communicator {
+protected:
+	static constexpr uint64_t Magic = 0x314d4d4f434d4252;  // "RBMCOMM1"
+
+	// ファイル先頭(1キャッシュライン), 以降にワーカー数分のスロットと結果の領域が続く
+	struct Header {
+		uint64_t magic;
+		uint32_t size;  // ワーカー数
+		uint32_t reserved;
+		uint64_t capacity;  // 1スロットのdouble数
+		std::atomic<uint32_t> arrived;  // バリアに到着したワーカー数
+		std::atomic<uint32_t> generation;  // バリアを抜けた回数
+		char padding[64 - 32];
+	};
+	static_assert(sizeof(Header) == 64, "SharedMemoryCommunicator::Header must be one cache line");
+
+	int _rank = 0;
+	int _size = 1;
+	size_t _capacity = 0;
+	char * _data = nullptr;
+	size_t _bytes = 0;
+#ifdef _WIN32
+	HANDLE _file = INVALID_HANDLE_VALUE;
+	HANDLE _mapping = nullptr;
+#else
+	int _fd = -1;
+#endif
+
+public:
+	// 共有メモリファイルを作る(接続前に起動側で1度だけ呼ぶ, capacityは1回で送るdouble数)
+	static void create(const std::string & path, int size, size_t capacity = 1 << 16) {
+		if (size <= 0 || capacity == 0) throw std::runtime_error("SharedMemoryCommunicator: invalid size");
+
+		std::vector<char> bytes(fileSize(size, capacity), 0);
+		auto header = reinterpret_cast<Header *>(bytes.data());
+		header->magic = Magic;
+		header->size = static_cast<uint32_t>(size);
+		header->capacity = capacity;
+
+		std::ofstream ofs(path, std::ios::binary | std::ios::trunc);
+		if (!ofs) throw std::runtime_error("SharedMemoryCommunicator: cannot create " + path);
+		ofs.write(bytes.data(), bytes.size());
+		if (!ofs) throw std::runtime_error("SharedMemoryCommunicator: cannot write " + path);
+	}
+
+	SharedMemoryCommunicator(const std::string & path, int rank, int size) : _rank(rank), _size(size) {
+		if (rank < 0 || rank >= size) throw std::runtime_error("SharedMemoryCommunicator: rank out of range");
+		open(path);
+
+		auto & h = header();
+		if (h.magic != Magic || h.size != static_cast<uint32_t>(size) || _bytes != fileSize(size, h.capacity)) {
+			close();
+			throw std::runtime_error("SharedMemoryCommunicator: layout mismatch " + path);
+		}
+		_capacity = static_cast<size_t>(h.capacity);
+	}
+	SharedMemoryCommunicator(const SharedMemoryCommunicator &) = delete;
+	SharedMemoryCommunicator & operator=(const SharedMemoryCommunicator &) = delete;
+	~SharedMemoryCommunicator() {
+		close();
+	}
+
+	int getRank() const override {
+		return _rank;
+	}
+
+	int getSize() const override {
+		return _size;
+	}
+
+	void allReduceSum(double * data, size_t size) override {
+		for (size_t offset = 0; offset < size; offset += _capacity) {
+			auto length = std::min(_capacity, size - offset);
+
+			std::memcpy(slot(_rank), data + offset, length * sizeof(double));
+			barrier();
+
+			// 担当区間を全スロットについてランク順に合計
+			auto begin = length * _rank / _size;
+			auto end = length * (_rank + 1) / _size;
+			auto reduced = result();
+			for (auto i = begin; i < end; i++) {
+				double value = 0.0;
+				for (int r = 0; r < _size; r++) value += slot(r)[i];
+				reduced[i] = value;
+			}
+			barrier();
+
+			std::memcpy(data + offset, reduced, length * sizeof(double));
+			// 全員が読み終わるまで次の区切りで上書きしない
+			barrier();
+		}
+	}
+
+	// センス反転バリア(最後に来たワーカーが世代を進める)
+	void barrier() override {
+		auto & h = header();
+		auto generation = h.generation.load(std::memory_order_acquire);
+		if (h.arrived.fetch_add(1, std::memory_order_acq_rel) + 1 == static_cast<uint32_t>(_size)) {
+			h.arrived.store(0, std::memory_order_relaxed);
+			h.generation.fetch_add(1, std::memory_order_release);
+		}
+		else {
+			while (h.generation.load(std::memory_order_acquire) == generation) std::this_thread::yield();
+		}
+	}
+
+protected:
+	static size_t fileSize(int size, size_t capacity) {
+		return sizeof(Header) + sizeof(double) * capacity * (static_cast<size_t>(size) + 1);
+	}
+
+	Header & header() {
+		return *reinterpret_cast<Header *>(_data);
+	}
+
+	double * slot(int rank) {
+		return reinterpret_cast<double *>(_data + sizeof(Header)) + _capacity * rank;
+	}
+
+	double * result() {
+		return slot(_size);
+	}
+
+	void open(const std::string & path) {
+#ifdef _WIN32
+		_file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (_file == INVALID_HANDLE_VALUE) throw std::runtime_error("SharedMemoryCommunicator: cannot open " + path);
+		LARGE_INTEGER size;
+		GetFileSizeEx(_file, &size);
+		_bytes = static_cast<size_t>(size.QuadPart);
+		_mapping = _bytes >= sizeof(Header) ? CreateFileMappingA(_file, nullptr, PAGE_READWRITE, 0, 0, nullptr) : nullptr;
+		_data = _mapping ? static_cast<char *>(MapViewOfFile(_mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0)) : nullptr;
+#else
+		_fd = ::open(path.c_str(), O_RDWR);
+		if (_fd < 0) throw std::runtime_error("SharedMemoryCommunicator: cannot open " + path);
+		struct stat st;
+		fstat(_fd, &st);
+		_bytes = static_cast<size_t>(st.st_size);
+		if (_bytes >= sizeof(Header)) {
+			auto mapped = mmap(nullptr, _bytes, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+			_data = mapped == MAP_FAILED ? nullptr : static_cast<char *>(mapped);
+		}
+#endif
+		if (_data == nullptr) {
+			close();
+			throw std::runtime_error("SharedMemoryCommunicator: cannot map " + path);
+		}
+	}
+
+	void close() {
+#ifdef _WIN32
+		if (_data) UnmapViewOfFile(_data);
+		if (_mapping) CloseHandle(_mapping);
+		if (_file != INVALID_HANDLE_VALUE) CloseHandle(_file);
+		_mapping = nullptr;
+		_file = INVALID_HANDLE_VALUE;
+#else
+		if (_data) munmap(_data, _bytes);
+		if (_fd >= 0) ::close(_fd);
+		_fd = -1;
+#endif
+		_data = nullptr;
+	}
+};
@@ -0,0 +1,322 @@
+﻿#include "ConvolutionalGRBM.h"
+#include <algorithm>
+#include <stdexcept>
+#include "../Profiler.h"
+
+
+ConvolutionalGRBM::ConvolutionalGRBM(size_t channels, size_t height, size_t width, size_t filter_count, size_t filter_size, size_t pool_size) {
+	if (filter_size == 0 || filter_size > height || filter_size > width) throw std::invalid_argument("ConvolutionalGRBM: filter does not fit in the image");
+
+	this->channels = channels;
+	this->height = height;
+	this->width = width;
+	this->filterCount = filter_count;
+	this->filterSize = filter_size;
+	this->poolSize = std::max<size_t>(pool_size, 1);
+
+	if (getHiddenHeight() % poolSize != 0 || getHiddenWidth() % poolSize != 0) throw std::invalid_argument("ConvolutionalGRBM: feature map is not divisible by pool size");
+
+	// ノード確保
+	nodes = GeneralizedRBMNode(getVisibleSize(), getHiddenSize());
+
+	// パラメータ初期化
+	params = ConvolutionalGRBMParamator(channels, filter_count, filter_size);
+	params.initParamsXavier();
+
+	// 区間分割
+	hiddenValueSet = splitHiddenSet();
+}
+
+
+// 可視変数の数を返す
+size_t ConvolutionalGRBM::getVisibleSize() {
+	return channels * height * width;
+}
+
+// 隠れ変数の数を返す
+size_t ConvolutionalGRBM::getHiddenSize() {
+	return filterCount * getHiddenHeight() * getHiddenWidth();
+}
+
+size_t ConvolutionalGRBM::getChannelSize() {
+	return channels;
+}
+
+size_t ConvolutionalGRBM::getImageHeight() {
+	return height;
+}
+
+size_t ConvolutionalGRBM::getImageWidth() {
+	return width;
+}
+
+size_t ConvolutionalGRBM::getFilterCount() {
+	return filterCount;
+}
+
+size_t ConvolutionalGRBM::getFilterSize() {
+	return filterSize;
+}
+
+size_t ConvolutionalGRBM::getPatchSize() {
+	return channels * filterSize * filterSize;
+}
+
+size_t ConvolutionalGRBM::getHiddenHeight() {
+	return height - filterSize + 1;
+}
+
+size_t ConvolutionalGRBM::getHiddenWidth() {
+	return width - filterSize + 1;
+}
+
+size_t ConvolutionalGRBM::getPoolSize() {
+	return poolSize;
+}
+
+
+// 可視層vから隠れ層y行目に対応するパッチを並べる
+// パッチの行(ch, dy, dx)は画像の(ch, y + dy)行目のdx列目から隠れ層の幅だけ連続している
+void ConvolutionalGRBM::patchRow(const Eigen::VectorXd & v, int y, Eigen::MatrixXd & patches) {
+	auto hidden_width = getHiddenWidth();
+	patches.resize(getPatchSize(), hidden_width);
+
+	for (int ch = 0; ch < channels; ch++) {
+		for (int dy = 0; dy < filterSize; dy++) {
+			auto offset = (ch * height + y + dy) * width;
+			for (int dx = 0; dx < filterSize; dx++) {
+				patches.row((ch * filterSize + dy) * filterSize + dx) = v.segment(offset + dx, hidden_width).transpose();
+			}
+		}
+	}
+}
+
+ConvolutionalGRBM::FeatureRows ConvolutionalGRBM::hiddenRow(Eigen::VectorXd & h, int y) {
+	auto hidden_width = getHiddenWidth();
+	return FeatureRows(h.data() + y * hidden_width, filterCount, hidden_width, Eigen::OuterStride<>(getHiddenHeight() * hidden_width));
+}
+
+ConvolutionalGRBM::ConstFeatureRows ConvolutionalGRBM::hiddenRow(const Eigen::VectorXd & h, int y) {
+	auto hidden_width = getHiddenWidth();
+	return ConstFeatureRows(h.data() + y * hidden_width, filterCount, hidden_width, Eigen::OuterStride<>(getHiddenHeight() * hidden_width));
+}
+
+
+// 隠れ変数に関する外部磁場と相互作用(一括計算)
+void ConvolutionalGRBM::muVect(const Eigen::VectorXd & v, Eigen::VectorXd & mu_vect) {
+	RBM_PROFILE_SCOPE("muVect");
+
+	mu_vect.resize(getHiddenSize());
+
+	Eigen::MatrixXd patches;
+	for (int y = 0; y < getHiddenHeight(); y++) {
+		patchRow(v, y, patches);
+
+		auto mu_row = hiddenRow(mu_vect, y);
+		mu_row.noalias() = params.w * patches;
+		mu_row.colwise() += params.c;
+	}
+}
+
+Eigen::VectorXd ConvolutionalGRBM::muVect() {
+	Eigen::VectorXd mu_vect;
+	muVect(nodes.v, mu_vect);
+
+	return mu_vect;
+}
+
+// 可視変数に関する外部磁場と相互作用(一括計算)
+// im2colの逆(col2im): 各隠れ行のw^T hを, パッチの位置へ足し戻す
+void ConvolutionalGRBM::lambdaVect(const Eigen::VectorXd & h, Eigen::VectorXd & lambda_vect) {
+	RBM_PROFILE_SCOPE("lambdaVect");
+
+	auto hidden_width = getHiddenWidth();
+	auto plane = height * width;
+
+	lambda_vect.resize(getVisibleSize());
+	for (int ch = 0; ch < channels; ch++) {
+		lambda_vect.segment(ch * plane, plane).setConstant(params.b(ch));
+	}
+
+	Eigen::MatrixXd cols;
+	for (int y = 0; y < getHiddenHeight(); y++) {
+		cols.noalias() = params.w.transpose() * hiddenRow(h, y);
+
+		for (int ch = 0; ch < channels; ch++) {
+			for (int dy = 0; dy < filterSize; dy++) {
+				auto offset = (ch * height + y + dy) * width;
+				for (int dx = 0; dx < filterSize; dx++) {
+					lambda_vect.segment(offset + dx, hidden_width) += cols.row((ch * filterSize + dy) * filterSize + dx).transpose();
+				}
+			}
+		}
+	}
+}
+
+Eigen::VectorXd ConvolutionalGRBM::lambdaVect() {
+	Eigen::VectorXd lambda_vect;
+	lambdaVect(nodes.h, lambda_vect);
+
+	return lambda_vect;
+}
+
+// 可視変数の平均
+void ConvolutionalGRBM::meanVisible(const Eigen::VectorXd & lambda_vect, Eigen::VectorXd & mean) {
+	auto plane = height * width;
+
+	mean.resize(lambda_vect.size());
+	for (int ch = 0; ch < channels; ch++) {
+		mean.segment(ch * plane, plane) = lambda_vect.segment(ch * plane, plane) / params.lambda(ch);
+	}
+}
+
+// 可視変数の標準偏差
+double ConvolutionalGRBM::sigmaVisible(int channel) {
+	return sqrt(1.0 / params.lambda(channel));
+}
+
+// 隠れ変数の期待値E[h | v]
+void ConvolutionalGRBM::actHidden(const Eigen::VectorXd & mu_vect, Eigen::VectorXd & h) {
+	h.resize(mu_vect.size());
+
+	// 離散型
+	if (!isPooling()) {
+		for (int j = 0; j < mu_vect.size(); j++) {
+			double numer = 0.0;
+			double denom = 0.0;
+			for (auto & h_val : hiddenValueSet) {
+				auto term = exp(mu_vect(j) * h_val);
+				numer += h_val * term;
+				denom += term;
+			}
+			h(j) = numer / denom;
+		}
+
+		return;
+	}
+
+	// 確率的max-pooling: ブロック内の「全て0」とどれか1つが1のsoftmax
+	auto hidden_height = getHiddenHeight();
+	auto hidden_width = getHiddenWidth();
+	for (int k = 0; k < filterCount; k++) {
+		for (int by = 0; by < hidden_height; by += poolSize) {
+			for (int bx = 0; bx < hidden_width; bx += poolSize) {
+				auto base = (k * hidden_height + by) * hidden_width + bx;
+
+				double shift = 0.0;  // 「全て0」のエネルギー0も含めた最大値
+				for (int a = 0; a < poolSize; a++) {
+					for (int c = 0; c < poolSize; c++) shift = std::max(shift, mu_vect(base + a * hidden_width + c));
+				}
+
+				double denom = exp(-shift);
+				for (int a = 0; a < poolSize; a++) {
+					for (int c = 0; c < poolSize; c++) {
+						auto term = exp(mu_vect(base + a * hidden_width + c) - shift);
+						h(base + a * hidden_width + c) = term;
+						denom += term;
+					}
+				}
+
+				for (int a = 0; a < poolSize; a++) {
+					h.segment(base + a * hidden_width, poolSize) /= denom;
+				}
+			}
+		}
+	}
+}
+
+// プーリング層
+Eigen::VectorXd ConvolutionalGRBM::poolVect(const Eigen::VectorXd & h) {
+	auto hidden_height = getHiddenHeight();
+	auto hidden_width = getHiddenWidth();
+	auto pool_height = hidden_height / poolSize;
+	auto pool_width = hidden_width / poolSize;
+
+	Eigen::VectorXd pool = Eigen::VectorXd::Zero(filterCount * pool_height * pool_width);
+	for (int k = 0; k < filterCount; k++) {
+		for (int y = 0; y < hidden_height; y++) {
+			for (int x = 0; x < hidden_width; x++) {
+				pool((k * pool_height + y / poolSize) * pool_width + x / poolSize) += h((k * hidden_height + y) * hidden_width + x);
+			}
+		}
+	}
+
+	return pool;
+}
+
+// エネルギー関数を返します
+// E(v, h) = Σ_i lambda_i v_i^2 / 2 - b^T v - mu(v)^T h
+double ConvolutionalGRBM::getEnergy() {
+	auto plane = height * width;
+
+	double energy = 0.0;
+	for (int ch = 0; ch < channels; ch++) {
+		auto v_ch = nodes.v.segment(ch * plane, plane);
+		energy += 0.5 * params.lambda(ch) * v_ch.squaredNorm() - params.b(ch) * v_ch.sum();
+	}
+
+	energy -= muVect().dot(nodes.h);
+
+	return energy;
+}
+
+// プーリングが有効か
+bool ConvolutionalGRBM::isPooling() {
+	if (poolSize == 1) return false;
+
+	if (divSize != 1 || hMin != 0.0 || hMax != 1.0) throw std::runtime_error("ConvolutionalGRBM: probabilistic max-pooling needs hidden values {0, 1}");
+
+	return true;
+}
+
+
+std::vector<double> ConvolutionalGRBM::splitHiddenSet() {
+	std::vector<double> set(divSize + 1);
+
+	for (int i = 0; i < set.size(); i++) set[i] = 1.0 / divSize * i * (hMax - hMin) + hMin;
+
+	return set;
+}
+
+int ConvolutionalGRBM::getHiddenValueSetSize() {
+	return divSize + 1;
+}
+
+// 隠れ変数の取りうる最大値を取得
+double ConvolutionalGRBM::getHiddenMax() {
+	return hMax;
+}
+
+// 隠れ変数の取りうる最大値を設定
+void ConvolutionalGRBM::setHiddenMax(double value) {
+	hMax = value;
+
+	// 区間分割
+	hiddenValueSet = splitHiddenSet();
+}
+
+// 隠れ変数の取りうる最小値を取得
+double ConvolutionalGRBM::getHiddenMin() {
+	return hMin;
+}
+
+// 隠れ変数の取りうる最小値を設定
+void ConvolutionalGRBM::setHiddenMin(double value) {
+	hMin = value;
+
+	// 区間分割
+	hiddenValueSet = splitHiddenSet();
+}
+
+// 隠れ変数の区間分割数を返す
+size_t ConvolutionalGRBM::getHiddenDivSize() {
+	return divSize;
+}
+
+// 隠れ変数の区間分割数を設定
+void ConvolutionalGRBM::setHiddenDivSize(size_t div_size) {
+	divSize = div_size;
+
+	// 区間分割
+	hiddenValueSet = splitHiddenSet();
+}
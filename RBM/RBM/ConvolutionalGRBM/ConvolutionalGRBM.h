@@ -0,0 +1,128 @@
+﻿#pragma once
+#include "../GeneralizedRBM/GeneralizedRBMNode.h"
+#include "ConvolutionalGRBMParamator.h"
+#include "Eigen/Core"
+#include <vector>
+#include <cmath>
+
+
+// 畳み込みGaussian-Bernoulli(一般化)RBM
+// 可視層はchannels x height x widthの画像(ガウス分布, バイアスと逆分散はチャネルごとに共有)
+// 隠れ層はfilterCount枚の特徴マップ(height - filterSize + 1) x (width - filterSize + 1), フィルタを全位置で共有
+// 可視・隠れ層ともに(チャネル/マップ, 行, 列)の順に平坦化したベクトルで持つ
+// muとlambdaは隠れ層1行ずつのim2colと行列積で計算するので, 作業領域は(channels * filterSize^2) x 隠れ層の幅で済む
+// poolSize > 1のときは確率的max-pooling(各poolSize x poolSizeブロックで高々1つの隠れ変数が1), 隠れ変数は{0, 1}に限る
+class ConvolutionalGRBM {
+public:
+	// 隠れ層のy行目を特徴マップ数 x 幅の行列として見る
+	typedef Eigen::Map<Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>, 0, Eigen::OuterStride<>> FeatureRows;
+	typedef Eigen::Map<const Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>, 0, Eigen::OuterStride<>> ConstFeatureRows;
+
+protected:
+	size_t channels = 0;
+	size_t height = 0;
+	size_t width = 0;
+	size_t filterCount = 0;
+	size_t filterSize = 0;
+	size_t poolSize = 1;
+	double hMin = 0.0;
+	double hMax = 1.0;
+	size_t divSize = 1;  // 隠れ変数の区間分割数
+
+public:
+	ConvolutionalGRBMParamator params;
+	GeneralizedRBMNode nodes;
+
+	std::vector <double> hiddenValueSet;  // 隠れ変数の取りうる値
+
+public:
+	ConvolutionalGRBM() = default;
+	ConvolutionalGRBM(size_t channels, size_t height, size_t width, size_t filter_count, size_t filter_size, size_t pool_size = 1);
+	~ConvolutionalGRBM() = default;
+
+	// 可視変数の数を返す
+	size_t getVisibleSize();
+
+	// 隠れ変数の数を返す
+	size_t getHiddenSize();
+
+	// 画像のチャネル数, 高さ, 幅を返す
+	size_t getChannelSize();
+	size_t getImageHeight();
+	size_t getImageWidth();
+
+	// フィルタの数, 一辺の長さ, 要素数(channels * filterSize^2)を返す
+	size_t getFilterCount();
+	size_t getFilterSize();
+	size_t getPatchSize();
+
+	// 特徴マップの高さ, 幅を返す
+	size_t getHiddenHeight();
+	size_t getHiddenWidth();
+
+	// プーリングの一辺の長さを返す
+	size_t getPoolSize();
+
+	// 可視層vから隠れ層y行目に対応するパッチを並べる(im2col, patchSize x 隠れ層の幅)
+	void patchRow(const Eigen::VectorXd & v, int y, Eigen::MatrixXd & patches);
+
+	// 隠れ層のy行目
+	FeatureRows hiddenRow(Eigen::VectorXd & h, int y);
+	ConstFeatureRows hiddenRow(const Eigen::VectorXd & h, int y);
+
+	// 隠れ変数に関する外部磁場と相互作用(一括計算), mu = c + w * v(相関)
+	void muVect(const Eigen::VectorXd & v, Eigen::VectorXd & mu_vect);
+	Eigen::VectorXd muVect();
+
+	// 可視変数に関する外部磁場と相互作用(一括計算, 二乗の項を除く), lambda = b + w^T * h(転置畳み込み)
+	void lambdaVect(const Eigen::VectorXd & h, Eigen::VectorXd & lambda_vect);
+	Eigen::VectorXd lambdaVect();
+
+	// 可視変数の平均(lambdaを逆分散で割ったもの)
+	void meanVisible(const Eigen::VectorXd & lambda_vect, Eigen::VectorXd & mean);
+
+	// 可視変数の標準偏差
+	double sigmaVisible(int channel);
+
+	// 隠れ変数の期待値E[h | v](プーリングありならブロック内のsoftmax)
+	void actHidden(const Eigen::VectorXd & mu_vect, Eigen::VectorXd & h);
+
+	// プーリング層(各ブロックで隠れ変数が1つでも1である確率/状態)
+	Eigen::VectorXd poolVect(const Eigen::VectorXd & h);
+
+	// エネルギー関数を返します
+	double getEnergy();
+
+	// プーリングが有効か(隠れ変数が{0, 1}でない場合は例外)
+	bool isPooling();
+
+
+
+	//
+	//appendix methods
+	//
+
+	// 隠れ変数の取りうる値を返す
+	std::vector<double> splitHiddenSet();
+
+	// 隠れ変数の取りうるパターン数
+	int getHiddenValueSetSize();
+
+	// 隠れ変数の取りうる最大値を取得
+	double getHiddenMax();
+
+	// 隠れ変数の取りうる最大値を設定
+	void setHiddenMax(double value);
+
+	// 隠れ変数の取りうる最小値を取得
+	double getHiddenMin();
+
+	// 隠れ変数の取りうる最小値を設定
+	void setHiddenMin(double value);
+
+	// 隠れ変数の区間分割数を返す
+	size_t getHiddenDivSize();
+
+	// 隠れ変数の区間分割数を設定
+	void setHiddenDivSize(size_t div_size);
+};
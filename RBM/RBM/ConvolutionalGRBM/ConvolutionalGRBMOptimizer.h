@@ -0,0 +1,68 @@
+﻿#pragma once
+#include "../Optimizer.h"
+#include "../GeneralizedRBM/GeneralizedRBMOptimizer.h"
+#include "ConvolutionalGRBM.h"
+
+// フィルタ(filterCount x patchSize)の更新はGeneralizedRBMのオプティマイザを使いまわす
+// patchSize x filterCountのGeneralizedRBMとみなし, 可視バイアス欄の先頭channels個をチャネルのバイアスに使う
+template <class OPTIMIZERTYPE>
+class Optimizer<ConvolutionalGRBM, OPTIMIZERTYPE> {
+
+protected:
+	Optimizer<GeneralizedRBM, OPTIMIZERTYPE> _filter;
+
+public:
+	Optimizer() = default;
+	Optimizer(ConvolutionalGRBM & rbm);
+	~Optimizer() = default;
+	void init(ConvolutionalGRBM & rbm);
+	double getNewParamVBias(double gradient, int channel);
+	double getNewParamHBias(double gradient, int filter);
+	double getNewParamWeight(double gradient, int filter, int pindex);
+	// next timestep
+	void updateOptimizer();
+	// 状態のチェックポイント(内側のオプティマイザごとに接頭辞を付ける)
+	void writeCheckpoint(rbmckpt::Writer & writer, const std::string & prefix);
+	void readCheckpoint(rbmckpt::Reader & reader, const std::string & prefix);
+};
+
+template <class OPTIMIZERTYPE>
+Optimizer<ConvolutionalGRBM, OPTIMIZERTYPE>::Optimizer(ConvolutionalGRBM & rbm) {
+	this->init(rbm);
+}
+
+template <class OPTIMIZERTYPE>
+void Optimizer<ConvolutionalGRBM, OPTIMIZERTYPE>::init(ConvolutionalGRBM & rbm) {
+	GeneralizedRBM filter_shape(rbm.getPatchSize(), rbm.getFilterCount());
+	this->_filter = Optimizer<GeneralizedRBM, OPTIMIZERTYPE>(filter_shape);
+}
+
+template <class OPTIMIZERTYPE>
+void Optimizer<ConvolutionalGRBM, OPTIMIZERTYPE>::updateOptimizer() {
+	this->_filter.updateOptimizer();
+}
+
+template <class OPTIMIZERTYPE>
+void Optimizer<ConvolutionalGRBM, OPTIMIZERTYPE>::writeCheckpoint(rbmckpt::Writer & writer, const std::string & prefix) {
+	this->_filter.writeCheckpoint(writer, prefix + "filter.");
+}
+
+template <class OPTIMIZERTYPE>
+void Optimizer<ConvolutionalGRBM, OPTIMIZERTYPE>::readCheckpoint(rbmckpt::Reader & reader, const std::string & prefix) {
+	this->_filter.readCheckpoint(reader, prefix + "filter.");
+}
+
+template <class OPTIMIZERTYPE>
+double Optimizer<ConvolutionalGRBM, OPTIMIZERTYPE>::getNewParamVBias(double gradient, int channel) {
+	return this->_filter.getNewParamVBias(gradient, channel);
+}
+
+template <class OPTIMIZERTYPE>
+double Optimizer<ConvolutionalGRBM, OPTIMIZERTYPE>::getNewParamHBias(double gradient, int filter) {
+	return this->_filter.getNewParamHBias(gradient, filter);
+}
+
+template <class OPTIMIZERTYPE>
+double Optimizer<ConvolutionalGRBM, OPTIMIZERTYPE>::getNewParamWeight(double gradient, int filter, int pindex) {
+	return this->_filter.getNewParamWeight(gradient, pindex, filter);
+}
@@ -0,0 +1,150 @@
+﻿#include "ConvolutionalGRBMParamator.h"
+#include "../Checkpoint.h"
+#include <iostream>
+#include <cmath>
+
+
+ConvolutionalGRBMParamator::ConvolutionalGRBMParamator(size_t channels, size_t filter_count, size_t filter_size) {
+	this->channels = channels;
+	this->filterCount = filter_count;
+	this->filterSize = filter_size;
+
+	initParams();
+}
+
+void ConvolutionalGRBMParamator::initParams() {
+	b.setConstant(channels, 0.0);
+	c.setConstant(filterCount, 0.0);
+	w.setConstant(filterCount, channels * filterSize * filterSize, 0.0);
+	lambda.setConstant(channels, 1.0);  // 逆分散は非負制約がある
+}
+
+void ConvolutionalGRBMParamator::initParamsRandom(double range_min, double range_max) {
+	std::random_device rd;
+	std::mt19937 mt(rd());
+	this->initParamsRandom(range_min, range_max, mt());
+}
+
+void ConvolutionalGRBMParamator::initParamsRandom(double range_min, double range_max, int seed) {
+	initParams();
+
+	std::mt19937 mt(seed);
+	std::uniform_real_distribution<double> dist(range_min, range_max);
+
+	for (int ch = 0; ch < channels; ch++) b(ch) = dist(mt);
+	for (int k = 0; k < filterCount; k++) c(k) = dist(mt);
+	for (int n = 0; n < w.size(); n++) w(n) = dist(mt);
+}
+
+void ConvolutionalGRBMParamator::initParamsXavier() {
+	std::random_device seed_gen;
+	std::mt19937 engine(seed_gen());
+
+	this->initParamsXavier(engine());
+}
+
+void ConvolutionalGRBMParamator::initParamsXavier(int seed) {
+	initParams();
+
+	std::mt19937 mt(seed);
+	std::uniform_real_distribution<double> dist(-1.0, 1.0);
+
+	auto epsiron = 0.00001;
+	auto scale = sqrt(3.0 / w.cols());
+
+	for (int ch = 0; ch < channels; ch++) b(ch) = dist(mt) * epsiron;
+	for (int k = 0; k < filterCount; k++) c(k) = dist(mt) * epsiron;
+	for (int n = 0; n < w.size(); n++) w(n) = dist(mt) * scale;
+}
+
+
+// 可視層のチャネル数を返す
+size_t ConvolutionalGRBMParamator::getChannelSize() {
+	return channels;
+}
+
+// フィルタ(特徴マップ)の数を返す
+size_t ConvolutionalGRBMParamator::getFilterCount() {
+	return filterCount;
+}
+
+// フィルタの一辺の長さを返す
+size_t ConvolutionalGRBMParamator::getFilterSize() {
+	return filterSize;
+}
+
+// フィルタの重みを返す
+double ConvolutionalGRBMParamator::getWeight(int filter, int channel, int dy, int dx) {
+	return w(filter, (channel * filterSize + dy) * filterSize + dx);
+}
+
+// パラメータ情報のシリアライズ
+std::string ConvolutionalGRBMParamator::serialize() {
+	nlohmann::json json;
+	json["channels"] = channels;
+	json["filterCount"] = filterCount;
+	json["filterSize"] = filterSize;
+	json["params"]["b"] = std::vector<double>(this->b.data(), this->b.data() + this->b.size());
+	json["params"]["c"] = std::vector<double>(this->c.data(), this->c.data() + this->c.size());
+	json["params"]["w"] = std::vector<double>(this->w.data(), this->w.data() + this->w.size());
+	json["params"]["lambda"] = std::vector<double>(this->lambda.data(), this->lambda.data() + this->lambda.size());
+
+	return json.dump();
+}
+
+// パラメータ情報のデシリアライズ
+void ConvolutionalGRBMParamator::deserialize(std::string js) {
+	auto json = nlohmann::json::parse(js);
+
+	channels = json["channels"];
+	filterCount = json["filterCount"];
+	filterSize = json["filterSize"];
+	std::vector<double> tmp_b(json["params"]["b"].begin(), json["params"]["b"].end());
+	std::vector<double> tmp_c(json["params"]["c"].begin(), json["params"]["c"].end());
+	std::vector<double> tmp_w(json["params"]["w"].begin(), json["params"]["w"].end());
+	std::vector<double> tmp_lambda(json["params"]["lambda"].begin(), json["params"]["lambda"].end());
+
+	this->b = Eigen::Map<Eigen::VectorXd>(tmp_b.data(), channels);
+	this->c = Eigen::Map<Eigen::VectorXd>(tmp_c.data(), filterCount);
+	this->w = Eigen::Map<Eigen::MatrixXd>(tmp_w.data(), filterCount, channels * filterSize * filterSize);
+	this->lambda = Eigen::Map<Eigen::VectorXd>(tmp_lambda.data(), channels);
+}
+
+// チェックポイントに登録
+void ConvolutionalGRBMParamator::writeCheckpoint(rbmckpt::Writer & writer) {
+	writer.setModelType("ConvolutionalGRBM");
+	writer.add("b", this->b);
+	writer.add("c", this->c);
+	writer.add("w", this->w);
+	writer.add("lambda", this->lambda);
+}
+
+// チェックポイントから復元
+void ConvolutionalGRBMParamator::readCheckpoint(rbmckpt::Reader & reader) {
+	if (reader.modelType() != "ConvolutionalGRBM") throw std::runtime_error("ConvolutionalGRBMParamator: model type mismatch " + reader.modelType());
+	auto ckpt_b = reader.vector("b");
+	auto ckpt_c = reader.vector("c");
+	auto ckpt_w = reader.matrix("w");
+	auto ckpt_lambda = reader.vector("lambda");
+	if (ckpt_b.size() != channels || ckpt_c.size() != filterCount || ckpt_w.rows() != filterCount || ckpt_w.cols() != channels * filterSize * filterSize || ckpt_lambda.size() != channels) throw std::runtime_error("ConvolutionalGRBMParamator: shape mismatch");
+
+	this->b = ckpt_b;
+	this->c = ckpt_c;
+	this->w = ckpt_w;
+	this->lambda = ckpt_lambda;
+}
+
+void ConvolutionalGRBMParamator::printParams()
+{
+	std::cout << "--- b ---" << std::endl;
+	std::cout << this->b << std::endl;
+
+	std::cout << "--- c ---" << std::endl;
+	std::cout << this->c << std::endl;
+
+	std::cout << "--- w ---" << std::endl;
+	std::cout << this->w << std::endl;
+
+	std::cout << "--- lambda ---" << std::endl;
+	std::cout << this->lambda << std::endl;
+}
@@ -0,0 +1,67 @@
+﻿#pragma once
+#include "Eigen/Core"
+#include "json.hpp"
+#include <random>
+
+
+// 畳み込みRBMのパラメータ, 画像サイズによらずフィルタ数とフィルタサイズだけで決まる
+namespace rbmckpt {
+	class Writer;
+	class Reader;
+}
+
+class ConvolutionalGRBMParamator {
+private:
+	size_t channels;
+	size_t filterCount;
+	size_t filterSize;
+public:
+	Eigen::VectorXd b;  // 可視変数のバイアス(チャネルごとに共有)
+	Eigen::VectorXd c;  // 隠れ変数のバイアス(特徴マップごとに共有)
+	Eigen::MatrixXd w;  // フィルタ(filterCount x channels * filterSize * filterSize, 列は(チャネル, 行, 列)の順)
+	Eigen::VectorXd lambda;  // 可視変数の逆分散(チャネルごとに共有)
+
+
+public:
+	ConvolutionalGRBMParamator() = default;
+	ConvolutionalGRBMParamator(size_t channels, size_t filter_count, size_t filter_size);
+	~ConvolutionalGRBMParamator() = default;
+
+	// 可視層のチャネル数を返す
+	size_t getChannelSize();
+
+	// フィルタ(特徴マップ)の数を返す
+	size_t getFilterCount();
+
+	// フィルタの一辺の長さを返す
+	size_t getFilterSize();
+
+	// フィルタの重みを返す
+	double getWeight(int filter, int channel, int dy, int dx);
+
+	// 全てのパラメータを0で初期化
+	void initParams();
+
+	// 全てのパラメータを[min, max]の一様乱数で初期化
+	void initParamsRandom(double range_min, double range_max);
+	void initParamsRandom(double range_min, double range_max, int seed);
+
+	// Xavier Initialization(ファンインはフィルタの要素数)
+	void initParamsXavier();
+	void initParamsXavier(int seed);
+
+	// パラメータ情報のシリアライズ
+	std::string serialize();
+
+	// パラメータ情報のデシリアライズ
+	void deserialize(std::string js);
+
+	// チェックポイントに登録(配列はコピーしない)
+	void writeCheckpoint(rbmckpt::Writer & writer);
+
+	// チェックポイントから復元(同じ形であること)
+	void readCheckpoint(rbmckpt::Reader & reader);
+
+	// パラメータ出力
+	void printParams();
+};
@@ -0,0 +1,126 @@
+﻿#pragma once
+#include "../Sampler.h"
+#include "ConvolutionalGRBM.h"
+#include "Eigen/Core"
+#include <vector>
+#include <random>
+#include <cmath>
+
+template<>
+class Sampler<ConvolutionalGRBM> {
+public:
+	std::mt19937 randEngine = std::mt19937();
+public:
+	Sampler();
+	Sampler(const std::mt19937 & rand_engine);
+	~Sampler() = default;
+
+	// 可視層すべてをサンプリング(lambdaを与える)
+	void sampleVisible(ConvolutionalGRBM & rbm, const Eigen::VectorXd & lambda_vect, Eigen::VectorXd & v);
+
+	// 隠れ層すべてをサンプリング(muを与える, プーリングありならブロックごと)
+	void sampleHidden(ConvolutionalGRBM & rbm, const Eigen::VectorXd & mu_vect, Eigen::VectorXd & h);
+
+	// 可視層すべてをギブスサンプリングで更新
+	Eigen::VectorXd & updateByBlockedGibbsSamplingVisible(ConvolutionalGRBM & rbm);
+
+	// 隠れ層すべてをギブスサンプリングで更新
+	Eigen::VectorXd & updateByBlockedGibbsSamplingHidden(ConvolutionalGRBM & rbm);
+};
+
+
+inline Sampler<ConvolutionalGRBM>::Sampler() {
+	std::random_device rd;
+	this->randEngine = std::mt19937(rd());
+}
+
+// 乱数エンジンを与える(random_deviceを開かない)
+inline Sampler<ConvolutionalGRBM>::Sampler(const std::mt19937 & rand_engine) : randEngine(rand_engine) {
+}
+
+inline void Sampler<ConvolutionalGRBM>::sampleVisible(ConvolutionalGRBM & rbm, const Eigen::VectorXd & lambda_vect, Eigen::VectorXd & v) {
+	auto plane = rbm.getImageHeight() * rbm.getImageWidth();
+	std::normal_distribution<double> dist(0.0, 1.0);
+
+	rbm.meanVisible(lambda_vect, v);
+	for (int ch = 0; ch < rbm.getChannelSize(); ch++) {
+		auto sigma = rbm.sigmaVisible(ch);
+		for (int i = ch * plane; i < (ch + 1) * plane; i++) {
+			v(i) += sigma * dist(this->randEngine);
+		}
+	}
+}
+
+inline void Sampler<ConvolutionalGRBM>::sampleHidden(ConvolutionalGRBM & rbm, const Eigen::VectorXd & mu_vect, Eigen::VectorXd & h) {
+	std::uniform_real_distribution<double> dist(0.0, 1.0);
+	h.resize(mu_vect.size());
+
+	// 離散型: 累積がu * Σ exp(mu h)を超えた値
+	if (!rbm.isPooling()) {
+		auto & hidset = rbm.hiddenValueSet;
+		for (int j = 0; j < mu_vect.size(); j++) {
+			double denom = 0.0;
+			for (auto & h_val : hidset) denom += exp(mu_vect(j) * h_val);
+
+			auto threshold = dist(this->randEngine) * denom;
+			double cumulative = 0.0;
+			h(j) = hidset.back();
+			for (int k = 0; k < hidset.size() - 1; k++) {
+				cumulative += exp(mu_vect(j) * hidset[k]);
+				if (threshold < cumulative) {
+					h(j) = hidset[k];
+					break;
+				}
+			}
+		}
+
+		return;
+	}
+
+	// 確率的max-pooling: ブロックの確率(actHidden)から「全て0」かどの1つが1かを選ぶ
+	Eigen::VectorXd probs;
+	rbm.actHidden(mu_vect, probs);
+	h.setZero();
+
+	auto pool_size = rbm.getPoolSize();
+	auto hidden_height = rbm.getHiddenHeight();
+	auto hidden_width = rbm.getHiddenWidth();
+	for (int k = 0; k < rbm.getFilterCount(); k++) {
+		for (int by = 0; by < hidden_height; by += pool_size) {
+			for (int bx = 0; bx < hidden_width; bx += pool_size) {
+				auto base = (k * hidden_height + by) * hidden_width + bx;
+				auto u = dist(this->randEngine);
+
+				double cumulative = 0.0;
+				for (int a = 0; a < pool_size * pool_size; a++) {
+					auto j = base + (a / pool_size) * hidden_width + a % pool_size;
+					cumulative += probs(j);
+					if (u < cumulative) {
+						h(j) = 1.0;
+						break;
+					}
+				}
+			}
+		}
+	}
+}
+
+inline Eigen::VectorXd & Sampler<ConvolutionalGRBM>::updateByBlockedGibbsSamplingVisible(ConvolutionalGRBM & rbm) {
+	RBM_PROFILE_COUNT(Sweeps, 1);
+
+	Eigen::VectorXd lambda_vect;
+	rbm.lambdaVect(rbm.nodes.h, lambda_vect);
+	sampleVisible(rbm, lambda_vect, rbm.nodes.v);
+
+	return rbm.nodes.v;
+}
+
+inline Eigen::VectorXd & Sampler<ConvolutionalGRBM>::updateByBlockedGibbsSamplingHidden(ConvolutionalGRBM & rbm) {
+	RBM_PROFILE_COUNT(Sweeps, 1);
+
+	Eigen::VectorXd mu_vect;
+	rbm.muVect(rbm.nodes.v, mu_vect);
+	sampleHidden(rbm, mu_vect, rbm.nodes.h);
+
+	return rbm.nodes.h;
+}
@@ -0,0 +1,316 @@
+﻿#pragma once
+#include "Eigen/Core"
+#include "../Trainer.h"
+#include "../Checkpoint.h"
+#include "ConvolutionalGRBM.h"
+#include "ConvolutionalGRBMSampler.h"
+#include "ConvolutionalGRBMOptimizer.h"
+#include <vector>
+#include <numeric>
+#include <algorithm>
+#include <random>
+#include <omp.h>
+
+// 勾配は共有パラメータについて全位置の和をとり, 位置数で割ったもの(画像サイズで学習率が変わらないように)
+// 逆分散lambdaは学習しない(GeneralizedGRBMと同じ)
+template<class OPTIMIZERTYPE>
+class Trainer<ConvolutionalGRBM, OPTIMIZERTYPE> {
+	struct Moments {
+		double scale = 0.0;  // 画像数
+		Eigen::VectorXd vBias;  // チャネルごとのvの平均
+		Eigen::VectorXd hBias;  // 特徴マップごとのhの平均
+		Eigen::MatrixXd weight;  // 位置平均したh * パッチ^T
+
+		void init(ConvolutionalGRBM & rbm) {
+			vBias.setZero(rbm.getChannelSize());
+			hBias.setZero(rbm.getFilterCount());
+			weight.setZero(rbm.getFilterCount(), rbm.getPatchSize());
+			scale = 0.0;
+		}
+
+		void add(ConvolutionalGRBM & rbm, const Eigen::VectorXd & v, const Eigen::VectorXd & h, Eigen::MatrixXd & patches) {
+			auto plane = rbm.getImageHeight() * rbm.getImageWidth();
+			auto hidden_plane = rbm.getHiddenHeight() * rbm.getHiddenWidth();
+
+			scale += 1.0;
+			for (int ch = 0; ch < rbm.getChannelSize(); ch++) {
+				vBias(ch) += v.segment(ch * plane, plane).sum() / plane;
+			}
+			for (int k = 0; k < rbm.getFilterCount(); k++) {
+				hBias(k) += h.segment(k * hidden_plane, hidden_plane).sum() / hidden_plane;
+			}
+
+			// Σ_y (隠れ層y行目) * (y行目のパッチ)^T
+			Eigen::MatrixXd weight_sum = Eigen::MatrixXd::Zero(weight.rows(), weight.cols());
+			for (int y = 0; y < rbm.getHiddenHeight(); y++) {
+				rbm.patchRow(v, y, patches);
+				weight_sum.noalias() += rbm.hiddenRow(h, y) * patches.transpose();
+			}
+			weight += weight_sum / hidden_plane;
+		}
+
+		void merge(const Moments & other) {
+			scale += other.scale;
+			vBias += other.vBias;
+			hBias += other.hBias;
+			weight += other.weight;
+		}
+
+		void normalize() {
+			vBias /= scale;
+			hBias /= scale;
+			weight /= scale;
+		}
+	};
+
+private:
+	Moments gradient;
+	Moments dataMean;
+	Moments rbmexpected;
+	Optimizer<ConvolutionalGRBM, OPTIMIZERTYPE> optimizer;
+	int _trainCount = 0;
+
+
+public:
+	int epoch = 0;
+	int batchSize = 1;
+	int cdk = 1;
+	double learningRate = 0.01;
+	std::mt19937 randDevice = std::mt19937(std::random_device()());
+
+public:
+	Trainer() = default;
+	Trainer(ConvolutionalGRBM & rbm);
+	~Trainer() = default;
+
+	// 学習
+	void trainCD(ConvolutionalGRBM & rbm, std::vector<std::vector<double>> & dataset);
+
+	// 1回だけ学習
+	void trainOnceCD(ConvolutionalGRBM & rbm, std::vector<std::vector<double>> & dataset);
+
+	// データ平均の計算
+	void calcDataMean(ConvolutionalGRBM & rbm, std::vector<std::vector<double>> & dataset, std::vector<int> & data_indexes);
+
+	// サンプル平均の計算
+	void calcRBMExpectedCD(ConvolutionalGRBM & rbm, std::vector<std::vector<double>> & dataset, std::vector<int> & data_indexes);
+
+	// 勾配の計算
+	void calcGradient(ConvolutionalGRBM & rbm);
+
+	// 勾配更新
+	void updateParams(ConvolutionalGRBM & rbm);
+
+	// 再構成誤差(v -> E[h | v] -> E[v | h]の二乗誤差の画素平均), 対数尤度の代わりの監視用
+	double reconstructionError(ConvolutionalGRBM & rbm, std::vector<std::vector<double>> & dataset);
+
+	// 学習状態(反復回数, オプティマイザのモーメント, 乱数, チェイン)のチェックポイント
+	// モデルと合わせてrbmckpt::saveTraining/loadTrainingから使う
+	void writeCheckpoint(rbmckpt::Writer & writer, ConvolutionalGRBM & rbm);
+	void readCheckpoint(rbmckpt::Reader & reader, ConvolutionalGRBM & rbm);
+};
+
+template<class OPTIMIZERTYPE>
+Trainer<ConvolutionalGRBM, OPTIMIZERTYPE>::Trainer(ConvolutionalGRBM & rbm) {
+	this->optimizer = Optimizer<ConvolutionalGRBM, OPTIMIZERTYPE>(rbm);
+	gradient.init(rbm);
+	dataMean.init(rbm);
+	rbmexpected.init(rbm);
+}
+
+template<class OPTIMIZERTYPE>
+void Trainer<ConvolutionalGRBM, OPTIMIZERTYPE>::trainCD(ConvolutionalGRBM & rbm, std::vector<std::vector<double>> & dataset) {
+	for (int e = 0; e < epoch; e++) {
+		trainOnceCD(rbm, dataset);
+	}
+}
+
+template<class OPTIMIZERTYPE>
+void Trainer<ConvolutionalGRBM, OPTIMIZERTYPE>::trainOnceCD(ConvolutionalGRBM & rbm, std::vector<std::vector<double>> & dataset) {
+	RBM_PROFILE_SCOPE("trainOnceCD");
+
+	// ミニバッチ学習のためにデータインデックスをシャッフルする
+	std::vector<int> data_indexes(dataset.size());
+	std::iota(data_indexes.begin(), data_indexes.end(), 0);
+	std::shuffle(data_indexes.begin(), data_indexes.end(), this->randDevice);
+
+	// バッチサイズの確認
+	size_t batch_size = std::min<size_t>(std::max(this->batchSize, 1), dataset.size());
+	data_indexes.resize(batch_size);
+
+	// Contrastive Divergence
+	calcDataMean(rbm, dataset, data_indexes);
+	calcRBMExpectedCD(rbm, dataset, data_indexes);
+	calcGradient(rbm);
+
+	// 勾配の更新
+	updateParams(rbm);
+
+	// オプティマイザの更新
+	optimizer.updateOptimizer();
+
+	// Trainer情報更新
+	RBM_PROFILE_EPOCH(_trainCount);
+	_trainCount++;
+}
+
+template<class OPTIMIZERTYPE>
+void Trainer<ConvolutionalGRBM, OPTIMIZERTYPE>::calcDataMean(ConvolutionalGRBM & rbm, std::vector<std::vector<double>> & dataset, std::vector<int> & data_indexes) {
+	RBM_PROFILE_SCOPE("calcDataMean");
+
+	// プーリングの設定はここで確認しておく(並列区間の中で例外を投げないように)
+	rbm.isPooling();
+	dataMean.init(rbm);
+	auto index_size = data_indexes.size();
+
+#pragma omp parallel
+	{
+		Moments local;
+		local.init(rbm);
+		Eigen::VectorXd v, h, mu_vect;
+		Eigen::MatrixXd patches;
+
+#pragma omp for schedule(dynamic)
+		for (int n = 0; n < index_size; n++) {
+			auto & data = dataset[data_indexes[n]];
+			v = Eigen::Map<Eigen::VectorXd>(data.data(), data.size());
+
+			rbm.muVect(v, mu_vect);
+			rbm.actHidden(mu_vect, h);
+
+			local.add(rbm, v, h, patches);
+		}
+
+#pragma omp critical
+		dataMean.merge(local);
+	}
+
+	dataMean.normalize();
+}
+
+template<class OPTIMIZERTYPE>
+void Trainer<ConvolutionalGRBM, OPTIMIZERTYPE>::calcRBMExpectedCD(ConvolutionalGRBM & rbm, std::vector<std::vector<double>> & dataset, std::vector<int> & data_indexes) {
+	RBM_PROFILE_SCOPE("calcRBMExpectedCD");
+
+	// プーリングの設定はここで確認しておく(並列区間の中で例外を投げないように)
+	rbm.isPooling();
+	rbmexpected.init(rbm);
+	auto index_size = data_indexes.size();
+
+	// 画像ごとに乱数列をずらす
+	std::vector<std::mt19937::result_type> seeds(index_size);
+	for (auto & seed : seeds) seed = this->randDevice();
+
+#pragma omp parallel
+	{
+		Moments local;
+		local.init(rbm);
+		Eigen::VectorXd v, h, mu_vect, lambda_vect;
+		Eigen::MatrixXd patches;
+
+#pragma omp for schedule(dynamic)
+		for (int n = 0; n < index_size; n++) {
+			auto & data = dataset[data_indexes[n]];
+			v = Eigen::Map<Eigen::VectorXd>(data.data(), data.size());
+
+			// CD-K
+			Sampler<ConvolutionalGRBM> sampler(std::mt19937(seeds[n]));
+			rbm.muVect(v, mu_vect);
+			sampler.sampleHidden(rbm, mu_vect, h);
+			for (int k = 0; k < cdk; k++) {
+				rbm.lambdaVect(h, lambda_vect);
+				sampler.sampleVisible(rbm, lambda_vect, v);
+				rbm.muVect(v, mu_vect);
+				sampler.sampleHidden(rbm, mu_vect, h);
+			}
+
+			// 最後の隠れ層は期待値で(分散を減らす)
+			rbm.actHidden(mu_vect, h);
+			local.add(rbm, v, h, patches);
+		}
+
+#pragma omp critical
+		rbmexpected.merge(local);
+	}
+
+	rbmexpected.normalize();
+}
+
+
+// 勾配の計算
+template<class OPTIMIZERTYPE>
+void Trainer<ConvolutionalGRBM, OPTIMIZERTYPE>::calcGradient(ConvolutionalGRBM & rbm) {
+	RBM_PROFILE_SCOPE("calcGradient");
+
+	gradient.vBias = dataMean.vBias - rbmexpected.vBias;
+	gradient.hBias = dataMean.hBias - rbmexpected.hBias;
+	gradient.weight = dataMean.weight - rbmexpected.weight;
+}
+
+
+// パラメータの更新
+template<class OPTIMIZERTYPE>
+void Trainer<ConvolutionalGRBM, OPTIMIZERTYPE>::updateParams(ConvolutionalGRBM & rbm) {
+	RBM_PROFILE_SCOPE("updateParams");
+
+	for (int ch = 0; ch < rbm.getChannelSize(); ch++) {
+		rbm.params.b(ch) += optimizer.getNewParamVBias(gradient.vBias(ch), ch);
+	}
+
+	for (int k = 0; k < rbm.getFilterCount(); k++) {
+		rbm.params.c(k) += optimizer.getNewParamHBias(gradient.hBias(k), k);
+
+		for (int p = 0; p < rbm.getPatchSize(); p++) {
+			rbm.params.w(k, p) += optimizer.getNewParamWeight(gradient.weight(k, p), k, p);
+		}
+	}
+}
+
+
+// 再構成誤差
+template<class OPTIMIZERTYPE>
+double Trainer<ConvolutionalGRBM, OPTIMIZERTYPE>::reconstructionError(ConvolutionalGRBM & rbm, std::vector<std::vector<double>> & dataset) {
+	RBM_PROFILE_SCOPE("reconstructionError");
+
+	double error = 0.0;
+
+#pragma omp parallel reduction(+:error)
+	{
+		Eigen::VectorXd v, h, mu_vect, lambda_vect, mean;
+
+#pragma omp for schedule(dynamic)
+		for (int n = 0; n < dataset.size(); n++) {
+			v = Eigen::Map<Eigen::VectorXd>(dataset[n].data(), dataset[n].size());
+			rbm.muVect(v, mu_vect);
+			rbm.actHidden(mu_vect, h);
+			rbm.lambdaVect(h, lambda_vect);
+			rbm.meanVisible(lambda_vect, mean);
+
+			error += (mean - v).squaredNorm() / v.size();
+		}
+	}
+
+	return error / dataset.size();
+}
+
+template<class OPTIMIZERTYPE>
+void Trainer<ConvolutionalGRBM, OPTIMIZERTYPE>::writeCheckpoint(rbmckpt::Writer & writer, ConvolutionalGRBM & rbm) {
+	writer.addScalar("trainer.trainCount", _trainCount);
+	writer.addScalar("trainer.epoch", epoch);
+	writer.addScalar("trainer.batchSize", batchSize);
+	writer.addScalar("trainer.cdk", cdk);
+	writer.addScalar("trainer.learningRate", learningRate);
+	rbmckpt::addEngine(writer, "trainer.rand", this->randDevice);
+	this->optimizer.writeCheckpoint(writer, "optimizer.");
+}
+
+template<class OPTIMIZERTYPE>
+void Trainer<ConvolutionalGRBM, OPTIMIZERTYPE>::readCheckpoint(rbmckpt::Reader & reader, ConvolutionalGRBM & rbm) {
+	_trainCount = static_cast<int>(reader.scalar("trainer.trainCount"));
+	epoch = static_cast<int>(reader.scalar("trainer.epoch"));
+	batchSize = static_cast<int>(reader.scalar("trainer.batchSize"));
+	cdk = static_cast<int>(reader.scalar("trainer.cdk"));
+	learningRate = reader.scalar("trainer.learningRate");
+	rbmckpt::readEngine(reader, "trainer.rand", this->randDevice);
+	this->optimizer.readCheckpoint(reader, "optimizer.");
+}
@@ -0,0 +1,128 @@
+﻿#pragma once
+#include "WorkStealingPool.h"
+#include "ResultSink.h"
+#include "rbmutil.h"
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <cmath>
+
+// 学習中のパラメータのスナップショットを別スレッドで評価する
+// 学習側はpublish()でスナップショットを渡すだけで, KLD, 対数尤度, 再構成誤差の計算を待たない
+template <class RBM>
+class EvalScheduler {
+public:
+	int interval = 1;  // スナップショットを取るエポック間隔
+	size_t maxPending;  // 評価待ちスナップショットの上限(超えたらpublish()で待つ)
+	std::vector<double> visibleValues = { -1.0, 1.0 };  // 構築時にデータをまとめるのにも使う
+
+protected:
+	ResultSink & _sink;
+	PackedDataset _dataset;  // 重複行をまとめたデータ(評価はパターン数に比例)
+	std::vector<double> & _referenceProbs;  // 生成モデルの可視変数の確率表
+	size_t _pendingCount = 0;
+	std::mutex _mutex;
+	std::condition_variable _pendingCondition;
+	WorkStealingPool _pool;  // タスクが上のメンバを参照するので, 最初に破棄されるよう末尾に置く
+
+public:
+	EvalScheduler(ResultSink & sink, std::vector<std::vector<double>> & dataset, std::vector<double> & reference_probs, size_t thread_size = std::thread::hardware_concurrency());
+	~EvalScheduler();
+
+	// このエポックでスナップショットを取るか
+	bool isSnapshotEpoch(int epoch, int epoch_size);
+
+	// スナップショットを取って評価を投入
+	// recordのkld, loglikelihood, reconstruction以外(エポック等)は呼び出し側で設定する
+	void publish(RBM & rbm, const ResultRecord & record);
+
+	// 投入済みの評価が全て終わるまで待つ
+	void wait();
+
+	// 同期的に評価
+	static void evaluate(RBM & rbm, std::vector<std::vector<double>> & dataset, std::vector<double> & reference_probs, std::vector<double> & visible_values, ResultRecord & record);
+
+	// 同期的に評価(重み付きデータ)
+	static void evaluate(RBM & rbm, PackedDataset & dataset, std::vector<double> & reference_probs, std::vector<double> & visible_values, ResultRecord & record);
+};
+
+
+template <class RBM>
+EvalScheduler<RBM>::EvalScheduler(ResultSink & sink, std::vector<std::vector<double>> & dataset, std::vector<double> & reference_probs, size_t thread_size)
+	: _sink(sink), _dataset(PackedDataset::unique(dataset, visibleValues[0], visibleValues[1])), _referenceProbs(reference_probs), _pool(thread_size) {
+	maxPending = _pool.getThreadSize() * 2;
+}
+
+template <class RBM>
+EvalScheduler<RBM>::~EvalScheduler() {
+	try {
+		wait();
+	}
+	catch (...) {
+	}
+}
+
+template <class RBM>
+bool EvalScheduler<RBM>::isSnapshotEpoch(int epoch, int epoch_size) {
+	return epoch == epoch_size - 1 || (epoch + 1) % interval == 0;
+}
+
+template <class RBM>
+void EvalScheduler<RBM>::publish(RBM & rbm, const ResultRecord & record) {
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		_pendingCondition.wait(lock, [&] { return _pendingCount < maxPending; });
+		_pendingCount++;
+	}
+
+	// 評価タスクが所有するコピー(学習側はそのまま更新を続けてよい)
+	auto snapshot = std::make_shared<RBM>(rbm);
+
+	_pool.submit([this, snapshot, record] {
+		auto result = record;
+		try {
+			evaluate(*snapshot, _dataset, _referenceProbs, visibleValues, result);
+			_sink.write(result);
+		}
+		catch (...) {
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				_pendingCount--;
+			}
+			_pendingCondition.notify_all();
+			throw;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_pendingCount--;
+		}
+		_pendingCondition.notify_all();
+	});
+}
+
+template <class RBM>
+void EvalScheduler<RBM>::wait() {
+	_pool.wait();
+}
+
+template <class RBM>
+void EvalScheduler<RBM>::evaluate(RBM & rbm, std::vector<std::vector<double>> & dataset, std::vector<double> & reference_probs, std::vector<double> & visible_values, ResultRecord & record) {
+	auto unique_dataset = PackedDataset::unique(dataset, visible_values[0], visible_values[1]);
+	evaluate(rbm, unique_dataset, reference_probs, visible_values, record);
+}
+
+template <class RBM>
+void EvalScheduler<RBM>::evaluate(RBM & rbm, PackedDataset & dataset, std::vector<double> & reference_probs, std::vector<double> & visible_values, ResultRecord & record) {
+	// 確率表を一度だけ計算し, KLDと対数尤度の両方に使う
+	auto probs = rbmutil::prob_table(rbm, visible_values);
+
+	record.kld = rbmutil::kld_from_probs(reference_probs, probs);
+	record.loglikelihood = 0.0;
+	for (size_t n = 0; n < dataset.size(); n++) {
+		auto data = dataset.unpack(n);
+		record.loglikelihood += dataset.weight(n) * log(probs[rbmutil::state_index(data, visible_values)]);
+	}
+	record.reconstruction = rbmutil::reconstruction_error(rbm, dataset, visible_values);
+}
@@ -29,9 +29,18 @@ public:
     // 規格化を返します
     double getNormalConstant();
 
+    // 規格化の対数を返します(隠れ変数の配位を列挙, 可視変数は解析的に積分)
+    double getLogNormalConstant();
+
+    // 可視変数の対数尤度 log P(v)(log Zを与える)
+    double logProbVis(std::vector<double> & data, double log_z);
+
     // エネルギー関数を返します
     double getEnergy();
 
+    // エネルギー関数を一括計算します(各行が1つの配位, 戻り値の各要素が各行のエネルギー)
+    Eigen::VectorXd getEnergyBatch(const Eigen::MatrixXd & v_batch, const Eigen::MatrixXd & h_batch);
+
     // 自由エネルギーを返します
     double getFreeEnergy();
 
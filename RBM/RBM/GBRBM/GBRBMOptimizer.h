@@ -0,0 +1,80 @@
+﻿#pragma once
+#include "../Optimizer.h"
+#include "../GeneralizedRBM/GeneralizedRBMOptimizer.h"
+#include "GBRBM.h"
+
+// (b, c, w)の更新はvSize x hSizeのGeneralizedRBMのオプティマイザを使いまわす
+// 逆分散はlog(lambda)を更新して非負制約を満たす(vSize x 1のオプティマイザの可視バイアス欄を使う)
+template <class OPTIMIZERTYPE>
+class Optimizer<GBRBM, OPTIMIZERTYPE> {
+
+protected:
+	Optimizer<GeneralizedRBM, OPTIMIZERTYPE> _params;
+	Optimizer<GeneralizedRBM, OPTIMIZERTYPE> _logLambda;
+
+public:
+	Optimizer() = default;
+	Optimizer(GBRBM & rbm);
+	~Optimizer() = default;
+	void init(GBRBM & rbm);
+	double getNewParamVBias(double gradient, int vindex);
+	double getNewParamHBias(double gradient, int hindex);
+	double getNewParamWeight(double gradient, int vindex, int hindex);
+	double getNewParamLogLambda(double gradient, int vindex);
+	// next timestep
+	void updateOptimizer();
+	// 状態のチェックポイント(内側のオプティマイザごとに接頭辞を付ける)
+	void writeCheckpoint(rbmckpt::Writer & writer, const std::string & prefix);
+	void readCheckpoint(rbmckpt::Reader & reader, const std::string & prefix);
+};
+
+template <class OPTIMIZERTYPE>
+Optimizer<GBRBM, OPTIMIZERTYPE>::Optimizer(GBRBM & rbm) {
+	this->init(rbm);
+}
+
+template <class OPTIMIZERTYPE>
+void Optimizer<GBRBM, OPTIMIZERTYPE>::init(GBRBM & rbm) {
+	GeneralizedRBM params_shape(rbm.getVisibleSize(), rbm.getHiddenSize());
+	GeneralizedRBM lambda_shape(rbm.getVisibleSize(), 1);
+	this->_params = Optimizer<GeneralizedRBM, OPTIMIZERTYPE>(params_shape);
+	this->_logLambda = Optimizer<GeneralizedRBM, OPTIMIZERTYPE>(lambda_shape);
+}
+
+template <class OPTIMIZERTYPE>
+void Optimizer<GBRBM, OPTIMIZERTYPE>::updateOptimizer() {
+	this->_params.updateOptimizer();
+	this->_logLambda.updateOptimizer();
+}
+
+template <class OPTIMIZERTYPE>
+void Optimizer<GBRBM, OPTIMIZERTYPE>::writeCheckpoint(rbmckpt::Writer & writer, const std::string & prefix) {
+	this->_params.writeCheckpoint(writer, prefix + "params.");
+	this->_logLambda.writeCheckpoint(writer, prefix + "logLambda.");
+}
+
+template <class OPTIMIZERTYPE>
+void Optimizer<GBRBM, OPTIMIZERTYPE>::readCheckpoint(rbmckpt::Reader & reader, const std::string & prefix) {
+	this->_params.readCheckpoint(reader, prefix + "params.");
+	this->_logLambda.readCheckpoint(reader, prefix + "logLambda.");
+}
+
+template <class OPTIMIZERTYPE>
+double Optimizer<GBRBM, OPTIMIZERTYPE>::getNewParamVBias(double gradient, int vindex) {
+	return this->_params.getNewParamVBias(gradient, vindex);
+}
+
+template <class OPTIMIZERTYPE>
+double Optimizer<GBRBM, OPTIMIZERTYPE>::getNewParamHBias(double gradient, int hindex) {
+	return this->_params.getNewParamHBias(gradient, hindex);
+}
+
+template <class OPTIMIZERTYPE>
+double Optimizer<GBRBM, OPTIMIZERTYPE>::getNewParamWeight(double gradient, int vindex, int hindex) {
+	return this->_params.getNewParamWeight(gradient, vindex, hindex);
+}
+
+template <class OPTIMIZERTYPE>
+double Optimizer<GBRBM, OPTIMIZERTYPE>::getNewParamLogLambda(double gradient, int vindex) {
+	return this->_logLambda.getNewParamVBias(gradient, vindex);
+}
@@ -1,4 +1,5 @@
 ﻿#include "GBRBMParamator.h"
+#include "../Checkpoint.h"
 
 
 // 可視変数の総数を返す
@@ -81,6 +82,30 @@ void GBRBMParamator::deserialize(std::string js) {
 	this->lambda = Eigen::Map<Eigen::VectorXd>(tmp_lambda.data(), vSize);
 }
 
+// チェックポイントに登録
+void GBRBMParamator::writeCheckpoint(rbmckpt::Writer & writer) {
+	writer.setModelType("GBRBM");
+	writer.add("b", this->b);
+	writer.add("c", this->c);
+	writer.add("w", this->w);
+	writer.add("lambda", this->lambda);
+}
+
+// チェックポイントから復元
+void GBRBMParamator::readCheckpoint(rbmckpt::Reader & reader) {
+	if (reader.modelType() != "GBRBM") throw std::runtime_error("GBRBMParamator: model type mismatch " + reader.modelType());
+	auto ckpt_b = reader.vector("b");
+	auto ckpt_c = reader.vector("c");
+	auto ckpt_w = reader.matrix("w");
+	auto ckpt_lambda = reader.vector("lambda");
+	if (ckpt_b.size() != vSize || ckpt_c.size() != hSize || ckpt_w.rows() != vSize || ckpt_w.cols() != hSize || ckpt_lambda.size() != vSize) throw std::runtime_error("GBRBMParamator: shape mismatch");
+
+	this->b = ckpt_b;
+	this->c = ckpt_c;
+	this->w = ckpt_w;
+	this->lambda = ckpt_lambda;
+}
+
 
 GBRBMParamator::GBRBMParamator(size_t v_size, size_t h_size) {
 	vSize = v_size;
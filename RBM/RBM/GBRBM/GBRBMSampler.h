@@ -1,11 +1,17 @@
 ﻿#pragma once
 #include "../Sampler.h"
 #include "GBRBM.h"
+#include "../MaskedSampler.h"
+#include <random>
 
 template<>
 class Sampler<GBRBM> {
 public:
-    Sampler() = default;
+    std::mt19937 randEngine = std::mt19937();
+
+public:
+    Sampler();
+    Sampler(const std::mt19937 & rand_engine);
     ~Sampler() = default;
 
     // 可視変数一つをギブスサンプリング
@@ -31,23 +37,34 @@ public:
 
     // 隠れ層すべてをギブスサンプリングで更新
     Eigen::VectorXd & updateByBlockedGibbsSamplingHidden(GBRBM & rbm);
+
+    // バッチの各列の可視変数をサンプリング, v = (b + W h) / lambda + N(0, 1) / sqrt(lambda)
+    void sampleVisibleBatch(GBRBM & rbm, const Eigen::MatrixXd & h_batch, Eigen::MatrixXd & v_batch);
+
+    // バッチの各列の隠れ変数をサンプリング, prob_batchにP(h_j = 1 | v)が入る
+    void sampleHiddenBatch(GBRBM & rbm, const Eigen::MatrixXd & v_batch, Eigen::MatrixXd & h_batch, Eigen::MatrixXd & prob_batch);
 };
 
-inline double Sampler<GBRBM>::gibbsSamplingVisible(GBRBM &rbm, int vindex) {
+inline Sampler<GBRBM>::Sampler() {
 	std::random_device rd;
-	std::mt19937 mt(rd());
+	this->randEngine = std::mt19937(rd());
+}
+
+// 乱数エンジンを与える(random_deviceを開かない)
+inline Sampler<GBRBM>::Sampler(const std::mt19937 & rand_engine) : randEngine(rand_engine) {
+}
+
+inline double Sampler<GBRBM>::gibbsSamplingVisible(GBRBM &rbm, int vindex) {
 	std::normal_distribution<double> dist(rbm.meanVisible(vindex), sqrt(1 / rbm.params.lambda(vindex)));
 
-	double value = dist(mt);
+	double value = dist(this->randEngine);
 	return value;
 }
 
 inline double Sampler<GBRBM>::gibbsSamplingHidden(GBRBM &rbm, int hindex) {
-	std::random_device rd;
-	std::mt19937 mt(rd());
 	std::uniform_real_distribution<double> dist(0.0, 1.0);
 
-	double value = rbm.condProbHid(hindex, 0.0) < dist(mt) ? 0.0 : 1.0;
+	double value = dist(this->randEngine) < rbm.condProbHid(hindex, 1.0) ? 1.0 : 0.0;
 	return value;
 }
 
@@ -72,26 +89,23 @@ inline Eigen::VectorXd & Sampler<GBRBM>::blockedGibbsSamplingHidden(GBRBM &rbm)
 }
 
 inline double Sampler<GBRBM>::updateByGibbsSamplingVisible(GBRBM &rbm, int vindex) {
-	std::random_device rd;
-	std::mt19937 mt(rd());
 	std::normal_distribution<double> dist(rbm.meanVisible(vindex), sqrt(1 / rbm.params.lambda(vindex)));
 
-	double value = dist(mt);
+	double value = dist(this->randEngine);
 	rbm.nodes.v(vindex) = value;
 	return value;
 }
 
 inline double Sampler<GBRBM>::updateByGibbsSamplingHidden(GBRBM &rbm, int hindex) {
-	std::random_device rd;
-	std::mt19937 mt(rd());
 	std::uniform_real_distribution<double> dist(0.0, 1.0);
 
-	double value = rbm.condProbHid(hindex, 0.0) < dist(mt) ? 0.0 : 1.0;
+	double value = dist(this->randEngine) < rbm.condProbHid(hindex, 1.0) ? 1.0 : 0.0;
 	rbm.nodes.h(hindex) = value;
 	return value;
 }
 
 inline Eigen::VectorXd & Sampler<GBRBM>::updateByBlockedGibbsSamplingVisible(GBRBM &rbm) {
+	RBM_PROFILE_COUNT(Sweeps, 1);
 
 	for (int i = 0; i < rbm.getVisibleSize(); i++) {
 		updateByGibbsSamplingVisible(rbm, i);
@@ -101,9 +115,76 @@ inline Eigen::VectorXd & Sampler<GBRBM>::updateByBlockedGibbsSamplingVisible(GBR
 }
 
 inline Eigen::VectorXd & Sampler<GBRBM>::updateByBlockedGibbsSamplingHidden(GBRBM &rbm) {
+	RBM_PROFILE_COUNT(Sweeps, 1);
 	for (int j = 0; j < rbm.getHiddenSize(); j++) {
 		updateByGibbsSamplingHidden(rbm, j);
 	}
 
 	return rbm.nodes.h;
-}
\ No newline at end of file
+}
+
+inline void Sampler<GBRBM>::sampleVisibleBatch(GBRBM & rbm, const Eigen::MatrixXd & h_batch, Eigen::MatrixXd & v_batch) {
+	RBM_PROFILE_COUNT(Sweeps, h_batch.cols());
+
+	// 正規乱数はまとめて生成する
+	std::normal_distribution<double> dist(0.0, 1.0);
+	Eigen::MatrixXd noise(rbm.getVisibleSize(), h_batch.cols());
+	for (int k = 0; k < noise.size(); k++) noise(k) = dist(this->randEngine);
+
+	Eigen::ArrayXd inv_var = rbm.params.lambda.cwiseInverse();
+	v_batch = rbm.params.w * h_batch;
+	v_batch.colwise() += rbm.params.b;
+	v_batch = (v_batch.array().colwise() * inv_var + noise.array().colwise() * inv_var.sqrt()).matrix();
+}
+
+inline void Sampler<GBRBM>::sampleHiddenBatch(GBRBM & rbm, const Eigen::MatrixXd & v_batch, Eigen::MatrixXd & h_batch, Eigen::MatrixXd & prob_batch) {
+	RBM_PROFILE_COUNT(Sweeps, v_batch.cols());
+
+	prob_batch = rbm.params.w.transpose() * v_batch;
+	prob_batch.colwise() += rbm.params.c;
+	prob_batch = prob_batch.unaryExpr([](double mu) { return RBMMath::sigmoid(mu); });
+
+	std::uniform_real_distribution<double> dist(0.0, 1.0);
+	h_batch.resize(prob_batch.rows(), prob_batch.cols());
+	for (int k = 0; k < h_batch.size(); k++) h_batch(k) = dist(this->randEngine) < prob_batch(k) ? 1.0 : 0.0;
+}
+
+
+// 観測値固定サンプリング用, バッチの各列のmu = c + W^T v
+template<>
+inline void MaskedSampler<GBRBM>::muBatch(GBRBM & rbm, const Eigen::MatrixXd & v_batch, Eigen::MatrixXd & mu_batch) {
+	mu_batch.noalias() = rbm.params.w.transpose() * v_batch;
+	mu_batch.colwise() += rbm.params.c;
+}
+
+template<>
+inline void MaskedSampler<GBRBM>::visibleRows(GBRBM & rbm, const std::vector<int> & rows, Eigen::VectorXd & b_rows, Eigen::MatrixXd & w_rows) {
+	b_rows.resize(rows.size());
+	w_rows.resize(rows.size(), rbm.getHiddenSize());
+	for (int r = 0; r < rows.size(); r++) {
+		b_rows(r) = rbm.params.b(rows[r]);
+		w_rows.row(r) = rbm.params.w.row(rows[r]);
+	}
+}
+
+// 隠れ変数は{0, 1}
+template<>
+inline double MaskedSampler<GBRBM>::sampleHidden(GBRBM & rbm, int hindex, double mu, std::mt19937 & engine) {
+	std::uniform_real_distribution<double> dist(0.0, 1.0);
+
+	return dist(engine) < RBMMath::sigmoid(mu) ? 1.0 : 0.0;
+}
+
+// 可視変数はN(lambda / 逆分散, 1 / 逆分散)
+template<>
+inline double MaskedSampler<GBRBM>::sampleVisible(GBRBM & rbm, int vindex, double lambda, std::mt19937 & engine) {
+	auto inv_var = rbm.params.lambda(vindex);
+	std::normal_distribution<double> dist(lambda / inv_var, sqrt(1 / inv_var));
+
+	return dist(engine);
+}
+
+template<>
+inline double MaskedSampler<GBRBM>::meanVisible(GBRBM & rbm, int vindex, double lambda) {
+	return lambda / rbm.params.lambda(vindex);
+}
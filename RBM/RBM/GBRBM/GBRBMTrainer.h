@@ -1,43 +1,50 @@
 ﻿#pragma once
+#include "../Profiler.h"
+#include "../Trainer.h"
+#include "../Checkpoint.h"
+#include "../Communicator.h"
 #include "GBRBM.h"
+#include "GBRBMSampler.h"
+#include "GBRBMOptimizer.h"
+#include "../GaussianExact.h"
 #include "Eigen/Core"
 #include <vector>
 #include <numeric>
 #include <random>
 
+// ミニバッチを行列(可視変数 x バッチ)にまとめ, CD/PCDを行列積で計算する
+// 逆分散はlog(lambda)で学習する(非負制約)
 template<class OPTIMIZERTYPE>
 class Trainer<GBRBM, OPTIMIZERTYPE> {
-    struct Momentum {
-        Eigen::VectorXd vBias;
-        Eigen::VectorXd vLambda;
-        Eigen::VectorXd hBias;
-        Eigen::MatrixXd weight;
-    };
-
     struct Gradient {
         Eigen::VectorXd vBias;
-        Eigen::VectorXd vLambda;
+        Eigen::VectorXd vLogLambda;
         Eigen::VectorXd hBias;
         Eigen::MatrixXd weight;
     };
 
     struct DataMean {
         Eigen::VectorXd visible;
-        Eigen::VectorXd visible2;  // Gausiann Unit限定 
+        Eigen::VectorXd visible2;  // Gausiann Unit限定, E[v^2] / 2
         Eigen::VectorXd hidden;
+        Eigen::MatrixXd weight;  // E[v h^T]
     };
 
     struct RBMExpected {
         Eigen::VectorXd visible;
-        Eigen::VectorXd visible2;  // Gausiann Unit限定 
+        Eigen::VectorXd visible2;  // Gausiann Unit限定, E[v^2] / 2
         Eigen::VectorXd hidden;
+        Eigen::MatrixXd weight;  // E[v h^T]
     };
 
 private:
-    Momentum momentum;
     Gradient gradient;
     DataMean dataMean;
     RBMExpected sampleMean;
+    Optimizer<GBRBM, OPTIMIZERTYPE> optimizer;
+    Sampler<GBRBM> sampler;
+    Eigen::MatrixXd dataBatch;  // ミニバッチ(可視変数 x バッチ)
+    Eigen::MatrixXd persistentBatch;  // PCDのチェイン(可視変数 x バッチ)
 	int _trainCount = 0;
 
 
@@ -46,19 +53,19 @@ public:
     int batchSize = 1;
     int cdk = 0;
     double learningRate = 0.01;
-    double momentumRate = 0.9;
+    bool persistent = false;  // PCD(チェインをミニバッチ間で引き継ぐ)
+    bool lambdaLearning = true;  // 逆分散も学習する
+    std::mt19937 randDevice = std::mt19937(std::random_device()());
+
+    // データ並列学習(nullptrなら単一ワーカー)
+    // 各ワーカーに自分のデータ分割を渡し, 同じ初期パラメータ・同じ設定で学習させる(PCDのチェインはワーカーごと)
+    Communicator * communicator = nullptr;
 
 public:
     Trainer() = default;
     Trainer(GBRBM & rbm);
     ~Trainer() = default;
 
-    // モーメンタムベクトル初期化
-    void initMomentum(GBRBM & rbm);
-
-    // 確保済みのモーメンタムベクトルを0初期化
-    void initMomentum();
-
     // 勾配ベクトル初期化
     void initGradient(GBRBM & rbm);
 
@@ -86,17 +93,32 @@ public:
     // CD計算
     void calcContrastiveDivergence(GBRBM & rbm, std::vector<std::vector<double>> & dataset, std::vector<int> & data_indexes);
 
+    // ミニバッチを行列にまとめる
+    void makeBatch(GBRBM & rbm, std::vector<std::vector<double>> & dataset, std::vector<int> & data_indexes);
+
     // データ平均の計算
     void calcDataMean(GBRBM & rbm, std::vector<std::vector<double>> & dataset, std::vector<int> & data_indexes);
 
     // サンプル平均の計算
     void calcRBMExpectedCD(GBRBM & rbm, std::vector<std::vector<double>> & dataset, std::vector<int> & data_indexes);
 
+    // 学習(厳密な期待値)
+    void trainExact(GBRBM & rbm, std::vector<std::vector<double>> & dataset);
+
+    // 1回だけ学習(厳密な期待値)
+    void trainOnceExact(GBRBM & rbm, std::vector<std::vector<double>> & dataset);
+
+    // サンプル平均の計算(隠れ変数の配位を列挙, 可視変数は解析的に積分)
+    void calcRBMExpectedExact(GBRBM & rbm);
+
+    // 対数尤度関数(厳密)
+    double logLikeliHood(GBRBM & rbm, std::vector<std::vector<double>> & dataset);
+
     // 勾配の計算
     void calcGradient(GBRBM & rbm, std::vector<int> & data_indexes);
 
-    // モーメンタム更新
-    void updateMomentum(GBRBM & rbm);
+    // 全ワーカーの勾配をバッチサイズで重み付けして平均する(communicatorが無ければ何もしない)
+    void allReduceGradient(double batch_size);
 
     // 勾配更新
     void updateParams(GBRBM & rbm);
@@ -107,36 +129,26 @@ public:
 	// 学習情報から学習(JSON)
 	void trainFromTrainInfo(GBRBM & rbm, std::string json);
 
+	// 学習状態(反復回数, オプティマイザのモーメント, 乱数, チェイン)のチェックポイント
+	// モデルと合わせてrbmckpt::saveTraining/loadTrainingから使う
+	void writeCheckpoint(rbmckpt::Writer & writer, GBRBM & rbm);
+	void readCheckpoint(rbmckpt::Reader & reader, GBRBM & rbm);
+
 };
 
 template<class OPTIMIZERTYPE>
 inline Trainer<GBRBM, OPTIMIZERTYPE>::Trainer(GBRBM & rbm) {
-	initMomentum(rbm);
 	initGradient(rbm);
 	initDataMean(rbm);
 	initRBMExpected(rbm);
-}
-
-template<class OPTIMIZERTYPE>
-inline void Trainer<GBRBM, OPTIMIZERTYPE>::initMomentum(GBRBM & rbm) {
-	momentum.vBias.setConstant(rbm.getVisibleSize(), 0.0);
-	momentum.vLambda.setConstant(rbm.getVisibleSize(), 0.0);
-	momentum.hBias.setConstant(rbm.getHiddenSize(), 0.0);
-	momentum.weight.setConstant(rbm.getVisibleSize(), rbm.getHiddenSize(), 0.0);
-}
-
-template<class OPTIMIZERTYPE>
-inline void Trainer<GBRBM, OPTIMIZERTYPE>::initMomentum() {
-	momentum.vBias.setConstant(0.0);
-	momentum.vLambda.setConstant(0.0);
-	momentum.hBias.setConstant(0.0);
-	momentum.weight.setConstant(0.0);
+	this->optimizer = Optimizer<GBRBM, OPTIMIZERTYPE>(rbm);
+	this->sampler = Sampler<GBRBM>(std::mt19937(randDevice()));
 }
 
 template<class OPTIMIZERTYPE>
 inline void Trainer<GBRBM, OPTIMIZERTYPE>::initGradient(GBRBM & rbm) {
 	gradient.vBias.setConstant(rbm.getVisibleSize(), 0.0);
-	gradient.vLambda.setConstant(rbm.getVisibleSize(), 0.0);
+	gradient.vLogLambda.setConstant(rbm.getVisibleSize(), 0.0);
 	gradient.hBias.setConstant(rbm.getHiddenSize(), 0.0);
 	gradient.weight.setConstant(rbm.getVisibleSize(), rbm.getHiddenSize(), 0.0);
 }
@@ -144,7 +156,7 @@ inline void Trainer<GBRBM, OPTIMIZERTYPE>::initGradient(GBRBM & rbm) {
 template<class OPTIMIZERTYPE>
 inline void Trainer<GBRBM, OPTIMIZERTYPE>::initGradient() {
 	gradient.vBias.setConstant(0.0);
-	gradient.vLambda.setConstant(0.0);
+	gradient.vLogLambda.setConstant(0.0);
 	gradient.hBias.setConstant(0.0);
 	gradient.weight.setConstant(0.0);
 }
@@ -154,6 +166,7 @@ inline void Trainer<GBRBM, OPTIMIZERTYPE>::initDataMean(GBRBM & rbm) {
 	dataMean.visible.setConstant(rbm.getVisibleSize(), 0.0);
 	dataMean.visible2.setConstant(rbm.getVisibleSize(), 0.0);  // Gaussian Unit
 	dataMean.hidden.setConstant(rbm.getHiddenSize(), 0.0);
+	dataMean.weight.setConstant(rbm.getVisibleSize(), rbm.getHiddenSize(), 0.0);
 }
 
 template<class OPTIMIZERTYPE>
@@ -161,6 +174,7 @@ inline void Trainer<GBRBM, OPTIMIZERTYPE>::initDataMean() {
 	dataMean.visible.setConstant(0.0);
 	dataMean.visible2.setConstant(0.0);  // Gaussian Unit
 	dataMean.hidden.setConstant(0.0);
+	dataMean.weight.setConstant(0.0);
 }
 
 template<class OPTIMIZERTYPE>
@@ -168,6 +182,7 @@ inline void Trainer<GBRBM, OPTIMIZERTYPE>::initRBMExpected(GBRBM & rbm) {
 	sampleMean.visible.setConstant(rbm.getVisibleSize(), 0.0);
 	sampleMean.visible2.setConstant(rbm.getVisibleSize(), 0.0);  // Gaussian Unit
 	sampleMean.hidden.setConstant(rbm.getHiddenSize(), 0.0);
+	sampleMean.weight.setConstant(rbm.getVisibleSize(), rbm.getHiddenSize(), 0.0);
 }
 
 template<class OPTIMIZERTYPE>
@@ -175,6 +190,7 @@ inline void Trainer<GBRBM, OPTIMIZERTYPE>::initRBMExpected() {
 	sampleMean.visible.setConstant(0.0);
 	sampleMean.visible2.setConstant(0.0);  // Gaussian Unit
 	sampleMean.hidden.setConstant(0.0);
+	sampleMean.weight.setConstant(0.0);
 }
 
 template<class OPTIMIZERTYPE>
@@ -188,17 +204,18 @@ inline void Trainer<GBRBM, OPTIMIZERTYPE>::train(GBRBM & rbm, std::vector<std::v
 // 1回だけ学習
 template<class OPTIMIZERTYPE>
 inline void Trainer<GBRBM, OPTIMIZERTYPE>::trainOnce(GBRBM & rbm, std::vector<std::vector<double>> & dataset) {
+	RBM_PROFILE_SCOPE("trainOnce");
 
 	// データインデックス集合
 	std::vector<int> data_indexes(dataset.size());
 
 	// ミニバッチ学習のためにデータインデックスをシャッフルする
 	std::iota(data_indexes.begin(), data_indexes.end(), 0);
-	std::shuffle(data_indexes.begin(), data_indexes.end(), std::mt19937());
+	std::shuffle(data_indexes.begin(), data_indexes.end(), randDevice);
 
 	// ミニバッチ
 	// バッチサイズの確認
-	int batch_size = this->batchSize < dataset.size() ? dataset.size() : this->batchSize;
+	int batch_size = std::min(this->batchSize, static_cast<int>(dataset.size()));
 
 	// ミニバッチ学習に使うデータのインデックス集合
 	std::vector<int> minibatch_indexes(batch_size);
@@ -207,13 +224,15 @@ inline void Trainer<GBRBM, OPTIMIZERTYPE>::trainOnce(GBRBM & rbm, std::vector<st
 	// Contrastive Divergence
 	calcContrastiveDivergence(rbm, dataset, minibatch_indexes);
 
-	// モーメンタムの更新
-	updateMomentum(rbm);
+	// ワーカー間で勾配を平均
+	allReduceGradient(minibatch_indexes.size());
 
 	// 勾配の更新
 	updateParams(rbm);
 
 	// Trainer情報更新
+	optimizer.updateOptimizer();
+	RBM_PROFILE_EPOCH(_trainCount);
 	_trainCount++;
 }
 
@@ -229,118 +248,155 @@ inline void Trainer<GBRBM, OPTIMIZERTYPE>::calcContrastiveDivergence(GBRBM & rbm
 	calcGradient(rbm, data_indexes);
 }
 
+template<class OPTIMIZERTYPE>
+inline void Trainer<GBRBM, OPTIMIZERTYPE>::makeBatch(GBRBM & rbm, std::vector<std::vector<double>> & dataset, std::vector<int> & data_indexes) {
+	dataBatch.resize(rbm.getVisibleSize(), data_indexes.size());
+	for (int n = 0; n < data_indexes.size(); n++) {
+		auto & data = dataset[data_indexes[n]];
+		dataBatch.col(n) = Eigen::Map<Eigen::VectorXd>(data.data(), data.size());
+	}
+}
+
 template<class OPTIMIZERTYPE>
 inline void Trainer<GBRBM, OPTIMIZERTYPE>::calcDataMean(GBRBM & rbm, std::vector<std::vector<double>> & dataset, std::vector<int> & data_indexes) {
-	// 0埋め初期化
-	initDataMean();
-
-	for (auto & n : data_indexes) {
-		auto & data = dataset[n];
-		Eigen::VectorXd vect = Eigen::Map<Eigen::VectorXd>(data.data(), data.size());
-		rbm.nodes.v = vect;
-
-		dataMean.visible += vect;
-		// Gausiann Unit限定 
-		for (int i = 0; i < rbm.getVisibleSize(); i++) {
-			dataMean.visible2(i) += vect(i) * vect(i) / 2.0;  // Gausiann Unit限定 
-		}
+	RBM_PROFILE_SCOPE("calcDataMean");
 
-		for (int j = 0; j < rbm.getHiddenSize(); j++) {
-			dataMean.hidden(j) += rbm.actHidJ(j);
-		}
-	}
+	makeBatch(rbm, dataset, data_indexes);
 
-	dataMean.visible /= static_cast<double>(data_indexes.size());
-	dataMean.hidden /= static_cast<double>(data_indexes.size());
+	// E[h | v] = sigmoid(c + W^T v)
+	Eigen::MatrixXd hidden_batch = rbm.params.w.transpose() * dataBatch;
+	hidden_batch.colwise() += rbm.params.c;
+	hidden_batch = hidden_batch.unaryExpr([](double mu) { return RBMMath::sigmoid(mu); });
+
+	auto batch_size = static_cast<double>(data_indexes.size());
+	dataMean.visible = dataBatch.rowwise().sum() / batch_size;
+	dataMean.visible2 = dataBatch.cwiseAbs2().rowwise().sum() / 2.0 / batch_size;
+	dataMean.hidden = hidden_batch.rowwise().sum() / batch_size;
+	dataMean.weight.noalias() = dataBatch * hidden_batch.transpose() / batch_size;
 }
 
 template<class OPTIMIZERTYPE>
 inline void Trainer<GBRBM, OPTIMIZERTYPE>::calcRBMExpectedCD(GBRBM & rbm, std::vector<std::vector<double>> & dataset, std::vector<int> & data_indexes) {
-	// 0埋め初期化
-	initRBMExpected();
+	RBM_PROFILE_SCOPE("calcRBMExpectedCD");
 
-	for (auto & n : data_indexes) {
-		auto & data = dataset[n];
-		Eigen::VectorXd vect = Eigen::Map<Eigen::VectorXd>(data.data(), data.size());
+	// チェインの初期値: CDはデータ, PCDは前回の続き(バッチサイズが変わったらデータから)
+	Eigen::MatrixXd visible_batch, hidden_batch, prob_batch;
+	if (persistent && persistentBatch.cols() == dataBatch.cols() && persistentBatch.rows() == dataBatch.rows()) {
+		visible_batch = persistentBatch;
+	}
+	else {
+		visible_batch = dataBatch;
+	}
+	sampler.sampleHiddenBatch(rbm, visible_batch, hidden_batch, prob_batch);
 
-		// GBRBMの初期値設定
-		rbm.nodes.v = vect;
+	// CD-K(PCDは最低1スイープ)
+	int sweeps = persistent ? std::max(cdk, 1) : cdk;
+	for (int k = 0; k < sweeps; k++) {
+		sampler.sampleVisibleBatch(rbm, hidden_batch, visible_batch);
+		sampler.sampleHiddenBatch(rbm, visible_batch, hidden_batch, prob_batch);
+	}
+	if (persistent) persistentBatch = visible_batch;
+
+	// 結果を格納(隠れ変数は条件付き期待値)
+	auto batch_size = static_cast<double>(data_indexes.size());
+	sampleMean.visible = visible_batch.rowwise().sum() / batch_size;
+	sampleMean.visible2 = visible_batch.cwiseAbs2().rowwise().sum() / 2.0 / batch_size;
+	sampleMean.hidden = prob_batch.rowwise().sum() / batch_size;
+	sampleMean.weight.noalias() = visible_batch * prob_batch.transpose() / batch_size;
+}
 
-		for (int j = 0; j < rbm.getHiddenSize(); j++) {
-			rbm.nodes.h(j) = rbm.actHidJ(j);
-		}
+template<class OPTIMIZERTYPE>
+inline void Trainer<GBRBM, OPTIMIZERTYPE>::calcRBMExpectedExact(GBRBM & rbm) {
+	RBM_PROFILE_SCOPE("calcRBMExpectedExact");
+
+	auto moments = GaussianExact::moments(rbm.params.b, rbm.params.c, rbm.params.w, rbm.params.lambda, std::vector<double>{ 0.0, 1.0 });
+	sampleMean.visible = moments.visible;
+	sampleMean.visible2 = moments.visible2;
+	sampleMean.hidden = moments.hidden;
+	sampleMean.weight = moments.weight;
+}
 
-		// CD-K
-		Sampler<GBRBM, OPTIMIZERTYPE> sampler;
-		for (int k = 0; k < cdk; k++) {
-			sampler.updateByBlockedGibbsSamplingVisible(rbm);
-			sampler.updateByBlockedGibbsSamplingHidden(rbm);
-		}
+template<class OPTIMIZERTYPE>
+inline void Trainer<GBRBM, OPTIMIZERTYPE>::trainExact(GBRBM & rbm, std::vector<std::vector<double>> & dataset) {
+	for (int e = 0; e < epoch; e++) {
+		trainOnceExact(rbm, dataset);
+	}
+}
 
-		// 結果を格納
-		sampleMean.visible += rbm.nodes.v;
-		sampleMean.hidden += rbm.nodes.h;
+// 1回だけ学習(データ平均は全データ, モデル平均は厳密)
+template<class OPTIMIZERTYPE>
+inline void Trainer<GBRBM, OPTIMIZERTYPE>::trainOnceExact(GBRBM & rbm, std::vector<std::vector<double>> & dataset) {
+	RBM_PROFILE_SCOPE("trainOnceExact");
 
-		// Gausiann Unit限定 
-		for (int i = 0; i < rbm.getVisibleSize(); i++) {
-			sampleMean.visible2(i) += rbm.nodes.v(i) * rbm.nodes.v(i) / 2.0;
-		}
+	std::vector<int> data_indexes(dataset.size());
+	std::iota(data_indexes.begin(), data_indexes.end(), 0);
+
+	calcDataMean(rbm, dataset, data_indexes);
+	calcRBMExpectedExact(rbm);
+	calcGradient(rbm, data_indexes);
+	allReduceGradient(data_indexes.size());
+	updateParams(rbm);
+
+	optimizer.updateOptimizer();
+	RBM_PROFILE_EPOCH(_trainCount);
+	_trainCount++;
+}
+
+// 対数尤度関数(厳密)
+template<class OPTIMIZERTYPE>
+inline double Trainer<GBRBM, OPTIMIZERTYPE>::logLikeliHood(GBRBM & rbm, std::vector<std::vector<double>> & dataset) {
+	RBM_PROFILE_SCOPE("logLikeliHood");
+
+	auto log_z = rbm.getLogNormalConstant();
+	double value = 0.0;
+	for (auto & data : dataset) {
+		value += rbm.logProbVis(data, log_z);
 	}
 
-	sampleMean.visible /= static_cast<double>(data_indexes.size());
-	sampleMean.hidden /= static_cast<double>(data_indexes.size());
+	return value;
 }
 
 // 勾配の計算
 template<class OPTIMIZERTYPE>
 inline void Trainer<GBRBM, OPTIMIZERTYPE>::calcGradient(GBRBM & rbm, std::vector<int> & data_indexes) {
-	// 勾配ベクトルリセット
-	initGradient();
-
-	for (int i = 0; i < rbm.getVisibleSize(); i++) {
-		gradient.vBias(i) = dataMean.visible(i) - sampleMean.visible(i);
-		//gradient.vLambda(i) = dataMean.visible2(i) - sampleMean.visible2(i);
+	RBM_PROFILE_SCOPE("calcGradient");
 
-		for (int j = 0; j < rbm.getHiddenSize(); j++) {
-			gradient.weight(i, j) = dataMean.visible(i) * dataMean.hidden(j) - sampleMean.visible(i) * sampleMean.hidden(j);
-		}
-	}
+	gradient.vBias = dataMean.visible - sampleMean.visible;
+	gradient.hBias = dataMean.hidden - sampleMean.hidden;
+	gradient.weight = dataMean.weight - sampleMean.weight;
 
-	for (int j = 0; j < rbm.getHiddenSize(); j++) {
-		gradient.hBias(j) = dataMean.hidden(j) - sampleMean.hidden(j);
-	}
+	// dlogP / dlog(lambda_i) = lambda_i (E_model[v_i^2] - E_data[v_i^2]) / 2
+	gradient.vLogLambda = rbm.params.lambda.cwiseProduct(sampleMean.visible2 - dataMean.visible2);
 }
 
+// 勾配のall-reduce(オプティマイザより前に全ワーカーで同じ勾配にそろえる)
 template<class OPTIMIZERTYPE>
-inline void Trainer<GBRBM, OPTIMIZERTYPE>::updateMomentum(GBRBM & rbm) {
-	for (int i = 0; i < rbm.getVisibleSize(); i++) {
-		momentum.vBias(i) = momentumRate * momentum.vBias(i) + learningRate * gradient.vBias(i);
-		//momentum.vLambda(i) = momentumRate * momentum.vLambda(i) + learningRate * gradient.vLambda(i);  // 非負制約満たすこと
-
-		for (int j = 0; j < rbm.getHiddenSize(); j++) {
-			momentum.weight(i, j) = momentumRate * momentum.weight(i, j) + learningRate * gradient.weight(i, j);
-		}
-	}
+inline void Trainer<GBRBM, OPTIMIZERTYPE>::allReduceGradient(double batch_size) {
+	if (communicator == nullptr) return;
+	RBM_PROFILE_SCOPE("allReduceGradient");
 
-	for (int j = 0; j < rbm.getHiddenSize(); j++) {
-		momentum.hBias(j) = momentumRate * momentum.hBias(j) + learningRate * gradient.hBias(j);
-	}
+	communicator->allReduceMean(batch_size, gradient.vBias, gradient.vLogLambda, gradient.hBias, gradient.weight);
 }
 
 // パラメータの更新
 template<class OPTIMIZERTYPE>
 inline void Trainer<GBRBM, OPTIMIZERTYPE>::updateParams(GBRBM & rbm) {
+	RBM_PROFILE_SCOPE("updateParams");
+
 	for (int i = 0; i < rbm.getVisibleSize(); i++) {
-		rbm.params.b(i) += momentum.vBias(i);
-		//rbm.params.lambda(i) += momentum.vLambda(i);  // 非負制約を満たすこと
+		rbm.params.b(i) += optimizer.getNewParamVBias(gradient.vBias(i), i);
 
 		for (int j = 0; j < rbm.getHiddenSize(); j++) {
-			rbm.params.w(i, j) += momentum.weight(i, j);
+			rbm.params.w(i, j) += optimizer.getNewParamWeight(gradient.weight(i, j), i, j);
+		}
+
+		if (lambdaLearning) {
+			rbm.params.lambda(i) *= exp(optimizer.getNewParamLogLambda(gradient.vLogLambda(i), i));
 		}
 	}
 
 	for (int j = 0; j < rbm.getHiddenSize(); j++) {
-		rbm.params.c(j) += momentum.hBias(j);
+		rbm.params.c(j) += optimizer.getNewParamHBias(gradient.hBias(j), j);
 	}
 }
 
@@ -351,8 +407,9 @@ inline std::string Trainer<GBRBM, OPTIMIZERTYPE>::trainInfoJson(GBRBM & rbm) {
 	js["rbm"] = nlohmann::json::parse(rbm.params.serialize());
 	js["trainCount"] = _trainCount;
 	js["learningRate"] = learningRate;
-	js["momentumRate"] = momentumRate;
 	js["cdk"] = cdk;
+	js["persistent"] = persistent;
+	js["lambdaLearning"] = lambdaLearning;
 
 	return js.dump();
 }
@@ -363,6 +420,37 @@ inline void Trainer<GBRBM, OPTIMIZERTYPE>::trainFromTrainInfo(GBRBM & rbm, std::
 	rbm.params.deserialize(js["rbm"].dump());
 	_trainCount = js["trainCount"];
 	learningRate = js["learningRate"];
-	momentumRate = js["momentumRate"];
 	cdk = js["cdk"];
-}
\ No newline at end of file
+	if (js.count("persistent")) persistent = js["persistent"];
+	if (js.count("lambdaLearning")) lambdaLearning = js["lambdaLearning"];
+}
+
+template<class OPTIMIZERTYPE>
+void Trainer<GBRBM, OPTIMIZERTYPE>::writeCheckpoint(rbmckpt::Writer & writer, GBRBM & rbm) {
+	writer.addScalar("trainer.trainCount", _trainCount);
+	writer.addScalar("trainer.epoch", epoch);
+	writer.addScalar("trainer.batchSize", batchSize);
+	writer.addScalar("trainer.cdk", cdk);
+	writer.addScalar("trainer.learningRate", learningRate);
+	writer.addScalar("trainer.persistent", persistent ? 1.0 : 0.0);
+	writer.addScalar("trainer.lambdaLearning", lambdaLearning ? 1.0 : 0.0);
+	rbmckpt::addEngine(writer, "trainer.rand", this->randDevice);
+	this->optimizer.writeCheckpoint(writer, "optimizer.");
+	rbmckpt::addEngine(writer, "trainer.samplerRand", this->sampler.randEngine);
+	writer.add("trainer.persistentBatch", persistentBatch);
+}
+
+template<class OPTIMIZERTYPE>
+void Trainer<GBRBM, OPTIMIZERTYPE>::readCheckpoint(rbmckpt::Reader & reader, GBRBM & rbm) {
+	_trainCount = static_cast<int>(reader.scalar("trainer.trainCount"));
+	epoch = static_cast<int>(reader.scalar("trainer.epoch"));
+	batchSize = static_cast<int>(reader.scalar("trainer.batchSize"));
+	cdk = static_cast<int>(reader.scalar("trainer.cdk"));
+	learningRate = reader.scalar("trainer.learningRate");
+	persistent = reader.scalar("trainer.persistent") != 0.0;
+	lambdaLearning = reader.scalar("trainer.lambdaLearning") != 0.0;
+	rbmckpt::readEngine(reader, "trainer.rand", this->randDevice);
+	this->optimizer.readCheckpoint(reader, "optimizer.");
+	rbmckpt::readEngine(reader, "trainer.samplerRand", this->sampler.randEngine);
+	persistentBatch = reader.matrix("trainer.persistentBatch");
+}
@@ -0,0 +1,169 @@
+﻿#pragma once
+#include "Eigen/Core"
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <omp.h>
+
+// 可視変数がガウス型のモデル(GBRBM, GeneralizedGRBM)の厳密な分配関数と期待値
+// E(v, h) = sum_i lambda_i v_i^2 / 2 - b^T v - c^T h - v^T W h
+// 可視変数はhを与えると独立な正規分布なので解析的に積分し, 隠れ変数の配位だけを列挙する
+// Z = prod_i sqrt(2 pi / lambda_i) sum_h exp(c^T h + sum_i a_i^2 / (2 lambda_i)), a = b + W h
+// 列挙はグレイコード順(1ステップで隠れ変数1つだけが変わる)なのでaの更新はO(V)
+// 列挙範囲はスレッド毎に分割し, 各スレッドは自分の範囲の先頭の配位から始める
+class GaussianExact {
+public:
+	// 期待値(visible2はE[v^2] / 2, 学習の逆分散の項と揃える)
+	struct Moments {
+		double logZ = 0.0;
+		Eigen::VectorXd visible;
+		Eigen::VectorXd visible2;
+		Eigen::VectorXd hidden;
+		Eigen::MatrixXd weight;  // E[v h^T]
+	};
+
+protected:
+	// 1スレッド分の累積(重みはexp(s - shift))
+	struct Partial {
+		double shift = -std::numeric_limits<double>::infinity();
+		double sum = 0.0;
+		Eigen::VectorXd hidden;
+		Eigen::MatrixXd hidden2;
+	};
+
+public:
+	// log Z
+	static double logNormalConstant(const Eigen::VectorXd & b, const Eigen::VectorXd & c, const Eigen::MatrixXd & w, const Eigen::VectorXd & prec, const std::vector<double> & hidden_values) {
+		auto partials = enumerate(b, c, w, prec, hidden_values, false);
+		return merge(partials, prec, c.size(), false).logZ;
+	}
+
+	// log Zと期待値
+	static Moments moments(const Eigen::VectorXd & b, const Eigen::VectorXd & c, const Eigen::MatrixXd & w, const Eigen::VectorXd & prec, const std::vector<double> & hidden_values) {
+		auto partials = enumerate(b, c, w, prec, hidden_values, true);
+		auto result = merge(partials, prec, c.size(), true);
+
+		// E[hh^T]からvの期待値を解析的に: E[v | h] = a / lambda, E[v^2 | h] = 1 / lambda + (a / lambda)^2
+		Eigen::MatrixXd hidden2 = result.weight;  // mergeはE[hh^T]をweightに入れて返す
+		Eigen::VectorXd inv_prec = prec.cwiseInverse();
+		Eigen::VectorXd w_h = w * result.hidden;
+		Eigen::MatrixXd w_hh = w * hidden2;
+		Eigen::VectorXd a2 = b.cwiseAbs2() + 2.0 * b.cwiseProduct(w_h) + w_hh.cwiseProduct(w).rowwise().sum();
+
+		result.visible = (b + w_h).cwiseProduct(inv_prec);
+		result.visible2 = (inv_prec + a2.cwiseProduct(inv_prec.cwiseAbs2())) / 2.0;
+		Eigen::MatrixXd weight = b * result.hidden.transpose() + w_hh;
+		result.weight = inv_prec.asDiagonal() * weight;
+
+		return result;
+	}
+
+protected:
+	static std::vector<Partial> enumerate(const Eigen::VectorXd & b, const Eigen::VectorXd & c, const Eigen::MatrixXd & w, const Eigen::VectorXd & prec, const std::vector<double> & hidden_values, bool moment_flag) {
+		int h_size = c.size();
+		int k_size = hidden_values.size();
+		if (h_size * std::log2(static_cast<double>(k_size)) > 62) throw std::runtime_error("GaussianExact: too many hidden configurations");
+
+		long long total = 1;
+		for (int j = 0; j < h_size; j++) total *= k_size;
+
+		Eigen::VectorXd half_inv_prec = prec.cwiseInverse() / 2.0;
+		int chunk_size = std::max(1, static_cast<int>(std::min<long long>(omp_get_max_threads(), total)));
+		std::vector<Partial> partials(chunk_size);
+
+#pragma omp parallel for schedule(static, 1)
+		for (int t = 0; t < chunk_size; t++) {
+			auto begin = total * t / chunk_size;
+			auto end = total * (t + 1) / chunk_size;
+			auto & partial = partials[t];
+			if (moment_flag) {
+				partial.hidden.setZero(h_size);
+				partial.hidden2.setZero(h_size, h_size);
+			}
+
+			// begin番目の配位: 上位の桁の数が奇数なら反転(反射グレイコード)
+			std::vector<int> digit(h_size), dir(h_size);
+			Eigen::VectorXd h(h_size);
+			auto q = begin;
+			for (int j = 0; j < h_size; j++) {
+				int d = q % k_size;
+				q /= k_size;
+				bool odd = q % 2 == 1;
+				digit[j] = odd ? k_size - 1 - d : d;
+				dir[j] = odd ? -1 : 1;
+				h(j) = hidden_values[digit[j]];
+			}
+			Eigen::VectorXd a = b + w * h;
+			double ch = c.dot(h);
+
+			for (auto n = begin; n < end; n++) {
+				double s = ch + a.cwiseAbs2().dot(half_inv_prec);
+
+				if (s > partial.shift) {
+					auto ratio = std::exp(partial.shift - s);
+					partial.sum *= ratio;
+					if (moment_flag) {
+						partial.hidden *= ratio;
+						partial.hidden2 *= ratio;
+					}
+					partial.shift = s;
+				}
+				auto p = std::exp(s - partial.shift);
+				partial.sum += p;
+				if (moment_flag) {
+					partial.hidden.noalias() += p * h;
+					partial.hidden2.noalias() += p * h * h.transpose();
+				}
+
+				if (n + 1 == end) break;
+
+				// 動ける最下位の桁を1つ動かし, それより下の桁は向きを反転
+				int j = 0;
+				while (digit[j] + dir[j] < 0 || digit[j] + dir[j] >= k_size) {
+					dir[j] = -dir[j];
+					j++;
+				}
+				digit[j] += dir[j];
+				auto delta = hidden_values[digit[j]] - h(j);
+				h(j) = hidden_values[digit[j]];
+				a.noalias() += delta * w.col(j);
+				ch += delta * c(j);
+			}
+		}
+
+		return partials;
+	}
+
+	// スレッド毎の累積をまとめる(moment_flagならhiddenにE[h], weightにE[hh^T])
+	static Moments merge(std::vector<Partial> & partials, const Eigen::VectorXd & prec, int h_size, bool moment_flag) {
+		double shift = -std::numeric_limits<double>::infinity();
+		for (auto & partial : partials) shift = std::max(shift, partial.shift);
+
+		Moments moments;
+		double sum = 0.0;
+		if (moment_flag) {
+			moments.hidden.setZero(h_size);
+			moments.weight.setZero(h_size, h_size);
+		}
+		for (auto & partial : partials) {
+			if (partial.sum == 0.0) continue;
+			auto ratio = std::exp(partial.shift - shift);
+			sum += ratio * partial.sum;
+			if (moment_flag) {
+				moments.hidden += ratio * partial.hidden;
+				moments.weight += ratio * partial.hidden2;
+			}
+		}
+		if (moment_flag) {
+			moments.hidden /= sum;
+			moments.weight /= sum;
+		}
+
+		// 可視変数の積分 prod_i sqrt(2 pi / lambda_i)
+		const double pi = 3.14159265358979323846;
+		moments.logZ = shift + std::log(sum) + 0.5 * (2.0 * pi * prec.cwiseInverse().array()).log().sum();
+		return moments;
+	}
+};
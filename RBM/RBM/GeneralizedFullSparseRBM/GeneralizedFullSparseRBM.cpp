@@ -83,8 +83,26 @@
 //
 //// エネルギー関数を返します
 //double GeneralizedFullSparseRBM::getEnergy() {
-//	// まだ必要ないため実装保留
-//	throw;
+//	Eigen::MatrixXd v_batch = nodes.v.transpose();
+//	Eigen::MatrixXd h_batch = nodes.h.transpose();
+//	return this->getEnergyBatch(v_batch, h_batch)(0);
+//}
+//
+//// エネルギー関数を一括計算します
+//// E(v, h) = -b^T v - mu(v)^T h + sum_j exp(sparseC_j + sum_i sparseW_ij v_i) |h_j| を行列積でまとめて計算
+//Eigen::VectorXd GeneralizedFullSparseRBM::getEnergyBatch(const Eigen::MatrixXd & v_batch, const Eigen::MatrixXd & h_batch) {
+//	// 各行の隠れ変数に関する外部磁場と相互作用, mu = c + W^T v
+//	Eigen::MatrixXd mu_batch = v_batch * params.w;
+//	mu_batch.rowwise() += params.c.transpose();
+//
+//	// 各行のスパース係数の指数部, sparseC + sparseW^T v
+//	Eigen::MatrixXd mu_star_batch = v_batch * params.sparseW;
+//	mu_star_batch.rowwise() += params.sparseC.transpose();
+//
+//	Eigen::VectorXd energy = -(v_batch * params.b) - mu_batch.cwiseProduct(h_batch).rowwise().sum();
+//	energy += (mu_star_batch.array().exp() * h_batch.array().abs()).matrix().rowwise().sum();
+//
+//	return energy;
 //}
 //
 //
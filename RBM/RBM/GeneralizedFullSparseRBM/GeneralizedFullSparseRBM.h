@@ -39,6 +39,9 @@ public:
 	// エネルギー関数を返します
 	double getEnergy();
 
+	// エネルギー関数を一括計算します(各行が1つの配位, 戻り値の各要素が各行のエネルギー)
+	Eigen::VectorXd getEnergyBatch(const Eigen::MatrixXd & v_batch, const Eigen::MatrixXd & h_batch);
+
 	// 自由エネルギーを返します
 	double getFreeEnergy();
 
@@ -0,0 +1,164 @@
+﻿#pragma once
+#include "GeneralizedFullSparseRBM.h"
+#include "GeneralizedFullSparseRBMParamator.h"
+#include "Eigen/Core"
+#include <vector>
+#include <cmath>
+#include <random>
+#include <stdexcept>
+
+// GeneralizedFullSparseRBMの隠れ変数の2つの場(mu, mu*)をまとめて計算する
+// E(v, h) = -b^T v - mu^T h + sum_j mu*_j |h_j|, mu = c + W^T v, mu* = exp(sparseC + sparseW^T v)
+// [w | sparseW]を1つの行列に積んでおき, バッチの各列の(mu, log mu*)を1回の行列積で求める
+// 可視変数は{0, 1}, 隠れ変数は離散型のみ
+// パラメータの写しを持つので, 更新後はsync()しなおすこと
+class GeneralizedFullSparseRBMKernel {
+protected:
+	int _hSize = 0;
+	Eigen::MatrixXd _stacked;  // [w | sparseW] (可視変数 x 2隠れ変数)
+	Eigen::VectorXd _stackedBias;  // [c; sparseC]
+	Eigen::VectorXd _vBias;
+	Eigen::ArrayXd _hiddenValues;  // 隠れ変数の取りうる値
+
+public:
+	GeneralizedFullSparseRBMKernel() = default;
+	GeneralizedFullSparseRBMKernel(GeneralizedFullSparseRBM & rbm) {
+		sync(rbm);
+	}
+	GeneralizedFullSparseRBMKernel(GeneralizedFullSparseRBMParamator & params, const std::vector<double> & hidden_values) {
+		sync(params, hidden_values);
+	}
+	~GeneralizedFullSparseRBMKernel() = default;
+
+	// パラメータを写しなおす
+	void sync(GeneralizedFullSparseRBM & rbm) {
+		if (rbm.isRealHiddenValue()) throw std::runtime_error("GeneralizedFullSparseRBMKernel: hidden units must be discrete");
+		sync(rbm.params, rbm.splitHiddenSet());
+	}
+
+	void sync(GeneralizedFullSparseRBMParamator & params, const std::vector<double> & hidden_values) {
+		auto v_size = params.w.rows();
+		_hSize = params.w.cols();
+		_stacked.resize(v_size, 2 * _hSize);
+		_stacked.leftCols(_hSize) = params.w;
+		// sparseWが未確保なら0とみなす
+		if (params.sparseW.size() == 0) _stacked.rightCols(_hSize).setZero();
+		else _stacked.rightCols(_hSize) = params.sparseW;
+		_stackedBias.resize(2 * _hSize);
+		_stackedBias << params.c, params.sparseC;
+		_vBias = params.b;
+		_hiddenValues = Eigen::Map<const Eigen::ArrayXd>(hidden_values.data(), hidden_values.size());
+	}
+
+	// バッチの各列の(mu, log mu*)を一括計算(上半分がmu, 下半分がlog mu*)
+	void rawFields(const Eigen::MatrixXd & v_batch, Eigen::MatrixXd & raw_batch) const {
+		raw_batch.noalias() = _stacked.transpose() * v_batch;
+		raw_batch.colwise() += _stackedBias;
+	}
+
+	// バッチの各列の(mu, mu*)を一括計算(上半分がmu, 下半分がmu*)
+	void fields(const Eigen::MatrixXd & v_batch, Eigen::MatrixXd & field_batch) const {
+		rawFields(v_batch, field_batch);
+		field_batch.bottomRows(_hSize) = field_batch.bottomRows(_hSize).array().exp().matrix();
+	}
+
+	// log z_j = log sum_k exp(mu_j h_k - mu*_j |h_k|) を全ユニット, 全列まとめて
+	void logNormalizer(const Eigen::MatrixXd & field_batch, Eigen::MatrixXd & log_z) const {
+		Eigen::ArrayXXd shift, sum;
+		accumulate(field_batch, shift, sum, nullptr, nullptr);
+		log_z = (shift + sum.log()).matrix();
+	}
+
+	// 条件付き期待値 E[h_j | v] と E[-mu*_j |h_j| | v] を全ユニット, 全列まとめて
+	void moments(const Eigen::MatrixXd & field_batch, Eigen::MatrixXd & hidden, Eigen::MatrixXd & sparse) const {
+		Eigen::ArrayXXd shift, sum, numer_h, numer_abs;
+		accumulate(field_batch, shift, sum, &numer_h, &numer_abs);
+		hidden = (numer_h / sum).matrix();
+		sparse = (-field_batch.bottomRows(_hSize).array() * numer_abs / sum).matrix();
+	}
+
+	// 各列の可視変数の非正規化対数周辺確率, b^T v + sum_j log z_j(v)
+	Eigen::VectorXd logMarginal(const Eigen::MatrixXd & v_batch) const {
+		Eigen::MatrixXd field_batch, log_z;
+		fields(v_batch, field_batch);
+		logNormalizer(field_batch, log_z);
+
+		Eigen::VectorXd value = v_batch.transpose() * _vBias;
+		value += log_z.colwise().sum().transpose();
+		return value;
+	}
+
+	// 隠れ層をバッチの全列まとめてギブスサンプリング
+	template <class ENGINE>
+	void sampleHidden(const Eigen::MatrixXd & field_batch, ENGINE & engine, Eigen::MatrixXd & h_batch) const {
+		std::uniform_real_distribution<double> dist(0.0, 1.0);
+		Eigen::ArrayXXd shift, sum;
+		accumulate(field_batch, shift, sum, nullptr, nullptr);
+
+		auto mu = field_batch.topRows(_hSize).array();
+		auto mu_star = field_batch.bottomRows(_hSize).array();
+		h_batch.resize(_hSize, field_batch.cols());
+		for (int n = 0; n < h_batch.cols(); n++) {
+			for (int j = 0; j < _hSize; j++) {
+				// 累積がu * z_jを超えた値
+				auto threshold = dist(engine) * sum(j, n);
+				double cumulative = 0.0;
+				auto value = _hiddenValues(_hiddenValues.size() - 1);
+				for (int k = 0; k < _hiddenValues.size() - 1; k++) {
+					cumulative += std::exp(mu(j, n) * _hiddenValues(k) - mu_star(j, n) * std::abs(_hiddenValues(k)) - shift(j, n));
+					if (threshold < cumulative) {
+						value = _hiddenValues(k);
+						break;
+					}
+				}
+				h_batch(j, n) = value;
+			}
+		}
+	}
+
+	// 可視層を1つずつギブスサンプリング(sparseWのためhを与えても可視変数は独立でない)
+	// raw_fieldはvに対するrawFieldsの1列, vの更新に合わせて差分更新する
+	template <class ENGINE>
+	void sampleVisible(const Eigen::VectorXd & h, ENGINE & engine, Eigen::VectorXd & v, Eigen::VectorXd & raw_field) const {
+		std::uniform_real_distribution<double> dist(0.0, 1.0);
+		Eigen::ArrayXd abs_h = h.array().abs();
+		Eigen::ArrayXd w_h = (_stacked.leftCols(_hSize) * h).array();
+
+		for (int i = 0; i < v.size(); i++) {
+			// v_i = 0としたときのlog mu*
+			Eigen::ArrayXd log_mu_star0 = raw_field.tail(_hSize).array() - _stacked.row(i).tail(_hSize).transpose().array() * v(i);
+			Eigen::ArrayXd log_mu_star1 = log_mu_star0 + _stacked.row(i).tail(_hSize).transpose().array();
+
+			// log P(v_i = 1 | v_-i, h) - log P(v_i = 0 | v_-i, h)
+			auto log_odds = _vBias(i) + w_h(i) - (abs_h * (log_mu_star1.exp() - log_mu_star0.exp())).sum();
+			double value = dist(engine) < 1.0 / (1.0 + std::exp(-log_odds)) ? 1.0 : 0.0;
+
+			if (value != v(i)) {
+				raw_field.noalias() += (value - v(i)) * _stacked.row(i).transpose();
+				v(i) = value;
+			}
+		}
+	}
+
+protected:
+	// 隠れ変数の値ごとの項を全ユニット, 全列まとめて足し込む(shiftは項の最大値)
+	void accumulate(const Eigen::MatrixXd & field_batch, Eigen::ArrayXXd & shift, Eigen::ArrayXXd & sum, Eigen::ArrayXXd * numer_h, Eigen::ArrayXXd * numer_abs) const {
+		auto mu = field_batch.topRows(_hSize).array();
+		auto mu_star = field_batch.bottomRows(_hSize).array();
+
+		shift = mu * _hiddenValues(0) - mu_star * std::abs(_hiddenValues(0));
+		for (int k = 1; k < _hiddenValues.size(); k++) {
+			shift = shift.max(mu * _hiddenValues(k) - mu_star * std::abs(_hiddenValues(k)));
+		}
+
+		sum.setZero(_hSize, field_batch.cols());
+		if (numer_h) numer_h->setZero(_hSize, field_batch.cols());
+		if (numer_abs) numer_abs->setZero(_hSize, field_batch.cols());
+		for (int k = 0; k < _hiddenValues.size(); k++) {
+			Eigen::ArrayXXd term = (mu * _hiddenValues(k) - mu_star * std::abs(_hiddenValues(k)) - shift).exp();
+			sum += term;
+			if (numer_h) *numer_h += _hiddenValues(k) * term;
+			if (numer_abs) *numer_abs += std::abs(_hiddenValues(k)) * term;
+		}
+	}
+};
@@ -1,6 +1,7 @@
 #pragma once
 #include <fstream>
 #include "../Optimizer.h"
+#include "../Checkpoint.h"
 #include "GeneralizedFullSparseRBM.h"
 #include <cmath>
 
@@ -23,6 +24,9 @@ public:
 	double getNewParamHSparse(double gradient, int hindex);
 	// next timestep
 	void updateOptimizer();
+	// 状態(反復回数, モーメント)のチェックポイント(登録した配列は書き出しまで保持すること)
+	void writeCheckpoint(rbmckpt::Writer & writer, const std::string & prefix);
+	void readCheckpoint(rbmckpt::Reader & reader, const std::string & prefix);
 };
 
 inline Optimizer<GeneralizedFullSparseRBM, OptimizerType::Default>::Optimizer(GeneralizedFullSparseRBM & rbm) {
@@ -33,6 +37,14 @@ inline void Optimizer<GeneralizedFullSparseRBM, OptimizerType::Default>::updateO
 	this->_iteration++;
 }
 
+inline void Optimizer<GeneralizedFullSparseRBM, OptimizerType::Default>::writeCheckpoint(rbmckpt::Writer & writer, const std::string & prefix) {
+	writer.addScalar(prefix + "iteration", this->_iteration);
+}
+
+inline void Optimizer<GeneralizedFullSparseRBM, OptimizerType::Default>::readCheckpoint(rbmckpt::Reader & reader, const std::string & prefix) {
+	this->_iteration = static_cast<int>(reader.scalar(prefix + "iteration"));
+}
+
 inline void Optimizer<GeneralizedFullSparseRBM, OptimizerType::Default>::init(GeneralizedFullSparseRBM & rbm) {
 
 }
@@ -80,6 +92,9 @@ public:
 	double getNewParamWeight(double gradient, int vindex, int hindex);
 	// next timestep
 	void updateOptimizer();
+	// 状態(反復回数, モーメント)のチェックポイント(登録した配列は書き出しまで保持すること)
+	void writeCheckpoint(rbmckpt::Writer & writer, const std::string & prefix);
+	void readCheckpoint(rbmckpt::Reader & reader, const std::string & prefix);
 };
 
 inline Optimizer<GeneralizedFullSparseRBM, OptimizerType::Momentum>::Optimizer(GeneralizedFullSparseRBM & rbm) {
@@ -90,6 +105,24 @@ inline void Optimizer<GeneralizedFullSparseRBM, OptimizerType::Momentum>::update
 	this->_iteration++;
 }
 
+inline void Optimizer<GeneralizedFullSparseRBM, OptimizerType::Momentum>::writeCheckpoint(rbmckpt::Writer & writer, const std::string & prefix) {
+	writer.addScalar(prefix + "iteration", this->_iteration);
+	writer.add(prefix + "moment1st.vBias", this->moment1st.vBias);
+	writer.add(prefix + "moment1st.hBias", this->moment1st.hBias);
+	writer.add(prefix + "moment1st.hSparse", this->moment1st.hSparse);
+	writer.add(prefix + "moment1st.weight", this->moment1st.weight);
+	writer.add(prefix + "moment1st.sparseWeight", this->moment1st.sparseWeight);
+}
+
+inline void Optimizer<GeneralizedFullSparseRBM, OptimizerType::Momentum>::readCheckpoint(rbmckpt::Reader & reader, const std::string & prefix) {
+	this->_iteration = static_cast<int>(reader.scalar(prefix + "iteration"));
+	this->moment1st.vBias = reader.vector(prefix + "moment1st.vBias");
+	this->moment1st.hBias = reader.vector(prefix + "moment1st.hBias");
+	this->moment1st.hSparse = reader.vector(prefix + "moment1st.hSparse");
+	this->moment1st.weight = reader.matrix(prefix + "moment1st.weight");
+	this->moment1st.sparseWeight = reader.matrix(prefix + "moment1st.sparseWeight");
+}
+
 // Momentum
 inline void Optimizer<GeneralizedFullSparseRBM, OptimizerType::Momentum>::init(GeneralizedFullSparseRBM & rbm) {
 	this->moment1st.vBias.setConstant(rbm.getVisibleSize(), 0.0);
@@ -146,6 +179,9 @@ public:
 	double getNewParamWeight(double gradient, int vindex, int hindex);
 	// next timestep
 	void updateOptimizer();
+	// 状態(反復回数, モーメント)のチェックポイント(登録した配列は書き出しまで保持すること)
+	void writeCheckpoint(rbmckpt::Writer & writer, const std::string & prefix);
+	void readCheckpoint(rbmckpt::Reader & reader, const std::string & prefix);
 };
 
 inline Optimizer<GeneralizedFullSparseRBM, OptimizerType::AdaGrad>::Optimizer(GeneralizedFullSparseRBM & rbm) {
@@ -156,6 +192,22 @@ inline void Optimizer<GeneralizedFullSparseRBM, OptimizerType::AdaGrad>::updateO
 	this->_iteration++;
 }
 
+inline void Optimizer<GeneralizedFullSparseRBM, OptimizerType::AdaGrad>::writeCheckpoint(rbmckpt::Writer & writer, const std::string & prefix) {
+	writer.addScalar(prefix + "iteration", this->_iteration);
+	writer.add(prefix + "moment2nd.vBias", this->moment2nd.vBias);
+	writer.add(prefix + "moment2nd.hBias", this->moment2nd.hBias);
+	writer.add(prefix + "moment2nd.hSparse", this->moment2nd.hSparse);
+	writer.add(prefix + "moment2nd.weight", this->moment2nd.weight);
+}
+
+inline void Optimizer<GeneralizedFullSparseRBM, OptimizerType::AdaGrad>::readCheckpoint(rbmckpt::Reader & reader, const std::string & prefix) {
+	this->_iteration = static_cast<int>(reader.scalar(prefix + "iteration"));
+	this->moment2nd.vBias = reader.vector(prefix + "moment2nd.vBias");
+	this->moment2nd.hBias = reader.vector(prefix + "moment2nd.hBias");
+	this->moment2nd.hSparse = reader.vector(prefix + "moment2nd.hSparse");
+	this->moment2nd.weight = reader.matrix(prefix + "moment2nd.weight");
+}
+
 // AdaGrad
 inline void Optimizer<GeneralizedFullSparseRBM, OptimizerType::AdaGrad>::init(GeneralizedFullSparseRBM & rbm) {
 	this->moment2nd.vBias.setConstant(rbm.getVisibleSize(), 0.0);
@@ -224,6 +276,9 @@ public:
 	double getNewParamWeight(double gradient, int vindex, int hindex);
 	// next timestep
 	void updateOptimizer();
+	// 状態(反復回数, モーメント)のチェックポイント(登録した配列は書き出しまで保持すること)
+	void writeCheckpoint(rbmckpt::Writer & writer, const std::string & prefix);
+	void readCheckpoint(rbmckpt::Reader & reader, const std::string & prefix);
 };
 
 inline Optimizer<GeneralizedFullSparseRBM, OptimizerType::AdaDelta>::Optimizer(GeneralizedFullSparseRBM & rbm) {
@@ -234,6 +289,30 @@ inline void Optimizer<GeneralizedFullSparseRBM, OptimizerType::AdaDelta>::update
 	this->_iteration++;
 }
 
+inline void Optimizer<GeneralizedFullSparseRBM, OptimizerType::AdaDelta>::writeCheckpoint(rbmckpt::Writer & writer, const std::string & prefix) {
+	writer.addScalar(prefix + "iteration", this->_iteration);
+	writer.add(prefix + "moment1st.vBias", this->moment1st.vBias);
+	writer.add(prefix + "moment1st.hBias", this->moment1st.hBias);
+	writer.add(prefix + "moment1st.hSparse", this->moment1st.hSparse);
+	writer.add(prefix + "moment1st.weight", this->moment1st.weight);
+	writer.add(prefix + "moment2nd.vBias", this->moment2nd.vBias);
+	writer.add(prefix + "moment2nd.hBias", this->moment2nd.hBias);
+	writer.add(prefix + "moment2nd.hSparse", this->moment2nd.hSparse);
+	writer.add(prefix + "moment2nd.weight", this->moment2nd.weight);
+}
+
+inline void Optimizer<GeneralizedFullSparseRBM, OptimizerType::AdaDelta>::readCheckpoint(rbmckpt::Reader & reader, const std::string & prefix) {
+	this->_iteration = static_cast<int>(reader.scalar(prefix + "iteration"));
+	this->moment1st.vBias = reader.vector(prefix + "moment1st.vBias");
+	this->moment1st.hBias = reader.vector(prefix + "moment1st.hBias");
+	this->moment1st.hSparse = reader.vector(prefix + "moment1st.hSparse");
+	this->moment1st.weight = reader.matrix(prefix + "moment1st.weight");
+	this->moment2nd.vBias = reader.vector(prefix + "moment2nd.vBias");
+	this->moment2nd.hBias = reader.vector(prefix + "moment2nd.hBias");
+	this->moment2nd.hSparse = reader.vector(prefix + "moment2nd.hSparse");
+	this->moment2nd.weight = reader.matrix(prefix + "moment2nd.weight");
+}
+
 // AdaDelta
 inline void Optimizer<GeneralizedFullSparseRBM, OptimizerType::AdaDelta>::init(GeneralizedFullSparseRBM & rbm) {
 	this->moment1st.vBias.setConstant(rbm.getVisibleSize(), 0.0);
@@ -315,6 +394,9 @@ public:
 	double getNewParamWeight(double gradient, int vindex, int hindex);
 	// next timestep
 	void updateOptimizer();
+	// 状態(反復回数, モーメント)のチェックポイント(登録した配列は書き出しまで保持すること)
+	void writeCheckpoint(rbmckpt::Writer & writer, const std::string & prefix);
+	void readCheckpoint(rbmckpt::Reader & reader, const std::string & prefix);
 };
 
 inline Optimizer<GeneralizedFullSparseRBM, OptimizerType::Adam>::Optimizer(GeneralizedFullSparseRBM & rbm) {
@@ -325,6 +407,30 @@ inline void Optimizer<GeneralizedFullSparseRBM, OptimizerType::Adam>::updateOpti
 	this->_iteration++;
 }
 
+inline void Optimizer<GeneralizedFullSparseRBM, OptimizerType::Adam>::writeCheckpoint(rbmckpt::Writer & writer, const std::string & prefix) {
+	writer.addScalar(prefix + "iteration", this->_iteration);
+	writer.add(prefix + "moment1st.vBias", this->moment1st.vBias);
+	writer.add(prefix + "moment1st.hBias", this->moment1st.hBias);
+	writer.add(prefix + "moment1st.hSparse", this->moment1st.hSparse);
+	writer.add(prefix + "moment1st.weight", this->moment1st.weight);
+	writer.add(prefix + "moment2nd.vBias", this->moment2nd.vBias);
+	writer.add(prefix + "moment2nd.hBias", this->moment2nd.hBias);
+	writer.add(prefix + "moment2nd.hSparse", this->moment2nd.hSparse);
+	writer.add(prefix + "moment2nd.weight", this->moment2nd.weight);
+}
+
+inline void Optimizer<GeneralizedFullSparseRBM, OptimizerType::Adam>::readCheckpoint(rbmckpt::Reader & reader, const std::string & prefix) {
+	this->_iteration = static_cast<int>(reader.scalar(prefix + "iteration"));
+	this->moment1st.vBias = reader.vector(prefix + "moment1st.vBias");
+	this->moment1st.hBias = reader.vector(prefix + "moment1st.hBias");
+	this->moment1st.hSparse = reader.vector(prefix + "moment1st.hSparse");
+	this->moment1st.weight = reader.matrix(prefix + "moment1st.weight");
+	this->moment2nd.vBias = reader.vector(prefix + "moment2nd.vBias");
+	this->moment2nd.hBias = reader.vector(prefix + "moment2nd.hBias");
+	this->moment2nd.hSparse = reader.vector(prefix + "moment2nd.hSparse");
+	this->moment2nd.weight = reader.matrix(prefix + "moment2nd.weight");
+}
+
 // Adam
 inline void Optimizer<GeneralizedFullSparseRBM, OptimizerType::Adam>::init(GeneralizedFullSparseRBM & rbm) {
 	this->moment1st.vBias.setConstant(rbm.getVisibleSize(), 0.0);
@@ -415,6 +521,9 @@ public:
 	double getNewParamWeight(double gradient, int vindex, int hindex);
 	// next timestep
 	void updateOptimizer();
+	// 状態(反復回数, モーメント)のチェックポイント(登録した配列は書き出しまで保持すること)
+	void writeCheckpoint(rbmckpt::Writer & writer, const std::string & prefix);
+	void readCheckpoint(rbmckpt::Reader & reader, const std::string & prefix);
 };
 
 inline Optimizer<GeneralizedFullSparseRBM, OptimizerType::AdaMax>::Optimizer(GeneralizedFullSparseRBM & rbm) {
@@ -425,6 +534,30 @@ inline void Optimizer<GeneralizedFullSparseRBM, OptimizerType::AdaMax>::updateOp
 	this->_iteration++;
 }
 
+inline void Optimizer<GeneralizedFullSparseRBM, OptimizerType::AdaMax>::writeCheckpoint(rbmckpt::Writer & writer, const std::string & prefix) {
+	writer.addScalar(prefix + "iteration", this->_iteration);
+	writer.add(prefix + "moment1st.vBias", this->moment1st.vBias);
+	writer.add(prefix + "moment1st.hBias", this->moment1st.hBias);
+	writer.add(prefix + "moment1st.hSparse", this->moment1st.hSparse);
+	writer.add(prefix + "moment1st.weight", this->moment1st.weight);
+	writer.add(prefix + "moment2nd.vBias", this->moment2nd.vBias);
+	writer.add(prefix + "moment2nd.hBias", this->moment2nd.hBias);
+	writer.add(prefix + "moment2nd.hSparse", this->moment2nd.hSparse);
+	writer.add(prefix + "moment2nd.weight", this->moment2nd.weight);
+}
+
+inline void Optimizer<GeneralizedFullSparseRBM, OptimizerType::AdaMax>::readCheckpoint(rbmckpt::Reader & reader, const std::string & prefix) {
+	this->_iteration = static_cast<int>(reader.scalar(prefix + "iteration"));
+	this->moment1st.vBias = reader.vector(prefix + "moment1st.vBias");
+	this->moment1st.hBias = reader.vector(prefix + "moment1st.hBias");
+	this->moment1st.hSparse = reader.vector(prefix + "moment1st.hSparse");
+	this->moment1st.weight = reader.matrix(prefix + "moment1st.weight");
+	this->moment2nd.vBias = reader.vector(prefix + "moment2nd.vBias");
+	this->moment2nd.hBias = reader.vector(prefix + "moment2nd.hBias");
+	this->moment2nd.hSparse = reader.vector(prefix + "moment2nd.hSparse");
+	this->moment2nd.weight = reader.matrix(prefix + "moment2nd.weight");
+}
+
 // AdaMax
 inline void Optimizer<GeneralizedFullSparseRBM, OptimizerType::AdaMax>::init(GeneralizedFullSparseRBM & rbm) {
 	this->moment1st.vBias.setConstant(rbm.getVisibleSize(), 0.0);
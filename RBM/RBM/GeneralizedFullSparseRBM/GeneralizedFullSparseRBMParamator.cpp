@@ -1,4 +1,5 @@
 ﻿#include "GeneralizedFullSparseRBMParamator.h"
+#include "../Checkpoint.h"
 
 
 GeneralizedFullSparseRBMParamator::GeneralizedFullSparseRBMParamator(size_t v_size, size_t h_size) {
@@ -127,6 +128,33 @@ void GeneralizedFullSparseRBMParamator::deserialize(std::string js) {
 	this->sparseC = Eigen::Map<Eigen::VectorXd>(tmp_sparse.data(), hSize);
 }
 
+// チェックポイントに登録
+void GeneralizedFullSparseRBMParamator::writeCheckpoint(rbmckpt::Writer & writer) {
+	writer.setModelType("GeneralizedFullSparseRBM");
+	writer.add("b", this->b);
+	writer.add("c", this->c);
+	writer.add("w", this->w);
+	writer.add("sparseC", this->sparseC);
+	writer.add("sparseW", this->sparseW);
+}
+
+// チェックポイントから復元
+void GeneralizedFullSparseRBMParamator::readCheckpoint(rbmckpt::Reader & reader) {
+	if (reader.modelType() != "GeneralizedFullSparseRBM") throw std::runtime_error("GeneralizedFullSparseRBMParamator: model type mismatch " + reader.modelType());
+	auto ckpt_b = reader.vector("b");
+	auto ckpt_c = reader.vector("c");
+	auto ckpt_w = reader.matrix("w");
+	auto ckpt_sparseC = reader.vector("sparseC");
+	auto ckpt_sparseW = reader.matrix("sparseW");
+	if (ckpt_b.size() != vSize || ckpt_c.size() != hSize || ckpt_w.rows() != vSize || ckpt_w.cols() != hSize || ckpt_sparseC.size() != hSize || (ckpt_sparseW.size() != 0 && (ckpt_sparseW.rows() != vSize || ckpt_sparseW.cols() != hSize))) throw std::runtime_error("GeneralizedFullSparseRBMParamator: shape mismatch");
+
+	this->b = ckpt_b;
+	this->c = ckpt_c;
+	this->w = ckpt_w;
+	this->sparseC = ckpt_sparseC;
+	this->sparseW = ckpt_sparseW;
+}
+
 // 隠れ変数のスパースパラメータを返す
 double GeneralizedFullSparseRBMParamator::getHiddenSparse(int hindex) {
 	return sparseC(hindex);
@@ -1,6 +1,7 @@
 ﻿#pragma once
 #include "../Sampler.h"
 #include "GeneralizedFullSparseRBM.h"
+#include "GeneralizedFullSparseRBMKernel.h"
 #include "Eigen/Core"
 #include <vector>
 #include <numeric>
@@ -11,7 +12,11 @@ class GeneralizedFullSparseRBM;
 template<>
 class Sampler<GeneralizedFullSparseRBM> {
 public:
-	Sampler() = default;
+	std::mt19937 randEngine = std::mt19937();
+
+public:
+	Sampler();
+	Sampler(const std::mt19937 & rand_engine);
 	~Sampler() = default;
 
 	// 可視変数一つをギブスサンプリング
@@ -37,8 +42,23 @@ public:
 
 	// 隠れ層すべてをギブスサンプリングで更新
 	Eigen::VectorXd & updateByBlockedGibbsSamplingHidden(GeneralizedFullSparseRBM & rbm);
+
+	// バッチの各列の隠れ変数をサンプリング(muとmu*は1回の行列積)
+	void sampleHiddenBatch(const GeneralizedFullSparseRBMKernel & kernel, const Eigen::MatrixXd & v_batch, Eigen::MatrixXd & h_batch);
+
+	// バッチの各列の可視変数を1つずつサンプリング(場は差分更新)
+	void sampleVisibleBatch(const GeneralizedFullSparseRBMKernel & kernel, const Eigen::MatrixXd & h_batch, Eigen::MatrixXd & v_batch);
 };
 
+inline Sampler<GeneralizedFullSparseRBM>::Sampler() {
+	std::random_device rd;
+	this->randEngine = std::mt19937(rd());
+}
+
+// 乱数エンジンを与える(random_deviceを開かない)
+inline Sampler<GeneralizedFullSparseRBM>::Sampler(const std::mt19937 & rand_engine) : randEngine(rand_engine) {
+}
+
 
 
 inline double Sampler<GeneralizedFullSparseRBM>::gibbsSamplingVisible(GeneralizedFullSparseRBM & rbm, int vindex) {
@@ -128,6 +148,7 @@ inline double Sampler<GeneralizedFullSparseRBM>::updateByGibbsSamplingHidden(Gen
 }
 
 inline Eigen::VectorXd & Sampler<GeneralizedFullSparseRBM>::updateByBlockedGibbsSamplingVisible(GeneralizedFullSparseRBM & rbm) {
+	RBM_PROFILE_COUNT(Sweeps, 1);
 
 	for (int i = 0; i < rbm.getVisibleSize(); i++) {
 		updateByGibbsSamplingVisible(rbm, i);
@@ -137,9 +158,31 @@ inline Eigen::VectorXd & Sampler<GeneralizedFullSparseRBM>::updateByBlockedGibbs
 }
 
 inline Eigen::VectorXd & Sampler<GeneralizedFullSparseRBM>::updateByBlockedGibbsSamplingHidden(GeneralizedFullSparseRBM & rbm) {
+	RBM_PROFILE_COUNT(Sweeps, 1);
 	for (int j = 0; j < rbm.getHiddenSize(); j++) {
 		updateByGibbsSamplingHidden(rbm, j);
 	}
 
 	return rbm.nodes.h;
 }
+
+inline void Sampler<GeneralizedFullSparseRBM>::sampleHiddenBatch(const GeneralizedFullSparseRBMKernel & kernel, const Eigen::MatrixXd & v_batch, Eigen::MatrixXd & h_batch) {
+	RBM_PROFILE_COUNT(Sweeps, v_batch.cols());
+
+	Eigen::MatrixXd field_batch;
+	kernel.fields(v_batch, field_batch);
+	kernel.sampleHidden(field_batch, this->randEngine, h_batch);
+}
+
+inline void Sampler<GeneralizedFullSparseRBM>::sampleVisibleBatch(const GeneralizedFullSparseRBMKernel & kernel, const Eigen::MatrixXd & h_batch, Eigen::MatrixXd & v_batch) {
+	RBM_PROFILE_COUNT(Sweeps, v_batch.cols());
+
+	Eigen::MatrixXd raw_batch;
+	kernel.rawFields(v_batch, raw_batch);
+	for (int n = 0; n < v_batch.cols(); n++) {
+		Eigen::VectorXd v = v_batch.col(n);
+		Eigen::VectorXd raw_field = raw_batch.col(n);
+		kernel.sampleVisible(h_batch.col(n), this->randEngine, v, raw_field);
+		v_batch.col(n) = v;
+	}
+}
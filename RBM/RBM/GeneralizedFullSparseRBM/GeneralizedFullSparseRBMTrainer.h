@@ -1,10 +1,16 @@
 ﻿#pragma once
 #include "Eigen/Core"
 #include "../Trainer.h"
+#include "../Checkpoint.h"
 #include "GeneralizedFullSparseRBM.h"
 #include "GeneralizedFullSparseRBMSampler.h"
 #include "GeneralizedFullSparseRBMOptimizer.h"
+#include "GeneralizedFullSparseRBMKernel.h"
 #include <vector>
+#include <random>
+#include <limits>
+#include <algorithm>
+#include <stdexcept>
 #include <omp.h>
 
 
@@ -22,6 +28,7 @@ class Trainer<GeneralizedFullSparseRBM, OPTIMIZERTYPE>{
 		Eigen::VectorXd vBias;
 		Eigen::VectorXd hBias;
 		Eigen::MatrixXd weight;
+		Eigen::VectorXd hSparseBias;  // E[-mu*_j |h_j|]
 		Eigen::MatrixXd sparseWeight;
 	};
 
@@ -29,6 +36,7 @@ class Trainer<GeneralizedFullSparseRBM, OPTIMIZERTYPE>{
 		Eigen::VectorXd vBias;
 		Eigen::VectorXd hBias;
 		Eigen::MatrixXd weight;
+		Eigen::VectorXd hSparseBias;  // E[-mu*_j |h_j|]
 		Eigen::MatrixXd sparseWeight;
 	};
 
@@ -37,6 +45,7 @@ private:
 	DataMean dataMean;
 	RBMExpected rbmexpected;
 	Optimizer<GeneralizedFullSparseRBM, OPTIMIZERTYPE> optimizer;
+	GeneralizedFullSparseRBMKernel kernel;  // (mu, mu*)の一括計算
 	int _trainCount = 0;
 
 
@@ -45,6 +54,7 @@ public:
 	int batchSize = 1;
 	int cdk = 0;
 	double learningRate = 0.01;
+	std::mt19937 randDevice = std::mt19937(std::random_device()());
 
 public:
 	Trainer() = default;
@@ -113,6 +123,11 @@ public:
 
 	// 学習情報から学習(JSON)
 	void trainFromTrainInfo(GeneralizedFullSparseRBM & rbm, std::string json);
+
+	// 学習状態(反復回数, オプティマイザのモーメント, 乱数, チェイン)のチェックポイント
+	// モデルと合わせてrbmckpt::saveTraining/loadTrainingから使う
+	void writeCheckpoint(rbmckpt::Writer & writer, GeneralizedFullSparseRBM & rbm);
+	void readCheckpoint(rbmckpt::Reader & reader, GeneralizedFullSparseRBM & rbm);
 };
 
 template<class OPTIMIZERTYPE>
@@ -145,6 +160,7 @@ inline void Trainer<GeneralizedFullSparseRBM, OPTIMIZERTYPE>::initDataMean(Gener
 	dataMean.hBias.setConstant(rbm.getHiddenSize(), 0.0);
 	dataMean.weight.setConstant(rbm.getVisibleSize(), rbm.getHiddenSize(), 0.0);
 	dataMean.hSparseBias.setConstant(rbm.getHiddenSize(), 0.0);
+	dataMean.sparseWeight.setConstant(rbm.getVisibleSize(), rbm.getHiddenSize(), 0.0);
 }
 
 template<class OPTIMIZERTYPE>
@@ -153,6 +169,7 @@ inline void Trainer<GeneralizedFullSparseRBM, OPTIMIZERTYPE>::initDataMean() {
 	dataMean.hBias.setConstant(0.0);
 	dataMean.weight.setConstant(0.0);
 	dataMean.hSparseBias.setConstant(0.0);
+	dataMean.sparseWeight.setConstant(0.0);
 }
 
 template<class OPTIMIZERTYPE>
@@ -161,6 +178,7 @@ inline void Trainer<GeneralizedFullSparseRBM, OPTIMIZERTYPE>::initRBMExpected(Ge
 	rbmexpected.hBias.setConstant(rbm.getHiddenSize(), 0.0);
 	rbmexpected.weight.setConstant(rbm.getVisibleSize(), rbm.getHiddenSize(), 0.0);
 	rbmexpected.hSparseBias.setConstant(rbm.getHiddenSize(), 0.0);
+	rbmexpected.sparseWeight.setConstant(rbm.getVisibleSize(), rbm.getHiddenSize(), 0.0);
 }
 
 template<class OPTIMIZERTYPE>
@@ -169,6 +187,7 @@ inline void Trainer<GeneralizedFullSparseRBM, OPTIMIZERTYPE>::initRBMExpected()
 	rbmexpected.hBias.setConstant(0.0);
 	rbmexpected.weight.setConstant(0.0);
 	rbmexpected.hSparseBias.setConstant(0.0);
+	rbmexpected.sparseWeight.setConstant(0.0);
 }
 
 template<class OPTIMIZERTYPE>
@@ -197,6 +216,8 @@ inline void Trainer<GeneralizedFullSparseRBM, OPTIMIZERTYPE>::trainExact(General
 // 1回だけ学習
 template<class OPTIMIZERTYPE>
 inline void Trainer<GeneralizedFullSparseRBM, OPTIMIZERTYPE>::trainOnce(GeneralizedFullSparseRBM & rbm, std::vector<std::vector<double>> & dataset) {
+	RBM_PROFILE_SCOPE("trainOnce");
+
 	// 勾配初期化
 	initGradient();
 
@@ -225,11 +246,14 @@ inline void Trainer<GeneralizedFullSparseRBM, OPTIMIZERTYPE>::trainOnce(Generali
 	optimizer.updateOptimizer();
 
 	// Trainer情報更新
+	RBM_PROFILE_EPOCH(_trainCount);
 	_trainCount++;
 }
 
 template<class OPTIMIZERTYPE>
 inline void Trainer<GeneralizedFullSparseRBM, OPTIMIZERTYPE>::trainOnceCD(GeneralizedFullSparseRBM & rbm, std::vector<std::vector<double>> & dataset) {
+	RBM_PROFILE_SCOPE("trainOnceCD");
+
 	// 勾配初期化
 	initGradient();
 
@@ -258,11 +282,14 @@ inline void Trainer<GeneralizedFullSparseRBM, OPTIMIZERTYPE>::trainOnceCD(Genera
 	optimizer.updateOptimizer();
 
 	// Trainer情報更新
+	RBM_PROFILE_EPOCH(_trainCount);
 	_trainCount++;
 }
 
 template<class OPTIMIZERTYPE>
 inline void Trainer<GeneralizedFullSparseRBM, OPTIMIZERTYPE>::trainOnceExact(GeneralizedFullSparseRBM & rbm, std::vector<std::vector<double>> & dataset) {
+	RBM_PROFILE_SCOPE("trainOnceExact");
+
 	// 勾配初期化
 	initGradient();
 
@@ -291,6 +318,7 @@ inline void Trainer<GeneralizedFullSparseRBM, OPTIMIZERTYPE>::trainOnceExact(Gen
 	optimizer.updateOptimizer();
 
 	// Trainer情報更新
+	RBM_PROFILE_EPOCH(_trainCount);
 	_trainCount++;
 }
 
@@ -322,151 +350,161 @@ inline void Trainer<GeneralizedFullSparseRBM, OPTIMIZERTYPE>::calcExact(Generali
 
 template<class OPTIMIZERTYPE>
 inline void Trainer<GeneralizedFullSparseRBM, OPTIMIZERTYPE>::calcDataMean(GeneralizedFullSparseRBM & rbm, std::vector<std::vector<double>> & dataset, std::vector<int> & data_indexes) {
-	// 0埋め初期化
-	initDataMean();
-
-	auto index_size = data_indexes.size();
-    #pragma omp parallel for schedule(static)
-	for (int n = 0; n < index_size; n++) {
-		auto rbm_replica = rbm;
-		auto & data = dataset[n];
-		Eigen::VectorXd vect = Eigen::Map<Eigen::VectorXd>(data.data(), data.size());
-		rbm_replica.nodes.v = vect;
-		auto mu_vect = rbm_replica.muVect();
-
-#pragma omp critical
-		{
-			for (int i = 0; i < rbm_replica.getVisibleSize(); i++) {
-				dataMean.vBias(i) += vect(i);
+	RBM_PROFILE_SCOPE("calcDataMean");
 
-				for (int j = 0; j < rbm_replica.getHiddenSize(); j++) {
-					dataMean.weight(i, j) += vect(i) * rbm_replica.actHidJ(j, mu_vect(j));
-				}
-			}
-
-			for (int j = 0; j < rbm_replica.getHiddenSize(); j++) {
-				dataMean.hBias(j) += rbm_replica.actHidJ(j, mu_vect(j));
-				dataMean.hSparseBias(j) += rbm_replica.actHidSparseJ(j, mu_vect(j));
-			}
-		}
+	// ミニバッチを行列(可視変数 x バッチ)にまとめる
+	Eigen::MatrixXd data_batch(rbm.getVisibleSize(), data_indexes.size());
+	for (int n = 0; n < data_indexes.size(); n++) {
+		auto & data = dataset[data_indexes[n]];
+		data_batch.col(n) = Eigen::Map<Eigen::VectorXd>(data.data(), data.size());
 	}
-	dataMean.vBias /= static_cast<double>(data_indexes.size());
-	dataMean.hBias /= static_cast<double>(data_indexes.size());
-	dataMean.weight /= static_cast<double>(data_indexes.size());
-	dataMean.hSparseBias /= static_cast<double>(data_indexes.size());
+
+	// (mu, mu*)は1回の行列積, 条件付き期待値は全ユニットまとめて
+	kernel.sync(rbm);
+	Eigen::MatrixXd field_batch, hidden_batch, sparse_batch;
+	kernel.fields(data_batch, field_batch);
+	kernel.moments(field_batch, hidden_batch, sparse_batch);
+
+	auto batch_size = static_cast<double>(data_indexes.size());
+	dataMean.vBias = data_batch.rowwise().sum() / batch_size;
+	dataMean.hBias = hidden_batch.rowwise().sum() / batch_size;
+	dataMean.hSparseBias = sparse_batch.rowwise().sum() / batch_size;
+	dataMean.weight.noalias() = data_batch * hidden_batch.transpose() / batch_size;
+	dataMean.sparseWeight.noalias() = data_batch * sparse_batch.transpose() / batch_size;
 }
 
 
 template<class OPTIMIZERTYPE>
 inline void Trainer<GeneralizedFullSparseRBM, OPTIMIZERTYPE>::calcRBMExpectedCD(GeneralizedFullSparseRBM & rbm, std::vector<std::vector<double>> & dataset, std::vector<int> & data_indexes) {
-	// 0埋め初期化
-	initRBMExpected();
+	RBM_PROFILE_SCOPE("calcRBMExpectedCD");
 
-	auto index_size = data_indexes.size();
-	#pragma omp parallel for schedule(static)
-	for (int n = 0; n < index_size; n++) {
-		auto rbm_replica = rbm;
-		auto & data = dataset[n];
-		Eigen::VectorXd vect = Eigen::Map<Eigen::VectorXd>(data.data(), data.size());
-
-		// GeneralizedFullSparseRBMの初期値設定
-		rbm_replica.nodes.v = vect;
-
-		for (int j = 0; j < rbm_replica.getHiddenSize(); j++) {
-			rbm_replica.nodes.h(j) = rbm_replica.actHidJ(j);
-		}
-
-		// CD-K
-		Sampler<GeneralizedFullSparseRBM> sampler;
-		for (int k = 0; k < cdk; k++) {
-			sampler.updateByBlockedGibbsSamplingVisible(rbm_replica);
-			sampler.updateByBlockedGibbsSamplingHidden(rbm_replica);
-		}
-
-		// 結果を格納
-#pragma omp critical
-		{
-			rbmexpected.vBias += rbm_replica.nodes.v;
-			rbmexpected.hBias += rbm_replica.nodes.h;
-			for (int j = 0; j < rbm_replica.getHiddenSize(); j++) {
-				rbmexpected.hSparseBias(j) += -exp(rbm_replica.params.sparse(j)) * abs(rbm_replica.nodes.h(j));
-			}
+	// チェインの初期値はデータ
+	Eigen::MatrixXd visible_batch(rbm.getVisibleSize(), data_indexes.size());
+	for (int n = 0; n < data_indexes.size(); n++) {
+		auto & data = dataset[data_indexes[n]];
+		visible_batch.col(n) = Eigen::Map<Eigen::VectorXd>(data.data(), data.size());
+	}
 
-			for (int i = 0; i < rbm_replica.getVisibleSize(); i++) {
-				for (int j = 0; j < rbm_replica.getHiddenSize(); j++) {
-					rbmexpected.weight(i, j) += rbm_replica.nodes.v(i) * rbm_replica.nodes.h(j);
-				}
-			}
-		}
+	// CD-K
+	kernel.sync(rbm);
+	auto sampler = Sampler<GeneralizedFullSparseRBM>(std::mt19937(randDevice()));
+	Eigen::MatrixXd hidden_batch;
+	for (int k = 0; k < cdk; k++) {
+		sampler.sampleHiddenBatch(kernel, visible_batch, hidden_batch);
+		sampler.sampleVisibleBatch(kernel, hidden_batch, visible_batch);
 	}
 
-	rbmexpected.vBias /= static_cast<double>(data_indexes.size());
-	rbmexpected.hBias /= static_cast<double>(data_indexes.size());
-	rbmexpected.weight /= static_cast<double>(data_indexes.size());
-	rbmexpected.hSparseBias /= static_cast<double>(data_indexes.size());
+	// 結果を格納(隠れ変数は条件付き期待値)
+	Eigen::MatrixXd field_batch, sparse_batch;
+	kernel.fields(visible_batch, field_batch);
+	kernel.moments(field_batch, hidden_batch, sparse_batch);
+
+	auto batch_size = static_cast<double>(data_indexes.size());
+	rbmexpected.vBias = visible_batch.rowwise().sum() / batch_size;
+	rbmexpected.hBias = hidden_batch.rowwise().sum() / batch_size;
+	rbmexpected.hSparseBias = sparse_batch.rowwise().sum() / batch_size;
+	rbmexpected.weight.noalias() = visible_batch * hidden_batch.transpose() / batch_size;
+	rbmexpected.sparseWeight.noalias() = visible_batch * sparse_batch.transpose() / batch_size;
 }
 
 template<class OPTIMIZERTYPE>
 inline void Trainer<GeneralizedFullSparseRBM, OPTIMIZERTYPE>::calcRBMExpectedExact(GeneralizedFullSparseRBM & rbm, std::vector<std::vector<double>> & dataset, std::vector<int> & data_indexes) {
-	// 0埋め初期化
+	RBM_PROFILE_SCOPE("calcRBMExpectedExact");
+
+	// 可視変数の配位をblock_size個ずつ列に並べ, (mu, mu*)と隠れ変数の正規化・期待値をまとめて計算する
+	// 重みはexp(log P~ - shift)でスレッド毎に累積し, 最後にshiftを揃えて足す
+	kernel.sync(rbm);
+	auto v_size = rbm.getVisibleSize();
+	auto h_size = rbm.getHiddenSize();
+	if (v_size > 62) throw std::runtime_error("calcRBMExpectedExact: too many visible units");
+	long long max_count = 1LL << v_size;
+	const long long block_size = 256;
+	long long block_count = (max_count + block_size - 1) / block_size;
+	RBM_PROFILE_COUNT(StatesEnumerated, max_count);
+
+	double shift = -std::numeric_limits<double>::infinity();
+	double sum = 0.0;
 	initRBMExpected();
 
-	StateCounter<std::vector<int>> sc(std::vector<int>(rbm.getVisibleSize(), 2));  // 可視変数Vの状態カウンター
-	int v_state_map[] = { 0, 1 };  // 可視変数の状態->値変換写像
-
-	auto max_count = sc.getMaxCount();
-	#pragma omp parallel for schedule(static)
-	for (int c = 0; c < max_count; c++) {
-		// FIXME: stlのコピーは遅いぞ
-		auto sc_replica = sc;
-		sc_replica.innerCounter = c;
-
-		auto v_state = sc_replica.getState();
-		auto rbm_replica = rbm;
-
-		// FIXME: v_i == 0 ときそのままcontinueしたほうが速いぞ
+	#pragma omp parallel
+	{
+		double local_shift = -std::numeric_limits<double>::infinity();
+		double local_sum = 0.0;
+		Eigen::VectorXd local_v = Eigen::VectorXd::Zero(v_size);
+		Eigen::VectorXd local_h = Eigen::VectorXd::Zero(h_size);
+		Eigen::VectorXd local_sparse = Eigen::VectorXd::Zero(h_size);
+		Eigen::MatrixXd local_weight = Eigen::MatrixXd::Zero(v_size, h_size);
+		Eigen::MatrixXd local_sparse_weight = Eigen::MatrixXd::Zero(v_size, h_size);
+
+		#pragma omp for schedule(static)
+		for (long long block = 0; block < block_count; block++) {
+			auto begin = block * block_size;
+			auto count = std::min(block_size, max_count - begin);
+
+			Eigen::MatrixXd v_batch(v_size, count);
+			for (long long n = 0; n < count; n++) {
+				for (int i = 0; i < v_size; i++) v_batch(i, n) = ((begin + n) >> i) & 1;
+			}
 
-		for (int i = 0; i < rbm_replica.getVisibleSize(); i++) {
-			rbm_replica.nodes.v(i) = v_state_map[v_state[i]];
+			// log P~(v) = b^T v + sum_j log z_j(v)
+			Eigen::MatrixXd field_batch, log_z, hidden_batch, sparse_batch;
+			kernel.fields(v_batch, field_batch);
+			kernel.logNormalizer(field_batch, log_z);
+			kernel.moments(field_batch, hidden_batch, sparse_batch);
+			Eigen::VectorXd log_p = v_batch.transpose() * rbm.params.b;
+			log_p += log_z.colwise().sum().transpose();
+
+			auto block_max = log_p.maxCoeff();
+			if (block_max > local_shift) {
+				auto ratio = std::exp(local_shift - block_max);
+				local_sum *= ratio;
+				local_v *= ratio;
+				local_h *= ratio;
+				local_sparse *= ratio;
+				local_weight *= ratio;
+				local_sparse_weight *= ratio;
+				local_shift = block_max;
+			}
+			Eigen::VectorXd p = (log_p.array() - local_shift).exp().matrix();
+
+			local_sum += p.sum();
+			local_v.noalias() += v_batch * p;
+			local_h.noalias() += hidden_batch * p;
+			local_sparse.noalias() += sparse_batch * p;
+			local_weight.noalias() += v_batch * p.asDiagonal() * hidden_batch.transpose();
+			local_sparse_weight.noalias() += v_batch * p.asDiagonal() * sparse_batch.transpose();
 		}
 
-
-		auto b_dot_v = rbm_replica.nodes.getVisibleLayer().dot(rbm_replica.params.b);  // bとvの内積
-		auto mu_vect = rbm_replica.muVect();
-		auto sum_h_exp_mu_sparse = rbm_replica.sumHExpMuSparse(mu_vect);
-
-#pragma omp critical
+		#pragma omp critical
 		{
-			// 期待値一括計算
-			// E[v_i]
-			for (int i = 0; i < rbm_replica.getVisibleSize(); i++) {
-				rbmexpected.vBias(i) += rbm_replica.nodes.v(i) * exp(b_dot_v) * sum_h_exp_mu_sparse;
-			}
-
-			// E[v_i h_j] and E[h_j] and E[|h_j|]
-			for (int j = 0; j < rbm_replica.getHiddenSize(); j++) {
-				auto mu_j = mu_vect(j);
-				rbmexpected.hBias(j) += exp(b_dot_v) * sum_h_exp_mu_sparse * rbm_replica.actHidJ(j, mu_j);
-				rbmexpected.hSparseBias(j) += exp(b_dot_v) * sum_h_exp_mu_sparse * rbm_replica.actHidSparseJ(j, mu_j);
-
-				for (int i = 0; i < rbm_replica.getVisibleSize(); i++) {
-					rbmexpected.weight(i, j) += rbm_replica.nodes.v(i) * exp(b_dot_v) * sum_h_exp_mu_sparse * rbm_replica.actHidJ(j, mu_j);
-				}
+			if (local_sum > 0.0) {
+				auto new_shift = std::max(shift, local_shift);
+				auto ratio_global = std::exp(shift - new_shift);
+				auto ratio_local = std::exp(local_shift - new_shift);
+				sum = sum * ratio_global + local_sum * ratio_local;
+				rbmexpected.vBias = rbmexpected.vBias * ratio_global + local_v * ratio_local;
+				rbmexpected.hBias = rbmexpected.hBias * ratio_global + local_h * ratio_local;
+				rbmexpected.hSparseBias = rbmexpected.hSparseBias * ratio_global + local_sparse * ratio_local;
+				rbmexpected.weight = rbmexpected.weight * ratio_global + local_weight * ratio_local;
+				rbmexpected.sparseWeight = rbmexpected.sparseWeight * ratio_global + local_sparse_weight * ratio_local;
+				shift = new_shift;
 			}
 		}
 	}
 
-	auto z = rbm.getNormalConstant();
-	rbmexpected.vBias /= z;
-	rbmexpected.hBias /= z;
-	rbmexpected.weight /= z;
-	rbmexpected.hSparseBias /= z;
+	rbmexpected.vBias /= sum;
+	rbmexpected.hBias /= sum;
+	rbmexpected.hSparseBias /= sum;
+	rbmexpected.weight /= sum;
+	rbmexpected.sparseWeight /= sum;
 }
 
 
 // 勾配の計算
 template<class OPTIMIZERTYPE>
 inline void Trainer<GeneralizedFullSparseRBM, OPTIMIZERTYPE>::calcGradient(GeneralizedFullSparseRBM & rbm, std::vector<int> & data_indexes) {
+	RBM_PROFILE_SCOPE("calcGradient");
+
 	// 勾配ベクトルリセット
 	initGradient();
 
@@ -487,6 +525,8 @@ inline void Trainer<GeneralizedFullSparseRBM, OPTIMIZERTYPE>::calcGradient(Gener
 // パラメータの更新
 template<class OPTIMIZERTYPE>
 inline void Trainer<GeneralizedFullSparseRBM, OPTIMIZERTYPE>::updateParams(GeneralizedFullSparseRBM & rbm) {
+	RBM_PROFILE_SCOPE("updateParams");
+
 	for (int i = 0; i < rbm.getVisibleSize(); i++) {
 		rbm.params.b(i) += optimizer.getNewParamVBias(gradient.vBias(i), i);
 
@@ -497,7 +537,7 @@ inline void Trainer<GeneralizedFullSparseRBM, OPTIMIZERTYPE>::updateParams(Gener
 
 	for (int j = 0; j < rbm.getHiddenSize(); j++) {
 		rbm.params.c(j) += optimizer.getNewParamHBias(gradient.hBias(j), j);
-		rbm.params.sparse(j) += optimizer.getNewParamHSparse(gradient.hBias(j), j);
+		rbm.params.sparseC(j) += optimizer.getNewParamHSparse(gradient.hSparseBias(j), j);
 	}
 }
 
@@ -505,6 +545,8 @@ inline void Trainer<GeneralizedFullSparseRBM, OPTIMIZERTYPE>::updateParams(Gener
 // 対数尤度関数
 template<class OPTIMIZERTYPE>
 inline double Trainer<GeneralizedFullSparseRBM, OPTIMIZERTYPE>::logLikeliHood(GeneralizedFullSparseRBM & rbm, std::vector<std::vector<double>> & dataset) {
+	RBM_PROFILE_SCOPE("logLikeliHood");
+
 	double value = 0.0;
 
 	auto z = rbm.getNormalConstant();
@@ -542,3 +584,24 @@ inline void Trainer<GeneralizedFullSparseRBM, OPTIMIZERTYPE>::trainFromTrainInfo
 	rbm.setRealHiddenValue(js["realFlag"]);
 }
 
+template<class OPTIMIZERTYPE>
+void Trainer<GeneralizedFullSparseRBM, OPTIMIZERTYPE>::writeCheckpoint(rbmckpt::Writer & writer, GeneralizedFullSparseRBM & rbm) {
+	writer.addScalar("trainer.trainCount", _trainCount);
+	writer.addScalar("trainer.epoch", epoch);
+	writer.addScalar("trainer.batchSize", batchSize);
+	writer.addScalar("trainer.cdk", cdk);
+	writer.addScalar("trainer.learningRate", learningRate);
+	rbmckpt::addEngine(writer, "trainer.rand", this->randDevice);
+	this->optimizer.writeCheckpoint(writer, "optimizer.");
+}
+
+template<class OPTIMIZERTYPE>
+void Trainer<GeneralizedFullSparseRBM, OPTIMIZERTYPE>::readCheckpoint(rbmckpt::Reader & reader, GeneralizedFullSparseRBM & rbm) {
+	_trainCount = static_cast<int>(reader.scalar("trainer.trainCount"));
+	epoch = static_cast<int>(reader.scalar("trainer.epoch"));
+	batchSize = static_cast<int>(reader.scalar("trainer.batchSize"));
+	cdk = static_cast<int>(reader.scalar("trainer.cdk"));
+	learningRate = reader.scalar("trainer.learningRate");
+	rbmckpt::readEngine(reader, "trainer.rand", this->randDevice);
+	this->optimizer.readCheckpoint(reader, "optimizer.");
+}
@@ -1,4 +1,6 @@
 ﻿#include "GeneralizedGRBM.h"
+#include "../GaussianExact.h"
+#include "../Profiler.h"
 
 GeneralizedGRBM::GeneralizedGRBM(size_t v_size, size_t h_size) {
 	vSize = v_size;
@@ -29,47 +31,59 @@ size_t GeneralizedGRBM::getHiddenSize() {
 
 // 規格化を返します
 double GeneralizedGRBM::getNormalConstant() {
-	throw;
-	// 以下全部間違ってます///
-
-	StateCounter<std::vector<int>> sc(std::vector<int>(vSize, this->divSize + 1));  // 可視変数Vの状態カウンター
-	auto state_map = this->splitHiddenSet();  // 状態->値変換写像
+	return exp(getLogNormalConstant());
+}
 
+// 規格化の対数を返します
+double GeneralizedGRBM::getLogNormalConstant() {
+	RBM_PROFILE_SCOPE("getNormalConstant");
 
-	double z = 0.0;
-	auto max_count = sc.getMaxCount();
-	for (int i = 0; i < max_count; i++, sc++) {
-		// TODO: ここに状態数の計算を記述せよ
+	return GaussianExact::logNormalConstant(params.b, params.c, params.w, params.lambda, hiddenValueSet);
+}
 
-		// FIXME: stlのコピーは遅いぞ
-		auto v_state = sc.getState();
-		for (int i = 0; i < vSize; i++) {
-			this->nodes.v(i) = state_map[v_state[i]];
-		}
+// 可視変数の対数尤度 log P(v) = -sum_i lambda_i v_i^2 / 2 + b^T v + sum_j log sum_h exp(mu_j h) - log Z
+double GeneralizedGRBM::logProbVis(std::vector<double> & data, double log_z) {
+	Eigen::VectorXd v = Eigen::Map<Eigen::VectorXd>(data.data(), data.size());
+	Eigen::VectorXd mu_vect = params.c + params.w.transpose() * v;
 
-		// 項計算
-		double term = exp(nodes.getVisibleLayer().dot(params.b));
-		for (int j = 0; j < hSize; j++) {
-			term *= 1 + exp(mu(j));
-		}
+	double log_prob = -0.5 * v.cwiseAbs2().dot(params.lambda) + params.b.dot(v) - log_z;
 
-		z += term;
+	for (int j = 0; j < hSize; j++) {
+		double sum = 0.0;
+		for (auto & value : hiddenValueSet) sum += exp(mu_vect(j) * value);
+		log_prob += log(sum);
 	}
 
-	return z;
+	return log_prob;
 }
 
 
 // エネルギー関数を返します
 double GeneralizedGRBM::getEnergy() {
-	// まだ必要ないため実装保留
-	throw;
+	Eigen::MatrixXd v_batch = nodes.v.transpose();
+	Eigen::MatrixXd h_batch = nodes.h.transpose();
+	return this->getEnergyBatch(v_batch, h_batch)(0);
+}
+
+// エネルギー関数を一括計算します
+// E(v, h) = sum_i lambda_i v_i^2 / 2 - b^T v - mu(v)^T h を行列積でまとめて計算
+Eigen::VectorXd GeneralizedGRBM::getEnergyBatch(const Eigen::MatrixXd & v_batch, const Eigen::MatrixXd & h_batch) {
+	// 各行の隠れ変数に関する外部磁場と相互作用, mu = c + W^T v
+	Eigen::MatrixXd mu_batch = v_batch * params.w;
+	mu_batch.rowwise() += params.c.transpose();
+
+	Eigen::VectorXd energy = -(v_batch * params.b) - mu_batch.cwiseProduct(h_batch).rowwise().sum();
+
+	// 可視変数の二乗の項(params.lambdaは逆分散)
+	energy.noalias() += 0.5 * (v_batch.cwiseAbs2() * params.lambda);
+
+	return energy;
 }
 
 
 // 自由エネルギーを返します
 double GeneralizedGRBM::getFreeEnergy() {
-	return -log(this->getNormalConstant());
+	return -this->getLogNormalConstant();
 }
 
 // 隠れ変数の活性化関数的なもの
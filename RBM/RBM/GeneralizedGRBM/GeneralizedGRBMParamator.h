@@ -5,6 +5,11 @@
 #include <random>
 
 
+namespace rbmckpt {
+	class Writer;
+	class Reader;
+}
+
 class GeneralizedGRBMParamator : RBMParamatorBase {
 private:
     size_t vSize;
@@ -62,4 +67,10 @@ public:
 
 	// パラメータ情報のデシリアライズ
 	void deserialize(std::string js);
+
+	// チェックポイントに登録(配列はコピーしない)
+	void writeCheckpoint(rbmckpt::Writer & writer);
+
+	// チェックポイントから復元(同じ形であること)
+	void readCheckpoint(rbmckpt::Reader & reader);
 };
@@ -108,6 +108,7 @@ inline double Sampler<GeneralizedGRBM>::updateByGibbsSamplingHidden(GeneralizedG
 }
 
 inline Eigen::VectorXd & Sampler<GeneralizedGRBM>::updateByBlockedGibbsSamplingVisible(GeneralizedGRBM &rbm) {
+	RBM_PROFILE_COUNT(Sweeps, 1);
 
 	for (int i = 0; i < rbm.getVisibleSize(); i++) {
 		updateByGibbsSamplingVisible(rbm, i);
@@ -117,6 +118,7 @@ inline Eigen::VectorXd & Sampler<GeneralizedGRBM>::updateByBlockedGibbsSamplingV
 }
 
 inline Eigen::VectorXd & Sampler<GeneralizedGRBM>::updateByBlockedGibbsSamplingHidden(GeneralizedGRBM &rbm) {
+	RBM_PROFILE_COUNT(Sweeps, 1);
 	for (int j = 0; j < rbm.getHiddenSize(); j++) {
 		updateByGibbsSamplingHidden(rbm, j);
 	}
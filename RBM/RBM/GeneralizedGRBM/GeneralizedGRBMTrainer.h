@@ -1,6 +1,8 @@
 ﻿#pragma once
 #include "../Trainer.h"
+#include "../Checkpoint.h"
 #include "GeneralizedGRBM.h"
+#include "../GaussianExact.h"
 #include "Eigen/Core"
 #include <vector>
 #include <numeric>
@@ -26,12 +28,14 @@ class Trainer<GeneralizedGRBM, OPTIMIZERTYPE> {
         Eigen::VectorXd visible;
         Eigen::VectorXd visible2;  // Gausiann Unit限定 
         Eigen::VectorXd hidden;
+        Eigen::MatrixXd weight;  // E[v h^T]
     };
 
     struct RBMExpected {
         Eigen::VectorXd visible;
         Eigen::VectorXd visible2;  // Gausiann Unit限定 
         Eigen::VectorXd hidden;
+        Eigen::MatrixXd weight;  // E[v h^T]
     };
 
 private:
@@ -102,6 +106,22 @@ public:
     void calcRBMExpectedCD(RBMBase & rbm, std::vector<std::vector<double>> & dataset, std::vector<int> & data_indexes) { calcRBMExpectedCD(reinterpret_cast<GeneralizedGRBM &>(rbm), dataset, data_indexes); }
     void calcRBMExpectedCD(GeneralizedGRBM & rbm, std::vector<std::vector<double>> & dataset, std::vector<int> & data_indexes);
 
+    // 学習(厳密な期待値)
+    void trainExact(RBMBase & rbm, std::vector<std::vector<double>> & dataset) { trainExact(reinterpret_cast<GeneralizedGRBM &>(rbm), dataset); }
+    void trainExact(GeneralizedGRBM & rbm, std::vector<std::vector<double>> & dataset);
+
+    // 1回だけ学習(厳密な期待値)
+    void trainOnceExact(RBMBase & rbm, std::vector<std::vector<double>> & dataset) { trainOnceExact(reinterpret_cast<GeneralizedGRBM &>(rbm), dataset); }
+    void trainOnceExact(GeneralizedGRBM & rbm, std::vector<std::vector<double>> & dataset);
+
+    // サンプル平均の計算(隠れ変数の配位を列挙, 可視変数は解析的に積分)
+    void calcRBMExpectedExact(RBMBase & rbm) { calcRBMExpectedExact(reinterpret_cast<GeneralizedGRBM &>(rbm)); }
+    void calcRBMExpectedExact(GeneralizedGRBM & rbm);
+
+    // 対数尤度関数(厳密)
+    double logLikeliHood(RBMBase & rbm, std::vector<std::vector<double>> & dataset) { return logLikeliHood(reinterpret_cast<GeneralizedGRBM &>(rbm), dataset); }
+    double logLikeliHood(GeneralizedGRBM & rbm, std::vector<std::vector<double>> & dataset);
+
     // 勾配の計算
     void calcGradient(RBMBase & rbm, std::vector<int> & data_indexes) { calcGradient(reinterpret_cast<GeneralizedGRBM &>(rbm), data_indexes); }
     void calcGradient(GeneralizedGRBM & rbm, std::vector<int> & data_indexes);
@@ -121,6 +141,11 @@ public:
 	// 学習情報から学習(JSON)
 	void trainFromTrainInfo(RBMBase & rbm, std::string json) { trainFromTrainInfo(reinterpret_cast<GeneralizedGRBM &>(rbm), json); };
 	void trainFromTrainInfo(GeneralizedGRBM & rbm, std::string json);
+
+	// 学習状態(反復回数, オプティマイザのモーメント, 乱数, チェイン)のチェックポイント
+	// モデルと合わせてrbmckpt::saveTraining/loadTrainingから使う
+	void writeCheckpoint(rbmckpt::Writer & writer, GeneralizedGRBM & rbm);
+	void readCheckpoint(rbmckpt::Reader & reader, GeneralizedGRBM & rbm);
 };
 
 template<class OPTIMIZERTYPE>
@@ -168,6 +193,7 @@ inline void Trainer<GeneralizedGRBM, OPTIMIZERTYPE>::initDataMean(GeneralizedGRB
 	dataMean.visible.setConstant(rbm.getVisibleSize(), 0.0);
 	dataMean.visible2.setConstant(rbm.getVisibleSize(), 0.0);  // Gaussian Unit
 	dataMean.hidden.setConstant(rbm.getHiddenSize(), 0.0);
+	dataMean.weight.setConstant(rbm.getVisibleSize(), rbm.getHiddenSize(), 0.0);
 }
 
 template<class OPTIMIZERTYPE>
@@ -175,6 +201,7 @@ inline void Trainer<GeneralizedGRBM, OPTIMIZERTYPE>::initDataMean() {
 	dataMean.visible.setConstant(0.0);
 	dataMean.visible2.setConstant(0.0);  // Gaussian Unit
 	dataMean.hidden.setConstant(0.0);
+	dataMean.weight.setConstant(0.0);
 }
 
 template<class OPTIMIZERTYPE>
@@ -182,6 +209,7 @@ inline void Trainer<GeneralizedGRBM, OPTIMIZERTYPE>::initRBMExpected(Generalized
 	sampleMean.visible.setConstant(rbm.getVisibleSize(), 0.0);
 	sampleMean.visible2.setConstant(rbm.getVisibleSize(), 0.0);  // Gaussian Unit
 	sampleMean.hidden.setConstant(rbm.getHiddenSize(), 0.0);
+	sampleMean.weight.setConstant(rbm.getVisibleSize(), rbm.getHiddenSize(), 0.0);
 }
 
 template<class OPTIMIZERTYPE>
@@ -189,6 +217,7 @@ inline void Trainer<GeneralizedGRBM, OPTIMIZERTYPE>::initRBMExpected() {
 	sampleMean.visible.setConstant(0.0);
 	sampleMean.visible2.setConstant(0.0);  // Gaussian Unit
 	sampleMean.hidden.setConstant(0.0);
+	sampleMean.weight.setConstant(0.0);
 }
 
 template<class OPTIMIZERTYPE>
@@ -202,6 +231,7 @@ inline void Trainer<GeneralizedGRBM, OPTIMIZERTYPE>::train(GeneralizedGRBM & rbm
 // 1回だけ学習
 template<class OPTIMIZERTYPE>
 inline void Trainer<GeneralizedGRBM, OPTIMIZERTYPE>::trainOnce(GeneralizedGRBM & rbm, std::vector<std::vector<double>> & dataset) {
+	RBM_PROFILE_SCOPE("trainOnce");
 
 	// データインデックス集合
 	std::vector<int> data_indexes(dataset.size());
@@ -228,6 +258,7 @@ inline void Trainer<GeneralizedGRBM, OPTIMIZERTYPE>::trainOnce(GeneralizedGRBM &
 	updateParams(rbm);
 
 	// Trainer情報更新
+	RBM_PROFILE_EPOCH(_trainCount);
 	_trainCount++;
 }
 
@@ -245,6 +276,8 @@ inline void Trainer<GeneralizedGRBM, OPTIMIZERTYPE>::calcContrastiveDivergence(G
 
 template<class OPTIMIZERTYPE>
 inline void Trainer<GeneralizedGRBM, OPTIMIZERTYPE>::calcDataMean(GeneralizedGRBM & rbm, std::vector<std::vector<double>> & dataset, std::vector<int> & data_indexes) {
+	RBM_PROFILE_SCOPE("calcDataMean");
+
 	// 0埋め初期化
 	initDataMean();
 
@@ -259,17 +292,24 @@ inline void Trainer<GeneralizedGRBM, OPTIMIZERTYPE>::calcDataMean(GeneralizedGRB
 			dataMean.visible2(i) += vect(i) * vect(i) / 2.0;  // Gausiann Unit限定 
 		}
 
+		Eigen::VectorXd hid_vect(rbm.getHiddenSize());
 		for (int j = 0; j < rbm.getHiddenSize(); j++) {
-			dataMean.hidden(j) += rbm.actHidJ(j);
+			hid_vect(j) = rbm.actHidJ(j);
 		}
+		dataMean.hidden += hid_vect;
+		dataMean.weight.noalias() += vect * hid_vect.transpose();
 	}
 
 	dataMean.visible /= static_cast<double>(data_indexes.size());
+	dataMean.visible2 /= static_cast<double>(data_indexes.size());
 	dataMean.hidden /= static_cast<double>(data_indexes.size());
+	dataMean.weight /= static_cast<double>(data_indexes.size());
 }
 
 template<class OPTIMIZERTYPE>
 inline void Trainer<GeneralizedGRBM, OPTIMIZERTYPE>::calcRBMExpectedCD(GeneralizedGRBM & rbm, std::vector<std::vector<double>> & dataset, std::vector<int> & data_indexes) {
+	RBM_PROFILE_SCOPE("calcRBMExpectedCD");
+
 	// 0埋め初期化
 	initRBMExpected();
 
@@ -285,7 +325,7 @@ inline void Trainer<GeneralizedGRBM, OPTIMIZERTYPE>::calcRBMExpectedCD(Generaliz
 		}
 
 		// CD-K
-		Sampler<GeneralizedGRBM, OPTIMIZERTYPE> sampler;
+		Sampler<GeneralizedGRBM> sampler;
 		for (int k = 0; k < cdk; k++) {
 			sampler.updateByBlockedGibbsSamplingVisible(rbm);
 			sampler.updateByBlockedGibbsSamplingHidden(rbm);
@@ -294,6 +334,7 @@ inline void Trainer<GeneralizedGRBM, OPTIMIZERTYPE>::calcRBMExpectedCD(Generaliz
 		// 結果を格納
 		sampleMean.visible += rbm.nodes.v;
 		sampleMean.hidden += rbm.nodes.h;
+		sampleMean.weight.noalias() += rbm.nodes.v * rbm.nodes.h.transpose();
 
 		// Gausiann Unit限定 
 		for (int i = 0; i < rbm.getVisibleSize(); i++) {
@@ -302,12 +343,66 @@ inline void Trainer<GeneralizedGRBM, OPTIMIZERTYPE>::calcRBMExpectedCD(Generaliz
 	}
 
 	sampleMean.visible /= static_cast<double>(data_indexes.size());
+	sampleMean.visible2 /= static_cast<double>(data_indexes.size());
 	sampleMean.hidden /= static_cast<double>(data_indexes.size());
+	sampleMean.weight /= static_cast<double>(data_indexes.size());
+}
+
+template<class OPTIMIZERTYPE>
+inline void Trainer<GeneralizedGRBM, OPTIMIZERTYPE>::calcRBMExpectedExact(GeneralizedGRBM & rbm) {
+	RBM_PROFILE_SCOPE("calcRBMExpectedExact");
+
+	auto moments = GaussianExact::moments(rbm.params.b, rbm.params.c, rbm.params.w, rbm.params.lambda, rbm.splitHiddenSet());
+	sampleMean.visible = moments.visible;
+	sampleMean.visible2 = moments.visible2;
+	sampleMean.hidden = moments.hidden;
+	sampleMean.weight = moments.weight;
+}
+
+template<class OPTIMIZERTYPE>
+inline void Trainer<GeneralizedGRBM, OPTIMIZERTYPE>::trainExact(GeneralizedGRBM & rbm, std::vector<std::vector<double>> & dataset) {
+	for (int e = 0; e < epoch; e++) {
+		trainOnceExact(rbm, dataset);
+	}
+}
+
+// 1回だけ学習(データ平均は全データ, モデル平均は厳密)
+template<class OPTIMIZERTYPE>
+inline void Trainer<GeneralizedGRBM, OPTIMIZERTYPE>::trainOnceExact(GeneralizedGRBM & rbm, std::vector<std::vector<double>> & dataset) {
+	RBM_PROFILE_SCOPE("trainOnceExact");
+
+	std::vector<int> data_indexes(dataset.size());
+	std::iota(data_indexes.begin(), data_indexes.end(), 0);
+
+	calcDataMean(rbm, dataset, data_indexes);
+	calcRBMExpectedExact(rbm);
+	calcGradient(rbm, data_indexes);
+	updateMomentum(rbm);
+	updateParams(rbm);
+
+	RBM_PROFILE_EPOCH(_trainCount);
+	_trainCount++;
+}
+
+// 対数尤度関数(厳密)
+template<class OPTIMIZERTYPE>
+inline double Trainer<GeneralizedGRBM, OPTIMIZERTYPE>::logLikeliHood(GeneralizedGRBM & rbm, std::vector<std::vector<double>> & dataset) {
+	RBM_PROFILE_SCOPE("logLikeliHood");
+
+	auto log_z = rbm.getLogNormalConstant();
+	double value = 0.0;
+	for (auto & data : dataset) {
+		value += rbm.logProbVis(data, log_z);
+	}
+
+	return value;
 }
 
 // 勾配の計算
 template<class OPTIMIZERTYPE>
 inline void Trainer<GeneralizedGRBM, OPTIMIZERTYPE>::calcGradient(GeneralizedGRBM & rbm, std::vector<int> & data_indexes) {
+	RBM_PROFILE_SCOPE("calcGradient");
+
 	// 勾配ベクトルリセット
 	initGradient();
 
@@ -316,7 +411,7 @@ inline void Trainer<GeneralizedGRBM, OPTIMIZERTYPE>::calcGradient(GeneralizedGRB
 		//gradient.vLambda(i) = dataMean.visible2(i) - sampleMean.visible2(i);
 
 		for (int j = 0; j < rbm.getHiddenSize(); j++) {
-			gradient.weight(i, j) = dataMean.visible(i) * dataMean.hidden(j) - sampleMean.visible(i) * sampleMean.hidden(j);
+			gradient.weight(i, j) = dataMean.weight(i, j) - sampleMean.weight(i, j);
 		}
 	}
 
@@ -344,6 +439,8 @@ inline void Trainer<GeneralizedGRBM, OPTIMIZERTYPE>::updateMomentum(GeneralizedG
 // パラメータの更新
 template<class OPTIMIZERTYPE>
 inline void Trainer<GeneralizedGRBM, OPTIMIZERTYPE>::updateParams(GeneralizedGRBM & rbm) {
+	RBM_PROFILE_SCOPE("updateParams");
+
 	for (int i = 0; i < rbm.getVisibleSize(); i++) {
 		rbm.params.b(i) += momentum.vBias(i);
 		//rbm.params.lambda(i) += momentum.vLambda(i);  // 非負制約を満たすこと
@@ -383,4 +480,32 @@ inline void Trainer<GeneralizedGRBM, OPTIMIZERTYPE>::trainFromTrainInfo(Generali
 	cdk = js["cdk"];
 	rbm.setHiddenDiveSize(js["divSize"]);
 	//rbm.setRealHiddenValue(js["realFlag"]);
+}
+
+template<class OPTIMIZERTYPE>
+void Trainer<GeneralizedGRBM, OPTIMIZERTYPE>::writeCheckpoint(rbmckpt::Writer & writer, GeneralizedGRBM & rbm) {
+	writer.addScalar("trainer.trainCount", _trainCount);
+	writer.addScalar("trainer.epoch", epoch);
+	writer.addScalar("trainer.batchSize", batchSize);
+	writer.addScalar("trainer.cdk", cdk);
+	writer.addScalar("trainer.learningRate", learningRate);
+	writer.addScalar("trainer.momentumRate", momentumRate);
+	writer.add("trainer.momentum.vBias", momentum.vBias);
+	writer.add("trainer.momentum.vLambda", momentum.vLambda);
+	writer.add("trainer.momentum.hBias", momentum.hBias);
+	writer.add("trainer.momentum.weight", momentum.weight);
+}
+
+template<class OPTIMIZERTYPE>
+void Trainer<GeneralizedGRBM, OPTIMIZERTYPE>::readCheckpoint(rbmckpt::Reader & reader, GeneralizedGRBM & rbm) {
+	_trainCount = static_cast<int>(reader.scalar("trainer.trainCount"));
+	epoch = static_cast<int>(reader.scalar("trainer.epoch"));
+	batchSize = static_cast<int>(reader.scalar("trainer.batchSize"));
+	cdk = static_cast<int>(reader.scalar("trainer.cdk"));
+	learningRate = reader.scalar("trainer.learningRate");
+	momentumRate = reader.scalar("trainer.momentumRate");
+	momentum.vBias = reader.vector("trainer.momentum.vBias");
+	momentum.vLambda = reader.vector("trainer.momentum.vLambda");
+	momentum.hBias = reader.vector("trainer.momentum.hBias");
+	momentum.weight = reader.matrix("trainer.momentum.weight");
 }
\ No newline at end of file
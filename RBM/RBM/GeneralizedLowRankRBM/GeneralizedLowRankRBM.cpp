@@ -0,0 +1,267 @@
+﻿#include "GeneralizedLowRankRBM.h"
+#include <cmath>
+#include "../Profiler.h"
+
+
+GeneralizedLowRankRBM::GeneralizedLowRankRBM(size_t v_size, size_t h_size, size_t rank) {
+	vSize = v_size;
+	hSize = h_size;
+	this->rank = rank;
+
+	// ノード確保
+	nodes = GeneralizedRBMNode(v_size, h_size);
+
+	// パラメータ初期化
+	params = GeneralizedLowRankRBMParamator(v_size, h_size, rank);
+	params.initParamsRandom(-0.1, 0.1);
+
+	// 区間分割
+	hiddenValueSet = splitHiddenSet();
+}
+
+
+// 可視変数の数を返す
+size_t GeneralizedLowRankRBM::getVisibleSize() {
+	return vSize;
+}
+
+// 隠れ変数の数を返す
+size_t GeneralizedLowRankRBM::getHiddenSize() {
+	return hSize;
+}
+
+// カップリングのランクを返す
+size_t GeneralizedLowRankRBM::getRank() {
+	return rank;
+}
+
+
+// 規格化を返します
+double GeneralizedLowRankRBM::getNormalConstant() {
+	RBM_PROFILE_SCOPE("getNormalConstant");
+
+	StateCounter<std::vector<int>> sc(std::vector<int>(vSize, 2));  // 可視変数Vの状態カウンター
+	auto & v_state_map = this->visibleValueSet;  // 可視変数の状態->値変換写像
+
+	double z = 0.0;
+	auto max_count = sc.getMaxCount();
+	RBM_PROFILE_COUNT(StatesEnumerated, max_count);
+	for (int c = 0; c < max_count; c++, sc++) {
+		auto v_state = sc.getState();
+
+		for (int i = 0; i < vSize; i++) {
+			this->nodes.v(i) = v_state_map[v_state[i]];
+		}
+
+		// 項計算
+		auto mu_vect = muVect();
+		double term = exp(nodes.v.dot(params.b));
+		for (int j = 0; j < hSize; j++) {
+			term *= miniNormalizeConstantHidden(j, mu_vect(j));
+		}
+
+		z += term;
+	}
+
+	return z;
+}
+
+
+// エネルギー関数を返します
+// E(v, h) = -b^T v - c^T h - (wv^T v)^T (wh^T h)
+double GeneralizedLowRankRBM::getEnergy() {
+	Eigen::VectorXd v_proj = params.wv.transpose() * nodes.v;
+	Eigen::VectorXd h_proj = params.wh.transpose() * nodes.h;
+
+	return -nodes.v.dot(params.b) - nodes.h.dot(params.c) - v_proj.dot(h_proj);
+}
+
+
+// 自由エネルギーを返します
+double GeneralizedLowRankRBM::getFreeEnergy() {
+	return -log(this->getNormalConstant());
+}
+
+// 隠れ変数の活性化関数的なもの
+double GeneralizedLowRankRBM::actHidJ(int hindex) {
+	return this->actHidJ(hindex, this->mu(hindex));
+}
+
+double GeneralizedLowRankRBM::actHidJ(int hindex, double mu)
+{
+	// 連続型
+	if (realFlag) {
+		// FIXME: 0除算の可能性あり, 要テイラー展開(GeneralizedRBMと同じ)
+		return (hMax * exp(hMax * mu) - hMin * exp(hMin * mu)) / (exp(hMax * mu) - exp(hMin * mu)) - 1 / mu;
+	}
+
+	// 離散型
+	double numer = 0.0;  // 分子
+	double denom = miniNormalizeConstantHidden(hindex, mu);  // 分母
+	for (auto & h_j : hiddenValueSet) {
+		numer += h_j * exp(mu * h_j);
+	}
+
+	return numer / denom;
+}
+
+// 可視変数に関する外部磁場と相互作用
+double GeneralizedLowRankRBM::lambda(int vindex) {
+	Eigen::VectorXd h_proj = params.wh.transpose() * nodes.h;
+
+	return params.b(vindex) + params.wv.row(vindex).dot(h_proj);
+}
+
+Eigen::VectorXd GeneralizedLowRankRBM::lambdaVect()
+{
+	Eigen::VectorXd h_proj = params.wh.transpose() * nodes.h;
+	Eigen::VectorXd lambda_vect = params.b;
+	lambda_vect.noalias() += params.wv * h_proj;
+
+	return lambda_vect;
+}
+
+double GeneralizedLowRankRBM::sumExpLambda(int vindex, double lambda)
+{
+	double value = 0.0;
+	for (auto & v_i : this->visibleValueSet) {
+		value += exp(lambda * v_i);
+	}
+	return value;
+}
+
+// 隠れ変数に関する外部磁場と相互作用
+double GeneralizedLowRankRBM::mu(int hindex) {
+	Eigen::VectorXd v_proj = params.wv.transpose() * nodes.v;
+
+	return params.c(hindex) + params.wh.row(hindex).dot(v_proj);
+}
+
+Eigen::VectorXd GeneralizedLowRankRBM::muVect()
+{
+	Eigen::VectorXd v_proj = params.wv.transpose() * nodes.v;
+	Eigen::VectorXd mu_vect = params.c;
+	mu_vect.noalias() += params.wh * v_proj;
+
+	return mu_vect;
+}
+
+// muの隠れ変数に関する全ての実現値の総和
+double GeneralizedLowRankRBM::miniNormalizeConstantHidden(int hindex, double mu) {
+	// 連続型
+	if (realFlag) {
+		return (exp(hMax * mu) - exp(hMin * mu)) / mu;
+	}
+
+	// 離散型
+	double value = 0.0;
+	for (auto & h_j : hiddenValueSet) {
+		value += exp(mu * h_j);
+	}
+
+	return value;
+}
+
+
+// 可視変数の確率(隠れ変数周辺化済み)
+double GeneralizedLowRankRBM::probVis(std::vector<double> & data) {
+	// 分配関数
+	double z = getNormalConstant();
+
+	return probVis(data, z);
+}
+
+// 可視変数の確率(隠れ変数周辺化済み, 分配関数使いまわし)
+double GeneralizedLowRankRBM::probVis(std::vector<double> & data, double normalize_constant) {
+	for (int i = 0; i < vSize; i++) {
+		this->nodes.v(i) = data[i];
+	}
+
+	auto mu_vect = muVect();
+	double value = exp(nodes.v.dot(params.b)) / normalize_constant;
+	for (int j = 0; j < hSize; j++) {
+		value *= miniNormalizeConstantHidden(j, mu_vect(j));
+	}
+
+	return value;
+}
+
+// 隠れ変数を条件で与えた可視変数の条件付き確率, P(v_i | h)
+double GeneralizedLowRankRBM::condProbVis(int vindex, double value) {
+	return this->condProbVis(vindex, value, this->lambda(vindex));
+}
+
+double GeneralizedLowRankRBM::condProbVis(int vindex, double value, double lambda)
+{
+	return exp(lambda * value) / sumExpLambda(vindex, lambda);
+}
+
+// 可視変数を条件で与えた隠れ変数の条件付き確率, P(h_j | v)
+double GeneralizedLowRankRBM::condProbHid(int hindex, double value) {
+	return this->condProbHid(hindex, value, this->mu(hindex));
+}
+
+double GeneralizedLowRankRBM::condProbHid(int hindex, double value, double mu)
+{
+	return exp(mu * value) / miniNormalizeConstantHidden(hindex, mu);
+}
+
+
+std::vector<double> GeneralizedLowRankRBM::splitHiddenSet() {
+	std::vector<double> set(divSize + 1);
+
+	for (int i = 0; i < set.size(); i++) set[i] = 1.0 / divSize * i * (hMax - hMin) + hMin;
+
+	return set;
+}
+
+int GeneralizedLowRankRBM::getHiddenValueSetSize() {
+	return divSize + 1;
+}
+
+// 隠れ変数の取りうる最大値を取得
+double GeneralizedLowRankRBM::getHiddenMax() {
+	return hMax;
+}
+
+// 隠れ変数の取りうる最大値を設定
+void GeneralizedLowRankRBM::setHiddenMax(double value) {
+	hMax = value;
+
+	// 区間分割
+	hiddenValueSet = splitHiddenSet();
+}
+
+// 隠れ変数の取りうる最小値を取得
+double GeneralizedLowRankRBM::getHiddenMin() {
+	return hMin;
+}
+
+// 隠れ変数の取りうる最小値を設定
+void GeneralizedLowRankRBM::setHiddenMin(double value) {
+	hMin = value;
+
+	// 区間分割
+	hiddenValueSet = splitHiddenSet();
+}
+
+// 隠れ変数の区間分割数を返す
+size_t GeneralizedLowRankRBM::getHiddenDivSize() {
+	return divSize;
+}
+
+// 隠れ変数の区間分割数を設定
+void GeneralizedLowRankRBM::setHiddenDivSize(size_t div_size) {
+	divSize = div_size;
+
+	// 区間分割
+	hiddenValueSet = splitHiddenSet();
+}
+
+void GeneralizedLowRankRBM::setRealHiddenValue(bool flag) {
+	realFlag = flag;
+}
+
+bool GeneralizedLowRankRBM::isRealHiddenValue() {
+	return realFlag;
+}
@@ -0,0 +1,131 @@
+﻿#pragma once
+#include "../GeneralizedRBM/GeneralizedRBMNode.h"
+#include "GeneralizedLowRankRBMParamator.h"
+#include <vector>
+#include <string>
+#include "../StateCounter.h"
+#include <cmath>
+
+
+// カップリングを低ランク因子 W = wv * wh^T で持つGeneralizedRBM
+// mu, lambdaは因子を経由して計算するので, 計算量もメモリも(vSize + hSize) * rankに比例する
+class GeneralizedLowRankRBM {
+
+protected:
+	size_t vSize = 0;
+	size_t hSize = 0;
+	size_t rank = 0;
+	double hMin = 0.0;
+	double hMax = 1.0;
+	size_t divSize = 1;  // 隠れ変数の区間分割数
+	bool realFlag = false;
+
+
+public:
+	GeneralizedLowRankRBMParamator params;
+	GeneralizedRBMNode nodes;
+	std::string trainType = "";
+
+	std::vector <double> visibleValueSet = { -1.0, 1.0 };
+	std::vector <double> hiddenValueSet;  // 隠れ変数の取りうる値
+
+public:
+	GeneralizedLowRankRBM() = default;
+	GeneralizedLowRankRBM(size_t v_size, size_t h_size, size_t rank);
+	~GeneralizedLowRankRBM() = default;
+
+	// 可視変数の数を返す
+	size_t getVisibleSize();
+
+	// 隠れ変数の数を返す
+	size_t getHiddenSize();
+
+	// カップリングのランクを返す
+	size_t getRank();
+
+	// 規格化を返します
+	double getNormalConstant();
+
+	// エネルギー関数を返します
+	double getEnergy();
+
+	// 自由エネルギーを返します
+	double getFreeEnergy();
+
+	// 隠れ変数の活性化関数的なもの
+	double actHidJ(int hindex);
+
+	// 隠れ変数の活性化関数的なもの
+	double actHidJ(int hindex, double mu);
+
+	// 可視変数に関する外部磁場と相互作用(1つだけでもwh^T hの計算が要るので, 全体はlambdaVectで)
+	double lambda(int vindex);
+
+	// 可視変数に関する外部磁場と相互作用, lambda = b + wv (wh^T h)
+	Eigen::VectorXd lambdaVect();
+
+	// exp(lambda)の可視変数に関する全ての実現値の総和
+	double sumExpLambda(int vindex, double lambda);
+
+	// 隠れ変数に関する外部磁場と相互作用(1つだけでもwv^T vの計算が要るので, 全体はmuVectで)
+	double mu(int hindex);
+
+	// 隠れ変数に関する外部磁場と相互作用, mu = c + wh (wv^T v)
+	Eigen::VectorXd muVect();
+
+	// exp(mu)の隠れ変数に関する全ての実現値の総和
+	double miniNormalizeConstantHidden(int hindex, double mu);
+
+	// 可視変数の確率(隠れ変数周辺化済み)
+	double probVis(std::vector<double> & data);
+
+	// 可視変数の確率(隠れ変数周辺化済み, 分配関数使いまわし)
+	double probVis(std::vector<double> & data, double normalize_constant);
+
+	// 隠れ変数を条件で与えた可視変数の条件付き確率, P(v_i | h)
+	double condProbVis(int vindex, double value);
+
+	// 隠れ変数を条件で与えた可視変数の条件付き確率, P(v_i | h)
+	double condProbVis(int vindex, double value, double lambda);
+
+	// 可視変数を条件で与えた隠れ変数の条件付き確率, P(h_j | v)
+	double condProbHid(int hindex, double value);
+
+	// 可視変数を条件で与えた隠れ変数の条件付き確率, P(h_j | v)
+	double condProbHid(int hindex, double value, double mu);
+
+
+
+	//
+	//appendix methods
+	//
+
+	// 隠れ変数の取りうる値を返す
+	std::vector<double> splitHiddenSet();
+
+	// 隠れ変数の取りうるパターン数
+	int getHiddenValueSetSize();
+
+	// 隠れ変数の取りうる最大値を取得
+	double getHiddenMax();
+
+	// 隠れ変数の取りうる最大値を設定
+	void setHiddenMax(double value);
+
+	// 隠れ変数の取りうる最小値を取得
+	double getHiddenMin();
+
+	// 隠れ変数の取りうる最小値を設定
+	void setHiddenMin(double value);
+
+	// 隠れ変数の区間分割数を返す
+	size_t getHiddenDivSize();
+
+	// 隠れ変数の区間分割数を設定
+	void setHiddenDivSize(size_t div_size);
+
+	// 隠れ変数を連続値にするか離散値にするか
+	void setRealHiddenValue(bool flag);
+
+	bool isRealHiddenValue();
+};
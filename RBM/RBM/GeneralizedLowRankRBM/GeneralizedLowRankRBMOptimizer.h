@@ -0,0 +1,81 @@
+﻿#pragma once
+#include "../Optimizer.h"
+#include "../GeneralizedRBM/GeneralizedRBMOptimizer.h"
+#include "GeneralizedLowRankRBM.h"
+
+// 因子wv(vSize x rank), wh(hSize x rank)の更新はGeneralizedRBMのオプティマイザを2つ使いまわす
+// 可視側はvSize x rankのGeneralizedRBMとみなして(b, wv), 隠れ側はhSize x rankとみなして(c, wh)を更新する
+// モーメントも(vSize + hSize) * rankで済む(隠れ側の可視バイアス欄とランク分のバイアス欄は未使用)
+template <class OPTIMIZERTYPE>
+class Optimizer<GeneralizedLowRankRBM, OPTIMIZERTYPE> {
+
+protected:
+	Optimizer<GeneralizedRBM, OPTIMIZERTYPE> _visible;
+	Optimizer<GeneralizedRBM, OPTIMIZERTYPE> _hidden;
+
+public:
+	Optimizer() = default;
+	Optimizer(GeneralizedLowRankRBM & rbm);
+	~Optimizer() = default;
+	void init(GeneralizedLowRankRBM & rbm);
+	double getNewParamVBias(double gradient, int vindex);
+	double getNewParamHBias(double gradient, int hindex);
+	double getNewParamWeightVisible(double gradient, int vindex, int rindex);
+	double getNewParamWeightHidden(double gradient, int hindex, int rindex);
+	// next timestep
+	void updateOptimizer();
+	// 状態のチェックポイント(内側のオプティマイザごとに接頭辞を付ける)
+	void writeCheckpoint(rbmckpt::Writer & writer, const std::string & prefix);
+	void readCheckpoint(rbmckpt::Reader & reader, const std::string & prefix);
+};
+
+template <class OPTIMIZERTYPE>
+Optimizer<GeneralizedLowRankRBM, OPTIMIZERTYPE>::Optimizer(GeneralizedLowRankRBM & rbm) {
+	this->init(rbm);
+}
+
+template <class OPTIMIZERTYPE>
+void Optimizer<GeneralizedLowRankRBM, OPTIMIZERTYPE>::init(GeneralizedLowRankRBM & rbm) {
+	GeneralizedRBM visible_shape(rbm.getVisibleSize(), rbm.getRank());
+	GeneralizedRBM hidden_shape(rbm.getHiddenSize(), rbm.getRank());
+	this->_visible = Optimizer<GeneralizedRBM, OPTIMIZERTYPE>(visible_shape);
+	this->_hidden = Optimizer<GeneralizedRBM, OPTIMIZERTYPE>(hidden_shape);
+}
+
+template <class OPTIMIZERTYPE>
+void Optimizer<GeneralizedLowRankRBM, OPTIMIZERTYPE>::updateOptimizer() {
+	this->_visible.updateOptimizer();
+	this->_hidden.updateOptimizer();
+}
+
+template <class OPTIMIZERTYPE>
+void Optimizer<GeneralizedLowRankRBM, OPTIMIZERTYPE>::writeCheckpoint(rbmckpt::Writer & writer, const std::string & prefix) {
+	this->_visible.writeCheckpoint(writer, prefix + "visible.");
+	this->_hidden.writeCheckpoint(writer, prefix + "hidden.");
+}
+
+template <class OPTIMIZERTYPE>
+void Optimizer<GeneralizedLowRankRBM, OPTIMIZERTYPE>::readCheckpoint(rbmckpt::Reader & reader, const std::string & prefix) {
+	this->_visible.readCheckpoint(reader, prefix + "visible.");
+	this->_hidden.readCheckpoint(reader, prefix + "hidden.");
+}
+
+template <class OPTIMIZERTYPE>
+double Optimizer<GeneralizedLowRankRBM, OPTIMIZERTYPE>::getNewParamVBias(double gradient, int vindex) {
+	return this->_visible.getNewParamVBias(gradient, vindex);
+}
+
+template <class OPTIMIZERTYPE>
+double Optimizer<GeneralizedLowRankRBM, OPTIMIZERTYPE>::getNewParamHBias(double gradient, int hindex) {
+	return this->_hidden.getNewParamVBias(gradient, hindex);
+}
+
+template <class OPTIMIZERTYPE>
+double Optimizer<GeneralizedLowRankRBM, OPTIMIZERTYPE>::getNewParamWeightVisible(double gradient, int vindex, int rindex) {
+	return this->_visible.getNewParamWeight(gradient, vindex, rindex);
+}
+
+template <class OPTIMIZERTYPE>
+double Optimizer<GeneralizedLowRankRBM, OPTIMIZERTYPE>::getNewParamWeightHidden(double gradient, int hindex, int rindex) {
+	return this->_hidden.getNewParamWeight(gradient, hindex, rindex);
+}
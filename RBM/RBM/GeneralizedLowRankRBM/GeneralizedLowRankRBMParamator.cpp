@@ -0,0 +1,216 @@
+﻿#include "GeneralizedLowRankRBMParamator.h"
+#include "../Checkpoint.h"
+#include <iostream>
+#include <cmath>
+
+
+GeneralizedLowRankRBMParamator::GeneralizedLowRankRBMParamator(size_t v_size, size_t h_size, size_t rank) {
+	vSize = v_size;
+	hSize = h_size;
+	this->rank = rank;
+
+	initParams();
+}
+
+void GeneralizedLowRankRBMParamator::initParams() {
+	b.resize(vSize);
+	b.setConstant(0.0);
+	c.resize(hSize);
+	c.setConstant(0.0);
+	wv.resize(vSize, rank);
+	wv.setConstant(0.0);
+	wh.resize(hSize, rank);
+	wh.setConstant(0.0);
+}
+
+void GeneralizedLowRankRBMParamator::initParamsRandom(double range_min, double range_max) {
+
+	std::random_device rd;
+	std::mt19937 mt(rd());
+	this->initParamsRandom(range_min, range_max, mt());
+
+}
+
+void GeneralizedLowRankRBMParamator::initParamsRandom(double range_min, double range_max, int seed) {
+	b.resize(vSize);
+	c.resize(hSize);
+	wv.resize(vSize, rank);
+	wh.resize(hSize, rank);
+
+	std::mt19937 mt(seed);
+	std::uniform_real_distribution<double> dist(range_min, range_max);
+
+	for (int i = 0; i < vSize; i++) {
+		b(i) = dist(mt);
+
+		for (int k = 0; k < rank; k++) {
+			wv(i, k) = dist(mt);
+		}
+	}
+
+	for (int j = 0; j < hSize; j++) {
+		c(j) = dist(mt);
+
+		for (int k = 0; k < rank; k++) {
+			wh(j, k) = dist(mt);
+		}
+	}
+}
+
+
+void GeneralizedLowRankRBMParamator::initParamsXavier() {
+	std::random_device seed_gen;
+	std::mt19937 engine(seed_gen());
+
+	this->initParamsXavier(engine());
+}
+
+void GeneralizedLowRankRBMParamator::initParamsXavier(int seed) {
+	b.resize(vSize);
+	c.resize(hSize);
+	wv.resize(vSize, rank);
+	wh.resize(hSize, rank);
+
+	std::mt19937 mt(seed);
+	std::uniform_real_distribution<double> dist(-1.0, 1.0);
+
+	auto epsiron = 0.00001;
+
+	// W_ij = Σ_k wv_ik wh_jk の分散が密な場合(1 / vSize)と揃うように
+	auto scale = sqrt(3.0 / sqrt(static_cast<double>(vSize * rank)));
+
+	for (int i = 0; i < vSize; i++) {
+		b(i) = dist(mt) * epsiron;
+
+		for (int k = 0; k < rank; k++) {
+			wv(i, k) = dist(mt) * scale;
+		}
+	}
+
+	for (int j = 0; j < hSize; j++) {
+		c(j) = dist(mt) * epsiron;
+
+		for (int k = 0; k < rank; k++) {
+			wh(j, k) = dist(mt) * scale;
+		}
+	}
+
+}
+
+
+
+// 可視変数の総数を返す
+size_t GeneralizedLowRankRBMParamator::getVisibleSize() {
+	return vSize;
+}
+
+// 隠れ変数の総数を返す
+size_t GeneralizedLowRankRBMParamator::getHiddenSize() {
+	return hSize;
+}
+
+// カップリングのランクを返す
+size_t GeneralizedLowRankRBMParamator::getRank() {
+	return rank;
+}
+
+// 可視変数のバイアスを返す
+double GeneralizedLowRankRBMParamator::getVisibleBias(int vindex) {
+	return b(vindex);
+}
+
+// 可視変数のバイアスベクトルを返す
+Eigen::VectorXd GeneralizedLowRankRBMParamator::getVisibleBiasVector() {
+	return b;
+}
+
+// 隠れ変数のバイアスを返す
+double GeneralizedLowRankRBMParamator::getHiddenBias(int hindex) {
+	return c(hindex);
+}
+
+// 隠れ変数のバイアスベクトルを返す
+Eigen::VectorXd GeneralizedLowRankRBMParamator::getHiddenBiasVector() {
+	return c;
+}
+
+// ウェイトパラメータを返す
+double GeneralizedLowRankRBMParamator::getWeight(int vindex, int hindex) {
+	return wv.row(vindex).dot(wh.row(hindex));
+}
+
+// ウェイト行列を返す
+Eigen::MatrixXd GeneralizedLowRankRBMParamator::getWeightMatrix() {
+	return wv * wh.transpose();
+}
+
+// パラメータ情報のシリアライズ
+std::string GeneralizedLowRankRBMParamator::serialize() {
+	nlohmann::json json;
+	json["vSize"] = vSize;
+	json["hSize"] = hSize;
+	json["rank"] = rank;
+	json["params"]["b"] = std::vector<double>(this->b.data(), this->b.data() + this->b.size());
+	json["params"]["c"] = std::vector<double>(this->c.data(), this->c.data() + this->c.size());
+	json["params"]["wv"] = std::vector<double>(this->wv.data(), this->wv.data() + this->wv.size());
+	json["params"]["wh"] = std::vector<double>(this->wh.data(), this->wh.data() + this->wh.size());
+
+	return json.dump();
+}
+
+// パラメータ情報のデシリアライズ
+void GeneralizedLowRankRBMParamator::deserialize(std::string js) {
+	auto json = nlohmann::json::parse(js);
+
+	vSize = json["vSize"];
+	hSize = json["hSize"];
+	rank = json["rank"];
+	std::vector<double> tmp_b(json["params"]["b"].begin(), json["params"]["b"].end());
+	std::vector<double> tmp_c(json["params"]["c"].begin(), json["params"]["c"].end());
+	std::vector<double> tmp_wv(json["params"]["wv"].begin(), json["params"]["wv"].end());
+	std::vector<double> tmp_wh(json["params"]["wh"].begin(), json["params"]["wh"].end());
+
+	this->b = Eigen::Map<Eigen::VectorXd>(tmp_b.data(), vSize);
+	this->c = Eigen::Map<Eigen::VectorXd>(tmp_c.data(), hSize);
+	this->wv = Eigen::Map<Eigen::MatrixXd>(tmp_wv.data(), vSize, rank);
+	this->wh = Eigen::Map<Eigen::MatrixXd>(tmp_wh.data(), hSize, rank);
+}
+
+// チェックポイントに登録
+void GeneralizedLowRankRBMParamator::writeCheckpoint(rbmckpt::Writer & writer) {
+	writer.setModelType("GeneralizedLowRankRBM");
+	writer.add("b", this->b);
+	writer.add("c", this->c);
+	writer.add("wv", this->wv);
+	writer.add("wh", this->wh);
+}
+
+// チェックポイントから復元
+void GeneralizedLowRankRBMParamator::readCheckpoint(rbmckpt::Reader & reader) {
+	if (reader.modelType() != "GeneralizedLowRankRBM") throw std::runtime_error("GeneralizedLowRankRBMParamator: model type mismatch " + reader.modelType());
+	auto ckpt_b = reader.vector("b");
+	auto ckpt_c = reader.vector("c");
+	auto ckpt_wv = reader.matrix("wv");
+	auto ckpt_wh = reader.matrix("wh");
+	if (ckpt_b.size() != vSize || ckpt_c.size() != hSize || ckpt_wv.rows() != vSize || ckpt_wv.cols() != rank || ckpt_wh.rows() != hSize || ckpt_wh.cols() != rank) throw std::runtime_error("GeneralizedLowRankRBMParamator: shape mismatch");
+
+	this->b = ckpt_b;
+	this->c = ckpt_c;
+	this->wv = ckpt_wv;
+	this->wh = ckpt_wh;
+}
+
+void GeneralizedLowRankRBMParamator::printParams()
+{
+	std::cout << "--- b ---" << std::endl;
+	std::cout << this->b << std::endl;
+
+	std::cout << "--- c ---" << std::endl;
+	std::cout << this->c << std::endl;
+
+	std::cout << "--- wv ---" << std::endl;
+	std::cout << this->wv << std::endl;
+
+	std::cout << "--- wh ---" << std::endl;
+	std::cout << this->wh << std::endl;
+}
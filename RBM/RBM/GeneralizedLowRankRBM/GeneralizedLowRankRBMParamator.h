@@ -0,0 +1,83 @@
+﻿#pragma once
+#include <random>
+#include "../RBMParamatorBase.h"
+#include "Eigen/Core"
+#include "json.hpp"
+
+// 可視変数-隠れ変数間のカップリングを W = wv * wh^T (ランクrank)で持つ
+// 保持するのは(vSize + hSize) * rank要素だけで, vSize * hSizeの行列は作らない
+namespace rbmckpt {
+	class Writer;
+	class Reader;
+}
+
+class GeneralizedLowRankRBMParamator : RBMParamatorBase {
+private:
+	size_t vSize;
+	size_t hSize;
+	size_t rank;
+public:
+	Eigen::VectorXd b;  // 可視変数のバイアス
+	Eigen::VectorXd c;  // 隠れ変数のバイアス
+	Eigen::MatrixXd wv;  // カップリングの可視変数側の因子(vSize x rank)
+	Eigen::MatrixXd wh;  // カップリングの隠れ変数側の因子(hSize x rank)
+
+
+public:
+	GeneralizedLowRankRBMParamator() = default;
+	GeneralizedLowRankRBMParamator(size_t vsize, size_t hsize, size_t rank);
+	~GeneralizedLowRankRBMParamator() = default;
+
+	// 可視変数の総数を返す
+	size_t getVisibleSize();
+
+	// 隠れ変数の総数を返す
+	size_t getHiddenSize();
+
+	// カップリングのランクを返す
+	size_t getRank();
+
+	// 可視変数のバイアスを返す
+	double getVisibleBias(int vindex);
+
+	// 可視変数のバイアスベクトルを返す
+	Eigen::VectorXd getVisibleBiasVector();
+
+	// 隠れ変数のバイアスを返す
+	double getHiddenBias(int hindex);
+
+	// 隠れ変数のバイアスベクトルを返す
+	Eigen::VectorXd getHiddenBiasVector();
+
+	// ウェイトパラメータを返す(wvのi行とwhのj行の内積)
+	double getWeight(int vindex, int hindex);
+
+	// ウェイト行列を返す(vSize x hSizeの行列を作るので, 出力・比較用)
+	Eigen::MatrixXd getWeightMatrix();
+
+	// 全てのパラメータを0で初期化
+	void initParams();
+
+	// 全てのパラメータを[min, max]の一様乱数で初期化
+	void initParamsRandom(double range_min, double range_max);
+	void initParamsRandom(double range_min, double range_max, int seed);
+
+	// Xavier Initialization(積wv wh^Tの分散が密な場合と揃うように)
+	void initParamsXavier();
+	void initParamsXavier(int seed);
+
+	// パラメータ情報のシリアライズ
+	std::string serialize();
+
+	// パラメータ情報のデシリアライズ
+	void deserialize(std::string js);
+
+	// チェックポイントに登録(配列はコピーしない)
+	void writeCheckpoint(rbmckpt::Writer & writer);
+
+	// チェックポイントから復元(同じ形であること)
+	void readCheckpoint(rbmckpt::Reader & reader);
+
+	// パラメータ出力
+	void printParams();
+};
@@ -0,0 +1,96 @@
+﻿#pragma once
+#include "../Sampler.h"
+#include "GeneralizedLowRankRBM.h"
+#include "Eigen/Core"
+#include <vector>
+#include <random>
+#include <cmath>
+
+template<>
+class Sampler<GeneralizedLowRankRBM> {
+public:
+	std::mt19937 randEngine = std::mt19937();
+public:
+	Sampler();
+	Sampler(const std::mt19937 & rand_engine);
+	~Sampler() = default;
+
+	// 可視変数一つをギブスサンプリング(lambdaを与える)
+	double gibbsSamplingVisible(GeneralizedLowRankRBM & rbm, int vindex, double lambda);
+
+	// 隠れ変数一つをギブスサンプリング(muを与える)
+	double gibbsSamplingHidden(GeneralizedLowRankRBM & rbm, int hindex, double mu);
+
+	// 可視層すべてをギブスサンプリングで更新(lambdaは因子経由で一括計算)
+	Eigen::VectorXd & updateByBlockedGibbsSamplingVisible(GeneralizedLowRankRBM & rbm);
+
+	// 隠れ層すべてをギブスサンプリングで更新(muは因子経由で一括計算)
+	Eigen::VectorXd & updateByBlockedGibbsSamplingHidden(GeneralizedLowRankRBM & rbm);
+};
+
+
+inline Sampler<GeneralizedLowRankRBM>::Sampler() {
+	std::random_device rd;
+	this->randEngine = std::mt19937(rd());
+}
+
+// 乱数エンジンを与える(random_deviceを開かない)
+inline Sampler<GeneralizedLowRankRBM>::Sampler(const std::mt19937 & rand_engine) : randEngine(rand_engine) {
+}
+
+inline double Sampler<GeneralizedLowRankRBM>::gibbsSamplingVisible(GeneralizedLowRankRBM & rbm, int vindex, double lambda) {
+	std::uniform_real_distribution<double> dist(0.0, 1.0);
+
+	auto low = rbm.visibleValueSet[0];
+	auto high = rbm.visibleValueSet[1];
+	double value = dist(this->randEngine) < rbm.condProbVis(vindex, low, lambda) ? low : high;
+
+	return value;
+}
+
+inline double Sampler<GeneralizedLowRankRBM>::gibbsSamplingHidden(GeneralizedLowRankRBM & rbm, int hindex, double mu) {
+	std::uniform_real_distribution<double> dist(0.0, 1.0);
+	auto u = dist(this->randEngine);
+
+	// 連続型は逆関数法で
+	if (rbm.isRealHiddenValue()) {
+		auto h_max = rbm.getHiddenMax();
+		auto h_min = rbm.getHiddenMin();
+		auto z_j = (exp(h_max * mu) - exp(h_min * mu)) / mu;
+
+		return log(z_j * u * mu + exp(h_min * mu)) / mu;
+	}
+
+	// 離散型: 累積がu * Σ exp(mu h)を超えた値
+	auto & hidset = rbm.hiddenValueSet;
+	auto threshold = u * rbm.miniNormalizeConstantHidden(hindex, mu);
+	double cumulative = 0.0;
+	for (int k = 0; k < hidset.size() - 1; k++) {
+		cumulative += exp(mu * hidset[k]);
+		if (threshold < cumulative) return hidset[k];
+	}
+
+	return hidset.back();
+}
+
+inline Eigen::VectorXd & Sampler<GeneralizedLowRankRBM>::updateByBlockedGibbsSamplingVisible(GeneralizedLowRankRBM & rbm) {
+	RBM_PROFILE_COUNT(Sweeps, 1);
+
+	auto lambda_vect = rbm.lambdaVect();
+	for (int i = 0; i < rbm.getVisibleSize(); i++) {
+		rbm.nodes.v(i) = gibbsSamplingVisible(rbm, i, lambda_vect(i));
+	}
+
+	return rbm.nodes.v;
+}
+
+inline Eigen::VectorXd & Sampler<GeneralizedLowRankRBM>::updateByBlockedGibbsSamplingHidden(GeneralizedLowRankRBM & rbm) {
+	RBM_PROFILE_COUNT(Sweeps, 1);
+
+	auto mu_vect = rbm.muVect();
+	for (int j = 0; j < rbm.getHiddenSize(); j++) {
+		rbm.nodes.h(j) = gibbsSamplingHidden(rbm, j, mu_vect(j));
+	}
+
+	return rbm.nodes.h;
+}
@@ -0,0 +1,410 @@
+﻿#pragma once
+#include "Eigen/Core"
+#include "../Trainer.h"
+#include "../Checkpoint.h"
+#include "GeneralizedLowRankRBM.h"
+#include "GeneralizedLowRankRBMSampler.h"
+#include "GeneralizedLowRankRBMOptimizer.h"
+#include <vector>
+#include <numeric>
+#include <algorithm>
+#include <random>
+#include <stdexcept>
+#include <omp.h>
+
+// 勾配は<v h^T>(vSize x hSize)を作らず, 因子に射影した形で集計する
+// dL/dwv = (<v h^T>_data - <v h^T>_model) wh, dL/dwh = (<v h^T>_data - <v h^T>_model)^T wv
+template<class OPTIMIZERTYPE>
+class Trainer<GeneralizedLowRankRBM, OPTIMIZERTYPE> {
+	struct Moments {
+		double scale = 0.0;  // 重みの総和
+		Eigen::VectorXd vBias;
+		Eigen::VectorXd hBias;
+		Eigen::MatrixXd weightVisible;  // <v (wh^T h)^T>
+		Eigen::MatrixXd weightHidden;  // <h (wv^T v)^T>
+
+		void init(GeneralizedLowRankRBM & rbm) {
+			vBias.setZero(rbm.getVisibleSize());
+			hBias.setZero(rbm.getHiddenSize());
+			weightVisible.setZero(rbm.getVisibleSize(), rbm.getRank());
+			weightHidden.setZero(rbm.getHiddenSize(), rbm.getRank());
+			scale = 0.0;
+		}
+
+		// v_proj = wv^T v, h_proj = wh^T hを渡す
+		void add(const Eigen::VectorXd & v, const Eigen::VectorXd & h, const Eigen::VectorXd & v_proj, const Eigen::VectorXd & h_proj, double weight) {
+			scale += weight;
+			vBias += weight * v;
+			hBias += weight * h;
+			weightVisible.noalias() += (weight * v) * h_proj.transpose();
+			weightHidden.noalias() += (weight * h) * v_proj.transpose();
+		}
+
+		void merge(const Moments & other) {
+			scale += other.scale;
+			vBias += other.vBias;
+			hBias += other.hBias;
+			weightVisible += other.weightVisible;
+			weightHidden += other.weightHidden;
+		}
+
+		void normalize() {
+			vBias /= scale;
+			hBias /= scale;
+			weightVisible /= scale;
+			weightHidden /= scale;
+		}
+	};
+
+private:
+	Moments gradient;
+	Moments dataMean;
+	Moments rbmexpected;
+	Optimizer<GeneralizedLowRankRBM, OPTIMIZERTYPE> optimizer;
+	int _trainCount = 0;
+
+
+public:
+	int epoch = 0;
+	int batchSize = 1;
+	int cdk = 0;
+	double learningRate = 0.01;
+	std::mt19937 randDevice = std::mt19937(std::random_device()());
+
+public:
+	Trainer() = default;
+	Trainer(GeneralizedLowRankRBM & rbm);
+	~Trainer() = default;
+
+	// 学習
+	void trainCD(GeneralizedLowRankRBM & rbm, std::vector<std::vector<double>> & dataset);
+	void trainExact(GeneralizedLowRankRBM & rbm, std::vector<std::vector<double>> & dataset);
+
+	// 1回だけ学習
+	void trainOnceCD(GeneralizedLowRankRBM & rbm, std::vector<std::vector<double>> & dataset);
+	void trainOnceExact(GeneralizedLowRankRBM & rbm, std::vector<std::vector<double>> & dataset);
+
+	// データ平均の計算
+	void calcDataMean(GeneralizedLowRankRBM & rbm, std::vector<std::vector<double>> & dataset, std::vector<int> & data_indexes);
+
+	// サンプル平均の計算
+	void calcRBMExpectedCD(GeneralizedLowRankRBM & rbm, std::vector<std::vector<double>> & dataset, std::vector<int> & data_indexes);
+
+	// サンプル平均の計算(全状態の厳密計算)
+	void calcRBMExpectedExact(GeneralizedLowRankRBM & rbm);
+
+	// 勾配の計算
+	void calcGradient(GeneralizedLowRankRBM & rbm);
+
+	// 勾配更新
+	void updateParams(GeneralizedLowRankRBM & rbm);
+
+	// 対数尤度関数
+	double logLikeliHood(GeneralizedLowRankRBM & rbm, std::vector<std::vector<double>> & dataset);
+
+	// 学習状態(反復回数, オプティマイザのモーメント, 乱数, チェイン)のチェックポイント
+	// モデルと合わせてrbmckpt::saveTraining/loadTrainingから使う
+	void writeCheckpoint(rbmckpt::Writer & writer, GeneralizedLowRankRBM & rbm);
+	void readCheckpoint(rbmckpt::Reader & reader, GeneralizedLowRankRBM & rbm);
+
+private:
+	// ミニバッチのインデックス集合
+	std::vector<int> minibatchIndexes(size_t data_size);
+};
+
+template<class OPTIMIZERTYPE>
+Trainer<GeneralizedLowRankRBM, OPTIMIZERTYPE>::Trainer(GeneralizedLowRankRBM & rbm) {
+	this->optimizer = Optimizer<GeneralizedLowRankRBM, OPTIMIZERTYPE>(rbm);
+	gradient.init(rbm);
+	dataMean.init(rbm);
+	rbmexpected.init(rbm);
+}
+
+template<class OPTIMIZERTYPE>
+void Trainer<GeneralizedLowRankRBM, OPTIMIZERTYPE>::trainCD(GeneralizedLowRankRBM & rbm, std::vector<std::vector<double>> & dataset) {
+	for (int e = 0; e < epoch; e++) {
+		trainOnceCD(rbm, dataset);
+	}
+}
+
+template<class OPTIMIZERTYPE>
+void Trainer<GeneralizedLowRankRBM, OPTIMIZERTYPE>::trainExact(GeneralizedLowRankRBM & rbm, std::vector<std::vector<double>> & dataset) {
+	for (int e = 0; e < epoch; e++) {
+		trainOnceExact(rbm, dataset);
+	}
+}
+
+template<class OPTIMIZERTYPE>
+std::vector<int> Trainer<GeneralizedLowRankRBM, OPTIMIZERTYPE>::minibatchIndexes(size_t data_size) {
+	// ミニバッチ学習のためにデータインデックスをシャッフルする
+	std::vector<int> data_indexes(data_size);
+	std::iota(data_indexes.begin(), data_indexes.end(), 0);
+	std::shuffle(data_indexes.begin(), data_indexes.end(), this->randDevice);
+
+	// バッチサイズの確認
+	size_t batch_size = std::min<size_t>(std::max(this->batchSize, 1), data_size);
+	data_indexes.resize(batch_size);
+
+	return data_indexes;
+}
+
+template<class OPTIMIZERTYPE>
+void Trainer<GeneralizedLowRankRBM, OPTIMIZERTYPE>::trainOnceCD(GeneralizedLowRankRBM & rbm, std::vector<std::vector<double>> & dataset) {
+	RBM_PROFILE_SCOPE("trainOnceCD");
+
+	rbm.trainType = "cd";
+
+	auto minibatch_indexes = minibatchIndexes(dataset.size());
+
+	// Contrastive Divergence
+	calcDataMean(rbm, dataset, minibatch_indexes);
+	calcRBMExpectedCD(rbm, dataset, minibatch_indexes);
+	calcGradient(rbm);
+
+	// 勾配の更新
+	updateParams(rbm);
+
+	// オプティマイザの更新
+	optimizer.updateOptimizer();
+
+	// Trainer情報更新
+	RBM_PROFILE_EPOCH(_trainCount);
+	_trainCount++;
+}
+
+template<class OPTIMIZERTYPE>
+void Trainer<GeneralizedLowRankRBM, OPTIMIZERTYPE>::trainOnceExact(GeneralizedLowRankRBM & rbm, std::vector<std::vector<double>> & dataset) {
+	RBM_PROFILE_SCOPE("trainOnceExact");
+
+	rbm.trainType = "exact";
+
+	auto minibatch_indexes = minibatchIndexes(dataset.size());
+
+	calcDataMean(rbm, dataset, minibatch_indexes);
+	calcRBMExpectedExact(rbm);
+	calcGradient(rbm);
+
+	// 勾配の更新
+	updateParams(rbm);
+
+	// オプティマイザの更新
+	optimizer.updateOptimizer();
+
+	// Trainer情報更新
+	RBM_PROFILE_EPOCH(_trainCount);
+	_trainCount++;
+}
+
+template<class OPTIMIZERTYPE>
+void Trainer<GeneralizedLowRankRBM, OPTIMIZERTYPE>::calcDataMean(GeneralizedLowRankRBM & rbm, std::vector<std::vector<double>> & dataset, std::vector<int> & data_indexes) {
+	RBM_PROFILE_SCOPE("calcDataMean");
+
+	dataMean.init(rbm);
+
+	auto & wv = rbm.params.wv;
+	auto & wh = rbm.params.wh;
+	auto index_size = data_indexes.size();
+
+#pragma omp parallel
+	{
+		Moments local;
+		local.init(rbm);
+		Eigen::VectorXd v, h(rbm.getHiddenSize()), v_proj, h_proj, mu_vect;
+
+#pragma omp for schedule(static)
+		for (int n = 0; n < index_size; n++) {
+			auto & data = dataset[data_indexes[n]];
+			v = Eigen::Map<Eigen::VectorXd>(data.data(), data.size());
+
+			// mu = c + wh (wv^T v)
+			v_proj.noalias() = wv.transpose() * v;
+			mu_vect = rbm.params.c;
+			mu_vect.noalias() += wh * v_proj;
+			for (int j = 0; j < rbm.getHiddenSize(); j++) {
+				h(j) = rbm.actHidJ(j, mu_vect(j));
+			}
+			h_proj.noalias() = wh.transpose() * h;
+
+			local.add(v, h, v_proj, h_proj, 1.0);
+		}
+
+#pragma omp critical
+		dataMean.merge(local);
+	}
+
+	dataMean.normalize();
+}
+
+template<class OPTIMIZERTYPE>
+void Trainer<GeneralizedLowRankRBM, OPTIMIZERTYPE>::calcRBMExpectedCD(GeneralizedLowRankRBM & rbm, std::vector<std::vector<double>> & dataset, std::vector<int> & data_indexes) {
+	RBM_PROFILE_SCOPE("calcRBMExpectedCD");
+
+	rbmexpected.init(rbm);
+
+	auto & wv = rbm.params.wv;
+	auto & wh = rbm.params.wh;
+	auto index_size = data_indexes.size();
+
+	// レプリカごとに乱数列をずらす
+	std::vector<std::mt19937::result_type> seeds(index_size);
+	for (auto & seed : seeds) seed = this->randDevice();
+
+#pragma omp parallel
+	{
+		Moments local;
+		local.init(rbm);
+		auto rbm_replica = rbm;
+		Eigen::VectorXd v_proj, h_proj;
+
+#pragma omp for schedule(static)
+		for (int n = 0; n < index_size; n++) {
+			auto & data = dataset[data_indexes[n]];
+			rbm_replica.nodes.v = Eigen::Map<Eigen::VectorXd>(data.data(), data.size());
+
+			auto mu_vect = rbm_replica.muVect();
+			for (int j = 0; j < rbm_replica.getHiddenSize(); j++) {
+				rbm_replica.nodes.h(j) = rbm_replica.actHidJ(j, mu_vect(j));
+			}
+
+			// CD-K
+			Sampler<GeneralizedLowRankRBM> sampler(std::mt19937(seeds[n]));
+			for (int k = 0; k < cdk; k++) {
+				sampler.updateByBlockedGibbsSamplingVisible(rbm_replica);
+				sampler.updateByBlockedGibbsSamplingHidden(rbm_replica);
+			}
+
+			v_proj.noalias() = wv.transpose() * rbm_replica.nodes.v;
+			h_proj.noalias() = wh.transpose() * rbm_replica.nodes.h;
+			local.add(rbm_replica.nodes.v, rbm_replica.nodes.h, v_proj, h_proj, 1.0);
+		}
+
+#pragma omp critical
+		rbmexpected.merge(local);
+	}
+
+	rbmexpected.normalize();
+}
+
+template<class OPTIMIZERTYPE>
+void Trainer<GeneralizedLowRankRBM, OPTIMIZERTYPE>::calcRBMExpectedExact(GeneralizedLowRankRBM & rbm) {
+	RBM_PROFILE_SCOPE("calcRBMExpectedExact");
+
+	rbmexpected.init(rbm);
+
+	auto v_size = rbm.getVisibleSize();
+	if (v_size >= 8 * sizeof(long long) - 1) throw std::runtime_error("calcRBMExpectedExact: too many visible units");
+
+	auto & wv = rbm.params.wv;
+	auto & wh = rbm.params.wh;
+	auto & v_state_map = rbm.visibleValueSet;
+	long long max_count = 1LL << v_size;
+
+	// 各可視状態の重み exp(b^T v) Π_j Σ_h exp(mu_j h), 隠れ変数は期待値で周辺化
+#pragma omp parallel
+	{
+		Moments local;
+		local.init(rbm);
+		Eigen::VectorXd v(v_size), h(rbm.getHiddenSize()), v_proj, h_proj, mu_vect;
+
+#pragma omp for schedule(static)
+		for (long long c = 0; c < max_count; c++) {
+			for (int i = 0; i < v_size; i++) {
+				v(i) = v_state_map[(c >> i) & 1];
+			}
+
+			v_proj.noalias() = wv.transpose() * v;
+			mu_vect = rbm.params.c;
+			mu_vect.noalias() += wh * v_proj;
+
+			double weight = exp(v.dot(rbm.params.b));
+			for (int j = 0; j < rbm.getHiddenSize(); j++) {
+				weight *= rbm.miniNormalizeConstantHidden(j, mu_vect(j));
+				h(j) = rbm.actHidJ(j, mu_vect(j));
+			}
+			h_proj.noalias() = wh.transpose() * h;
+
+			local.add(v, h, v_proj, h_proj, weight);
+		}
+
+#pragma omp critical
+		rbmexpected.merge(local);
+	}
+
+	// 重みの総和が分配関数
+	rbmexpected.normalize();
+}
+
+
+// 勾配の計算
+template<class OPTIMIZERTYPE>
+void Trainer<GeneralizedLowRankRBM, OPTIMIZERTYPE>::calcGradient(GeneralizedLowRankRBM & rbm) {
+	RBM_PROFILE_SCOPE("calcGradient");
+
+	gradient.vBias = dataMean.vBias - rbmexpected.vBias;
+	gradient.hBias = dataMean.hBias - rbmexpected.hBias;
+	gradient.weightVisible = dataMean.weightVisible - rbmexpected.weightVisible;
+	gradient.weightHidden = dataMean.weightHidden - rbmexpected.weightHidden;
+}
+
+
+// パラメータの更新
+template<class OPTIMIZERTYPE>
+void Trainer<GeneralizedLowRankRBM, OPTIMIZERTYPE>::updateParams(GeneralizedLowRankRBM & rbm) {
+	RBM_PROFILE_SCOPE("updateParams");
+
+	for (int i = 0; i < rbm.getVisibleSize(); i++) {
+		rbm.params.b(i) += optimizer.getNewParamVBias(gradient.vBias(i), i);
+
+		for (int k = 0; k < rbm.getRank(); k++) {
+			rbm.params.wv(i, k) += optimizer.getNewParamWeightVisible(gradient.weightVisible(i, k), i, k);
+		}
+	}
+
+	for (int j = 0; j < rbm.getHiddenSize(); j++) {
+		rbm.params.c(j) += optimizer.getNewParamHBias(gradient.hBias(j), j);
+
+		for (int k = 0; k < rbm.getRank(); k++) {
+			rbm.params.wh(j, k) += optimizer.getNewParamWeightHidden(gradient.weightHidden(j, k), j, k);
+		}
+	}
+}
+
+
+// 対数尤度関数
+template<class OPTIMIZERTYPE>
+double Trainer<GeneralizedLowRankRBM, OPTIMIZERTYPE>::logLikeliHood(GeneralizedLowRankRBM & rbm, std::vector<std::vector<double>> & dataset) {
+	RBM_PROFILE_SCOPE("logLikeliHood");
+
+	double value = 0.0;
+
+	auto z = rbm.getNormalConstant();
+
+	for (auto & data : dataset) {
+		auto prob = rbm.probVis(data, z);
+		value += log(prob);
+	}
+
+	return value;
+}
+
+template<class OPTIMIZERTYPE>
+void Trainer<GeneralizedLowRankRBM, OPTIMIZERTYPE>::writeCheckpoint(rbmckpt::Writer & writer, GeneralizedLowRankRBM & rbm) {
+	writer.addScalar("trainer.trainCount", _trainCount);
+	writer.addScalar("trainer.epoch", epoch);
+	writer.addScalar("trainer.batchSize", batchSize);
+	writer.addScalar("trainer.cdk", cdk);
+	writer.addScalar("trainer.learningRate", learningRate);
+	rbmckpt::addEngine(writer, "trainer.rand", this->randDevice);
+	this->optimizer.writeCheckpoint(writer, "optimizer.");
+}
+
+template<class OPTIMIZERTYPE>
+void Trainer<GeneralizedLowRankRBM, OPTIMIZERTYPE>::readCheckpoint(rbmckpt::Reader & reader, GeneralizedLowRankRBM & rbm) {
+	_trainCount = static_cast<int>(reader.scalar("trainer.trainCount"));
+	epoch = static_cast<int>(reader.scalar("trainer.epoch"));
+	batchSize = static_cast<int>(reader.scalar("trainer.batchSize"));
+	cdk = static_cast<int>(reader.scalar("trainer.cdk"));
+	learningRate = reader.scalar("trainer.learningRate");
+	rbmckpt::readEngine(reader, "trainer.rand", this->randDevice);
+	this->optimizer.readCheckpoint(reader, "optimizer.");
+}
@@ -1,4 +1,6 @@
 ﻿#include "GeneralizedRBM.h"
+#include <cmath>
+#include "../Profiler.h"
 
 
 GeneralizedRBM::GeneralizedRBM(size_t v_size, size_t h_size) {
@@ -30,11 +32,15 @@ size_t GeneralizedRBM::getHiddenSize() {
 
 // 規格化を返します
 double GeneralizedRBM::getNormalConstant() {
+	RBM_PROFILE_SCOPE("getNormalConstant");
+
 	StateCounter<std::vector<int>> sc(std::vector<int>(vSize, 2));  // 可視変数Vの状態カウンター
 	auto & v_state_map = this->visibleValueSet;  // 可視変数の状態->値変換写像
 
 	double z = 0.0;
 	auto max_count = sc.getMaxCount();
+	RBM_PROFILE_COUNT(StatesEnumerated, max_count);
+	RBM_PROFILE_COUNT(ExpEvaluations, max_count * (1 + hSize * (realFlag ? 2 : hiddenValueSet.size())));
 	for (int c = 0; c < max_count; c++, sc++) {
 		// FIXME: stlのコピーは遅いぞ
 		auto v_state = sc.getState();
@@ -80,8 +86,21 @@ double GeneralizedRBM::getNormalConstant() {
 
 // エネルギー関数を返します
 double GeneralizedRBM::getEnergy() {
-	// まだ必要ないため実装保留
-	throw;
+	Eigen::MatrixXd v_batch = nodes.v.transpose();
+	Eigen::MatrixXd h_batch = nodes.h.transpose();
+	return this->getEnergyBatch(v_batch, h_batch)(0);
+}
+
+// エネルギー関数を一括計算します
+// E(v, h) = -b^T v - mu(v)^T h を行列積でまとめて計算
+Eigen::VectorXd GeneralizedRBM::getEnergyBatch(const Eigen::MatrixXd & v_batch, const Eigen::MatrixXd & h_batch) {
+	// 各行の隠れ変数に関する外部磁場と相互作用, mu = c + W^T v
+	Eigen::MatrixXd mu_batch = v_batch * params.w;
+	mu_batch.rowwise() += params.c.transpose();
+
+	Eigen::VectorXd energy = -(v_batch * params.b) - mu_batch.cwiseProduct(h_batch).rowwise().sum();
+
+	return energy;
 }
 
 
@@ -104,7 +123,7 @@ double GeneralizedRBM::actHidJ(int hindex, double mu)
 	// 離散型
 	auto discrete = [&]()
 	{
-		auto value_set = splitHiddenSet();
+		auto & value_set = hiddenValueSet;
 		auto mu_j = mu;
 		double numer = 0.0;  // 分子
 		double denom = miniNormalizeConstantHidden(hindex, mu_j);  // 分母
@@ -469,7 +488,7 @@ double GeneralizedRBM::expectedValueVis(int vindex, double normalize_constant) {
 		value += term;
 
 		// debug
-		if (isinf(value) || isnan(value)) {
+		if (std::isinf(value) || std::isnan(value)) {
 			volatile auto debug_value = value;
 			throw;
 		}
@@ -579,7 +598,7 @@ double GeneralizedRBM::expectedValueHid(int hindex, double normalize_constant) {
 	}
 
 	// debug
-	if (isinf(value) || isnan(value)) {
+	if (std::isinf(value) || std::isnan(value)) {
 		volatile auto debug_value = value;
 		throw;
 	}
@@ -688,7 +707,7 @@ double GeneralizedRBM::expectedValueVisHid(int vindex, int hindex, double normal
 	}
 
 	// debug
-	if (isinf(value) || isnan(value)) {
+	if (std::isinf(value) || std::isnan(value)) {
 		volatile auto debug_value = value;
 		throw;
 	}
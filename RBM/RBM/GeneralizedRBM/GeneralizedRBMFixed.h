@@ -0,0 +1,425 @@
+﻿#pragma once
+#include "GeneralizedRBM.h"
+#include "../Profiler.h"
+#include "../Checkpoint.h"
+#include "Eigen/Core"
+#include <array>
+#include <vector>
+#include <string>
+#include <cmath>
+#include <stdexcept>
+#include <type_traits>
+
+// 可視変数V個, 隠れ変数H個に固定したGeneralizedRBM(小さいモデル用)
+// パラメータとノードは固定長(スタック上)で, 内積や行列ベクトル積はEigenが展開する
+// 隠れ変数の値は等間隔なので, 値の総和はexp(mu h_min)と公比exp(mu Δh)の漸化式で求める(expは2回)
+// 学習前後はGeneralizedRBMとの間でパラメータを写す
+template <int V, int H>
+class FixedGeneralizedRBM {
+public:
+	// 固定長でもアライメントを要求しない(std::vectorやmake_sharedにそのまま載せるため)
+	typedef Eigen::Matrix<double, V, 1, Eigen::DontAlign> VisibleVector;
+	typedef Eigen::Matrix<double, H, 1, Eigen::DontAlign> HiddenVector;
+	typedef Eigen::Matrix<double, V, H, Eigen::DontAlign> WeightMatrix;
+
+	static const int VISIBLE_SIZE = V;
+	static const int HIDDEN_SIZE = H;
+
+	struct Paramator {
+		VisibleVector b;
+		HiddenVector c;
+		WeightMatrix w;
+
+		// GeneralizedRBMと同じ形式で登録(GeneralizedRBMとしても読み込める)
+		void writeCheckpoint(rbmckpt::Writer & writer) {
+			writer.setModelType("GeneralizedRBM");
+			writer.add("b", b.data(), V, 1);
+			writer.add("c", c.data(), H, 1);
+			writer.add("w", w.data(), V, H);
+		}
+
+		void readCheckpoint(rbmckpt::Reader & reader) {
+			if (reader.modelType() != "GeneralizedRBM") throw std::runtime_error("FixedGeneralizedRBM: model type mismatch " + reader.modelType());
+			auto ckpt_b = reader.vector("b");
+			auto ckpt_c = reader.vector("c");
+			auto ckpt_w = reader.matrix("w");
+			if (ckpt_b.size() != V || ckpt_c.size() != H || ckpt_w.rows() != V || ckpt_w.cols() != H) throw std::runtime_error("FixedGeneralizedRBM: shape mismatch");
+
+			b = ckpt_b;
+			c = ckpt_c;
+			w = ckpt_w;
+		}
+	};
+
+	struct Node {
+		VisibleVector v;
+		HiddenVector h;
+	};
+
+protected:
+	double hMin = 0.0;
+	double hMax = 1.0;
+	size_t divSize = 1;  // 隠れ変数の区間分割数
+	bool realFlag = false;
+
+public:
+	Paramator params;
+	Node nodes;
+	std::string trainType = "";
+
+	std::array<double, 2> visibleValueSet = { { -1.0, 1.0 } };
+
+public:
+	FixedGeneralizedRBM();
+	FixedGeneralizedRBM(GeneralizedRBM & rbm);
+	~FixedGeneralizedRBM() = default;
+
+	// GeneralizedRBMから写す(サイズが違えば例外)
+	void copyFrom(GeneralizedRBM & rbm);
+
+	// GeneralizedRBMへ書き戻す
+	void copyTo(GeneralizedRBM & rbm);
+
+	// 可視変数の数を返す
+	size_t getVisibleSize();
+
+	// 隠れ変数の数を返す
+	size_t getHiddenSize();
+
+	// 可視層を状態番号のビット列で設定(ビットiが1なら上側の値)
+	void setVisibleState(unsigned long long state);
+
+	// 規格化を返します
+	double getNormalConstant();
+
+	// 隠れ変数の活性化関数的なもの
+	double actHidJ(int hindex);
+
+	// 隠れ変数の活性化関数的なもの
+	double actHidJ(int hindex, double mu);
+
+	// 可視変数に関する外部磁場と相互作用
+	double lambda(int vindex);
+
+	// 可視変数に関する外部磁場と相互作用(一括計算)
+	VisibleVector lambdaVect();
+
+	// 隠れ変数に関する外部磁場と相互作用
+	double mu(int hindex);
+
+	// 隠れ変数に関する外部磁場と相互作用(一括計算)
+	HiddenVector muVect();
+
+	// Π_j Σ_h exp(mu_j h)
+	double sumHExpMu(const HiddenVector & mu_vect);
+
+	// exp(mu)の隠れ変数に関する全ての実現値の総和
+	double miniNormalizeConstantHidden(int hindex, double mu);
+
+	// 隠れ変数の総和Σ exp(mu h)と期待値を同時に求める
+	void hiddenMoments(double mu, double & sum, double & expected);
+
+	// 可視変数の確率(隠れ変数周辺化済み)
+	double probVis(std::vector<double> & data);
+
+	// 可視変数の確率(隠れ変数周辺化済み, 分配関数使いまわし)
+	double probVis(std::vector<double> & data, double normalize_constant);
+
+	// 隠れ変数を条件で与えた可視変数の条件付き確率, P(v_i | h)
+	double condProbVis(int vindex, double value);
+
+	// 隠れ変数を条件で与えた可視変数の条件付き確率, P(v_i | h)
+	double condProbVis(int vindex, double value, double lambda);
+
+	// 可視変数を条件で与えた隠れ変数の条件付き確率, P(h_j | v)
+	double condProbHid(int hindex, double value, double mu);
+
+	// 隠れ変数の取りうる最大値を取得
+	double getHiddenMax();
+
+	// 隠れ変数の取りうる最小値を取得
+	double getHiddenMin();
+
+	// 隠れ変数の区間分割数を返す
+	size_t getHiddenDivSize();
+
+	bool isRealHiddenValue();
+};
+
+
+template <int V, int H>
+FixedGeneralizedRBM<V, H>::FixedGeneralizedRBM() {
+	params.b.setZero();
+	params.c.setZero();
+	params.w.setZero();
+	nodes.v.setZero();
+	nodes.h.setZero();
+}
+
+template <int V, int H>
+FixedGeneralizedRBM<V, H>::FixedGeneralizedRBM(GeneralizedRBM & rbm) : FixedGeneralizedRBM() {
+	copyFrom(rbm);
+}
+
+template <int V, int H>
+void FixedGeneralizedRBM<V, H>::copyFrom(GeneralizedRBM & rbm) {
+	if (rbm.getVisibleSize() != V || rbm.getHiddenSize() != H) throw std::runtime_error("FixedGeneralizedRBM: size mismatch");
+	if (rbm.visibleValueSet.size() != 2) throw std::runtime_error("FixedGeneralizedRBM: visible units must be binary");
+
+	params.b = rbm.params.b;
+	params.c = rbm.params.c;
+	params.w = rbm.params.w;
+	nodes.v = rbm.nodes.v;
+	nodes.h = rbm.nodes.h;
+	trainType = rbm.trainType;
+	visibleValueSet[0] = rbm.visibleValueSet[0];
+	visibleValueSet[1] = rbm.visibleValueSet[1];
+	hMin = rbm.getHiddenMin();
+	hMax = rbm.getHiddenMax();
+	divSize = rbm.getHiddenDivSize();
+	realFlag = rbm.isRealHiddenValue();
+}
+
+template <int V, int H>
+void FixedGeneralizedRBM<V, H>::copyTo(GeneralizedRBM & rbm) {
+	if (rbm.getVisibleSize() != V || rbm.getHiddenSize() != H) throw std::runtime_error("FixedGeneralizedRBM: size mismatch");
+
+	rbm.params.b = params.b;
+	rbm.params.c = params.c;
+	rbm.params.w = params.w;
+	rbm.nodes.v = nodes.v;
+	rbm.nodes.h = nodes.h;
+	rbm.trainType = trainType;
+}
+
+template <int V, int H>
+size_t FixedGeneralizedRBM<V, H>::getVisibleSize() {
+	return V;
+}
+
+template <int V, int H>
+size_t FixedGeneralizedRBM<V, H>::getHiddenSize() {
+	return H;
+}
+
+template <int V, int H>
+void FixedGeneralizedRBM<V, H>::setVisibleState(unsigned long long state) {
+	for (int i = 0; i < V; i++) {
+		nodes.v(i) = visibleValueSet[(state >> i) & 1];
+	}
+}
+
+template <int V, int H>
+double FixedGeneralizedRBM<V, H>::getNormalConstant() {
+	RBM_PROFILE_SCOPE("getNormalConstant");
+
+	// 状態cのビットiはStateCounterのi桁目と同じ
+	double z = 0.0;
+	auto max_count = 1ULL << V;
+	RBM_PROFILE_COUNT(StatesEnumerated, max_count);
+	for (unsigned long long c = 0; c < max_count; c++) {
+		setVisibleState(c);
+		z += exp(nodes.v.dot(params.b)) * sumHExpMu(muVect());
+	}
+
+	return z;
+}
+
+template <int V, int H>
+double FixedGeneralizedRBM<V, H>::actHidJ(int hindex) {
+	return actHidJ(hindex, mu(hindex));
+}
+
+template <int V, int H>
+double FixedGeneralizedRBM<V, H>::actHidJ(int hindex, double mu) {
+	double sum, expected;
+	hiddenMoments(mu, sum, expected);
+
+	return expected;
+}
+
+template <int V, int H>
+double FixedGeneralizedRBM<V, H>::lambda(int vindex) {
+	return params.b(vindex) + params.w.row(vindex).dot(nodes.h);
+}
+
+template <int V, int H>
+typename FixedGeneralizedRBM<V, H>::VisibleVector FixedGeneralizedRBM<V, H>::lambdaVect() {
+	VisibleVector lambda_vect = params.b;
+	lambda_vect.noalias() += params.w * nodes.h;
+
+	return lambda_vect;
+}
+
+template <int V, int H>
+double FixedGeneralizedRBM<V, H>::mu(int hindex) {
+	return params.c(hindex) + params.w.col(hindex).dot(nodes.v);
+}
+
+template <int V, int H>
+typename FixedGeneralizedRBM<V, H>::HiddenVector FixedGeneralizedRBM<V, H>::muVect() {
+	HiddenVector mu_vect = params.c;
+	mu_vect.noalias() += params.w.transpose() * nodes.v;
+
+	return mu_vect;
+}
+
+template <int V, int H>
+double FixedGeneralizedRBM<V, H>::sumHExpMu(const HiddenVector & mu_vect) {
+	double value = 1.0;
+	for (int j = 0; j < H; j++) {
+		value *= miniNormalizeConstantHidden(j, mu_vect(j));
+	}
+
+	return value;
+}
+
+template <int V, int H>
+double FixedGeneralizedRBM<V, H>::miniNormalizeConstantHidden(int hindex, double mu) {
+	double sum, expected;
+	hiddenMoments(mu, sum, expected);
+
+	return sum;
+}
+
+template <int V, int H>
+void FixedGeneralizedRBM<V, H>::hiddenMoments(double mu, double & sum, double & expected) {
+	// 連続型
+	if (realFlag) {
+		// FIXME: 0除算の可能性あり(GeneralizedRBMと同じ)
+		auto exp_max = exp(hMax * mu);
+		auto exp_min = exp(hMin * mu);
+		sum = (exp_max - exp_min) / mu;
+		expected = (hMax * exp_max - hMin * exp_min) / (exp_max - exp_min) - 1 / mu;
+		return;
+	}
+
+	// 離散型: h_k = hMin + k Δh なので exp(mu h_k) = exp(mu hMin) r^k, r = exp(mu Δh)
+	auto step = (hMax - hMin) / divSize;
+	auto ratio = exp(mu * step);
+	auto term = exp(mu * hMin);
+	sum = 0.0;
+	double numer = 0.0;
+	for (size_t k = 0; k <= divSize; k++) {
+		sum += term;
+		numer += (hMin + k * step) * term;
+		term *= ratio;
+	}
+	expected = numer / sum;
+}
+
+template <int V, int H>
+double FixedGeneralizedRBM<V, H>::probVis(std::vector<double> & data) {
+	return probVis(data, getNormalConstant());
+}
+
+template <int V, int H>
+double FixedGeneralizedRBM<V, H>::probVis(std::vector<double> & data, double normalize_constant) {
+	for (int i = 0; i < V; i++) {
+		nodes.v(i) = data[i];
+	}
+
+	return exp(nodes.v.dot(params.b)) * sumHExpMu(muVect()) / normalize_constant;
+}
+
+template <int V, int H>
+double FixedGeneralizedRBM<V, H>::condProbVis(int vindex, double value) {
+	return condProbVis(vindex, value, lambda(vindex));
+}
+
+template <int V, int H>
+double FixedGeneralizedRBM<V, H>::condProbVis(int vindex, double value, double lambda) {
+	return exp(lambda * value) / (exp(lambda * visibleValueSet[0]) + exp(lambda * visibleValueSet[1]));
+}
+
+template <int V, int H>
+double FixedGeneralizedRBM<V, H>::condProbHid(int hindex, double value, double mu) {
+	return exp(mu * value) / miniNormalizeConstantHidden(hindex, mu);
+}
+
+template <int V, int H>
+double FixedGeneralizedRBM<V, H>::getHiddenMax() {
+	return hMax;
+}
+
+template <int V, int H>
+double FixedGeneralizedRBM<V, H>::getHiddenMin() {
+	return hMin;
+}
+
+template <int V, int H>
+size_t FixedGeneralizedRBM<V, H>::getHiddenDivSize() {
+	return divSize;
+}
+
+template <int V, int H>
+bool FixedGeneralizedRBM<V, H>::isRealHiddenValue() {
+	return realFlag;
+}
+
+
+// 実行時のサイズから固定サイズ版を選ぶ
+// 範囲内ならfunc(std::integral_constant<int, V>, std::integral_constant<int, H>)を呼んでtrueを返す
+// 組み合わせごとに実体化されるので, 範囲はビルド時間と相談して決める
+#ifndef RBM_FIXED_VISIBLE_MAX
+#define RBM_FIXED_VISIBLE_MAX 8
+#endif
+#ifndef RBM_FIXED_HIDDEN_MAX
+#define RBM_FIXED_HIDDEN_MAX 8
+#endif
+
+namespace rbmfixed {
+	const int VISIBLE_MIN = 2;
+	const int VISIBLE_MAX = RBM_FIXED_VISIBLE_MAX;
+	const int HIDDEN_MIN = 1;
+	const int HIDDEN_MAX = RBM_FIXED_HIDDEN_MAX;
+
+	template <int V, int H>
+	struct HiddenDispatcher {
+		template <class F>
+		static bool dispatch(size_t h_size, F & func) {
+			if (h_size == H) {
+				func(std::integral_constant<int, V>(), std::integral_constant<int, H>());
+				return true;
+			}
+
+			return HiddenDispatcher<V, H + 1>::dispatch(h_size, func);
+		}
+	};
+
+	template <int V>
+	struct HiddenDispatcher<V, HIDDEN_MAX + 1> {
+		template <class F>
+		static bool dispatch(size_t h_size, F & func) {
+			return false;
+		}
+	};
+
+	template <int V>
+	struct VisibleDispatcher {
+		template <class F>
+		static bool dispatch(size_t v_size, size_t h_size, F & func) {
+			if (v_size == V) return HiddenDispatcher<V, HIDDEN_MIN>::dispatch(h_size, func);
+
+			return VisibleDispatcher<V + 1>::dispatch(v_size, h_size, func);
+		}
+	};
+
+	template <>
+	struct VisibleDispatcher<VISIBLE_MAX + 1> {
+		template <class F>
+		static bool dispatch(size_t v_size, size_t h_size, F & func) {
+			return false;
+		}
+	};
+
+	// 固定サイズ版があるか
+	inline bool isSupported(size_t v_size, size_t h_size) {
+		return v_size >= VISIBLE_MIN && v_size <= VISIBLE_MAX && h_size >= HIDDEN_MIN && h_size <= HIDDEN_MAX;
+	}
+
+	template <class F>
+	bool dispatch(size_t v_size, size_t h_size, F func) {
+		return VisibleDispatcher<VISIBLE_MIN>::dispatch(v_size, h_size, func);
+	}
+}
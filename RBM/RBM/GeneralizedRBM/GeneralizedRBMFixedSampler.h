@@ -0,0 +1,106 @@
+﻿#pragma once
+#include "../Sampler.h"
+#include "GeneralizedRBMFixed.h"
+#include <cmath>
+#include <random>
+
+template <int V, int H>
+class Sampler<FixedGeneralizedRBM<V, H>> {
+public:
+	typedef FixedGeneralizedRBM<V, H> RBM;
+
+	std::mt19937 randEngine = std::mt19937();
+public:
+	Sampler();
+	Sampler(const std::mt19937 & rand_engine);
+	~Sampler() = default;
+
+	// 可視変数一つをギブスサンプリング(lambdaを与える)
+	double gibbsSamplingVisible(RBM & rbm, int vindex, double lambda);
+
+	// 隠れ変数一つをギブスサンプリング(muを与える)
+	double gibbsSamplingHidden(RBM & rbm, int hindex, double mu);
+
+	// 可視層すべてをギブスサンプリングで更新
+	typename RBM::VisibleVector & updateByBlockedGibbsSamplingVisible(RBM & rbm);
+
+	// 隠れ層すべてをギブスサンプリングで更新
+	typename RBM::HiddenVector & updateByBlockedGibbsSamplingHidden(RBM & rbm);
+};
+
+
+template <int V, int H>
+Sampler<FixedGeneralizedRBM<V, H>>::Sampler() {
+	std::random_device rd;
+	this->randEngine = std::mt19937(rd());
+}
+
+// 乱数エンジンを与える(random_deviceを開かない)
+template <int V, int H>
+Sampler<FixedGeneralizedRBM<V, H>>::Sampler(const std::mt19937 & rand_engine) : randEngine(rand_engine) {
+}
+
+template <int V, int H>
+double Sampler<FixedGeneralizedRBM<V, H>>::gibbsSamplingVisible(RBM & rbm, int vindex, double lambda) {
+	std::uniform_real_distribution<double> dist(0.0, 1.0);
+
+	auto low = rbm.visibleValueSet[0];
+	auto high = rbm.visibleValueSet[1];
+	double value = dist(this->randEngine) < rbm.condProbVis(vindex, low, lambda) ? low : high;
+
+	return value;
+}
+
+template <int V, int H>
+double Sampler<FixedGeneralizedRBM<V, H>>::gibbsSamplingHidden(RBM & rbm, int hindex, double mu) {
+	std::uniform_real_distribution<double> dist(0.0, 1.0);
+	auto u = dist(this->randEngine);
+	auto h_max = rbm.getHiddenMax();
+	auto h_min = rbm.getHiddenMin();
+
+	// 連続型は逆関数法で
+	if (rbm.isRealHiddenValue()) {
+		auto z_j = (exp(h_max * mu) - exp(h_min * mu)) / mu;
+
+		return log(z_j * u * mu + exp(h_min * mu)) / mu;
+	}
+
+	// 離散型: 累積がu * Σ exp(mu h)を超えた値(各項は漸化式で求める)
+	auto div_size = rbm.getHiddenDivSize();
+	auto step = (h_max - h_min) / div_size;
+	auto ratio = exp(mu * step);
+	auto threshold = u * rbm.miniNormalizeConstantHidden(hindex, mu);
+	auto term = exp(mu * h_min);
+	double cumulative = 0.0;
+	for (size_t k = 0; k < div_size; k++) {
+		cumulative += term;
+		if (threshold < cumulative) return h_min + k * step;
+		term *= ratio;
+	}
+
+	return h_max;
+}
+
+template <int V, int H>
+typename FixedGeneralizedRBM<V, H>::VisibleVector & Sampler<FixedGeneralizedRBM<V, H>>::updateByBlockedGibbsSamplingVisible(RBM & rbm) {
+	RBM_PROFILE_COUNT(Sweeps, 1);
+
+	auto lambda_vect = rbm.lambdaVect();
+	for (int i = 0; i < V; i++) {
+		rbm.nodes.v(i) = gibbsSamplingVisible(rbm, i, lambda_vect(i));
+	}
+
+	return rbm.nodes.v;
+}
+
+template <int V, int H>
+typename FixedGeneralizedRBM<V, H>::HiddenVector & Sampler<FixedGeneralizedRBM<V, H>>::updateByBlockedGibbsSamplingHidden(RBM & rbm) {
+	RBM_PROFILE_COUNT(Sweeps, 1);
+
+	auto mu_vect = rbm.muVect();
+	for (int j = 0; j < H; j++) {
+		rbm.nodes.h(j) = gibbsSamplingHidden(rbm, j, mu_vect(j));
+	}
+
+	return rbm.nodes.h;
+}
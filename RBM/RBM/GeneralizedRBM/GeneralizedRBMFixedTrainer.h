@@ -0,0 +1,408 @@
+﻿#pragma once
+#include "Eigen/Core"
+#include "../Trainer.h"
+#include "../Checkpoint.h"
+#include "GeneralizedRBMFixed.h"
+#include "GeneralizedRBMFixedSampler.h"
+#include "GeneralizedRBMOptimizer.h"
+#include "../PackedVisible.h"
+#include <vector>
+#include <numeric>
+#include <algorithm>
+#include <stdexcept>
+#include <omp.h>
+
+// 固定サイズ版の学習(exactとCDのみ)
+// 勾配まわりも固定長で持ち, オプティマイザはGeneralizedRBMのものを要素ごとに使う
+template <int V, int H, class OPTIMIZERTYPE>
+class Trainer<FixedGeneralizedRBM<V, H>, OPTIMIZERTYPE> {
+public:
+	typedef FixedGeneralizedRBM<V, H> RBM;
+
+	// 重み付きの Σ s, Σ s v, Σ s a, Σ s v a^T (勾配, データ平均, サンプル平均に使う)
+	struct Moments {
+		double scale;
+		typename RBM::VisibleVector vBias;
+		typename RBM::HiddenVector hBias;
+		typename RBM::WeightMatrix weight;
+
+		void setZero() {
+			scale = 0.0;
+			vBias.setZero();
+			hBias.setZero();
+			weight.setZero();
+		}
+
+		void add(double s, const typename RBM::VisibleVector & v, const typename RBM::HiddenVector & a) {
+			scale += s;
+			vBias += s * v;
+			hBias += s * a;
+			weight.noalias() += (s * v) * a.transpose();
+		}
+
+		void merge(const Moments & other) {
+			scale += other.scale;
+			vBias += other.vBias;
+			hBias += other.hBias;
+			weight += other.weight;
+		}
+
+		// 重みの総和で割って平均にする
+		void normalize() {
+			vBias /= scale;
+			hBias /= scale;
+			weight /= scale;
+		}
+	};
+
+private:
+	Moments gradient;
+	Moments dataMean;
+	Moments rbmexpected;
+	Optimizer<GeneralizedRBM, OPTIMIZERTYPE> optimizer;
+	int _trainCount = 0;
+
+
+public:
+	int epoch = 0;
+	int batchSize = 1;
+	int cdk = 0;
+	double learningRate = 0.01;
+	std::mt19937 randDevice = std::mt19937(std::random_device()());
+
+public:
+	Trainer();
+	Trainer(RBM & rbm);
+	~Trainer() = default;
+
+	// 1回だけ学習
+	void trainOnceCD(RBM & rbm, std::vector<std::vector<double>> & dataset);
+	void trainOnceExact(RBM & rbm, PackedDataset & dataset);
+
+	// データ平均の計算
+	void calcDataMean(RBM & rbm, std::vector<std::vector<double>> & dataset, std::vector<int> & data_indexes);
+
+	// データ平均の計算(ビット列データ, 行の重み付き)
+	void calcDataMean(RBM & rbm, PackedDataset & dataset);
+
+	// サンプル平均の計算
+	void calcRBMExpectedCD(RBM & rbm, std::vector<std::vector<double>> & dataset, std::vector<int> & data_indexes);
+
+	// サンプル平均の計算(全状態の厳密計算)
+	void calcRBMExpectedExact(RBM & rbm);
+
+	// 勾配の計算
+	void calcGradient();
+
+	// 勾配更新
+	void updateParams(RBM & rbm);
+
+	// 対数尤度関数(ビット列データ, 行の重み付き)
+	double logLikeliHood(RBM & rbm, PackedDataset & dataset);
+
+	// 学習状態(反復回数, オプティマイザのモーメント, 乱数, チェイン)のチェックポイント
+	// モデルと合わせてrbmckpt::saveTraining/loadTrainingから使う
+	void writeCheckpoint(rbmckpt::Writer & writer, RBM & rbm);
+	void readCheckpoint(rbmckpt::Reader & reader, RBM & rbm);
+};
+
+
+template <int V, int H, class OPTIMIZERTYPE>
+Trainer<FixedGeneralizedRBM<V, H>, OPTIMIZERTYPE>::Trainer() {
+	GeneralizedRBM shape(V, H);
+	this->optimizer = Optimizer<GeneralizedRBM, OPTIMIZERTYPE>(shape);
+	gradient.setZero();
+	dataMean.setZero();
+	rbmexpected.setZero();
+}
+
+template <int V, int H, class OPTIMIZERTYPE>
+Trainer<FixedGeneralizedRBM<V, H>, OPTIMIZERTYPE>::Trainer(RBM & rbm) : Trainer() {
+}
+
+template <int V, int H, class OPTIMIZERTYPE>
+void Trainer<FixedGeneralizedRBM<V, H>, OPTIMIZERTYPE>::trainOnceCD(RBM & rbm, std::vector<std::vector<double>> & dataset) {
+	RBM_PROFILE_SCOPE("trainOnceCD");
+
+	rbm.trainType = "cd";
+
+	// データインデックス集合
+	std::vector<int> data_indexes(dataset.size());
+
+	// ミニバッチ学習のためにデータインデックスをシャッフルする
+	std::iota(data_indexes.begin(), data_indexes.end(), 0);
+	std::shuffle(data_indexes.begin(), data_indexes.end(), this->randDevice);
+
+	// ミニバッチ
+	// バッチサイズの確認(Trainer<GeneralizedRBM>と同じ選び方)
+	int batch_size = this->batchSize < dataset.size() ? dataset.size() : this->batchSize;
+
+	// ミニバッチ学習に使うデータのインデックス集合
+	std::vector<int> minibatch_indexes(batch_size);
+	std::copy(data_indexes.begin(), data_indexes.begin() + batch_size, minibatch_indexes.begin());
+
+	// Contrastive Divergence
+	calcDataMean(rbm, dataset, minibatch_indexes);
+	calcRBMExpectedCD(rbm, dataset, minibatch_indexes);
+	calcGradient();
+
+	// 勾配の更新
+	updateParams(rbm);
+
+	// オプティマイザの更新
+	optimizer.updateOptimizer();
+
+	// Trainer情報更新
+	RBM_PROFILE_EPOCH(_trainCount);
+	_trainCount++;
+}
+
+template <int V, int H, class OPTIMIZERTYPE>
+void Trainer<FixedGeneralizedRBM<V, H>, OPTIMIZERTYPE>::trainOnceExact(RBM & rbm, PackedDataset & dataset) {
+	RBM_PROFILE_SCOPE("trainOnceExact");
+
+	rbm.trainType = "exact";
+
+	// 重み付きの行(パターン)は全て使う
+	calcDataMean(rbm, dataset);
+	calcRBMExpectedExact(rbm);
+	calcGradient();
+
+	// 勾配の更新
+	updateParams(rbm);
+
+	// オプティマイザの更新
+	optimizer.updateOptimizer();
+
+	// Trainer情報更新
+	RBM_PROFILE_EPOCH(_trainCount);
+	_trainCount++;
+}
+
+template <int V, int H, class OPTIMIZERTYPE>
+void Trainer<FixedGeneralizedRBM<V, H>, OPTIMIZERTYPE>::calcDataMean(RBM & rbm, std::vector<std::vector<double>> & dataset, std::vector<int> & data_indexes) {
+	RBM_PROFILE_SCOPE("calcDataMean");
+
+	dataMean.setZero();
+
+	auto index_size = data_indexes.size();
+#pragma omp parallel
+	{
+		Moments local;
+		local.setZero();
+		auto rbm_replica = rbm;
+		typename RBM::HiddenVector act_vect;
+
+#pragma omp for schedule(static)
+		for (int n = 0; n < index_size; n++) {
+			auto & data = dataset[data_indexes[n]];
+			for (int i = 0; i < V; i++) {
+				rbm_replica.nodes.v(i) = data[i];
+			}
+
+			auto mu_vect = rbm_replica.muVect();
+			for (int j = 0; j < H; j++) {
+				act_vect(j) = rbm_replica.actHidJ(j, mu_vect(j));
+			}
+
+			local.add(1.0, rbm_replica.nodes.v, act_vect);
+		}
+
+#pragma omp critical
+		dataMean.merge(local);
+	}
+
+	dataMean.normalize();
+}
+
+template <int V, int H, class OPTIMIZERTYPE>
+void Trainer<FixedGeneralizedRBM<V, H>, OPTIMIZERTYPE>::calcDataMean(RBM & rbm, PackedDataset & dataset) {
+	RBM_PROFILE_SCOPE("calcDataMean");
+
+	if (dataset.getVisibleSize() != V || dataset.getLow() != rbm.visibleValueSet[0] || dataset.getHigh() != rbm.visibleValueSet[1]) {
+		throw std::runtime_error("calcDataMean: dataset does not match visibleValueSet");
+	}
+
+	dataMean.setZero();
+
+	auto data_size = dataset.size();
+#pragma omp parallel
+	{
+		Moments local;
+		local.setZero();
+		auto rbm_replica = rbm;
+		typename RBM::HiddenVector act_vect;
+
+#pragma omp for schedule(static)
+		for (int n = 0; n < data_size; n++) {
+			rbm_replica.setVisibleState(*dataset.row(n));
+
+			auto mu_vect = rbm_replica.muVect();
+			for (int j = 0; j < H; j++) {
+				act_vect(j) = rbm_replica.actHidJ(j, mu_vect(j));
+			}
+
+			local.add(dataset.weight(n), rbm_replica.nodes.v, act_vect);
+		}
+
+#pragma omp critical
+		dataMean.merge(local);
+	}
+
+	// 重みの総和(データ数)で割る
+	dataMean.normalize();
+}
+
+template <int V, int H, class OPTIMIZERTYPE>
+void Trainer<FixedGeneralizedRBM<V, H>, OPTIMIZERTYPE>::calcRBMExpectedCD(RBM & rbm, std::vector<std::vector<double>> & dataset, std::vector<int> & data_indexes) {
+	RBM_PROFILE_SCOPE("calcRBMExpectedCD");
+
+	rbmexpected.setZero();
+
+	auto index_size = data_indexes.size();
+#pragma omp parallel
+	{
+		Moments local;
+		local.setZero();
+
+#pragma omp for schedule(static)
+		for (int n = 0; n < index_size; n++) {
+			auto & data = dataset[data_indexes[n]];
+
+			// 初期値設定(固定長なのでコピーはスタック上)
+			auto rbm_replica = rbm;
+			for (int i = 0; i < V; i++) {
+				rbm_replica.nodes.v(i) = data[i];
+			}
+
+			auto mu_vect = rbm_replica.muVect();
+			for (int j = 0; j < H; j++) {
+				rbm_replica.nodes.h(j) = rbm_replica.actHidJ(j, mu_vect(j));
+			}
+
+			// CD-K
+			Sampler<RBM> sampler(this->randDevice);
+			for (int k = 0; k < cdk; k++) {
+				sampler.updateByBlockedGibbsSamplingVisible(rbm_replica);
+				sampler.updateByBlockedGibbsSamplingHidden(rbm_replica);
+			}
+
+			local.add(1.0, rbm_replica.nodes.v, rbm_replica.nodes.h);
+		}
+
+#pragma omp critical
+		rbmexpected.merge(local);
+	}
+
+	rbmexpected.normalize();
+}
+
+template <int V, int H, class OPTIMIZERTYPE>
+void Trainer<FixedGeneralizedRBM<V, H>, OPTIMIZERTYPE>::calcRBMExpectedExact(RBM & rbm) {
+	RBM_PROFILE_SCOPE("calcRBMExpectedExact");
+
+	rbmexpected.setZero();
+
+	// 状態cのビットiはStateCounterのi桁目と同じ
+	long long max_count = 1LL << V;
+	RBM_PROFILE_COUNT(StatesEnumerated, max_count);
+#pragma omp parallel
+	{
+		Moments local;
+		local.setZero();
+		auto rbm_replica = rbm;
+		typename RBM::HiddenVector act_vect;
+
+#pragma omp for schedule(static)
+		for (long long c = 0; c < max_count; c++) {
+			rbm_replica.setVisibleState(c);
+
+			auto mu_vect = rbm_replica.muVect();
+			double sum_h_exp_mu = 1.0;
+			for (int j = 0; j < H; j++) {
+				double sum;
+				rbm_replica.hiddenMoments(mu_vect(j), sum, act_vect(j));
+				sum_h_exp_mu *= sum;
+			}
+
+			// 状態cの非正規化確率で重み付け
+			local.add(exp(rbm_replica.nodes.v.dot(rbm_replica.params.b)) * sum_h_exp_mu, rbm_replica.nodes.v, act_vect);
+		}
+
+#pragma omp critical
+		rbmexpected.merge(local);
+	}
+
+	// 重みの総和が分配関数
+	rbmexpected.normalize();
+}
+
+template <int V, int H, class OPTIMIZERTYPE>
+void Trainer<FixedGeneralizedRBM<V, H>, OPTIMIZERTYPE>::calcGradient() {
+	RBM_PROFILE_SCOPE("calcGradient");
+
+	gradient.vBias = dataMean.vBias - rbmexpected.vBias;
+	gradient.hBias = dataMean.hBias - rbmexpected.hBias;
+	gradient.weight = dataMean.weight - rbmexpected.weight;
+}
+
+template <int V, int H, class OPTIMIZERTYPE>
+void Trainer<FixedGeneralizedRBM<V, H>, OPTIMIZERTYPE>::updateParams(RBM & rbm) {
+	RBM_PROFILE_SCOPE("updateParams");
+
+	for (int i = 0; i < V; i++) {
+		rbm.params.b(i) += optimizer.getNewParamVBias(gradient.vBias(i), i);
+
+		for (int j = 0; j < H; j++) {
+			rbm.params.w(i, j) += optimizer.getNewParamWeight(gradient.weight(i, j), i, j);
+		}
+	}
+
+	for (int j = 0; j < H; j++) {
+		rbm.params.c(j) += optimizer.getNewParamHBias(gradient.hBias(j), j);
+	}
+}
+
+template <int V, int H, class OPTIMIZERTYPE>
+double Trainer<FixedGeneralizedRBM<V, H>, OPTIMIZERTYPE>::logLikeliHood(RBM & rbm, PackedDataset & dataset) {
+	RBM_PROFILE_SCOPE("logLikeliHood");
+
+	if (dataset.getVisibleSize() != V || dataset.getLow() != rbm.visibleValueSet[0] || dataset.getHigh() != rbm.visibleValueSet[1]) {
+		throw std::runtime_error("logLikeliHood: dataset does not match visibleValueSet");
+	}
+
+	auto z = rbm.getNormalConstant();
+	auto rbm_replica = rbm;
+
+	// 同じパターンは重み(データ数)倍するだけ
+	double value = 0.0;
+	for (size_t n = 0; n < dataset.size(); n++) {
+		rbm_replica.setVisibleState(*dataset.row(n));
+		auto prob = exp(rbm_replica.nodes.v.dot(rbm_replica.params.b)) * rbm_replica.sumHExpMu(rbm_replica.muVect()) / z;
+		value += dataset.weight(n) * log(prob);
+	}
+
+	return value;
+}
+
+template <int V, int H, class OPTIMIZERTYPE>
+void Trainer<FixedGeneralizedRBM<V, H>, OPTIMIZERTYPE>::writeCheckpoint(rbmckpt::Writer & writer, RBM & rbm) {
+	writer.addScalar("trainer.trainCount", _trainCount);
+	writer.addScalar("trainer.epoch", epoch);
+	writer.addScalar("trainer.batchSize", batchSize);
+	writer.addScalar("trainer.cdk", cdk);
+	writer.addScalar("trainer.learningRate", learningRate);
+	rbmckpt::addEngine(writer, "trainer.rand", this->randDevice);
+	this->optimizer.writeCheckpoint(writer, "optimizer.");
+}
+
+template <int V, int H, class OPTIMIZERTYPE>
+void Trainer<FixedGeneralizedRBM<V, H>, OPTIMIZERTYPE>::readCheckpoint(rbmckpt::Reader & reader, RBM & rbm) {
+	_trainCount = static_cast<int>(reader.scalar("trainer.trainCount"));
+	epoch = static_cast<int>(reader.scalar("trainer.epoch"));
+	batchSize = static_cast<int>(reader.scalar("trainer.batchSize"));
+	cdk = static_cast<int>(reader.scalar("trainer.cdk"));
+	learningRate = reader.scalar("trainer.learningRate");
+	rbmckpt::readEngine(reader, "trainer.rand", this->randDevice);
+	this->optimizer.readCheckpoint(reader, "optimizer.");
+}
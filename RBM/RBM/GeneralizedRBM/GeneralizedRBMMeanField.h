@@ -0,0 +1,19 @@
+﻿#pragma once
+#include "../MeanField.h"
+#include "GeneralizedRBM.h"
+#include "Eigen/Core"
+#include <vector>
+#include <cmath>
+
+// 隠れ変数の基底測度の対数
+template<>
+inline Eigen::MatrixXd MeanField<GeneralizedRBM>::hiddenLogMeasure(GeneralizedRBM & rbm, std::vector<double> & grid) {
+	Eigen::MatrixXd log_measure = Eigen::MatrixXd::Zero(rbm.getHiddenSize(), grid.size());
+
+	// 連続値の場合は積分の刻み幅
+	if (rbm.isRealHiddenValue()) {
+		log_measure.setConstant(log((rbm.getHiddenMax() - rbm.getHiddenMin()) / grid.size()));
+	}
+
+	return log_measure;
+}
@@ -1,6 +1,7 @@
 ﻿#pragma once
 #include <fstream>
 #include "../Optimizer.h"
+#include "../Checkpoint.h"
 #include "GeneralizedRBM.h"
 #include <cmath>
 
@@ -23,6 +24,9 @@ public:
 	double getNewParamWeight(double gradient, int vindex, int hindex);
 	// next timestep
 	void updateOptimizer();
+	// 状態(反復回数, モーメント)のチェックポイント(登録した配列は書き出しまで保持すること)
+	void writeCheckpoint(rbmckpt::Writer & writer, const std::string & prefix);
+	void readCheckpoint(rbmckpt::Reader & reader, const std::string & prefix);
 };
 
 inline Optimizer<GeneralizedRBM, OptimizerType::Default>::Optimizer(GeneralizedRBM & rbm) {
@@ -33,6 +37,14 @@ inline void Optimizer<GeneralizedRBM, OptimizerType::Default>::updateOptimizer()
 	this->_iteration++;
 }
 
+inline void Optimizer<GeneralizedRBM, OptimizerType::Default>::writeCheckpoint(rbmckpt::Writer & writer, const std::string & prefix) {
+	writer.addScalar(prefix + "iteration", this->_iteration);
+}
+
+inline void Optimizer<GeneralizedRBM, OptimizerType::Default>::readCheckpoint(rbmckpt::Reader & reader, const std::string & prefix) {
+	this->_iteration = static_cast<int>(reader.scalar(prefix + "iteration"));
+}
+
 inline void Optimizer<GeneralizedRBM, OptimizerType::Default>::init(GeneralizedRBM & rbm) {
 
 }
@@ -77,6 +89,9 @@ public:
 	double getNewParamWeight(double gradient, int vindex, int hindex);
 	// next timestep
 	void updateOptimizer();
+	// 状態(反復回数, モーメント)のチェックポイント(登録した配列は書き出しまで保持すること)
+	void writeCheckpoint(rbmckpt::Writer & writer, const std::string & prefix);
+	void readCheckpoint(rbmckpt::Reader & reader, const std::string & prefix);
 };
 
 inline Optimizer<GeneralizedRBM, OptimizerType::Momentum>::Optimizer(GeneralizedRBM & rbm) {
@@ -87,6 +102,20 @@ inline void Optimizer<GeneralizedRBM, OptimizerType::Momentum>::updateOptimizer(
 	this->_iteration++;
 }
 
+inline void Optimizer<GeneralizedRBM, OptimizerType::Momentum>::writeCheckpoint(rbmckpt::Writer & writer, const std::string & prefix) {
+	writer.addScalar(prefix + "iteration", this->_iteration);
+	writer.add(prefix + "moment1st.vBias", this->moment1st.vBias);
+	writer.add(prefix + "moment1st.hBias", this->moment1st.hBias);
+	writer.add(prefix + "moment1st.weight", this->moment1st.weight);
+}
+
+inline void Optimizer<GeneralizedRBM, OptimizerType::Momentum>::readCheckpoint(rbmckpt::Reader & reader, const std::string & prefix) {
+	this->_iteration = static_cast<int>(reader.scalar(prefix + "iteration"));
+	this->moment1st.vBias = reader.vector(prefix + "moment1st.vBias");
+	this->moment1st.hBias = reader.vector(prefix + "moment1st.hBias");
+	this->moment1st.weight = reader.matrix(prefix + "moment1st.weight");
+}
+
 // Momentum
 inline void Optimizer<GeneralizedRBM, OptimizerType::Momentum>::init(GeneralizedRBM & rbm) {
 	this->moment1st.vBias.setConstant(rbm.getVisibleSize(), 0.0);
@@ -135,6 +164,9 @@ public:
 	double getNewParamWeight(double gradient, int vindex, int hindex);
 	// next timestep
 	void updateOptimizer();
+	// 状態(反復回数, モーメント)のチェックポイント(登録した配列は書き出しまで保持すること)
+	void writeCheckpoint(rbmckpt::Writer & writer, const std::string & prefix);
+	void readCheckpoint(rbmckpt::Reader & reader, const std::string & prefix);
 };
 
 inline Optimizer<GeneralizedRBM, OptimizerType::AdaGrad>::Optimizer(GeneralizedRBM & rbm) {
@@ -145,6 +177,20 @@ inline void Optimizer<GeneralizedRBM, OptimizerType::AdaGrad>::updateOptimizer()
 	this->_iteration++;
 }
 
+inline void Optimizer<GeneralizedRBM, OptimizerType::AdaGrad>::writeCheckpoint(rbmckpt::Writer & writer, const std::string & prefix) {
+	writer.addScalar(prefix + "iteration", this->_iteration);
+	writer.add(prefix + "moment2nd.vBias", this->moment2nd.vBias);
+	writer.add(prefix + "moment2nd.hBias", this->moment2nd.hBias);
+	writer.add(prefix + "moment2nd.weight", this->moment2nd.weight);
+}
+
+inline void Optimizer<GeneralizedRBM, OptimizerType::AdaGrad>::readCheckpoint(rbmckpt::Reader & reader, const std::string & prefix) {
+	this->_iteration = static_cast<int>(reader.scalar(prefix + "iteration"));
+	this->moment2nd.vBias = reader.vector(prefix + "moment2nd.vBias");
+	this->moment2nd.hBias = reader.vector(prefix + "moment2nd.hBias");
+	this->moment2nd.weight = reader.matrix(prefix + "moment2nd.weight");
+}
+
 // AdaGrad
 inline void Optimizer<GeneralizedRBM, OptimizerType::AdaGrad>::init(GeneralizedRBM & rbm) {
 	this->moment2nd.vBias.setConstant(rbm.getVisibleSize(), 0.0);
@@ -203,6 +249,9 @@ public:
 	double getNewParamWeight(double gradient, int vindex, int hindex);
 	// next timestep
 	void updateOptimizer();
+	// 状態(反復回数, モーメント)のチェックポイント(登録した配列は書き出しまで保持すること)
+	void writeCheckpoint(rbmckpt::Writer & writer, const std::string & prefix);
+	void readCheckpoint(rbmckpt::Reader & reader, const std::string & prefix);
 };
 
 inline Optimizer<GeneralizedRBM, OptimizerType::AdaDelta>::Optimizer(GeneralizedRBM & rbm) {
@@ -213,6 +262,26 @@ inline void Optimizer<GeneralizedRBM, OptimizerType::AdaDelta>::updateOptimizer(
 	this->_iteration++;
 }
 
+inline void Optimizer<GeneralizedRBM, OptimizerType::AdaDelta>::writeCheckpoint(rbmckpt::Writer & writer, const std::string & prefix) {
+	writer.addScalar(prefix + "iteration", this->_iteration);
+	writer.add(prefix + "moment1st.vBias", this->moment1st.vBias);
+	writer.add(prefix + "moment1st.hBias", this->moment1st.hBias);
+	writer.add(prefix + "moment1st.weight", this->moment1st.weight);
+	writer.add(prefix + "moment2nd.vBias", this->moment2nd.vBias);
+	writer.add(prefix + "moment2nd.hBias", this->moment2nd.hBias);
+	writer.add(prefix + "moment2nd.weight", this->moment2nd.weight);
+}
+
+inline void Optimizer<GeneralizedRBM, OptimizerType::AdaDelta>::readCheckpoint(rbmckpt::Reader & reader, const std::string & prefix) {
+	this->_iteration = static_cast<int>(reader.scalar(prefix + "iteration"));
+	this->moment1st.vBias = reader.vector(prefix + "moment1st.vBias");
+	this->moment1st.hBias = reader.vector(prefix + "moment1st.hBias");
+	this->moment1st.weight = reader.matrix(prefix + "moment1st.weight");
+	this->moment2nd.vBias = reader.vector(prefix + "moment2nd.vBias");
+	this->moment2nd.hBias = reader.vector(prefix + "moment2nd.hBias");
+	this->moment2nd.weight = reader.matrix(prefix + "moment2nd.weight");
+}
+
 // AdaDelta
 inline void Optimizer<GeneralizedRBM, OptimizerType::AdaDelta>::init(GeneralizedRBM & rbm) {
 	this->moment1st.vBias.setConstant(rbm.getVisibleSize(), 0.0);
@@ -281,6 +350,9 @@ public:
 	double getNewParamWeight(double gradient, int vindex, int hindex);
 	// next timestep
 	void updateOptimizer();
+	// 状態(反復回数, モーメント)のチェックポイント(登録した配列は書き出しまで保持すること)
+	void writeCheckpoint(rbmckpt::Writer & writer, const std::string & prefix);
+	void readCheckpoint(rbmckpt::Reader & reader, const std::string & prefix);
 };
 
 inline Optimizer<GeneralizedRBM, OptimizerType::Adam>::Optimizer(GeneralizedRBM & rbm) {
@@ -291,6 +363,26 @@ inline void Optimizer<GeneralizedRBM, OptimizerType::Adam>::updateOptimizer() {
 	this->_iteration++;
 }
 
+inline void Optimizer<GeneralizedRBM, OptimizerType::Adam>::writeCheckpoint(rbmckpt::Writer & writer, const std::string & prefix) {
+	writer.addScalar(prefix + "iteration", this->_iteration);
+	writer.add(prefix + "moment1st.vBias", this->moment1st.vBias);
+	writer.add(prefix + "moment1st.hBias", this->moment1st.hBias);
+	writer.add(prefix + "moment1st.weight", this->moment1st.weight);
+	writer.add(prefix + "moment2nd.vBias", this->moment2nd.vBias);
+	writer.add(prefix + "moment2nd.hBias", this->moment2nd.hBias);
+	writer.add(prefix + "moment2nd.weight", this->moment2nd.weight);
+}
+
+inline void Optimizer<GeneralizedRBM, OptimizerType::Adam>::readCheckpoint(rbmckpt::Reader & reader, const std::string & prefix) {
+	this->_iteration = static_cast<int>(reader.scalar(prefix + "iteration"));
+	this->moment1st.vBias = reader.vector(prefix + "moment1st.vBias");
+	this->moment1st.hBias = reader.vector(prefix + "moment1st.hBias");
+	this->moment1st.weight = reader.matrix(prefix + "moment1st.weight");
+	this->moment2nd.vBias = reader.vector(prefix + "moment2nd.vBias");
+	this->moment2nd.hBias = reader.vector(prefix + "moment2nd.hBias");
+	this->moment2nd.weight = reader.matrix(prefix + "moment2nd.weight");
+}
+
 // Adam
 inline void Optimizer<GeneralizedRBM, OptimizerType::Adam>::init(GeneralizedRBM & rbm) {
 	this->moment1st.vBias.setConstant(rbm.getVisibleSize(), 0.0);
@@ -366,6 +458,9 @@ public:
 	double getNewParamWeight(double gradient, int vindex, int hindex);
 	// next timestep
 	void updateOptimizer();
+	// 状態(反復回数, モーメント)のチェックポイント(登録した配列は書き出しまで保持すること)
+	void writeCheckpoint(rbmckpt::Writer & writer, const std::string & prefix);
+	void readCheckpoint(rbmckpt::Reader & reader, const std::string & prefix);
 };
 
 inline Optimizer<GeneralizedRBM, OptimizerType::AdaMax>::Optimizer(GeneralizedRBM & rbm) {
@@ -376,6 +471,26 @@ inline void Optimizer<GeneralizedRBM, OptimizerType::AdaMax>::updateOptimizer()
 	this->_iteration++;
 }
 
+inline void Optimizer<GeneralizedRBM, OptimizerType::AdaMax>::writeCheckpoint(rbmckpt::Writer & writer, const std::string & prefix) {
+	writer.addScalar(prefix + "iteration", this->_iteration);
+	writer.add(prefix + "moment1st.vBias", this->moment1st.vBias);
+	writer.add(prefix + "moment1st.hBias", this->moment1st.hBias);
+	writer.add(prefix + "moment1st.weight", this->moment1st.weight);
+	writer.add(prefix + "moment2nd.vBias", this->moment2nd.vBias);
+	writer.add(prefix + "moment2nd.hBias", this->moment2nd.hBias);
+	writer.add(prefix + "moment2nd.weight", this->moment2nd.weight);
+}
+
+inline void Optimizer<GeneralizedRBM, OptimizerType::AdaMax>::readCheckpoint(rbmckpt::Reader & reader, const std::string & prefix) {
+	this->_iteration = static_cast<int>(reader.scalar(prefix + "iteration"));
+	this->moment1st.vBias = reader.vector(prefix + "moment1st.vBias");
+	this->moment1st.hBias = reader.vector(prefix + "moment1st.hBias");
+	this->moment1st.weight = reader.matrix(prefix + "moment1st.weight");
+	this->moment2nd.vBias = reader.vector(prefix + "moment2nd.vBias");
+	this->moment2nd.hBias = reader.vector(prefix + "moment2nd.hBias");
+	this->moment2nd.weight = reader.matrix(prefix + "moment2nd.weight");
+}
+
 // AdaMax
 inline void Optimizer<GeneralizedRBM, OptimizerType::AdaMax>::init(GeneralizedRBM & rbm) {
 	this->moment1st.vBias.setConstant(rbm.getVisibleSize(), 0.0);
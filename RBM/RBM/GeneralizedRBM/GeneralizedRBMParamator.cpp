@@ -1,4 +1,5 @@
 ﻿#include "GeneralizedRBMParamator.h"
+#include "../Checkpoint.h"
 #include <iostream>
 
 
@@ -148,6 +149,27 @@ void GeneralizedRBMParamator::deserialize(std::string js) {
 	this->w = Eigen::Map<Eigen::MatrixXd>(tmp_w.data(), vSize, hSize);
 }
 
+// チェックポイントに登録
+void GeneralizedRBMParamator::writeCheckpoint(rbmckpt::Writer & writer) {
+	writer.setModelType("GeneralizedRBM");
+	writer.add("b", this->b);
+	writer.add("c", this->c);
+	writer.add("w", this->w);
+}
+
+// チェックポイントから復元
+void GeneralizedRBMParamator::readCheckpoint(rbmckpt::Reader & reader) {
+	if (reader.modelType() != "GeneralizedRBM") throw std::runtime_error("GeneralizedRBMParamator: model type mismatch " + reader.modelType());
+	auto ckpt_b = reader.vector("b");
+	auto ckpt_c = reader.vector("c");
+	auto ckpt_w = reader.matrix("w");
+	if (ckpt_b.size() != vSize || ckpt_c.size() != hSize || ckpt_w.rows() != vSize || ckpt_w.cols() != hSize) throw std::runtime_error("GeneralizedRBMParamator: shape mismatch");
+
+	this->b = ckpt_b;
+	this->c = ckpt_c;
+	this->w = ckpt_w;
+}
+
 void GeneralizedRBMParamator::printParams()
 {
 	std::cout << "--- b ---" << std::endl;
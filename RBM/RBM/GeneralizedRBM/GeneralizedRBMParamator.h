@@ -4,6 +4,11 @@
 #include "Eigen/Core"
 #include "json.hpp"
 
+namespace rbmckpt {
+	class Writer;
+	class Reader;
+}
+
 class GeneralizedRBMParamator : RBMParamatorBase {
 private:
     size_t vSize;
@@ -60,6 +65,12 @@ public:
 	// パラメータ情報のデシリアライズ
 	void deserialize(std::string js);
 
+	// チェックポイントに登録(配列はコピーしない)
+	void writeCheckpoint(rbmckpt::Writer & writer);
+
+	// チェックポイントから復元(同じ形であること)
+	void readCheckpoint(rbmckpt::Reader & reader);
+
 	// パラメータ出力
 	void printParams();
 };
@@ -1,5 +1,7 @@
 ﻿#pragma once
 #include "../Sampler.h"
+#include "../ReplicaExchangeSampler.h"
+#include "../MaskedSampler.h"
 #include "GeneralizedRBM.h"
 #include "Eigen/Core"
 #include <vector>
@@ -20,6 +22,9 @@ public:
 	// 隠れ変数一つをギブスサンプリング
 	double gibbsSamplingHidden(GeneralizedRBM & rbm, int hindex);
 
+	// 隠れ変数一つをギブスサンプリング(muを与える)
+	double gibbsSamplingHidden(GeneralizedRBM & rbm, int hindex, double mu);
+
 	// 可視層すべてをギブスサンプリング
 	Eigen::VectorXd & blockedGibbsSamplingVisible(GeneralizedRBM & rbm);
 
@@ -37,6 +42,9 @@ public:
 
 	// 隠れ層すべてをギブスサンプリングで更新
 	Eigen::VectorXd & updateByBlockedGibbsSamplingHidden(GeneralizedRBM & rbm);
+
+	// 隠れ層すべてをギブスサンプリングで更新(muを一括で与える)
+	Eigen::VectorXd & updateByBlockedGibbsSamplingHidden(GeneralizedRBM & rbm, const Eigen::VectorXd & mu_vect);
 };
 
 
@@ -55,13 +63,16 @@ inline double Sampler<GeneralizedRBM>::gibbsSamplingVisible(GeneralizedRBM & rbm
 }
 
 inline double Sampler<GeneralizedRBM>::gibbsSamplingHidden(GeneralizedRBM & rbm, int hindex) {
+	return gibbsSamplingHidden(rbm, hindex, rbm.mu(hindex));
+}
+
+inline double Sampler<GeneralizedRBM>::gibbsSamplingHidden(GeneralizedRBM & rbm, int hindex, double mu) {
 	// 離散型
 	auto sample_discrete = [&] {
-		std::vector<double> probs(rbm.getHiddenValueSetSize());
-		auto hidset = rbm.splitHiddenSet();
+		auto & hidset = rbm.hiddenValueSet;
+		std::vector<double> probs(hidset.size());
 		for (int i = 0; i < hidset.size(); i++) {
-			// FIXME: 分配関数の計算を使いまわせば高速化可能
-			probs[i] = rbm.condProbHid(hindex, hidset[i]);
+			probs[i] = rbm.condProbHid(hindex, hidset[i], mu);
 		}
 
 		std::discrete_distribution<> dist(probs.begin(), probs.end());
@@ -79,7 +90,7 @@ inline double Sampler<GeneralizedRBM>::gibbsSamplingHidden(GeneralizedRBM & rbm,
 		auto h_max = rbm.getHiddenMax();
 		auto h_min = rbm.getHiddenMin();
 
-		auto mu_j = rbm.mu(hindex);
+		auto mu_j = mu;
 		auto z_j = (exp(h_max * mu_j) - exp(h_min * mu_j)) / mu_j;
 
 		double value = log(z_j * u * mu_j + exp(h_min * mu_j)) / mu_j;
@@ -125,6 +136,7 @@ inline double Sampler<GeneralizedRBM>::updateByGibbsSamplingHidden(GeneralizedRB
 }
 
 inline Eigen::VectorXd & Sampler<GeneralizedRBM>::updateByBlockedGibbsSamplingVisible(GeneralizedRBM & rbm) {
+	RBM_PROFILE_COUNT(Sweeps, 1);
 
 	for (int i = 0; i < rbm.getVisibleSize(); i++) {
 		updateByGibbsSamplingVisible(rbm, i);
@@ -134,9 +146,90 @@ inline Eigen::VectorXd & Sampler<GeneralizedRBM>::updateByBlockedGibbsSamplingVi
 }
 
 inline Eigen::VectorXd & Sampler<GeneralizedRBM>::updateByBlockedGibbsSamplingHidden(GeneralizedRBM & rbm) {
+	RBM_PROFILE_COUNT(Sweeps, 1);
 	for (int j = 0; j < rbm.getHiddenSize(); j++) {
 		updateByGibbsSamplingHidden(rbm, j);
 	}
 
 	return rbm.nodes.h;
 }
+
+inline Eigen::VectorXd & Sampler<GeneralizedRBM>::updateByBlockedGibbsSamplingHidden(GeneralizedRBM & rbm, const Eigen::VectorXd & mu_vect) {
+	RBM_PROFILE_COUNT(Sweeps, 1);
+	for (int j = 0; j < rbm.getHiddenSize(); j++) {
+		rbm.nodes.h(j) = gibbsSamplingHidden(rbm, j, mu_vect(j));
+	}
+
+	return rbm.nodes.h;
+}
+
+
+// レプリカ交換用, 逆温度betaのパラメータを設定
+template<>
+inline void ReplicaExchangeSampler<GeneralizedRBM>::temperParams(GeneralizedRBM & replica, GeneralizedRBM & rbm, double beta) {
+	replica.params.b = beta * rbm.params.b;
+	replica.params.c = beta * rbm.params.c;
+	replica.params.w = beta * rbm.params.w;
+}
+
+
+// 観測値固定サンプリング用, バッチの各列のmu = c + W^T v
+template<>
+inline void MaskedSampler<GeneralizedRBM>::muBatch(GeneralizedRBM & rbm, const Eigen::MatrixXd & v_batch, Eigen::MatrixXd & mu_batch) {
+	mu_batch.noalias() = rbm.params.w.transpose() * v_batch;
+	mu_batch.colwise() += rbm.params.c;
+}
+
+template<>
+inline void MaskedSampler<GeneralizedRBM>::visibleRows(GeneralizedRBM & rbm, const std::vector<int> & rows, Eigen::VectorXd & b_rows, Eigen::MatrixXd & w_rows) {
+	b_rows.resize(rows.size());
+	w_rows.resize(rows.size(), rbm.getHiddenSize());
+	for (int r = 0; r < rows.size(); r++) {
+		b_rows(r) = rbm.params.b(rows[r]);
+		w_rows.row(r) = rbm.params.w.row(rows[r]);
+	}
+}
+
+template<>
+inline double MaskedSampler<GeneralizedRBM>::sampleHidden(GeneralizedRBM & rbm, int hindex, double mu, std::mt19937 & engine) {
+	std::uniform_real_distribution<double> dist(0.0, 1.0);
+	auto u = dist(engine);
+
+	// 連続型は逆関数法で
+	if (rbm.isRealHiddenValue()) {
+		auto h_max = rbm.getHiddenMax();
+		auto h_min = rbm.getHiddenMin();
+		auto z_j = (exp(h_max * mu) - exp(h_min * mu)) / mu;
+
+		return log(z_j * u * mu + exp(h_min * mu)) / mu;
+	}
+
+	// 離散型: 累積がu * Σ exp(mu h)を超えた値
+	auto & hidset = rbm.hiddenValueSet;
+	auto threshold = u * rbm.miniNormalizeConstantHidden(hindex, mu);
+	double cumulative = 0.0;
+	for (int k = 0; k < hidset.size() - 1; k++) {
+		cumulative += exp(mu * hidset[k]);
+		if (threshold < cumulative) return hidset[k];
+	}
+
+	return hidset.back();
+}
+
+template<>
+inline double MaskedSampler<GeneralizedRBM>::sampleVisible(GeneralizedRBM & rbm, int vindex, double lambda, std::mt19937 & engine) {
+	std::uniform_real_distribution<double> dist(0.0, 1.0);
+
+	auto low = rbm.visibleValueSet[0];
+	auto high = rbm.visibleValueSet[1];
+	return dist(engine) < rbm.condProbVis(vindex, low, lambda) ? low : high;
+}
+
+template<>
+inline double MaskedSampler<GeneralizedRBM>::meanVisible(GeneralizedRBM & rbm, int vindex, double lambda) {
+	auto low = rbm.visibleValueSet[0];
+	auto high = rbm.visibleValueSet[1];
+	auto prob_low = rbm.condProbVis(vindex, low, lambda);
+
+	return low * prob_low + high * (1.0 - prob_low);
+}
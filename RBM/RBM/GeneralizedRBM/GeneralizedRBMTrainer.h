@@ -1,9 +1,17 @@
 ﻿#pragma once
 #include "Eigen/Core"
 #include "../Trainer.h"
+#include "../Checkpoint.h"
+#include "../Communicator.h"
 #include "GeneralizedRBM.h"
+#include "GeneralizedRBMSampler.h"
+#include "GeneralizedRBMMeanField.h"
 #include "GeneralizedRBMOptimizer.h"
+#include "../PackedVisible.h"
+#include "GeneralizedRBMKernel.h"
 #include <vector>
+#include <mutex>
+#include <atomic>
 #include <omp.h>
 
 template<class OPTIMIZERTYPE>
@@ -40,6 +48,23 @@ public:
 	int cdk = 0;
 	double learningRate = 0.01;
 	std::mt19937 randDevice = std::mt19937(std::random_device()());
+	bool singlePrecision = false;  // CDをfloatで計算する(平均はdoubleで持つ, exact等は常にdouble)
+
+	// パラレルテンパリングの設定
+	int replicaSize = 8;  // レプリカ数
+	double replicaBetaMin = 0.1;  // 最高温度レプリカの逆温度
+	ReplicaExchangeSampler<GeneralizedRBM> replicaSampler;
+
+	// 平均場近似(TAP近似)の設定
+	MeanField<GeneralizedRBM> meanField;
+
+	// データ並列学習(nullptrなら単一ワーカー)
+	// 各ワーカーに自分のデータ分割を渡し, 同じ初期パラメータ・同じ設定で学習させる
+	Communicator * communicator = nullptr;
+
+	// 非同期SGD(Hogwild)の設定
+	int asyncThreads = 0;  // ワーカースレッド数(0ならomp_get_max_threads())
+	int asyncBlockSize = 16;  // 1つのロックが受け持つ重みの列(隠れ変数)数
 
 public:
 	Trainer() = default;
@@ -69,6 +94,13 @@ public:
 
 	void trainCD(GeneralizedRBM & rbm, std::vector<std::vector<double>> & dataset);
 	void trainExact(GeneralizedRBM & rbm, std::vector<std::vector<double>> & dataset);
+	void trainPT(GeneralizedRBM & rbm, std::vector<std::vector<double>> & dataset);
+	void trainMF(GeneralizedRBM & rbm, std::vector<std::vector<double>> & dataset);
+
+	// 非同期SGD(Hogwild), epoch回のミニバッチ更新をスレッドで分け合う
+	// 各スレッドが自分のミニバッチでCDを計算し, 共有パラメータを重みの列ブロックごとのロックで直接更新する(全体のバリアは無い)
+	// 更新はlearningRateのSGD(オプティマイザのモーメントは共有状態なので使わない)
+	void trainAsync(GeneralizedRBM & rbm, std::vector<std::vector<double>> & dataset);
 
 
 	// 1回だけ学習
@@ -76,6 +108,9 @@ public:
 
 	void trainOnceCD(GeneralizedRBM & rbm, std::vector<std::vector<double>> & dataset);
 	void trainOnceExact(GeneralizedRBM & rbm, std::vector<std::vector<double>> & dataset);
+	void trainOnceExact(GeneralizedRBM & rbm, PackedDataset & dataset);
+	void trainOncePT(GeneralizedRBM & rbm, std::vector<std::vector<double>> & dataset);
+	void trainOnceMF(GeneralizedRBM & rbm, std::vector<std::vector<double>> & dataset);
 
 
 	// CD計算
@@ -84,32 +119,72 @@ public:
 	// CD計算
 	void calcExact(GeneralizedRBM & rbm, std::vector<std::vector<double>> & dataset, std::vector<int> & data_indexes);
 
+	// 厳密計算(ビット列データ)
+	void calcExact(GeneralizedRBM & rbm, PackedDataset & dataset, std::vector<int> & data_indexes);
+
+	// パラレルテンパリング計算
+	void calcReplicaExchange(GeneralizedRBM & rbm, std::vector<std::vector<double>> & dataset, std::vector<int> & data_indexes);
+
+	// 平均場近似計算
+	void calcMeanField(GeneralizedRBM & rbm, std::vector<std::vector<double>> & dataset, std::vector<int> & data_indexes);
+
 	// データ平均の計算
 	void calcDataMean(GeneralizedRBM & rbm, std::vector<std::vector<double>> & dataset, std::vector<int> & data_indexes);
 
+	// データ平均の計算(ビット列データ, 行の重み付き)
+	void calcDataMean(GeneralizedRBM & rbm, PackedDataset & dataset, std::vector<int> & data_indexes);
+
+	// データ平均の計算(muと隠れ変数の期待値をSCALAR型で計算)
+	template <class SCALAR>
+	void calcDataMeanScalar(GeneralizedRBM & rbm, std::vector<std::vector<double>> & dataset, std::vector<int> & data_indexes);
+
 	// サンプル平均の計算
 	void calcRBMExpectedCD(GeneralizedRBM & rbm, std::vector<std::vector<double>> & dataset, std::vector<int> & data_indexes);
 
+	// サンプル平均の計算(サンプリングをSCALAR型で行う)
+	template <class SCALAR>
+	void calcRBMExpectedCDScalar(GeneralizedRBM & rbm, std::vector<std::vector<double>> & dataset, std::vector<int> & data_indexes);
+
 	// サンプル平均の計算
 	void calcRBMExpectedExact(GeneralizedRBM & rbm, std::vector<std::vector<double>> & dataset, std::vector<int> & data_indexes);
 
+	// サンプル平均の計算(全状態の厳密計算, データに依存しない)
+	void calcRBMExpectedExact(GeneralizedRBM & rbm);
+
+	// サンプル平均の計算(パラレルテンパリング)
+	void calcRBMExpectedPT(GeneralizedRBM & rbm, std::vector<std::vector<double>> & dataset, std::vector<int> & data_indexes);
+
+	// サンプル平均の計算(平均場近似)
+	void calcRBMExpectedMF(GeneralizedRBM & rbm, std::vector<std::vector<double>> & dataset, std::vector<int> & data_indexes);
+
 
 
 	// 勾配の計算
 	void calcGradient(GeneralizedRBM & rbm, std::vector<int> & data_indexes);
 
 
+	// 全ワーカーの勾配をバッチサイズで重み付けして平均する(communicatorが無ければ何もしない)
+	void allReduceGradient(double batch_size);
+
 	// 勾配更新
 	void updateParams(GeneralizedRBM & rbm);
 
 	// 対数尤度関数
 	double logLikeliHood(GeneralizedRBM & rbm, std::vector<std::vector<double>> & dataset);
 
+	// 対数尤度関数(ビット列データ, 行の重み付き)
+	double logLikeliHood(GeneralizedRBM & rbm, PackedDataset & dataset);
+
 	// 学習情報出力(JSON)
 	std::string trainInfoJson(GeneralizedRBM & rbm);
 
 	// 学習情報から学習(JSON)
 	void trainFromTrainInfo(GeneralizedRBM & rbm, std::string json);
+
+	// 学習状態(反復回数, オプティマイザのモーメント, 乱数, チェイン)のチェックポイント
+	// モデルと合わせてrbmckpt::saveTraining/loadTrainingから使う
+	void writeCheckpoint(rbmckpt::Writer & writer, GeneralizedRBM & rbm);
+	void readCheckpoint(rbmckpt::Reader & reader, GeneralizedRBM & rbm);
 };
 
 template<class OPTIMIZERTYPE>
@@ -184,11 +259,122 @@ void Trainer<GeneralizedRBM, OPTIMIZERTYPE>::trainExact(GeneralizedRBM & rbm, st
 	}
 }
 
+template<class OPTIMIZERTYPE>
+void Trainer<GeneralizedRBM, OPTIMIZERTYPE>::trainPT(GeneralizedRBM & rbm, std::vector<std::vector<double>> & dataset) {
+	for (int e = 0; e < epoch; e++) {
+		trainOncePT(rbm, dataset);
+	}
+}
+
+template<class OMFIMIZERTYPE>
+void Trainer<GeneralizedRBM, OMFIMIZERTYPE>::trainMF(GeneralizedRBM & rbm, std::vector<std::vector<double>> & dataset) {
+	for (int e = 0; e < epoch; e++) {
+		trainOnceMF(rbm, dataset);
+	}
+}
+
+template<class OPTIMIZERTYPE>
+void Trainer<GeneralizedRBM, OPTIMIZERTYPE>::trainAsync(GeneralizedRBM & rbm, std::vector<std::vector<double>> & dataset) {
+	RBM_PROFILE_SCOPE("trainAsync");
+
+	rbm.trainType = "cd";
+
+	int v_size = static_cast<int>(rbm.getVisibleSize());
+	int h_size = static_cast<int>(rbm.getHiddenSize());
+	int thread_size = asyncThreads > 0 ? asyncThreads : omp_get_max_threads();
+	int block_size = std::max(1, asyncBlockSize);
+	int block_count = (h_size + block_size - 1) / block_size;
+	int batch_size = std::max(1, std::min(this->batchSize, static_cast<int>(dataset.size())));
+
+	// 重みの列ブロック(と対応する隠れバイアス)ごとのロック, 可視バイアスは別のロック
+	std::vector<std::mutex> block_mutexes(block_count);
+	std::mutex vbias_mutex;
+	std::atomic<int> next_step(0);
+
+	// スレッドごとの乱数の種は開始時に引いておく
+	std::vector<std::mt19937::result_type> seeds(thread_size);
+	for (auto & seed : seeds) seed = this->randDevice();
+
+#pragma omp parallel num_threads(thread_size)
+	{
+		int t = omp_get_thread_num();
+		auto local = rbm;
+		Sampler<GeneralizedRBM> sampler;
+		sampler.randEngine = std::mt19937(seeds[t]);
+		std::uniform_int_distribution<int> pick(0, static_cast<int>(dataset.size()) - 1);
+
+		Eigen::VectorXd grad_b(v_size), grad_c(h_size), h_data(h_size), mu_vect;
+		Eigen::MatrixXd grad_w(v_size, h_size);
+
+		while (next_step.fetch_add(1, std::memory_order_relaxed) < epoch) {
+			// 共有パラメータをブロックごとに読む(ブロック間では他スレッドの更新途中の値が混ざってよい)
+			for (int k = 0; k < block_count; k++) {
+				int j0 = k * block_size;
+				int cols = std::min(block_size, h_size - j0);
+				std::lock_guard<std::mutex> lock(block_mutexes[k]);
+				local.params.w.middleCols(j0, cols) = rbm.params.w.middleCols(j0, cols);
+				local.params.c.segment(j0, cols) = rbm.params.c.segment(j0, cols);
+			}
+			{
+				std::lock_guard<std::mutex> lock(vbias_mutex);
+				local.params.b = rbm.params.b;
+			}
+
+			// ミニバッチのCD-K(データ平均 - サンプル平均, バッチで和を取る)
+			grad_b.setZero();
+			grad_c.setZero();
+			grad_w.setZero();
+			for (int n = 0; n < batch_size; n++) {
+				auto & data = dataset[pick(sampler.randEngine)];
+				local.nodes.v = Eigen::Map<Eigen::VectorXd>(data.data(), data.size());
+				mu_vect = local.muVect();
+				for (int j = 0; j < h_size; j++) {
+					h_data(j) = local.actHidJ(j, mu_vect(j));
+				}
+				grad_b += local.nodes.v;
+				grad_c += h_data;
+				grad_w.noalias() += local.nodes.v * h_data.transpose();
+
+				local.nodes.h = h_data;
+				for (int k = 0; k < cdk; k++) {
+					sampler.updateByBlockedGibbsSamplingVisible(local);
+					mu_vect = local.muVect();
+					sampler.updateByBlockedGibbsSamplingHidden(local, mu_vect);
+				}
+				grad_b -= local.nodes.v;
+				grad_c -= local.nodes.h;
+				grad_w.noalias() -= local.nodes.v * local.nodes.h.transpose();
+			}
+
+			// 共有パラメータへ直接反映(スレッドごとに開始ブロックをずらして競合を減らす)
+			double scale = learningRate / batch_size;
+			for (int m = 0; m < block_count; m++) {
+				int k = (m + t) % block_count;
+				int j0 = k * block_size;
+				int cols = std::min(block_size, h_size - j0);
+				std::lock_guard<std::mutex> lock(block_mutexes[k]);
+				rbm.params.w.middleCols(j0, cols) += scale * grad_w.middleCols(j0, cols);
+				rbm.params.c.segment(j0, cols) += scale * grad_c.segment(j0, cols);
+			}
+			{
+				std::lock_guard<std::mutex> lock(vbias_mutex);
+				rbm.params.b += scale * grad_b;
+			}
+		}
+	}
+
+	// Trainer情報更新
+	RBM_PROFILE_EPOCH(_trainCount);
+	_trainCount += epoch;
+}
+
 
 // FIXME: CDとExactをフラグで切り分けられるように
 // 1回だけ学習
 template<class OPTIMIZERTYPE>
 void Trainer<GeneralizedRBM, OPTIMIZERTYPE>::trainOnce(GeneralizedRBM & rbm, std::vector<std::vector<double>> & dataset) {
+	RBM_PROFILE_SCOPE("trainOnce");
+
 	// 勾配初期化
 	initGradient();
 
@@ -210,6 +396,9 @@ void Trainer<GeneralizedRBM, OPTIMIZERTYPE>::trainOnce(GeneralizedRBM & rbm, std
 	// Contrastive Divergence
 	calcContrastiveDivergence(rbm, dataset, minibatch_indexes);
 
+	// ワーカー間で勾配を平均
+	allReduceGradient(minibatch_indexes.size());
+
 	// 勾配の更新
 	updateParams(rbm);
 
@@ -217,11 +406,14 @@ void Trainer<GeneralizedRBM, OPTIMIZERTYPE>::trainOnce(GeneralizedRBM & rbm, std
 	optimizer.updateOptimizer();
 
 	// Trainer情報更新
+	RBM_PROFILE_EPOCH(_trainCount);
 	_trainCount++;
 }
 
 template<class OPTIMIZERTYPE>
 void Trainer<GeneralizedRBM, OPTIMIZERTYPE>::trainOnceCD(GeneralizedRBM & rbm, std::vector<std::vector<double>> & dataset) {
+	RBM_PROFILE_SCOPE("trainOnceCD");
+
 	rbm.trainType = "cd";
 
 	// 勾配初期化
@@ -245,6 +437,9 @@ void Trainer<GeneralizedRBM, OPTIMIZERTYPE>::trainOnceCD(GeneralizedRBM & rbm, s
 	// Contrastive Divergence
 	calcContrastiveDivergence(rbm, dataset, minibatch_indexes);
 
+	// ワーカー間で勾配を平均
+	allReduceGradient(minibatch_indexes.size());
+
 	// 勾配の更新
 	updateParams(rbm);
 
@@ -252,11 +447,14 @@ void Trainer<GeneralizedRBM, OPTIMIZERTYPE>::trainOnceCD(GeneralizedRBM & rbm, s
 	optimizer.updateOptimizer();
 
 	// Trainer情報更新
+	RBM_PROFILE_EPOCH(_trainCount);
 	_trainCount++;
 }
 
 template<class OPTIMIZERTYPE>
 void Trainer<GeneralizedRBM, OPTIMIZERTYPE>::trainOnceExact(GeneralizedRBM & rbm, std::vector<std::vector<double>> & dataset) {
+	RBM_PROFILE_SCOPE("trainOnceExact");
+
 	rbm.trainType = "exact";
 
 	// 勾配初期化
@@ -280,6 +478,121 @@ void Trainer<GeneralizedRBM, OPTIMIZERTYPE>::trainOnceExact(GeneralizedRBM & rbm
 	// Contrastive Divergence
 	calcExact(rbm, dataset, minibatch_indexes);
 
+	// ワーカー間で勾配を平均
+	allReduceGradient(minibatch_indexes.size());
+
+	// 勾配の更新
+	updateParams(rbm);
+
+	// オプティマイザの更新
+	optimizer.updateOptimizer();
+
+	// Trainer情報更新
+	RBM_PROFILE_EPOCH(_trainCount);
+	_trainCount++;
+}
+
+template<class OPTIMIZERTYPE>
+void Trainer<GeneralizedRBM, OPTIMIZERTYPE>::trainOnceExact(GeneralizedRBM & rbm, PackedDataset & dataset) {
+	RBM_PROFILE_SCOPE("trainOnceExact");
+
+	rbm.trainType = "exact";
+
+	// 勾配初期化
+	initGradient();
+
+	// 重み付きの行(パターン)は全て使う(データ平均は重みで元のデータ数に戻る)
+	std::vector<int> data_indexes(dataset.size());
+	std::iota(data_indexes.begin(), data_indexes.end(), 0);
+
+	// Exact
+	calcExact(rbm, dataset, data_indexes);
+
+	// ワーカー間で勾配を平均
+	allReduceGradient(dataset.totalWeight());
+
+	// 勾配の更新
+	updateParams(rbm);
+
+	// オプティマイザの更新
+	optimizer.updateOptimizer();
+
+	// Trainer情報更新
+	RBM_PROFILE_EPOCH(_trainCount);
+	_trainCount++;
+}
+
+template<class OPTIMIZERTYPE>
+void Trainer<GeneralizedRBM, OPTIMIZERTYPE>::trainOncePT(GeneralizedRBM & rbm, std::vector<std::vector<double>> & dataset) {
+	RBM_PROFILE_SCOPE("trainOncePT");
+
+	rbm.trainType = "pt";
+
+	// 勾配初期化
+	initGradient();
+
+	// データインデックス集合
+	std::vector<int> data_indexes(dataset.size());
+
+	// ミニバッチ学習のためにデータインデックスをシャッフルする
+	std::iota(data_indexes.begin(), data_indexes.end(), 0);
+	std::shuffle(data_indexes.begin(), data_indexes.end(), this->randDevice);
+
+	// ミニバッチ
+	// バッチサイズの確認
+	int batch_size = this->batchSize < dataset.size() ? dataset.size() : this->batchSize;
+
+	// ミニバッチ学習に使うデータのインデックス集合
+	std::vector<int> minibatch_indexes(batch_size);
+	std::copy(data_indexes.begin(), data_indexes.begin() + batch_size, minibatch_indexes.begin());
+
+	// Parallel Tempering
+	calcReplicaExchange(rbm, dataset, minibatch_indexes);
+
+	// ワーカー間で勾配を平均
+	allReduceGradient(minibatch_indexes.size());
+
+	// 勾配の更新
+	updateParams(rbm);
+
+	// オプティマイザの更新
+	optimizer.updateOptimizer();
+
+	// Trainer情報更新
+	RBM_PROFILE_EPOCH(_trainCount);
+	_trainCount++;
+}
+
+template<class OPTIMIZERTYPE>
+void Trainer<GeneralizedRBM, OPTIMIZERTYPE>::trainOnceMF(GeneralizedRBM & rbm, std::vector<std::vector<double>> & dataset) {
+	RBM_PROFILE_SCOPE("trainOnceMF");
+
+	rbm.trainType = "mf";
+
+	// 勾配初期化
+	initGradient();
+
+	// データインデックス集合
+	std::vector<int> data_indexes(dataset.size());
+
+	// ミニバッチ学習のためにデータインデックスをシャッフルする
+	std::iota(data_indexes.begin(), data_indexes.end(), 0);
+	std::shuffle(data_indexes.begin(), data_indexes.end(), this->randDevice);
+
+	// ミニバッチ
+	// バッチサイズの確認
+	int batch_size = this->batchSize < dataset.size() ? dataset.size() : this->batchSize;
+
+	// ミニバッチ学習に使うデータのインデックス集合
+	std::vector<int> minibatch_indexes(batch_size);
+	std::copy(data_indexes.begin(), data_indexes.begin() + batch_size, minibatch_indexes.begin());
+
+	// Mean Field
+	calcMeanField(rbm, dataset, minibatch_indexes);
+
+	// ワーカー間で勾配を平均
+	allReduceGradient(minibatch_indexes.size());
+
 	// 勾配の更新
 	updateParams(rbm);
 
@@ -287,17 +600,24 @@ void Trainer<GeneralizedRBM, OPTIMIZERTYPE>::trainOnceExact(GeneralizedRBM & rbm
 	optimizer.updateOptimizer();
 
 	// Trainer情報更新
+	RBM_PROFILE_EPOCH(_trainCount);
 	_trainCount++;
 }
 
 
 template<class OPTIMIZERTYPE>
 void Trainer<GeneralizedRBM, OPTIMIZERTYPE>::calcContrastiveDivergence(GeneralizedRBM & rbm, std::vector<std::vector<double>> & dataset, std::vector<int> & data_indexes) {
-	// データ平均の計算
-	calcDataMean(rbm, dataset, data_indexes);
+	if (singlePrecision) {
+		calcDataMeanScalar<float>(rbm, dataset, data_indexes);
+		calcRBMExpectedCDScalar<float>(rbm, dataset, data_indexes);
+	}
+	else {
+		// データ平均の計算
+		calcDataMean(rbm, dataset, data_indexes);
 
-	// サンプル平均の計算(CD)
-	calcRBMExpectedCD(rbm, dataset, data_indexes);
+		// サンプル平均の計算(CD)
+		calcRBMExpectedCD(rbm, dataset, data_indexes);
+	}
 
 	// 勾配計算
 	calcGradient(rbm, data_indexes);
@@ -315,9 +635,47 @@ void Trainer<GeneralizedRBM, OPTIMIZERTYPE>::calcExact(GeneralizedRBM & rbm, std
 	calcGradient(rbm, data_indexes);
 }
 
+template<class OPTIMIZERTYPE>
+void Trainer<GeneralizedRBM, OPTIMIZERTYPE>::calcExact(GeneralizedRBM & rbm, PackedDataset & dataset, std::vector<int> & data_indexes) {
+	// データ平均の計算
+	calcDataMean(rbm, dataset, data_indexes);
+
+	// サンプル平均の計算
+	calcRBMExpectedExact(rbm);
+
+	// 勾配計算
+	calcGradient(rbm, data_indexes);
+}
+
+template<class OPTIMIZERTYPE>
+void Trainer<GeneralizedRBM, OPTIMIZERTYPE>::calcReplicaExchange(GeneralizedRBM & rbm, std::vector<std::vector<double>> & dataset, std::vector<int> & data_indexes) {
+	// データ平均の計算
+	calcDataMean(rbm, dataset, data_indexes);
+
+	// サンプル平均の計算(パラレルテンパリング)
+	calcRBMExpectedPT(rbm, dataset, data_indexes);
+
+	// 勾配計算
+	calcGradient(rbm, data_indexes);
+}
+
+template<class OPTIMIZERTYPE>
+void Trainer<GeneralizedRBM, OPTIMIZERTYPE>::calcMeanField(GeneralizedRBM & rbm, std::vector<std::vector<double>> & dataset, std::vector<int> & data_indexes) {
+	// データ平均の計算
+	calcDataMean(rbm, dataset, data_indexes);
+
+	// サンプル平均の計算(平均場近似)
+	calcRBMExpectedMF(rbm, dataset, data_indexes);
+
+	// 勾配計算
+	calcGradient(rbm, data_indexes);
+}
+
 
 template<class OPTIMIZERTYPE>
 void Trainer<GeneralizedRBM, OPTIMIZERTYPE>::calcDataMean(GeneralizedRBM & rbm, std::vector<std::vector<double>> & dataset, std::vector<int> & data_indexes) {
+	RBM_PROFILE_SCOPE("calcDataMean");
+
 	// 0埋め初期化
 	initDataMean();
 
@@ -350,23 +708,76 @@ void Trainer<GeneralizedRBM, OPTIMIZERTYPE>::calcDataMean(GeneralizedRBM & rbm,
 	dataMean.weight /= static_cast<double>(data_indexes.size());
 }
 
+template<class OPTIMIZERTYPE>
+void Trainer<GeneralizedRBM, OPTIMIZERTYPE>::calcDataMean(GeneralizedRBM & rbm, PackedDataset & dataset, std::vector<int> & data_indexes) {
+	RBM_PROFILE_SCOPE("calcDataMean");
+
+	// 0埋め初期化
+	initDataMean();
+
+	PackedVisibleKernel kernel(rbm);
+	if (!kernel.isCompatible(dataset)) throw std::runtime_error("calcDataMean: dataset does not match visibleValueSet");
+
+	auto v_size = rbm.getVisibleSize();
+	auto h_size = rbm.getHiddenSize();
+	PackedMoments moments(v_size, h_size, kernel.getLow(), kernel.getHigh());
+
+	auto index_size = data_indexes.size();
+#pragma omp parallel
+	{
+		PackedMoments local(v_size, h_size, kernel.getLow(), kernel.getHigh());
+		Eigen::VectorXd mu_vect;
+		Eigen::VectorXd act_vect(h_size);
+
+#pragma omp for schedule(static)
+		for (int n = 0; n < index_size; n++) {
+			auto words = dataset.row(data_indexes[n]);
+			kernel.muVect(words, mu_vect);
+			for (int j = 0; j < h_size; j++) {
+				act_vect(j) = rbm.actHidJ(j, mu_vect(j));
+			}
+
+			local.add(words, dataset.weight(data_indexes[n]), act_vect);
+		}
+
+#pragma omp critical
+		moments.merge(local);
+	}
+
+	// 重みの総和(データ数)で割る
+	auto data_size = moments.scaleSum();
+	dataMean.vBias = moments.visibleSum() / data_size;
+	dataMean.hBias = moments.hiddenSum() / data_size;
+	dataMean.weight = moments.visibleHiddenSum() / data_size;
+}
+
 template<class OPTIMIZERTYPE>
 void Trainer<GeneralizedRBM, OPTIMIZERTYPE>::calcRBMExpectedCD(GeneralizedRBM & rbm, std::vector<std::vector<double>> & dataset, std::vector<int> & data_indexes) {
+	RBM_PROFILE_SCOPE("calcRBMExpectedCD");
+
 	// 0埋め初期化
 	initRBMExpected();
 
+	// 可視層は2値なので, muはビット列から求める
+	PackedVisibleKernel kernel(rbm);
+
 	auto index_size = data_indexes.size();
+	RBM_PROFILE_COUNT(BytesCopied, index_size * rbmprof::modelBytes(rbm));
 #pragma omp parallel for schedule(static)
 	for (int n = 0; n < index_size; n++) {
 		auto & data = dataset[n];
 		Eigen::VectorXd vect = Eigen::Map<Eigen::VectorXd>(data.data(), data.size());
 
 		// GeneralizedRBMの初期値設定
-		rbm.nodes.v = vect;
 		auto rbm_replica = rbm;
+		rbm_replica.nodes.v = vect;
 
+		std::vector<rbmpack::Word> words(rbmpack::wordSize(rbm_replica.getVisibleSize()));
+		Eigen::VectorXd mu_vect;
+		kernel.pack(vect, words.data());
+		kernel.muVect(words.data(), mu_vect);
 		for (int j = 0; j < rbm_replica.getHiddenSize(); j++) {
-			rbm_replica.nodes.h(j) = rbm_replica.actHidJ(j);
+			rbm_replica.nodes.h(j) = rbm_replica.actHidJ(j, mu_vect(j));
 		}
 
 		// CD-K
@@ -374,7 +785,9 @@ void Trainer<GeneralizedRBM, OPTIMIZERTYPE>::calcRBMExpectedCD(GeneralizedRBM &
 		sampler.randEngine = this->randDevice;
 		for (int k = 0; k < cdk; k++) {
 			sampler.updateByBlockedGibbsSamplingVisible(rbm_replica);
-			sampler.updateByBlockedGibbsSamplingHidden(rbm_replica);
+			kernel.pack(rbm_replica.nodes.v, words.data());
+			kernel.muVect(words.data(), mu_vect);
+			sampler.updateByBlockedGibbsSamplingHidden(rbm_replica, mu_vect);
 		}
 
 		// 結果を格納
@@ -382,12 +795,7 @@ void Trainer<GeneralizedRBM, OPTIMIZERTYPE>::calcRBMExpectedCD(GeneralizedRBM &
 		{
 			rbmexpected.vBias += rbm_replica.nodes.v;
 			rbmexpected.hBias += rbm_replica.nodes.h;
-
-			for (int i = 0; i < rbm_replica.getVisibleSize(); i++) {
-				for (int j = 0; j < rbm_replica.getHiddenSize(); j++) {
-					rbmexpected.weight(i, j) += rbm_replica.nodes.v(i) * rbm_replica.nodes.h(j);
-				}
-			}
+			rbmexpected.weight.noalias() += rbm_replica.nodes.v * rbm_replica.nodes.h.transpose();
 		}
 	}
 
@@ -397,63 +805,204 @@ void Trainer<GeneralizedRBM, OPTIMIZERTYPE>::calcRBMExpectedCD(GeneralizedRBM &
 }
 
 template<class OPTIMIZERTYPE>
-void Trainer<GeneralizedRBM, OPTIMIZERTYPE>::calcRBMExpectedExact(GeneralizedRBM & rbm, std::vector<std::vector<double>> & dataset, std::vector<int> & data_indexes) {
-	// 0埋め初期化
-	initRBMExpected();
+template<class SCALAR>
+void Trainer<GeneralizedRBM, OPTIMIZERTYPE>::calcDataMeanScalar(GeneralizedRBM & rbm, std::vector<std::vector<double>> & dataset, std::vector<int> & data_indexes) {
+	RBM_PROFILE_SCOPE("calcDataMean");
 
-	StateCounter<std::vector<int>> sc(std::vector<int>(rbm.getVisibleSize(), 2));  // 可視変数Vの状態カウンター
-	auto & v_state_map = rbm.visibleValueSet;  // 可視変数の状態->値変換写像
+	typedef typename GeneralizedRBMKernel<SCALAR>::Vector Vector;
+	typedef typename GeneralizedRBMKernel<SCALAR>::Matrix Matrix;
+	GeneralizedRBMKernel<SCALAR> kernel(rbm);
 
-	auto max_count = sc.getMaxCount();
-#pragma omp parallel for schedule(static)
-	for (int c = 0; c < max_count; c++) {
-		// FIXME: stlのコピーは遅いぞ
-		auto sc_replica = sc;
-		sc_replica.innerCounter = c;
+	auto index_size = data_indexes.size();
+	Matrix v_data(rbm.getVisibleSize(), index_size);
+	Matrix h_data(rbm.getHiddenSize(), index_size);
+
+#pragma omp parallel
+	{
+		Vector v, h, mu_vect;
+
+#pragma omp for schedule(static)
+		for (int n = 0; n < index_size; n++) {
+			auto & data = dataset[data_indexes[n]];
+			v = Eigen::Map<Eigen::VectorXd>(data.data(), data.size()).cast<SCALAR>();
+			kernel.muVect(v, mu_vect);
+			kernel.actHidden(mu_vect, h);
+
+			v_data.col(n) = v;
+			h_data.col(n) = h;
+		}
+	}
 
-		auto v_state = sc_replica.getState();
-		auto rbm_replica = rbm;
+	auto size = static_cast<double>(index_size);
+	dataMean.vBias = v_data.rowwise().sum().template cast<double>() / size;
+	dataMean.hBias = h_data.rowwise().sum().template cast<double>() / size;
+	Matrix weight_sum = v_data * h_data.transpose();
+	dataMean.weight = weight_sum.template cast<double>() / size;
+}
+
+template<class OPTIMIZERTYPE>
+template<class SCALAR>
+void Trainer<GeneralizedRBM, OPTIMIZERTYPE>::calcRBMExpectedCDScalar(GeneralizedRBM & rbm, std::vector<std::vector<double>> & dataset, std::vector<int> & data_indexes) {
+	RBM_PROFILE_SCOPE("calcRBMExpectedCD");
 
-		// FIXME: v_i == 0 ときそのままcontinueしたほうが速いぞ
+	typedef typename GeneralizedRBMKernel<SCALAR>::Vector Vector;
+	typedef typename GeneralizedRBMKernel<SCALAR>::Matrix Matrix;
+	GeneralizedRBMKernel<SCALAR> kernel(rbm);
 
-		for (int i = 0; i < rbm_replica.getVisibleSize(); i++) {
-			rbm_replica.nodes.v(i) = v_state_map[v_state[i]];
+	// サンプルを列に並べておき, 最後に行列積でまとめて集計する
+	auto index_size = data_indexes.size();
+	Matrix v_samples(rbm.getVisibleSize(), index_size);
+	Matrix h_samples(rbm.getHiddenSize(), index_size);
+
+#pragma omp parallel
+	{
+		Vector v, h, mu_vect, lambda_vect;
+
+#pragma omp for schedule(static)
+		for (int n = 0; n < index_size; n++) {
+			auto & data = dataset[data_indexes[n]];
+			v = Eigen::Map<Eigen::VectorXd>(data.data(), data.size()).cast<SCALAR>();
+			kernel.muVect(v, mu_vect);
+			kernel.actHidden(mu_vect, h);
+
+			// CD-K
+			auto engine = this->randDevice;
+			for (int k = 0; k < cdk; k++) {
+				kernel.lambdaVect(h, lambda_vect);
+				kernel.sampleVisible(lambda_vect, engine, v);
+				kernel.muVect(v, mu_vect);
+				kernel.sampleHidden(mu_vect, engine, h);
+			}
+
+			v_samples.col(n) = v;
+			h_samples.col(n) = h;
 		}
+	}
 
+	// 行列積はSCALAR型のまま(丸め誤差はサンプリングの揺らぎより十分小さい), 平均はdoubleで持つ
+	auto size = static_cast<double>(index_size);
+	rbmexpected.vBias = v_samples.rowwise().sum().template cast<double>() / size;
+	rbmexpected.hBias = h_samples.rowwise().sum().template cast<double>() / size;
+	Matrix weight_sum = v_samples * h_samples.transpose();
+	rbmexpected.weight = weight_sum.template cast<double>() / size;
+}
 
-		auto b_dot_v = rbm_replica.nodes.getVisibleLayer().dot(rbm_replica.params.b);  // bとvの内積
-		auto mu_vect = rbm_replica.muVect();
-		auto sum_h_exp_mu = rbm_replica.sumHExpMu(mu_vect);
+template<class OPTIMIZERTYPE>
+void Trainer<GeneralizedRBM, OPTIMIZERTYPE>::calcRBMExpectedExact(GeneralizedRBM & rbm, std::vector<std::vector<double>> & dataset, std::vector<int> & data_indexes) {
+	calcRBMExpectedExact(rbm);
+}
 
-		// 期待値一括計算
-#pragma omp critical
-		{
-			// E[v_i]
-			for (int i = 0; i < rbm_replica.getVisibleSize(); i++) {
-				rbmexpected.vBias(i) += rbm_replica.nodes.v(i) * exp(b_dot_v) * sum_h_exp_mu;
-			}
+template<class OPTIMIZERTYPE>
+void Trainer<GeneralizedRBM, OPTIMIZERTYPE>::calcRBMExpectedExact(GeneralizedRBM & rbm) {
+	RBM_PROFILE_SCOPE("calcRBMExpectedExact");
 
-			// E[v_i h_j] and E[h_j]
-			for (int j = 0; j < rbm_replica.getHiddenSize(); j++) {
-				auto mu_j = mu_vect(j);
-				rbmexpected.hBias(j) += exp(b_dot_v) * sum_h_exp_mu * rbm_replica.actHidJ(j, mu_j);
-				for (int i = 0; i < rbm_replica.getVisibleSize(); i++) {
-					rbmexpected.weight(i, j) += rbm_replica.nodes.v(i) * exp(b_dot_v) * sum_h_exp_mu * rbm_replica.actHidJ(j, mu_j);
-				}
+	// 0埋め初期化
+	initRBMExpected();
+
+	// 可視変数の状態cのビット列はc自身(StateCounterの2進の桁と同じ並び)
+	PackedVisibleKernel kernel(rbm);
+	auto v_size = rbm.getVisibleSize();
+	auto h_size = rbm.getHiddenSize();
+	PackedMoments moments(v_size, h_size, kernel.getLow(), kernel.getHigh());
+
+	long long max_count = 1LL << v_size;
+	RBM_PROFILE_COUNT(StatesEnumerated, max_count);
+#pragma omp parallel
+	{
+		PackedMoments local(v_size, h_size, kernel.getLow(), kernel.getHigh());
+		Eigen::VectorXd mu_vect;
+		Eigen::VectorXd act_vect(h_size);
+
+#pragma omp for schedule(static)
+		for (long long c = 0; c < max_count; c++) {
+			rbmpack::Word word = static_cast<rbmpack::Word>(c);
+
+			auto b_dot_v = kernel.visibleDot(&word);  // bとvの内積
+			kernel.muVect(&word, mu_vect);
+			auto sum_h_exp_mu = rbm.sumHExpMu(mu_vect);
+
+			for (int j = 0; j < h_size; j++) {
+				act_vect(j) = rbm.actHidJ(j, mu_vect(j));
 			}
+
+			// 状態cの非正規化確率で重み付け
+			local.add(&word, exp(b_dot_v) * sum_h_exp_mu, act_vect);
 		}
+
+#pragma omp critical
+		moments.merge(local);
 	}
 
-	auto z = rbm.getNormalConstant();
-	rbmexpected.vBias /= z;
-	rbmexpected.hBias /= z;
-	rbmexpected.weight /= z;
+	// 重みの総和が分配関数
+	auto z = moments.scaleSum();
+	rbmexpected.vBias = moments.visibleSum() / z;
+	rbmexpected.hBias = moments.hiddenSum() / z;
+	rbmexpected.weight = moments.visibleHiddenSum() / z;
+}
+
+template<class OPTIMIZERTYPE>
+void Trainer<GeneralizedRBM, OPTIMIZERTYPE>::calcRBMExpectedPT(GeneralizedRBM & rbm, std::vector<std::vector<double>> & dataset, std::vector<int> & data_indexes) {
+	RBM_PROFILE_SCOPE("calcRBMExpectedPT");
+
+	// 0埋め初期化
+	initRBMExpected();
+
+	// レプリカは持続的なマルコフ連鎖として使いまわす
+	if (replicaSampler.getReplicaSize() != replicaSize) {
+		replicaSampler.randEngine = std::mt19937(this->randDevice());
+		replicaSampler.init(rbm, replicaSize, replicaBetaMin);
+	}
+	else {
+		replicaSampler.syncParams(rbm);
+	}
+
+	// 1サンプルあたりのスイープ数
+	int sweep_num = cdk < 1 ? 1 : cdk;
+
+	auto sample_size = data_indexes.size();
+	for (int n = 0; n < sample_size; n++) {
+		replicaSampler.updateByReplicaExchange(rbm, sweep_num);
+
+		auto & v = replicaSampler.replicas[0].nodes.v;
+		auto & h = replicaSampler.replicas[0].nodes.h;
+		rbmexpected.vBias += v;
+		rbmexpected.hBias += h;
+		rbmexpected.weight.noalias() += v * h.transpose();
+	}
+
+	rbmexpected.vBias /= static_cast<double>(sample_size);
+	rbmexpected.hBias /= static_cast<double>(sample_size);
+	rbmexpected.weight /= static_cast<double>(sample_size);
+}
+
+template<class OPTIMIZERTYPE>
+void Trainer<GeneralizedRBM, OPTIMIZERTYPE>::calcRBMExpectedMF(GeneralizedRBM & rbm, std::vector<std::vector<double>> & dataset, std::vector<int> & data_indexes) {
+	RBM_PROFILE_SCOPE("calcRBMExpectedMF");
+
+	// 0埋め初期化
+	initRBMExpected();
+
+	// ミニバッチのデータを磁化の初期値にする
+	Eigen::MatrixXd v_batch(data_indexes.size(), rbm.getVisibleSize());
+	for (int n = 0; n < data_indexes.size(); n++) {
+		auto & data = dataset[data_indexes[n]];
+		v_batch.row(n) = Eigen::Map<Eigen::VectorXd>(data.data(), data.size()).transpose();
+	}
+
+	meanField.init(rbm, v_batch);
+	meanField.iterate(rbm);
+
+	rbmexpected.vBias = meanField.expectedValueVis();
+	rbmexpected.hBias = meanField.expectedValueHid();
+	rbmexpected.weight = meanField.expectedValueVisHid(rbm);
 }
 
 
 // 勾配の計算
 template<class OPTIMIZERTYPE>
 void Trainer<GeneralizedRBM, OPTIMIZERTYPE>::calcGradient(GeneralizedRBM & rbm, std::vector<int> & data_indexes) {
+	RBM_PROFILE_SCOPE("calcGradient");
+
 	// 勾配ベクトルリセット
 	initGradient();
 
@@ -471,9 +1020,21 @@ void Trainer<GeneralizedRBM, OPTIMIZERTYPE>::calcGradient(GeneralizedRBM & rbm,
 }
 
 
+// 勾配のall-reduce(オプティマイザより前に全ワーカーで同じ勾配にそろえる)
+template<class OPTIMIZERTYPE>
+void Trainer<GeneralizedRBM, OPTIMIZERTYPE>::allReduceGradient(double batch_size) {
+	if (communicator == nullptr) return;
+	RBM_PROFILE_SCOPE("allReduceGradient");
+
+	communicator->allReduceMean(batch_size, gradient.vBias, gradient.hBias, gradient.weight);
+}
+
+
 // パラメータの更新
 template<class OPTIMIZERTYPE>
 void Trainer<GeneralizedRBM, OPTIMIZERTYPE>::updateParams(GeneralizedRBM & rbm) {
+	RBM_PROFILE_SCOPE("updateParams");
+
 	for (int i = 0; i < rbm.getVisibleSize(); i++) {
 		rbm.params.b(i) += optimizer.getNewParamVBias(gradient.vBias(i), i);
 
@@ -491,6 +1052,8 @@ void Trainer<GeneralizedRBM, OPTIMIZERTYPE>::updateParams(GeneralizedRBM & rbm)
 // 対数尤度関数
 template<class OPTIMIZERTYPE>
 double Trainer<GeneralizedRBM, OPTIMIZERTYPE>::logLikeliHood(GeneralizedRBM & rbm, std::vector<std::vector<double>> & dataset) {
+	RBM_PROFILE_SCOPE("logLikeliHood");
+
 	double value = 0.0;
 
 	auto z = rbm.getNormalConstant();
@@ -503,6 +1066,26 @@ double Trainer<GeneralizedRBM, OPTIMIZERTYPE>::logLikeliHood(GeneralizedRBM & rb
 	return value;
 }
 
+template<class OPTIMIZERTYPE>
+double Trainer<GeneralizedRBM, OPTIMIZERTYPE>::logLikeliHood(GeneralizedRBM & rbm, PackedDataset & dataset) {
+	RBM_PROFILE_SCOPE("logLikeliHood");
+
+	PackedVisibleKernel kernel(rbm);
+	if (!kernel.isCompatible(dataset)) throw std::runtime_error("logLikeliHood: dataset does not match visibleValueSet");
+
+	double value = 0.0;
+
+	auto z = rbm.getNormalConstant();
+
+	// 同じパターンは重み(データ数)倍するだけ
+	for (size_t n = 0; n < dataset.size(); n++) {
+		auto prob = kernel.probVis(rbm, dataset.row(n), z);
+		value += dataset.weight(n) * log(prob);
+	}
+
+	return value;
+}
+
 // 学習情報出力(JSON)
 template<class OPTIMIZERTYPE>
 std::string Trainer<GeneralizedRBM, OPTIMIZERTYPE>::trainInfoJson(GeneralizedRBM & rbm) {
@@ -524,6 +1107,36 @@ void Trainer<GeneralizedRBM, OPTIMIZERTYPE>::trainFromTrainInfo(GeneralizedRBM &
 	_trainCount = js["trainCount"];
 	learningRate = js["learningRate"];
 	cdk = js["cdk"];
-	rbm.setHiddenDiveSize(js["divSize"]);
+	rbm.setHiddenDivSize(js["divSize"]);
 	rbm.setRealHiddenValue(js["realFlag"]);
 }
+
+template<class OPTIMIZERTYPE>
+void Trainer<GeneralizedRBM, OPTIMIZERTYPE>::writeCheckpoint(rbmckpt::Writer & writer, GeneralizedRBM & rbm) {
+	writer.addScalar("trainer.trainCount", _trainCount);
+	writer.addScalar("trainer.epoch", epoch);
+	writer.addScalar("trainer.batchSize", batchSize);
+	writer.addScalar("trainer.cdk", cdk);
+	writer.addScalar("trainer.learningRate", learningRate);
+	writer.addScalar("trainer.singlePrecision", singlePrecision ? 1.0 : 0.0);
+	rbmckpt::addEngine(writer, "trainer.rand", this->randDevice);
+	this->optimizer.writeCheckpoint(writer, "optimizer.");
+	writer.addScalar("trainer.replicaSize", replicaSize);
+	writer.addScalar("trainer.replicaBetaMin", replicaBetaMin);
+	replicaSampler.writeCheckpoint(writer, "trainer.pt.");
+}
+
+template<class OPTIMIZERTYPE>
+void Trainer<GeneralizedRBM, OPTIMIZERTYPE>::readCheckpoint(rbmckpt::Reader & reader, GeneralizedRBM & rbm) {
+	_trainCount = static_cast<int>(reader.scalar("trainer.trainCount"));
+	epoch = static_cast<int>(reader.scalar("trainer.epoch"));
+	batchSize = static_cast<int>(reader.scalar("trainer.batchSize"));
+	cdk = static_cast<int>(reader.scalar("trainer.cdk"));
+	learningRate = reader.scalar("trainer.learningRate");
+	singlePrecision = reader.scalar("trainer.singlePrecision") != 0.0;
+	rbmckpt::readEngine(reader, "trainer.rand", this->randDevice);
+	this->optimizer.readCheckpoint(reader, "optimizer.");
+	replicaSize = static_cast<int>(reader.scalar("trainer.replicaSize"));
+	replicaBetaMin = reader.scalar("trainer.replicaBetaMin");
+	replicaSampler.readCheckpoint(reader, "trainer.pt.", rbm);
+}
@@ -0,0 +1,201 @@
+﻿#pragma once
+#include "../Checkpoint.h"
+#include "GeneralizedRBM.h"
+#include "Eigen/Core"
+#include <vector>
+#include <string>
+#include <memory>
+#include <cmath>
+#include <random>
+#include <algorithm>
+#include <stdexcept>
+
+// チェックポイント(rbmckpt)をmmapしたGeneralizedRBMの読み取り専用ビュー
+// パラメータはコピーせずマッピングをEigen::Mapで参照するので, 同じファイルを開いたプロセス間で物理ページが共有される
+// (/dev/shm以下に置けば名前付き共有メモリ, ホストあたり1コピー)
+// 推論(隠れ層の期待値, 非正規化対数確率, サンプリング)のみ, 列がサンプルのバッチで計算する
+// ビューはマッピングを保持するので, ファイルが差し替えられても参照が無くなるまで古い版のまま有効
+class GeneralizedRBMView {
+public:
+	typedef Eigen::Map<const Eigen::VectorXd> VectorMap;
+	typedef Eigen::Map<const Eigen::MatrixXd> MatrixMap;
+
+protected:
+	std::shared_ptr<const rbmckpt::Reader> _reader;
+	double _hMin = 0.0;
+	double _hMax = 1.0;
+	bool _realFlag = false;
+	Eigen::ArrayXd _hiddenValues;  // 隠れ変数の取りうる値(離散型)
+
+public:
+	const VectorMap b;  // 可視変数のバイアス
+	const VectorMap c;  // 隠れ変数のバイアス
+	const MatrixMap w;  // 可視変数-隠れ変数間のカップリング
+	std::vector<double> visibleValueSet = { -1.0, 1.0 };
+
+public:
+	explicit GeneralizedRBMView(const std::shared_ptr<const rbmckpt::Reader> & reader)
+		: _reader(reader), b(reader->vector("b")), c(reader->vector("c")), w(reader->matrix("w")) {
+		if (reader->modelType() != "GeneralizedRBM") throw std::runtime_error("GeneralizedRBMView: model type mismatch " + reader->modelType());
+		if (w.rows() != b.size() || w.cols() != c.size()) throw std::runtime_error("GeneralizedRBMView: shape mismatch");
+
+		if (reader->has("hiddenValues")) {
+			_hMin = reader->scalar("hiddenMin");
+			_hMax = reader->scalar("hiddenMax");
+			_hiddenValues = reader->vector("hiddenValues").array();
+		}
+		else {
+			_hiddenValues.resize(2);
+			_hiddenValues << _hMin, _hMax;
+		}
+		if (reader->has("hiddenRealFlag")) _realFlag = reader->scalar("hiddenRealFlag") != 0.0;
+	}
+	~GeneralizedRBMView() = default;
+
+	// ファイルを開いてビューを作る
+	static std::shared_ptr<const GeneralizedRBMView> open(const std::string & path, bool verify = true) {
+		auto reader = std::make_shared<const rbmckpt::Reader>(path, verify);
+		return std::make_shared<const GeneralizedRBMView>(reader);
+	}
+
+	size_t getVisibleSize() const {
+		return b.size();
+	}
+
+	size_t getHiddenSize() const {
+		return c.size();
+	}
+
+	bool isRealHiddenValue() const {
+		return _realFlag;
+	}
+
+	// 参照しているチェックポイントのチェックサム(版の識別に使う)
+	uint64_t getChecksum() const {
+		return _reader->header().checksum;
+	}
+
+	// 学習用のモデルへ写す(学習の再開等)
+	void copyTo(GeneralizedRBM & rbm) const {
+		rbm = GeneralizedRBM(getVisibleSize(), getHiddenSize());
+		rbm.setHiddenMin(_hMin);
+		rbm.setHiddenMax(_hMax);
+		rbm.setHiddenDivSize(std::max<size_t>(_hiddenValues.size(), 2) - 1);
+		rbm.setRealHiddenValue(_realFlag);
+		rbm.visibleValueSet = visibleValueSet;
+		rbm.params.b = b;
+		rbm.params.c = c;
+		rbm.params.w = w;
+	}
+
+	// 各列の隠れ変数に関する外部磁場と相互作用, mu = c + w^T v
+	void muBatch(const Eigen::MatrixXd & v_batch, Eigen::MatrixXd & mu_batch) const {
+		mu_batch.noalias() = w.transpose() * v_batch;
+		mu_batch.colwise() += c;
+	}
+
+	// 各列の可視変数に関する外部磁場と相互作用, lambda = b + w h
+	void lambdaBatch(const Eigen::MatrixXd & h_batch, Eigen::MatrixXd & lambda_batch) const {
+		lambda_batch.noalias() = w * h_batch;
+		lambda_batch.colwise() += b;
+	}
+
+	// 各列の隠れ変数の期待値 E[h_j | v]
+	void actHiddenBatch(const Eigen::MatrixXd & mu_batch, Eigen::MatrixXd & h_batch) const {
+		h_batch.resize(mu_batch.rows(), mu_batch.cols());
+		for (int n = 0; n < mu_batch.cols(); n++) {
+			for (int j = 0; j < mu_batch.rows(); j++) {
+				h_batch(j, n) = actHidden(mu_batch(j, n));
+			}
+		}
+	}
+
+	// 各列の可視変数の非正規化対数周辺確率, b^T v + sum_j log sum_h exp(mu_j h)
+	Eigen::VectorXd logMarginal(const Eigen::MatrixXd & v_batch) const {
+		Eigen::MatrixXd mu_batch;
+		muBatch(v_batch, mu_batch);
+
+		Eigen::VectorXd value = v_batch.transpose() * b;
+		for (int n = 0; n < v_batch.cols(); n++) {
+			for (int j = 0; j < mu_batch.rows(); j++) {
+				value(n) += logNormalizerHidden(mu_batch(j, n));
+			}
+		}
+		return value;
+	}
+
+	// 各列の可視層をギブスサンプリング(可視変数は2値)
+	template <class ENGINE>
+	void sampleVisible(const Eigen::MatrixXd & lambda_batch, ENGINE & engine, Eigen::MatrixXd & v_batch) const {
+		std::uniform_real_distribution<double> dist(0.0, 1.0);
+		auto low = visibleValueSet[0];
+		auto high = visibleValueSet[1];
+
+		// P(v_i = low | h) = 1 / (1 + exp((high - low) lambda_i))
+		v_batch.resize(lambda_batch.rows(), lambda_batch.cols());
+		for (int n = 0; n < lambda_batch.cols(); n++) {
+			for (int i = 0; i < lambda_batch.rows(); i++) {
+				auto prob_low = 1.0 / (1.0 + std::exp((high - low) * lambda_batch(i, n)));
+				v_batch(i, n) = dist(engine) < prob_low ? low : high;
+			}
+		}
+	}
+
+	// 各列の隠れ層をギブスサンプリング
+	template <class ENGINE>
+	void sampleHidden(const Eigen::MatrixXd & mu_batch, ENGINE & engine, Eigen::MatrixXd & h_batch) const {
+		std::uniform_real_distribution<double> dist(0.0, 1.0);
+
+		h_batch.resize(mu_batch.rows(), mu_batch.cols());
+		for (int n = 0; n < mu_batch.cols(); n++) {
+			for (int j = 0; j < mu_batch.rows(); j++) {
+				auto mu_j = mu_batch(j, n);
+				auto u = dist(engine);
+
+				// 連続型は逆関数法で
+				if (_realFlag) {
+					auto z_j = (std::exp(_hMax * mu_j) - std::exp(_hMin * mu_j)) / mu_j;
+					h_batch(j, n) = std::log(z_j * u * mu_j + std::exp(_hMin * mu_j)) / mu_j;
+					continue;
+				}
+
+				// 離散型: 累積がu * sum exp(mu h)を超えた値
+				Eigen::ArrayXd terms = (mu_j * _hiddenValues - (mu_j * _hiddenValues).maxCoeff()).exp();
+				auto threshold = u * terms.sum();
+				double cumulative = 0.0;
+				auto value = _hiddenValues(_hiddenValues.size() - 1);
+				for (int k = 0; k < _hiddenValues.size() - 1; k++) {
+					cumulative += terms(k);
+					if (threshold < cumulative) {
+						value = _hiddenValues(k);
+						break;
+					}
+				}
+				h_batch(j, n) = value;
+			}
+		}
+	}
+
+protected:
+	double actHidden(double mu_j) const {
+		if (_realFlag) {
+			// FIXME: 0除算の可能性あり(GeneralizedRBMと同じ)
+			auto exp_max = std::exp(_hMax * mu_j);
+			auto exp_min = std::exp(_hMin * mu_j);
+			return (_hMax * exp_max - _hMin * exp_min) / (exp_max - exp_min) - 1 / mu_j;
+		}
+
+		Eigen::ArrayXd terms = (mu_j * _hiddenValues - (mu_j * _hiddenValues).maxCoeff()).exp();
+		return (_hiddenValues * terms).sum() / terms.sum();
+	}
+
+	double logNormalizerHidden(double mu_j) const {
+		if (_realFlag) {
+			// log((exp(hMax mu) - exp(hMin mu)) / mu)
+			return std::log((std::exp(_hMax * mu_j) - std::exp(_hMin * mu_j)) / mu_j);
+		}
+
+		auto shift = (mu_j * _hiddenValues).maxCoeff();
+		return shift + std::log((mu_j * _hiddenValues - shift).exp().sum());
+	}
+};
@@ -0,0 +1,39 @@
+﻿#pragma once
+#include "../Sampler.h"
+#include "GeneralizedRBMView.h"
+#include "Eigen/Core"
+#include <random>
+
+// 読み取り専用ビュー上のサンプラー(状態はビューでなく呼び出し側のバッチが持つ)
+template<>
+class Sampler<GeneralizedRBMView> {
+public:
+	std::mt19937 randEngine = std::mt19937();
+
+public:
+	Sampler() {
+		std::random_device rd;
+		this->randEngine = std::mt19937(rd());
+	}
+	Sampler(const std::mt19937 & rand_engine) : randEngine(rand_engine) {
+	}
+	~Sampler() = default;
+
+	// バッチの各列の隠れ変数をサンプリング
+	void sampleHiddenBatch(const GeneralizedRBMView & view, const Eigen::MatrixXd & v_batch, Eigen::MatrixXd & h_batch) {
+		RBM_PROFILE_COUNT(Sweeps, v_batch.cols());
+
+		Eigen::MatrixXd mu_batch;
+		view.muBatch(v_batch, mu_batch);
+		view.sampleHidden(mu_batch, this->randEngine, h_batch);
+	}
+
+	// バッチの各列の可視変数をサンプリング
+	void sampleVisibleBatch(const GeneralizedRBMView & view, const Eigen::MatrixXd & h_batch, Eigen::MatrixXd & v_batch) {
+		RBM_PROFILE_COUNT(Sweeps, h_batch.cols());
+
+		Eigen::MatrixXd lambda_batch;
+		view.lambdaBatch(h_batch, lambda_batch);
+		view.sampleVisible(lambda_batch, this->randEngine, v_batch);
+	}
+};
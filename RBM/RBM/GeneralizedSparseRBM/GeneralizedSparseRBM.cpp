@@ -1,4 +1,6 @@
 ﻿#include "GeneralizedSparseRBM.h"
+#include <cmath>
+#include "../Profiler.h"
 
 
 
@@ -31,11 +33,15 @@ size_t GeneralizedSparseRBM::getHiddenSize() {
 
 // 規格化定数を返します
 double GeneralizedSparseRBM::getNormalConstant() {
+	RBM_PROFILE_SCOPE("getNormalConstant");
+
 	StateCounter<std::vector<int>> sc(std::vector<int>(vSize, 2));  // 可視変数Vの状態カウンター
 	auto & v_state_map = this->visibleValueSet;  // 可視変数の状態->値変換写像
 
 	double z = 0.0;
 	auto max_count = sc.getMaxCount();
+	RBM_PROFILE_COUNT(StatesEnumerated, max_count);
+	RBM_PROFILE_COUNT(ExpEvaluations, max_count * (1 + hSize * (realFlag ? 2 : hiddenValueSet.size())));
 	for (int c = 0; c < max_count; c++, sc++) {
 		// FIXME: stlのコピーは遅いぞ
 		auto v_state = sc.getState();
@@ -79,8 +85,24 @@ double GeneralizedSparseRBM::getNormalConstant() {
 
 // エネルギー関数を返します
 double GeneralizedSparseRBM::getEnergy() {
-	// まだ必要ないため実装保留
-	throw;
+	Eigen::MatrixXd v_batch = nodes.v.transpose();
+	Eigen::MatrixXd h_batch = nodes.h.transpose();
+	return this->getEnergyBatch(v_batch, h_batch)(0);
+}
+
+// エネルギー関数を一括計算します
+// E(v, h) = -b^T v - mu(v)^T h + sum_j exp(sparse_j) |h_j| を行列積でまとめて計算
+Eigen::VectorXd GeneralizedSparseRBM::getEnergyBatch(const Eigen::MatrixXd & v_batch, const Eigen::MatrixXd & h_batch) {
+	// 各行の隠れ変数に関する外部磁場と相互作用, mu = c + W^T v
+	Eigen::MatrixXd mu_batch = v_batch * params.w;
+	mu_batch.rowwise() += params.c.transpose();
+
+	Eigen::VectorXd energy = -(v_batch * params.b) - mu_batch.cwiseProduct(h_batch).rowwise().sum();
+
+	// スパース項
+	energy.noalias() += h_batch.cwiseAbs() * params.sparse.array().exp().matrix();
+
+	return energy;
 }
 
 
@@ -102,7 +124,7 @@ double GeneralizedSparseRBM::actHidJ(int hindex, double mu)
 	// 離散型
 	auto discrete = [&]()
 	{
-		auto value_set = splitHiddenSet();
+		auto & value_set = hiddenValueSet;
 		auto mu_j = mu;
 		auto mu_star_j = this->muStar(hindex);
 		double numer = 0.0;  // 分子
@@ -292,8 +314,14 @@ double GeneralizedSparseRBM::condProbVis(int vindex, double value) {
 
 // 可視変数を条件で与えた隠れ変数の条件付き確率, P(h_j | v)
 double GeneralizedSparseRBM::condProbHid(int hindex, double value) {
-	double mu_j = mu(hindex);
-	double prob = exp(mu_j * value - this->muStar(hindex) * abs(value)) / miniNormalizeConstantHidden(hindex);
+	double prob = this->condProbHid(hindex, value, this->mu(hindex));
+	return prob;
+}
+
+double GeneralizedSparseRBM::condProbHid(int hindex, double value, double mu)
+{
+	double mu_j = mu;
+	double prob = exp(mu_j * value - this->muStar(hindex) * abs(value)) / miniNormalizeConstantHidden(hindex, mu_j);
 	return prob;
 }
 
@@ -427,7 +455,7 @@ double GeneralizedSparseRBM::expectedValueVis(int vindex, double normalize_const
 		value += term;
 
 		// debug
-		if (isinf(value) || isnan(value)) {
+		if (std::isinf(value) || std::isnan(value)) {
 			volatile auto debug_value = value;
 			throw;
 		}
@@ -540,7 +568,7 @@ double GeneralizedSparseRBM::expectedValueHid(int hindex, double normalize_const
 	}
 
 	// debug
-	if (isinf(value) || isnan(value)) {
+	if (std::isinf(value) || std::isnan(value)) {
 		volatile auto debug_value = value;
 		throw;
 	}
@@ -652,7 +680,7 @@ double GeneralizedSparseRBM::expectedValueVisHid(int vindex, int hindex, double
 	}
 
 	// debug
-	if (isinf(value) || isnan(value)) {
+	if (std::isinf(value) || std::isnan(value)) {
 		volatile auto debug_value = value;
 		throw;
 	}
@@ -764,7 +792,7 @@ double GeneralizedSparseRBM::expectedValueAbsHid(int hindex, double normalize_co
 	}
 
 	// debug
-	if (isinf(value) || isnan(value)) {
+	if (std::isinf(value) || std::isnan(value)) {
 		volatile auto debug_value = value;
 		throw;
 	}
@@ -798,7 +826,7 @@ double GeneralizedSparseRBM::actHidSparseJ(int hindex, double mu)
 	// 離散型
 	auto discrete = [&]()
 	{
-		auto value_set = splitHiddenSet();
+		auto & value_set = hiddenValueSet;
 		auto mu_j = mu;
 		double numer = 0.0;  // 分子
 		double denom = miniNormalizeConstantHidden(hindex, mu_j);  // 分母
@@ -42,6 +42,9 @@ public:
 	// エネルギー関数を返します
 	double getEnergy();
 
+	// エネルギー関数を一括計算します(各行が1つの配位, 戻り値の各要素が各行のエネルギー)
+	Eigen::VectorXd getEnergyBatch(const Eigen::MatrixXd & v_batch, const Eigen::MatrixXd & h_batch);
+
 	// 自由エネルギーを返します
 	double getFreeEnergy();
 
@@ -83,6 +86,9 @@ public:
 	// 可視変数を条件で与えた隠れ変数の条件付き確率, P(h_j | v)
 	double condProbHid(int hindex, double value);
 
+	// 可視変数を条件で与えた隠れ変数の条件付き確率, P(h_j | v)
+	double condProbHid(int hindex, double value, double mu);
+
 	// 可視変数の期待値, E[v_i]
 	double expectedValueVis(int vindex);
 
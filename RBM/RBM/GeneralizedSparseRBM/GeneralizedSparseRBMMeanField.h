@@ -0,0 +1,23 @@
+﻿#pragma once
+#include "../MeanField.h"
+#include "GeneralizedSparseRBM.h"
+#include "Eigen/Core"
+#include <vector>
+#include <cmath>
+
+// 隠れ変数の基底測度の対数, -exp(sparse_j) |h_j|
+template<>
+inline Eigen::MatrixXd MeanField<GeneralizedSparseRBM>::hiddenLogMeasure(GeneralizedSparseRBM & rbm, std::vector<double> & grid) {
+	Eigen::MatrixXd log_measure = Eigen::MatrixXd::Zero(rbm.getHiddenSize(), grid.size());
+
+	for (int k = 0; k < grid.size(); k++) {
+		log_measure.col(k) = -abs(grid[k]) * rbm.params.sparse.array().exp();
+	}
+
+	// 連続値の場合は積分の刻み幅
+	if (rbm.isRealHiddenValue()) {
+		log_measure.array() += log((rbm.getHiddenMax() - rbm.getHiddenMin()) / grid.size());
+	}
+
+	return log_measure;
+}
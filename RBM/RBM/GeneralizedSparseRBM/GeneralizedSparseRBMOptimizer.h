@@ -1,6 +1,7 @@
 #pragma once
 #include <fstream>
 #include "../Optimizer.h"
+#include "../Checkpoint.h"
 #include "GeneralizedSparseRBM.h"
 #include <cmath>
 
@@ -23,6 +24,9 @@ public:
 	double getNewParamHSparse(double gradient, int hindex);
 	// next timestep
 	void updateOptimizer();
+	// 状態(反復回数, モーメント)のチェックポイント(登録した配列は書き出しまで保持すること)
+	void writeCheckpoint(rbmckpt::Writer & writer, const std::string & prefix);
+	void readCheckpoint(rbmckpt::Reader & reader, const std::string & prefix);
 };
 
 inline Optimizer<GeneralizedSparseRBM, OptimizerType::Default>::Optimizer(GeneralizedSparseRBM & rbm) {
@@ -33,6 +37,14 @@ inline void Optimizer<GeneralizedSparseRBM, OptimizerType::Default>::updateOptim
 	this->_iteration++;
 }
 
+inline void Optimizer<GeneralizedSparseRBM, OptimizerType::Default>::writeCheckpoint(rbmckpt::Writer & writer, const std::string & prefix) {
+	writer.addScalar(prefix + "iteration", this->_iteration);
+}
+
+inline void Optimizer<GeneralizedSparseRBM, OptimizerType::Default>::readCheckpoint(rbmckpt::Reader & reader, const std::string & prefix) {
+	this->_iteration = static_cast<int>(reader.scalar(prefix + "iteration"));
+}
+
 inline void Optimizer<GeneralizedSparseRBM, OptimizerType::Default>::init(GeneralizedSparseRBM & rbm) {
 
 }
@@ -49,6 +61,10 @@ inline double Optimizer<GeneralizedSparseRBM, OptimizerType::Default>::getNewPar
 	return _learningRate * gradient;
 }
 
+inline double Optimizer<GeneralizedSparseRBM, OptimizerType::Default>::getNewParamHSparse(double gradient, int hindex) {
+	return _learningRate * gradient;
+}
+
 
 template <>
 class Optimizer<GeneralizedSparseRBM, OptimizerType::Momentum> {
@@ -79,6 +95,9 @@ public:
 	double getNewParamWeight(double gradient, int vindex, int hindex);
 	// next timestep
 	void updateOptimizer();
+	// 状態(反復回数, モーメント)のチェックポイント(登録した配列は書き出しまで保持すること)
+	void writeCheckpoint(rbmckpt::Writer & writer, const std::string & prefix);
+	void readCheckpoint(rbmckpt::Reader & reader, const std::string & prefix);
 };
 
 inline Optimizer<GeneralizedSparseRBM, OptimizerType::Momentum>::Optimizer(GeneralizedSparseRBM & rbm) {
@@ -89,6 +108,22 @@ inline void Optimizer<GeneralizedSparseRBM, OptimizerType::Momentum>::updateOpti
 	this->_iteration++;
 }
 
+inline void Optimizer<GeneralizedSparseRBM, OptimizerType::Momentum>::writeCheckpoint(rbmckpt::Writer & writer, const std::string & prefix) {
+	writer.addScalar(prefix + "iteration", this->_iteration);
+	writer.add(prefix + "moment1st.vBias", this->moment1st.vBias);
+	writer.add(prefix + "moment1st.hBias", this->moment1st.hBias);
+	writer.add(prefix + "moment1st.hSparse", this->moment1st.hSparse);
+	writer.add(prefix + "moment1st.weight", this->moment1st.weight);
+}
+
+inline void Optimizer<GeneralizedSparseRBM, OptimizerType::Momentum>::readCheckpoint(rbmckpt::Reader & reader, const std::string & prefix) {
+	this->_iteration = static_cast<int>(reader.scalar(prefix + "iteration"));
+	this->moment1st.vBias = reader.vector(prefix + "moment1st.vBias");
+	this->moment1st.hBias = reader.vector(prefix + "moment1st.hBias");
+	this->moment1st.hSparse = reader.vector(prefix + "moment1st.hSparse");
+	this->moment1st.weight = reader.matrix(prefix + "moment1st.weight");
+}
+
 // Momentum
 inline void Optimizer<GeneralizedSparseRBM, OptimizerType::Momentum>::init(GeneralizedSparseRBM & rbm) {
 	this->moment1st.vBias.setConstant(rbm.getVisibleSize(), 0.0);
@@ -145,6 +180,9 @@ public:
 	double getNewParamWeight(double gradient, int vindex, int hindex);
 	// next timestep
 	void updateOptimizer();
+	// 状態(反復回数, モーメント)のチェックポイント(登録した配列は書き出しまで保持すること)
+	void writeCheckpoint(rbmckpt::Writer & writer, const std::string & prefix);
+	void readCheckpoint(rbmckpt::Reader & reader, const std::string & prefix);
 };
 
 inline Optimizer<GeneralizedSparseRBM, OptimizerType::AdaGrad>::Optimizer(GeneralizedSparseRBM & rbm) {
@@ -155,6 +193,22 @@ inline void Optimizer<GeneralizedSparseRBM, OptimizerType::AdaGrad>::updateOptim
 	this->_iteration++;
 }
 
+inline void Optimizer<GeneralizedSparseRBM, OptimizerType::AdaGrad>::writeCheckpoint(rbmckpt::Writer & writer, const std::string & prefix) {
+	writer.addScalar(prefix + "iteration", this->_iteration);
+	writer.add(prefix + "moment2nd.vBias", this->moment2nd.vBias);
+	writer.add(prefix + "moment2nd.hBias", this->moment2nd.hBias);
+	writer.add(prefix + "moment2nd.hSparse", this->moment2nd.hSparse);
+	writer.add(prefix + "moment2nd.weight", this->moment2nd.weight);
+}
+
+inline void Optimizer<GeneralizedSparseRBM, OptimizerType::AdaGrad>::readCheckpoint(rbmckpt::Reader & reader, const std::string & prefix) {
+	this->_iteration = static_cast<int>(reader.scalar(prefix + "iteration"));
+	this->moment2nd.vBias = reader.vector(prefix + "moment2nd.vBias");
+	this->moment2nd.hBias = reader.vector(prefix + "moment2nd.hBias");
+	this->moment2nd.hSparse = reader.vector(prefix + "moment2nd.hSparse");
+	this->moment2nd.weight = reader.matrix(prefix + "moment2nd.weight");
+}
+
 // AdaGrad
 inline void Optimizer<GeneralizedSparseRBM, OptimizerType::AdaGrad>::init(GeneralizedSparseRBM & rbm) {
 	this->moment2nd.vBias.setConstant(rbm.getVisibleSize(), 0.0);
@@ -223,6 +277,9 @@ public:
 	double getNewParamWeight(double gradient, int vindex, int hindex);
 	// next timestep
 	void updateOptimizer();
+	// 状態(反復回数, モーメント)のチェックポイント(登録した配列は書き出しまで保持すること)
+	void writeCheckpoint(rbmckpt::Writer & writer, const std::string & prefix);
+	void readCheckpoint(rbmckpt::Reader & reader, const std::string & prefix);
 };
 
 inline Optimizer<GeneralizedSparseRBM, OptimizerType::AdaDelta>::Optimizer(GeneralizedSparseRBM & rbm) {
@@ -233,6 +290,30 @@ inline void Optimizer<GeneralizedSparseRBM, OptimizerType::AdaDelta>::updateOpti
 	this->_iteration++;
 }
 
+inline void Optimizer<GeneralizedSparseRBM, OptimizerType::AdaDelta>::writeCheckpoint(rbmckpt::Writer & writer, const std::string & prefix) {
+	writer.addScalar(prefix + "iteration", this->_iteration);
+	writer.add(prefix + "moment1st.vBias", this->moment1st.vBias);
+	writer.add(prefix + "moment1st.hBias", this->moment1st.hBias);
+	writer.add(prefix + "moment1st.hSparse", this->moment1st.hSparse);
+	writer.add(prefix + "moment1st.weight", this->moment1st.weight);
+	writer.add(prefix + "moment2nd.vBias", this->moment2nd.vBias);
+	writer.add(prefix + "moment2nd.hBias", this->moment2nd.hBias);
+	writer.add(prefix + "moment2nd.hSparse", this->moment2nd.hSparse);
+	writer.add(prefix + "moment2nd.weight", this->moment2nd.weight);
+}
+
+inline void Optimizer<GeneralizedSparseRBM, OptimizerType::AdaDelta>::readCheckpoint(rbmckpt::Reader & reader, const std::string & prefix) {
+	this->_iteration = static_cast<int>(reader.scalar(prefix + "iteration"));
+	this->moment1st.vBias = reader.vector(prefix + "moment1st.vBias");
+	this->moment1st.hBias = reader.vector(prefix + "moment1st.hBias");
+	this->moment1st.hSparse = reader.vector(prefix + "moment1st.hSparse");
+	this->moment1st.weight = reader.matrix(prefix + "moment1st.weight");
+	this->moment2nd.vBias = reader.vector(prefix + "moment2nd.vBias");
+	this->moment2nd.hBias = reader.vector(prefix + "moment2nd.hBias");
+	this->moment2nd.hSparse = reader.vector(prefix + "moment2nd.hSparse");
+	this->moment2nd.weight = reader.matrix(prefix + "moment2nd.weight");
+}
+
 // AdaDelta
 inline void Optimizer<GeneralizedSparseRBM, OptimizerType::AdaDelta>::init(GeneralizedSparseRBM & rbm) {
 	this->moment1st.vBias.setConstant(rbm.getVisibleSize(), 0.0);
@@ -314,6 +395,9 @@ public:
 	double getNewParamWeight(double gradient, int vindex, int hindex);
 	// next timestep
 	void updateOptimizer();
+	// 状態(反復回数, モーメント)のチェックポイント(登録した配列は書き出しまで保持すること)
+	void writeCheckpoint(rbmckpt::Writer & writer, const std::string & prefix);
+	void readCheckpoint(rbmckpt::Reader & reader, const std::string & prefix);
 };
 
 inline Optimizer<GeneralizedSparseRBM, OptimizerType::Adam>::Optimizer(GeneralizedSparseRBM & rbm) {
@@ -324,6 +408,30 @@ inline void Optimizer<GeneralizedSparseRBM, OptimizerType::Adam>::updateOptimize
 	this->_iteration++;
 }
 
+inline void Optimizer<GeneralizedSparseRBM, OptimizerType::Adam>::writeCheckpoint(rbmckpt::Writer & writer, const std::string & prefix) {
+	writer.addScalar(prefix + "iteration", this->_iteration);
+	writer.add(prefix + "moment1st.vBias", this->moment1st.vBias);
+	writer.add(prefix + "moment1st.hBias", this->moment1st.hBias);
+	writer.add(prefix + "moment1st.hSparse", this->moment1st.hSparse);
+	writer.add(prefix + "moment1st.weight", this->moment1st.weight);
+	writer.add(prefix + "moment2nd.vBias", this->moment2nd.vBias);
+	writer.add(prefix + "moment2nd.hBias", this->moment2nd.hBias);
+	writer.add(prefix + "moment2nd.hSparse", this->moment2nd.hSparse);
+	writer.add(prefix + "moment2nd.weight", this->moment2nd.weight);
+}
+
+inline void Optimizer<GeneralizedSparseRBM, OptimizerType::Adam>::readCheckpoint(rbmckpt::Reader & reader, const std::string & prefix) {
+	this->_iteration = static_cast<int>(reader.scalar(prefix + "iteration"));
+	this->moment1st.vBias = reader.vector(prefix + "moment1st.vBias");
+	this->moment1st.hBias = reader.vector(prefix + "moment1st.hBias");
+	this->moment1st.hSparse = reader.vector(prefix + "moment1st.hSparse");
+	this->moment1st.weight = reader.matrix(prefix + "moment1st.weight");
+	this->moment2nd.vBias = reader.vector(prefix + "moment2nd.vBias");
+	this->moment2nd.hBias = reader.vector(prefix + "moment2nd.hBias");
+	this->moment2nd.hSparse = reader.vector(prefix + "moment2nd.hSparse");
+	this->moment2nd.weight = reader.matrix(prefix + "moment2nd.weight");
+}
+
 // Adam
 inline void Optimizer<GeneralizedSparseRBM, OptimizerType::Adam>::init(GeneralizedSparseRBM & rbm) {
 	this->moment1st.vBias.setConstant(rbm.getVisibleSize(), 0.0);
@@ -414,6 +522,9 @@ public:
 	double getNewParamWeight(double gradient, int vindex, int hindex);
 	// next timestep
 	void updateOptimizer();
+	// 状態(反復回数, モーメント)のチェックポイント(登録した配列は書き出しまで保持すること)
+	void writeCheckpoint(rbmckpt::Writer & writer, const std::string & prefix);
+	void readCheckpoint(rbmckpt::Reader & reader, const std::string & prefix);
 };
 
 inline Optimizer<GeneralizedSparseRBM, OptimizerType::AdaMax>::Optimizer(GeneralizedSparseRBM & rbm) {
@@ -424,6 +535,30 @@ inline void Optimizer<GeneralizedSparseRBM, OptimizerType::AdaMax>::updateOptimi
 	this->_iteration++;
 }
 
+inline void Optimizer<GeneralizedSparseRBM, OptimizerType::AdaMax>::writeCheckpoint(rbmckpt::Writer & writer, const std::string & prefix) {
+	writer.addScalar(prefix + "iteration", this->_iteration);
+	writer.add(prefix + "moment1st.vBias", this->moment1st.vBias);
+	writer.add(prefix + "moment1st.hBias", this->moment1st.hBias);
+	writer.add(prefix + "moment1st.hSparse", this->moment1st.hSparse);
+	writer.add(prefix + "moment1st.weight", this->moment1st.weight);
+	writer.add(prefix + "moment2nd.vBias", this->moment2nd.vBias);
+	writer.add(prefix + "moment2nd.hBias", this->moment2nd.hBias);
+	writer.add(prefix + "moment2nd.hSparse", this->moment2nd.hSparse);
+	writer.add(prefix + "moment2nd.weight", this->moment2nd.weight);
+}
+
+inline void Optimizer<GeneralizedSparseRBM, OptimizerType::AdaMax>::readCheckpoint(rbmckpt::Reader & reader, const std::string & prefix) {
+	this->_iteration = static_cast<int>(reader.scalar(prefix + "iteration"));
+	this->moment1st.vBias = reader.vector(prefix + "moment1st.vBias");
+	this->moment1st.hBias = reader.vector(prefix + "moment1st.hBias");
+	this->moment1st.hSparse = reader.vector(prefix + "moment1st.hSparse");
+	this->moment1st.weight = reader.matrix(prefix + "moment1st.weight");
+	this->moment2nd.vBias = reader.vector(prefix + "moment2nd.vBias");
+	this->moment2nd.hBias = reader.vector(prefix + "moment2nd.hBias");
+	this->moment2nd.hSparse = reader.vector(prefix + "moment2nd.hSparse");
+	this->moment2nd.weight = reader.matrix(prefix + "moment2nd.weight");
+}
+
 // AdaMax
 inline void Optimizer<GeneralizedSparseRBM, OptimizerType::AdaMax>::init(GeneralizedSparseRBM & rbm) {
 	this->moment1st.vBias.setConstant(rbm.getVisibleSize(), 0.0);
@@ -1,4 +1,5 @@
 ﻿#include "GeneralizedSparseRBMParamator.h"
+#include "../Checkpoint.h"
 #include <iostream>
 
 GeneralizedSparseRBMParamator::GeneralizedSparseRBMParamator(size_t v_size, size_t h_size) {
@@ -157,6 +158,30 @@ void GeneralizedSparseRBMParamator::deserialize(std::string js) {
 	this->sparse = Eigen::Map<Eigen::VectorXd>(tmp_sparse.data(), hSize);
 }
 
+// チェックポイントに登録
+void GeneralizedSparseRBMParamator::writeCheckpoint(rbmckpt::Writer & writer) {
+	writer.setModelType("GeneralizedSparseRBM");
+	writer.add("b", this->b);
+	writer.add("c", this->c);
+	writer.add("w", this->w);
+	writer.add("sparse", this->sparse);
+}
+
+// チェックポイントから復元
+void GeneralizedSparseRBMParamator::readCheckpoint(rbmckpt::Reader & reader) {
+	if (reader.modelType() != "GeneralizedSparseRBM") throw std::runtime_error("GeneralizedSparseRBMParamator: model type mismatch " + reader.modelType());
+	auto ckpt_b = reader.vector("b");
+	auto ckpt_c = reader.vector("c");
+	auto ckpt_w = reader.matrix("w");
+	auto ckpt_sparse = reader.vector("sparse");
+	if (ckpt_b.size() != vSize || ckpt_c.size() != hSize || ckpt_w.rows() != vSize || ckpt_w.cols() != hSize || ckpt_sparse.size() != hSize) throw std::runtime_error("GeneralizedSparseRBMParamator: shape mismatch");
+
+	this->b = ckpt_b;
+	this->c = ckpt_c;
+	this->w = ckpt_w;
+	this->sparse = ckpt_sparse;
+}
+
 // 隠れ変数のスパースパラメータを返す
 double GeneralizedSparseRBMParamator::getHiddenSparse(int hindex) {
 	return sparse(hindex);
@@ -4,6 +4,11 @@
 #include "json.hpp"
 #include <random>
 
+namespace rbmckpt {
+	class Writer;
+	class Reader;
+}
+
 class GeneralizedSparseRBMParamator : RBMParamatorBase {
 private:
 	size_t vSize;
@@ -61,6 +66,12 @@ public:
 	// パラメータ情報のデシリアライズ
 	void deserialize(std::string js);
 
+	// チェックポイントに登録(配列はコピーしない)
+	void writeCheckpoint(rbmckpt::Writer & writer);
+
+	// チェックポイントから復元(同じ形であること)
+	void readCheckpoint(rbmckpt::Reader & reader);
+
 	// 隠れ変数のスパースパラメータを返す
 	double getHiddenSparse(int hindex);
 
@@ -1,5 +1,6 @@
 ﻿#pragma once
 #include "../Sampler.h"
+#include "../ReplicaExchangeSampler.h"
 #include "GeneralizedSparseRBM.h"
 #include "Eigen/Core"
 #include <vector>
@@ -22,6 +23,9 @@ public:
 	// 隠れ変数一つをギブスサンプリング
 	double gibbsSamplingHidden(GeneralizedSparseRBM & rbm, int hindex);
 
+	// 隠れ変数一つをギブスサンプリング(muを与える)
+	double gibbsSamplingHidden(GeneralizedSparseRBM & rbm, int hindex, double mu);
+
 	// 可視層すべてをギブスサンプリング
 	Eigen::VectorXd & blockedGibbsSamplingVisible(GeneralizedSparseRBM & rbm);
 
@@ -39,6 +43,9 @@ public:
 
 	// 隠れ層すべてをギブスサンプリングで更新
 	Eigen::VectorXd & updateByBlockedGibbsSamplingHidden(GeneralizedSparseRBM & rbm);
+
+	// 隠れ層すべてをギブスサンプリングで更新(muを一括で与える)
+	Eigen::VectorXd & updateByBlockedGibbsSamplingHidden(GeneralizedSparseRBM & rbm, const Eigen::VectorXd & mu_vect);
 };
 
 
@@ -56,13 +63,16 @@ inline double Sampler<GeneralizedSparseRBM>::gibbsSamplingVisible(GeneralizedSpa
 }
 
 inline double Sampler<GeneralizedSparseRBM>::gibbsSamplingHidden(GeneralizedSparseRBM & rbm, int hindex) {
+	return gibbsSamplingHidden(rbm, hindex, rbm.mu(hindex));
+}
+
+inline double Sampler<GeneralizedSparseRBM>::gibbsSamplingHidden(GeneralizedSparseRBM & rbm, int hindex, double mu) {
 	// 離散型
 	auto sample_discrete = [&] {
-		std::vector<double> probs(rbm.getHiddenValueSetSize());
-		auto hidset = rbm.splitHiddenSet();
+		auto & hidset = rbm.hiddenValueSet;
+		std::vector<double> probs(hidset.size());
 		for (int i = 0; i < hidset.size(); i++) {
-			// FIXME: 分配関数の計算を使いまわせば高速化可能
-			probs[i] = rbm.condProbHid(hindex, hidset[i]);
+			probs[i] = rbm.condProbHid(hindex, hidset[i], mu);
 		}
 
 		std::discrete_distribution<> dist(probs.begin(), probs.end());
@@ -87,8 +97,6 @@ inline double Sampler<GeneralizedSparseRBM>::gibbsSamplingHidden(GeneralizedSpar
 
 
 		auto f = [&](double t, double mu, double mu_star) {
-			auto z_j = rbm.miniNormalizeConstantHidden(hindex);
-
 			double value = 0.0;
 			// tの値で分岐せよ
 			if (t < 0) {
@@ -107,7 +115,6 @@ inline double Sampler<GeneralizedSparseRBM>::gibbsSamplingHidden(GeneralizedSpar
 		auto h_max = rbm.getHiddenMax();
 		auto h_min = rbm.getHiddenMin();
 
-		auto mu = rbm.mu(hindex);
 		auto mu_star = rbm.muStar(hindex);
 		auto z_j = rbm.miniNormalizeConstantHidden(hindex, mu);
 
@@ -163,6 +170,7 @@ inline double Sampler<GeneralizedSparseRBM>::updateByGibbsSamplingHidden(General
 }
 
 inline Eigen::VectorXd & Sampler<GeneralizedSparseRBM>::updateByBlockedGibbsSamplingVisible(GeneralizedSparseRBM & rbm) {
+	RBM_PROFILE_COUNT(Sweeps, 1);
 
 	for (int i = 0; i < rbm.getVisibleSize(); i++) {
 		updateByGibbsSamplingVisible(rbm, i);
@@ -172,9 +180,31 @@ inline Eigen::VectorXd & Sampler<GeneralizedSparseRBM>::updateByBlockedGibbsSamp
 }
 
 inline Eigen::VectorXd & Sampler<GeneralizedSparseRBM>::updateByBlockedGibbsSamplingHidden(GeneralizedSparseRBM & rbm) {
+	RBM_PROFILE_COUNT(Sweeps, 1);
 	for (int j = 0; j < rbm.getHiddenSize(); j++) {
 		updateByGibbsSamplingHidden(rbm, j);
 	}
 
 	return rbm.nodes.h;
 }
+
+inline Eigen::VectorXd & Sampler<GeneralizedSparseRBM>::updateByBlockedGibbsSamplingHidden(GeneralizedSparseRBM & rbm, const Eigen::VectorXd & mu_vect) {
+	RBM_PROFILE_COUNT(Sweeps, 1);
+	for (int j = 0; j < rbm.getHiddenSize(); j++) {
+		rbm.nodes.h(j) = gibbsSamplingHidden(rbm, j, mu_vect(j));
+	}
+
+	return rbm.nodes.h;
+}
+
+
+// レプリカ交換用, 逆温度betaのパラメータを設定
+template<>
+inline void ReplicaExchangeSampler<GeneralizedSparseRBM>::temperParams(GeneralizedSparseRBM & replica, GeneralizedSparseRBM & rbm, double beta) {
+	replica.params.b = beta * rbm.params.b;
+	replica.params.c = beta * rbm.params.c;
+	replica.params.w = beta * rbm.params.w;
+
+	// exp(sparse)に逆温度を掛ける
+	replica.params.sparse = rbm.params.sparse.array() + log(beta);
+}
@@ -1,9 +1,12 @@
 ﻿#pragma once
 #include "Eigen/Core"
 #include "../Trainer.h"
+#include "../Checkpoint.h"
 #include "GeneralizedSparseRBM.h"
 #include "GeneralizedSparseRBMSampler.h"
+#include "GeneralizedSparseRBMMeanField.h"
 #include "GeneralizedSparseRBMOptimizer.h"
+#include "../PackedVisible.h"
 #include <vector>
 #include <random>
 
@@ -46,6 +49,14 @@ public:
 	double learningRate = 0.01;
 	std::mt19937 randDevice = std::mt19937(std::random_device()());
 
+	// パラレルテンパリングの設定
+	int replicaSize = 8;  // レプリカ数
+	double replicaBetaMin = 0.1;  // 最高温度レプリカの逆温度
+	ReplicaExchangeSampler<GeneralizedSparseRBM> replicaSampler;
+
+	// 平均場近似(TAP近似)の設定
+	MeanField<GeneralizedSparseRBM> meanField;
+
 public:
 	Trainer() = default;
 	Trainer(GeneralizedSparseRBM & rbm);
@@ -74,6 +85,8 @@ public:
 
 	void trainCD(GeneralizedSparseRBM & rbm, std::vector<std::vector<double>> & dataset);
 	void trainExact(GeneralizedSparseRBM & rbm, std::vector<std::vector<double>> & dataset);
+	void trainPT(GeneralizedSparseRBM & rbm, std::vector<std::vector<double>> & dataset);
+	void trainMF(GeneralizedSparseRBM & rbm, std::vector<std::vector<double>> & dataset);
 
 
 	// 1回だけ学習
@@ -81,6 +94,9 @@ public:
 
 	void trainOnceCD(GeneralizedSparseRBM & rbm, std::vector<std::vector<double>> & dataset);
 	void trainOnceExact(GeneralizedSparseRBM & rbm, std::vector<std::vector<double>> & dataset);
+	void trainOnceExact(GeneralizedSparseRBM & rbm, PackedDataset & dataset);
+	void trainOncePT(GeneralizedSparseRBM & rbm, std::vector<std::vector<double>> & dataset);
+	void trainOnceMF(GeneralizedSparseRBM & rbm, std::vector<std::vector<double>> & dataset);
 
 
 	// CD計算
@@ -89,15 +105,36 @@ public:
 	// CD計算
 	void calcExact(GeneralizedSparseRBM & rbm, std::vector<std::vector<double>> & dataset, std::vector<int> & data_indexes);
 
+	// 厳密計算(ビット列データ)
+	void calcExact(GeneralizedSparseRBM & rbm, PackedDataset & dataset, std::vector<int> & data_indexes);
+
+	// パラレルテンパリング計算
+	void calcReplicaExchange(GeneralizedSparseRBM & rbm, std::vector<std::vector<double>> & dataset, std::vector<int> & data_indexes);
+
+	// 平均場近似計算
+	void calcMeanField(GeneralizedSparseRBM & rbm, std::vector<std::vector<double>> & dataset, std::vector<int> & data_indexes);
+
 	// データ平均の計算
 	void calcDataMean(GeneralizedSparseRBM & rbm, std::vector<std::vector<double>> & dataset, std::vector<int> & data_indexes);
 
+	// データ平均の計算(ビット列データ, 行の重み付き)
+	void calcDataMean(GeneralizedSparseRBM & rbm, PackedDataset & dataset, std::vector<int> & data_indexes);
+
 	// サンプル平均の計算
 	void calcRBMExpectedCD(GeneralizedSparseRBM & rbm, std::vector<std::vector<double>> & dataset, std::vector<int> & data_indexes);
 
 	// サンプル平均の計算
 	void calcRBMExpectedExact(GeneralizedSparseRBM & rbm, std::vector<std::vector<double>> & dataset, std::vector<int> & data_indexes);
 
+	// サンプル平均の計算(全状態の厳密計算, データに依存しない)
+	void calcRBMExpectedExact(GeneralizedSparseRBM & rbm);
+
+	// サンプル平均の計算(パラレルテンパリング)
+	void calcRBMExpectedPT(GeneralizedSparseRBM & rbm, std::vector<std::vector<double>> & dataset, std::vector<int> & data_indexes);
+
+	// サンプル平均の計算(平均場近似)
+	void calcRBMExpectedMF(GeneralizedSparseRBM & rbm, std::vector<std::vector<double>> & dataset, std::vector<int> & data_indexes);
+
 
 	// 勾配の計算
 	void calcGradient(GeneralizedSparseRBM & rbm, std::vector<int> & data_indexes);
@@ -108,11 +145,19 @@ public:
 	// 対数尤度関数
 	double logLikeliHood(GeneralizedSparseRBM & rbm, std::vector<std::vector<double>> & dataset);
 
+	// 対数尤度関数(ビット列データ, 行の重み付き)
+	double logLikeliHood(GeneralizedSparseRBM & rbm, PackedDataset & dataset);
+
 	// 学習情報出力(JSON)
 	std::string trainInfoJson(GeneralizedSparseRBM & rbm);
 
 	// 学習情報から学習(JSON)
 	void trainFromTrainInfo(GeneralizedSparseRBM & rbm, std::string json);
+
+	// 学習状態(反復回数, オプティマイザのモーメント, 乱数, チェイン)のチェックポイント
+	// モデルと合わせてrbmckpt::saveTraining/loadTrainingから使う
+	void writeCheckpoint(rbmckpt::Writer & writer, GeneralizedSparseRBM & rbm);
+	void readCheckpoint(rbmckpt::Reader & reader, GeneralizedSparseRBM & rbm);
 };
 
 template<class OPTIMIZERTYPE>
@@ -192,11 +237,27 @@ inline void Trainer<GeneralizedSparseRBM, OPTIMIZERTYPE>::trainExact(Generalized
 	}
 }
 
+template<class OPTIMIZERTYPE>
+inline void Trainer<GeneralizedSparseRBM, OPTIMIZERTYPE>::trainPT(GeneralizedSparseRBM & rbm, std::vector<std::vector<double>> & dataset) {
+	for (int e = 0; e < epoch; e++) {
+		trainOncePT(rbm, dataset);
+	}
+}
+
+template<class OMFIMIZERTYPE>
+inline void Trainer<GeneralizedSparseRBM, OMFIMIZERTYPE>::trainMF(GeneralizedSparseRBM & rbm, std::vector<std::vector<double>> & dataset) {
+	for (int e = 0; e < epoch; e++) {
+		trainOnceMF(rbm, dataset);
+	}
+}
+
 
 // FIXME: CDとExactをフラグで切り分けられるように
 // 1回だけ学習
 template<class OPTIMIZERTYPE>
 inline void Trainer<GeneralizedSparseRBM, OPTIMIZERTYPE>::trainOnce(GeneralizedSparseRBM & rbm, std::vector<std::vector<double>> & dataset) {
+	RBM_PROFILE_SCOPE("trainOnce");
+
 	// 勾配初期化
 	initGradient();
 
@@ -225,11 +286,14 @@ inline void Trainer<GeneralizedSparseRBM, OPTIMIZERTYPE>::trainOnce(GeneralizedS
 	optimizer.updateOptimizer();
 
 	// Trainer情報更新
+	RBM_PROFILE_EPOCH(_trainCount);
 	_trainCount++;
 }
 
 template<class OPTIMIZERTYPE>
 inline void Trainer<GeneralizedSparseRBM, OPTIMIZERTYPE>::trainOnceCD(GeneralizedSparseRBM & rbm, std::vector<std::vector<double>> & dataset) {
+	RBM_PROFILE_SCOPE("trainOnceCD");
+
 	// RBMに学習タイプを記憶
 	rbm.trainType = "cd";
 
@@ -261,11 +325,14 @@ inline void Trainer<GeneralizedSparseRBM, OPTIMIZERTYPE>::trainOnceCD(Generalize
 	optimizer.updateOptimizer();
 
 	// Trainer情報更新
+	RBM_PROFILE_EPOCH(_trainCount);
 	_trainCount++;
 }
 
 template<class OPTIMIZERTYPE>
 inline void Trainer<GeneralizedSparseRBM, OPTIMIZERTYPE>::trainOnceExact(GeneralizedSparseRBM & rbm, std::vector<std::vector<double>> & dataset) {
+	RBM_PROFILE_SCOPE("trainOnceExact");
+
 	rbm.trainType = "exact";
 
 
@@ -297,6 +364,112 @@ inline void Trainer<GeneralizedSparseRBM, OPTIMIZERTYPE>::trainOnceExact(General
 	optimizer.updateOptimizer();
 
 	// Trainer情報更新
+	RBM_PROFILE_EPOCH(_trainCount);
+	_trainCount++;
+}
+
+template<class OPTIMIZERTYPE>
+inline void Trainer<GeneralizedSparseRBM, OPTIMIZERTYPE>::trainOnceExact(GeneralizedSparseRBM & rbm, PackedDataset & dataset) {
+	RBM_PROFILE_SCOPE("trainOnceExact");
+
+	rbm.trainType = "exact";
+
+	// 勾配初期化
+	initGradient();
+
+	// 重み付きの行(パターン)は全て使う(データ平均は重みで元のデータ数に戻る)
+	std::vector<int> data_indexes(dataset.size());
+	std::iota(data_indexes.begin(), data_indexes.end(), 0);
+
+	// Exact
+	calcExact(rbm, dataset, data_indexes);
+
+	// 勾配の更新
+	updateParams(rbm);
+
+	// オプティマイザの更新
+	optimizer.updateOptimizer();
+
+	// Trainer情報更新
+	RBM_PROFILE_EPOCH(_trainCount);
+	_trainCount++;
+}
+
+template<class OPTIMIZERTYPE>
+inline void Trainer<GeneralizedSparseRBM, OPTIMIZERTYPE>::trainOncePT(GeneralizedSparseRBM & rbm, std::vector<std::vector<double>> & dataset) {
+	RBM_PROFILE_SCOPE("trainOncePT");
+
+	rbm.trainType = "pt";
+
+
+	// 勾配初期化
+	initGradient();
+
+	// データインデックス集合
+	std::vector<int> data_indexes(dataset.size());
+
+	// ミニバッチ学習のためにデータインデックスをシャッフルする
+	std::iota(data_indexes.begin(), data_indexes.end(), 0);
+	std::shuffle(data_indexes.begin(), data_indexes.end(), this->randDevice);
+
+	// ミニバッチ
+	// バッチサイズの確認
+	int batch_size = this->batchSize < dataset.size() ? dataset.size() : this->batchSize;
+
+	// ミニバッチ学習に使うデータのインデックス集合
+	std::vector<int> minibatch_indexes(batch_size);
+	std::copy(data_indexes.begin(), data_indexes.begin() + batch_size, minibatch_indexes.begin());
+
+	// Parallel Tempering
+	calcReplicaExchange(rbm, dataset, minibatch_indexes);
+
+	// 勾配の更新
+	updateParams(rbm);
+
+	// オプティマイザの更新
+	optimizer.updateOptimizer();
+
+	// Trainer情報更新
+	RBM_PROFILE_EPOCH(_trainCount);
+	_trainCount++;
+}
+
+template<class OPTIMIZERTYPE>
+inline void Trainer<GeneralizedSparseRBM, OPTIMIZERTYPE>::trainOnceMF(GeneralizedSparseRBM & rbm, std::vector<std::vector<double>> & dataset) {
+	RBM_PROFILE_SCOPE("trainOnceMF");
+
+	rbm.trainType = "mf";
+
+
+	// 勾配初期化
+	initGradient();
+
+	// データインデックス集合
+	std::vector<int> data_indexes(dataset.size());
+
+	// ミニバッチ学習のためにデータインデックスをシャッフルする
+	std::iota(data_indexes.begin(), data_indexes.end(), 0);
+	std::shuffle(data_indexes.begin(), data_indexes.end(), this->randDevice);
+
+	// ミニバッチ
+	// バッチサイズの確認
+	int batch_size = this->batchSize < dataset.size() ? dataset.size() : this->batchSize;
+
+	// ミニバッチ学習に使うデータのインデックス集合
+	std::vector<int> minibatch_indexes(batch_size);
+	std::copy(data_indexes.begin(), data_indexes.begin() + batch_size, minibatch_indexes.begin());
+
+	// Mean Field
+	calcMeanField(rbm, dataset, minibatch_indexes);
+
+	// 勾配の更新
+	updateParams(rbm);
+
+	// オプティマイザの更新
+	optimizer.updateOptimizer();
+
+	// Trainer情報更新
+	RBM_PROFILE_EPOCH(_trainCount);
 	_trainCount++;
 }
 
@@ -325,13 +498,52 @@ inline void Trainer<GeneralizedSparseRBM, OPTIMIZERTYPE>::calcExact(GeneralizedS
 	calcGradient(rbm, data_indexes);
 }
 
+template<class OPTIMIZERTYPE>
+inline void Trainer<GeneralizedSparseRBM, OPTIMIZERTYPE>::calcExact(GeneralizedSparseRBM & rbm, PackedDataset & dataset, std::vector<int> & data_indexes) {
+	// データ平均の計算
+	calcDataMean(rbm, dataset, data_indexes);
+
+	// サンプル平均の計算
+	calcRBMExpectedExact(rbm);
+
+	// 勾配計算
+	calcGradient(rbm, data_indexes);
+}
+
+template<class OPTIMIZERTYPE>
+inline void Trainer<GeneralizedSparseRBM, OPTIMIZERTYPE>::calcReplicaExchange(GeneralizedSparseRBM & rbm, std::vector<std::vector<double>> & dataset, std::vector<int> & data_indexes) {
+	// データ平均の計算
+	calcDataMean(rbm, dataset, data_indexes);
+
+	// サンプル平均の計算(パラレルテンパリング)
+	calcRBMExpectedPT(rbm, dataset, data_indexes);
+
+	// 勾配計算
+	calcGradient(rbm, data_indexes);
+}
+
+template<class OPTIMIZERTYPE>
+inline void Trainer<GeneralizedSparseRBM, OPTIMIZERTYPE>::calcMeanField(GeneralizedSparseRBM & rbm, std::vector<std::vector<double>> & dataset, std::vector<int> & data_indexes) {
+	// データ平均の計算
+	calcDataMean(rbm, dataset, data_indexes);
+
+	// サンプル平均の計算(平均場近似)
+	calcRBMExpectedMF(rbm, dataset, data_indexes);
+
+	// 勾配計算
+	calcGradient(rbm, data_indexes);
+}
+
 
 template<class OPTIMIZERTYPE>
 inline void Trainer<GeneralizedSparseRBM, OPTIMIZERTYPE>::calcDataMean(GeneralizedSparseRBM & rbm, std::vector<std::vector<double>> & dataset, std::vector<int> & data_indexes) {
+	RBM_PROFILE_SCOPE("calcDataMean");
+
 	// 0埋め初期化
 	initDataMean();
 
 	auto index_size = data_indexes.size();
+	RBM_PROFILE_COUNT(BytesCopied, index_size * rbmprof::modelBytes(rbm));
     #pragma omp parallel for schedule(static)
 	for (int n = 0; n < index_size; n++) {
 		auto rbm_replica = rbm;
@@ -363,12 +575,69 @@ inline void Trainer<GeneralizedSparseRBM, OPTIMIZERTYPE>::calcDataMean(Generaliz
 }
 
 
+template<class OPTIMIZERTYPE>
+inline void Trainer<GeneralizedSparseRBM, OPTIMIZERTYPE>::calcDataMean(GeneralizedSparseRBM & rbm, PackedDataset & dataset, std::vector<int> & data_indexes) {
+	RBM_PROFILE_SCOPE("calcDataMean");
+
+	// 0埋め初期化
+	initDataMean();
+
+	PackedVisibleKernel kernel(rbm);
+	if (!kernel.isCompatible(dataset)) throw std::runtime_error("calcDataMean: dataset does not match visibleValueSet");
+
+	auto v_size = rbm.getVisibleSize();
+	auto h_size = rbm.getHiddenSize();
+	PackedMoments moments(v_size, h_size, kernel.getLow(), kernel.getHigh());
+	Eigen::VectorXd h_sparse_sum = Eigen::VectorXd::Zero(h_size);
+
+	auto index_size = data_indexes.size();
+#pragma omp parallel
+	{
+		PackedMoments local(v_size, h_size, kernel.getLow(), kernel.getHigh());
+		Eigen::VectorXd local_h_sparse = Eigen::VectorXd::Zero(h_size);
+		Eigen::VectorXd mu_vect;
+		Eigen::VectorXd act_vect(h_size);
+
+#pragma omp for schedule(static)
+		for (int n = 0; n < index_size; n++) {
+			auto words = dataset.row(data_indexes[n]);
+			kernel.muVect(words, mu_vect);
+			for (int j = 0; j < h_size; j++) {
+				act_vect(j) = rbm.actHidJ(j, mu_vect(j));
+				local_h_sparse(j) += dataset.weight(data_indexes[n]) * rbm.actHidSparseJ(j, mu_vect(j));
+			}
+
+			local.add(words, dataset.weight(data_indexes[n]), act_vect);
+		}
+
+#pragma omp critical
+		{
+			moments.merge(local);
+			h_sparse_sum += local_h_sparse;
+		}
+	}
+
+	// 重みの総和(データ数)で割る
+	auto data_size = moments.scaleSum();
+	dataMean.vBias = moments.visibleSum() / data_size;
+	dataMean.hBias = moments.hiddenSum() / data_size;
+	dataMean.weight = moments.visibleHiddenSum() / data_size;
+	dataMean.hSparse = h_sparse_sum / data_size;
+}
+
+
 template<class OPTIMIZERTYPE>
 inline void Trainer<GeneralizedSparseRBM, OPTIMIZERTYPE>::calcRBMExpectedCD(GeneralizedSparseRBM & rbm, std::vector<std::vector<double>> & dataset, std::vector<int> & data_indexes) {
+	RBM_PROFILE_SCOPE("calcRBMExpectedCD");
+
 	// 0埋め初期化
 	initRBMExpected();
 
+	// 可視層は2値なので, muはビット列から求める
+	PackedVisibleKernel kernel(rbm);
+
 	auto index_size = data_indexes.size();
+	RBM_PROFILE_COUNT(BytesCopied, index_size * rbmprof::modelBytes(rbm));
 	#pragma omp parallel for schedule(static)
 	for (int n = 0; n < index_size; n++) {
 		auto rbm_replica = rbm;
@@ -378,8 +647,12 @@ inline void Trainer<GeneralizedSparseRBM, OPTIMIZERTYPE>::calcRBMExpectedCD(Gene
 		// GeneralizedSparseRBMの初期値設定
 		rbm_replica.nodes.v = vect;
 
+		std::vector<rbmpack::Word> words(rbmpack::wordSize(rbm_replica.getVisibleSize()));
+		Eigen::VectorXd mu_vect;
+		kernel.pack(vect, words.data());
+		kernel.muVect(words.data(), mu_vect);
 		for (int j = 0; j < rbm_replica.getHiddenSize(); j++) {
-			rbm_replica.nodes.h(j) = rbm_replica.actHidJ(j);
+			rbm_replica.nodes.h(j) = rbm_replica.actHidJ(j, mu_vect(j));
 		}
 
 		// CD-K
@@ -387,7 +660,9 @@ inline void Trainer<GeneralizedSparseRBM, OPTIMIZERTYPE>::calcRBMExpectedCD(Gene
 		sampler.randEngine = this->randDevice;
 		for (int k = 0; k < cdk; k++) {
 			sampler.updateByBlockedGibbsSamplingVisible(rbm_replica);
-			sampler.updateByBlockedGibbsSamplingHidden(rbm_replica);
+			kernel.pack(rbm_replica.nodes.v, words.data());
+			kernel.muVect(words.data(), mu_vect);
+			sampler.updateByBlockedGibbsSamplingHidden(rbm_replica, mu_vect);
 		}
 
 		// 結果を格納
@@ -399,11 +674,7 @@ inline void Trainer<GeneralizedSparseRBM, OPTIMIZERTYPE>::calcRBMExpectedCD(Gene
 				rbmexpected.hSparse(j) += -exp(rbm_replica.params.sparse(j)) * abs(rbm_replica.nodes.h(j));
 			}
 
-			for (int i = 0; i < rbm_replica.getVisibleSize(); i++) {
-				for (int j = 0; j < rbm_replica.getHiddenSize(); j++) {
-					rbmexpected.weight(i, j) += rbm_replica.nodes.v(i) * rbm_replica.nodes.h(j);
-				}
-			}
+			rbmexpected.weight.noalias() += rbm_replica.nodes.v * rbm_replica.nodes.h.transpose();
 		}
 	}
 
@@ -415,66 +686,130 @@ inline void Trainer<GeneralizedSparseRBM, OPTIMIZERTYPE>::calcRBMExpectedCD(Gene
 
 template<class OPTIMIZERTYPE>
 inline void Trainer<GeneralizedSparseRBM, OPTIMIZERTYPE>::calcRBMExpectedExact(GeneralizedSparseRBM & rbm, std::vector<std::vector<double>> & dataset, std::vector<int> & data_indexes) {
+	calcRBMExpectedExact(rbm);
+}
+
+template<class OPTIMIZERTYPE>
+inline void Trainer<GeneralizedSparseRBM, OPTIMIZERTYPE>::calcRBMExpectedExact(GeneralizedSparseRBM & rbm) {
+	RBM_PROFILE_SCOPE("calcRBMExpectedExact");
+
 	// 0埋め初期化
 	initRBMExpected();
 
-	StateCounter<std::vector<int>> sc(std::vector<int>(rbm.getVisibleSize(), 2));  // 可視変数Vの状態カウンター
-	auto & v_state_map = rbm.visibleValueSet;  // 可視変数の状態->値変換写像
-
-	auto max_count = sc.getMaxCount();
-	#pragma omp parallel for schedule(static)
-	for (int c = 0; c < max_count; c++) {
-		// FIXME: stlのコピーは遅いぞ
-		auto sc_replica = sc;
-		sc_replica.innerCounter = c;
+	// 可視変数の状態cのビット列はc自身(StateCounterの2進の桁と同じ並び)
+	PackedVisibleKernel kernel(rbm);
+	auto v_size = rbm.getVisibleSize();
+	auto h_size = rbm.getHiddenSize();
+	PackedMoments moments(v_size, h_size, kernel.getLow(), kernel.getHigh());
+	Eigen::VectorXd h_sparse_sum = Eigen::VectorXd::Zero(h_size);
+
+	long long max_count = 1LL << v_size;
+	RBM_PROFILE_COUNT(StatesEnumerated, max_count);
+	#pragma omp parallel
+	{
+		PackedMoments local(v_size, h_size, kernel.getLow(), kernel.getHigh());
+		Eigen::VectorXd local_h_sparse = Eigen::VectorXd::Zero(h_size);
+		Eigen::VectorXd mu_vect;
+		Eigen::VectorXd act_vect(h_size);
+
+#pragma omp for schedule(static)
+		for (long long c = 0; c < max_count; c++) {
+			rbmpack::Word word = static_cast<rbmpack::Word>(c);
+
+			auto b_dot_v = kernel.visibleDot(&word);  // bとvの内積
+			kernel.muVect(&word, mu_vect);
+			auto prob = exp(b_dot_v) * rbm.sumHExpMuSparse(mu_vect);  // 状態cの非正規化確率
 
-		auto v_state = sc_replica.getState();
-		auto rbm_replica = rbm;
+			// E[v_i h_j] and E[h_j] and E[|h_j|]
+			for (int j = 0; j < h_size; j++) {
+				act_vect(j) = rbm.actHidJ(j, mu_vect(j));
+				local_h_sparse(j) += prob * rbm.actHidSparseJ(j, mu_vect(j));
+			}
 
-		// FIXME: v_i == 0 ときそのままcontinueしたほうが速いぞ
+			local.add(&word, prob, act_vect);
+		}
 
-		for (int i = 0; i < rbm_replica.getVisibleSize(); i++) {
-			rbm_replica.nodes.v(i) = v_state_map[v_state[i]];
+#pragma omp critical
+		{
+			moments.merge(local);
+			h_sparse_sum += local_h_sparse;
 		}
+	}
 
+	// 重みの総和が分配関数
+	auto z = moments.scaleSum();
+	rbmexpected.vBias = moments.visibleSum() / z;
+	rbmexpected.hBias = moments.hiddenSum() / z;
+	rbmexpected.weight = moments.visibleHiddenSum() / z;
+	rbmexpected.hSparse = h_sparse_sum / z;
+}
 
-		auto b_dot_v = rbm_replica.nodes.getVisibleLayer().dot(rbm_replica.params.b);  // bとvの内積
-		auto mu_vect = rbm_replica.muVect();
-		auto sum_h_exp_mu_sparse = rbm_replica.sumHExpMuSparse(mu_vect);
+template<class OPTIMIZERTYPE>
+inline void Trainer<GeneralizedSparseRBM, OPTIMIZERTYPE>::calcRBMExpectedPT(GeneralizedSparseRBM & rbm, std::vector<std::vector<double>> & dataset, std::vector<int> & data_indexes) {
+	RBM_PROFILE_SCOPE("calcRBMExpectedPT");
 
-#pragma omp critical
-		{
-			// FIXME: この計算本当にあってる???
-			// 期待値一括計算
-			// E[v_i]
-			for (int i = 0; i < rbm_replica.getVisibleSize(); i++) {
-				rbmexpected.vBias(i) += rbm_replica.nodes.v(i) * exp(b_dot_v) * sum_h_exp_mu_sparse;
-			}
+	// 0埋め初期化
+	initRBMExpected();
 
-			// E[v_i h_j] and E[h_j] and E[|h_j|]
-			for (int j = 0; j < rbm_replica.getHiddenSize(); j++) {
-				auto mu_j = mu_vect(j);
-				rbmexpected.hBias(j) += exp(b_dot_v) * sum_h_exp_mu_sparse * rbm_replica.actHidJ(j, mu_j);
-				rbmexpected.hSparse(j) += exp(b_dot_v) * sum_h_exp_mu_sparse * rbm_replica.actHidSparseJ(j, mu_j);
+	// レプリカは持続的なマルコフ連鎖として使いまわす
+	if (replicaSampler.getReplicaSize() != replicaSize) {
+		replicaSampler.randEngine = std::mt19937(this->randDevice());
+		replicaSampler.init(rbm, replicaSize, replicaBetaMin);
+	}
+	else {
+		replicaSampler.syncParams(rbm);
+	}
 
-				for (int i = 0; i < rbm_replica.getVisibleSize(); i++) {
-					rbmexpected.weight(i, j) += rbm_replica.nodes.v(i) * exp(b_dot_v) * sum_h_exp_mu_sparse * rbm_replica.actHidJ(j, mu_j);
-				}
-			}
-		}
+	// 1サンプルあたりのスイープ数
+	int sweep_num = cdk < 1 ? 1 : cdk;
+
+	auto sample_size = data_indexes.size();
+	for (int n = 0; n < sample_size; n++) {
+		replicaSampler.updateByReplicaExchange(rbm, sweep_num);
+
+		auto & v = replicaSampler.replicas[0].nodes.v;
+		auto & h = replicaSampler.replicas[0].nodes.h;
+		rbmexpected.vBias += v;
+		rbmexpected.hBias += h;
+		rbmexpected.hSparse += -(rbm.params.sparse.array().exp() * h.array().abs()).matrix();
+		rbmexpected.weight.noalias() += v * h.transpose();
 	}
 
-	auto z = rbm.getNormalConstant();
-	rbmexpected.vBias /= z;
-	rbmexpected.hBias /= z;
-	rbmexpected.weight /= z;
-	rbmexpected.hSparse /= z;
+	rbmexpected.vBias /= static_cast<double>(sample_size);
+	rbmexpected.hBias /= static_cast<double>(sample_size);
+	rbmexpected.weight /= static_cast<double>(sample_size);
+	rbmexpected.hSparse /= static_cast<double>(sample_size);
+}
+
+template<class OPTIMIZERTYPE>
+inline void Trainer<GeneralizedSparseRBM, OPTIMIZERTYPE>::calcRBMExpectedMF(GeneralizedSparseRBM & rbm, std::vector<std::vector<double>> & dataset, std::vector<int> & data_indexes) {
+	RBM_PROFILE_SCOPE("calcRBMExpectedMF");
+
+	// 0埋め初期化
+	initRBMExpected();
+
+	// ミニバッチのデータを磁化の初期値にする
+	Eigen::MatrixXd v_batch(data_indexes.size(), rbm.getVisibleSize());
+	for (int n = 0; n < data_indexes.size(); n++) {
+		auto & data = dataset[data_indexes[n]];
+		v_batch.row(n) = Eigen::Map<Eigen::VectorXd>(data.data(), data.size()).transpose();
+	}
+
+	meanField.init(rbm, v_batch);
+	meanField.iterate(rbm);
+
+	rbmexpected.vBias = meanField.expectedValueVis();
+	rbmexpected.hBias = meanField.expectedValueHid();
+	rbmexpected.weight = meanField.expectedValueVisHid(rbm);
+	rbmexpected.hSparse = -(rbm.params.sparse.array().exp() * meanField.expectedValueAbsHid().array()).matrix();
 }
 
 
 // 勾配の計算
 template<class OPTIMIZERTYPE>
 inline void Trainer<GeneralizedSparseRBM, OPTIMIZERTYPE>::calcGradient(GeneralizedSparseRBM & rbm, std::vector<int> & data_indexes) {
+	RBM_PROFILE_SCOPE("calcGradient");
+
 	// 勾配ベクトルリセット
 	initGradient();
 
@@ -495,6 +830,8 @@ inline void Trainer<GeneralizedSparseRBM, OPTIMIZERTYPE>::calcGradient(Generaliz
 // パラメータの更新
 template<class OPTIMIZERTYPE>
 inline void Trainer<GeneralizedSparseRBM, OPTIMIZERTYPE>::updateParams(GeneralizedSparseRBM & rbm) {
+	RBM_PROFILE_SCOPE("updateParams");
+
 	for (int i = 0; i < rbm.getVisibleSize(); i++) {
 		rbm.params.b(i) += optimizer.getNewParamVBias(gradient.vBias(i), i);
 
@@ -513,6 +850,8 @@ inline void Trainer<GeneralizedSparseRBM, OPTIMIZERTYPE>::updateParams(Generaliz
 // 対数尤度関数
 template<class OPTIMIZERTYPE>
 inline double Trainer<GeneralizedSparseRBM, OPTIMIZERTYPE>::logLikeliHood(GeneralizedSparseRBM & rbm, std::vector<std::vector<double>> & dataset) {
+	RBM_PROFILE_SCOPE("logLikeliHood");
+
 	double value = 0.0;
 
 	auto z = rbm.getNormalConstant();
@@ -525,6 +864,26 @@ inline double Trainer<GeneralizedSparseRBM, OPTIMIZERTYPE>::logLikeliHood(Genera
 	return value;
 }
 
+template<class OPTIMIZERTYPE>
+inline double Trainer<GeneralizedSparseRBM, OPTIMIZERTYPE>::logLikeliHood(GeneralizedSparseRBM & rbm, PackedDataset & dataset) {
+	RBM_PROFILE_SCOPE("logLikeliHood");
+
+	PackedVisibleKernel kernel(rbm);
+	if (!kernel.isCompatible(dataset)) throw std::runtime_error("logLikeliHood: dataset does not match visibleValueSet");
+
+	double value = 0.0;
+
+	auto z = rbm.getNormalConstant();
+
+	// 同じパターンは重み(データ数)倍するだけ
+	for (size_t n = 0; n < dataset.size(); n++) {
+		auto prob = kernel.probVis(rbm, dataset.row(n), z);
+		value += dataset.weight(n) * log(prob);
+	}
+
+	return value;
+}
+
 // 学習情報出力(JSON)
 template<class OPTIMIZERTYPE>
 inline std::string Trainer<GeneralizedSparseRBM, OPTIMIZERTYPE>::trainInfoJson(GeneralizedSparseRBM & rbm) {
@@ -546,7 +905,34 @@ inline void Trainer<GeneralizedSparseRBM, OPTIMIZERTYPE>::trainFromTrainInfo(Gen
 	_trainCount = js["trainCount"];
 	learningRate = js["learningRate"];
 	cdk = js["cdk"];
-	rbm.setHiddenDiveSize(js["divSize"]);
+	rbm.setHiddenDivSize(js["divSize"]);
 	rbm.setRealHiddenValue(js["realFlag"]);
 }
 
+template<class OPTIMIZERTYPE>
+void Trainer<GeneralizedSparseRBM, OPTIMIZERTYPE>::writeCheckpoint(rbmckpt::Writer & writer, GeneralizedSparseRBM & rbm) {
+	writer.addScalar("trainer.trainCount", _trainCount);
+	writer.addScalar("trainer.epoch", epoch);
+	writer.addScalar("trainer.batchSize", batchSize);
+	writer.addScalar("trainer.cdk", cdk);
+	writer.addScalar("trainer.learningRate", learningRate);
+	rbmckpt::addEngine(writer, "trainer.rand", this->randDevice);
+	this->optimizer.writeCheckpoint(writer, "optimizer.");
+	writer.addScalar("trainer.replicaSize", replicaSize);
+	writer.addScalar("trainer.replicaBetaMin", replicaBetaMin);
+	replicaSampler.writeCheckpoint(writer, "trainer.pt.");
+}
+
+template<class OPTIMIZERTYPE>
+void Trainer<GeneralizedSparseRBM, OPTIMIZERTYPE>::readCheckpoint(rbmckpt::Reader & reader, GeneralizedSparseRBM & rbm) {
+	_trainCount = static_cast<int>(reader.scalar("trainer.trainCount"));
+	epoch = static_cast<int>(reader.scalar("trainer.epoch"));
+	batchSize = static_cast<int>(reader.scalar("trainer.batchSize"));
+	cdk = static_cast<int>(reader.scalar("trainer.cdk"));
+	learningRate = reader.scalar("trainer.learningRate");
+	rbmckpt::readEngine(reader, "trainer.rand", this->randDevice);
+	this->optimizer.readCheckpoint(reader, "optimizer.");
+	replicaSize = static_cast<int>(reader.scalar("trainer.replicaSize"));
+	replicaBetaMin = reader.scalar("trainer.replicaBetaMin");
+	replicaSampler.readCheckpoint(reader, "trainer.pt.", rbm);
+}
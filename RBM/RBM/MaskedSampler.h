@@ -0,0 +1,132 @@
+﻿#pragma once
+#include "Sampler.h"
+#include "Eigen/Core"
+#include <vector>
+#include <random>
+#include <omp.h>
+
+// 一部の可視変数を観測値で固定した条件付きサンプリング(インペインティング, 色付け, ノイズ除去)
+// バッチの各列が1つの要求, maskが真の成分は観測値で固定し, 偽の成分だけをギブスサンプリングで更新する
+// muはバッチ全体の行列積, lambdaは未観測の成分を含む行だけの行列積で求める
+// モデル毎の計算(muBatch, visibleRows, sampleHidden, sampleVisible, meanVisible)は特殊化する
+template <class RBMBase>
+class MaskedSampler {
+public:
+	typedef Eigen::Matrix<bool, Eigen::Dynamic, Eigen::Dynamic> MaskMatrix;
+
+	std::mt19937 randEngine = std::mt19937();
+	int sweepSize = 1;  // ブロックギブスサンプリングの回数
+	int burnIn = 0;  // 平均に含めない最初のスイープ数
+
+	Eigen::MatrixXd samples;  // 最後のサンプル(可視変数 x バッチ)
+	Eigen::MatrixXd means;  // burnIn以降のE[v | h]の平均(観測済みの成分は観測値)
+
+public:
+	MaskedSampler();
+	MaskedSampler(const std::mt19937 & rand_engine);
+	~MaskedSampler() = default;
+
+	// observedとmaskは可視変数 x バッチ, 結果はsamplesとmeansに入る
+	void run(RBMBase & rbm, const Eigen::MatrixXd & observed, const MaskMatrix & mask);
+
+	// 隠れ変数に関する外部磁場と相互作用(バッチの各列)
+	// モデル毎に特殊化する
+	static void muBatch(RBMBase & rbm, const Eigen::MatrixXd & v_batch, Eigen::MatrixXd & mu_batch);
+
+	// rows行目の可視変数のバイアスとカップリング(lambda = b_rows + w_rows * h)
+	// モデル毎に特殊化する
+	static void visibleRows(RBMBase & rbm, const std::vector<int> & rows, Eigen::VectorXd & b_rows, Eigen::MatrixXd & w_rows);
+
+	// 隠れ変数一つをサンプリング(muを与える)
+	// モデル毎に特殊化する
+	static double sampleHidden(RBMBase & rbm, int hindex, double mu, std::mt19937 & engine);
+
+	// 可視変数一つをサンプリング(lambdaを与える)
+	// モデル毎に特殊化する
+	static double sampleVisible(RBMBase & rbm, int vindex, double lambda, std::mt19937 & engine);
+
+	// 可視変数の条件付き期待値E[v_i | h](lambdaを与える)
+	// モデル毎に特殊化する
+	static double meanVisible(RBMBase & rbm, int vindex, double lambda);
+};
+
+
+template <class RBMBase>
+MaskedSampler<RBMBase>::MaskedSampler() {
+	std::random_device rd;
+	this->randEngine = std::mt19937(rd());
+}
+
+// 乱数エンジンを与える(random_deviceを開かない)
+template <class RBMBase>
+MaskedSampler<RBMBase>::MaskedSampler(const std::mt19937 & rand_engine) : randEngine(rand_engine) {
+}
+
+template <class RBMBase>
+void MaskedSampler<RBMBase>::run(RBMBase & rbm, const Eigen::MatrixXd & observed, const MaskMatrix & mask) {
+	RBM_PROFILE_SCOPE("maskedSampling");
+
+	auto v_size = observed.rows();
+	auto batch_size = observed.cols();
+
+	// 未観測の成分を含む行だけlambdaを計算する
+	std::vector<int> rows;
+	for (int i = 0; i < v_size; i++) {
+		if (!mask.row(i).all()) rows.push_back(i);
+	}
+	Eigen::VectorXd b_rows;
+	Eigen::MatrixXd w_rows;
+	visibleRows(rbm, rows, b_rows, w_rows);
+
+	// 列毎に乱数列をずらす
+	std::vector<std::mt19937> engines;
+	for (int n = 0; n < batch_size; n++) engines.emplace_back(this->randEngine());
+
+	// 未観測の成分はh = 0での期待値から始める
+	samples = observed;
+	for (int r = 0; r < rows.size(); r++) {
+		auto mean = meanVisible(rbm, rows[r], b_rows(r));
+		for (int n = 0; n < batch_size; n++) {
+			if (!mask(rows[r], n)) samples(rows[r], n) = mean;
+		}
+	}
+
+	means = observed;
+	Eigen::MatrixXd mean_sum = Eigen::MatrixXd::Zero(rows.size(), batch_size);
+	int mean_count = 0;
+
+	Eigen::MatrixXd mu_batch, h_batch(rbm.getHiddenSize(), batch_size), lambda_batch;
+	for (int s = 0; s < sweepSize; s++) {
+		muBatch(rbm, samples, mu_batch);
+
+#pragma omp parallel for schedule(static)
+		for (int n = 0; n < batch_size; n++) {
+			for (int j = 0; j < mu_batch.rows(); j++) {
+				h_batch(j, n) = sampleHidden(rbm, j, mu_batch(j, n), engines[n]);
+			}
+		}
+
+		lambda_batch.noalias() = w_rows * h_batch;
+		lambda_batch.colwise() += b_rows;
+
+		bool accumulate = s >= burnIn;
+#pragma omp parallel for schedule(static)
+		for (int n = 0; n < batch_size; n++) {
+			for (int r = 0; r < rows.size(); r++) {
+				if (mask(rows[r], n)) continue;
+
+				samples(rows[r], n) = sampleVisible(rbm, rows[r], lambda_batch(r, n), engines[n]);
+				if (accumulate) mean_sum(r, n) += meanVisible(rbm, rows[r], lambda_batch(r, n));
+			}
+		}
+		if (accumulate) mean_count++;
+	}
+
+	// burnIn以降のスイープがなければ最後のサンプルを返す
+	for (int r = 0; r < rows.size(); r++) {
+		for (int n = 0; n < batch_size; n++) {
+			if (mask(rows[r], n)) continue;
+			means(rows[r], n) = mean_count > 0 ? mean_sum(r, n) / mean_count : samples(rows[r], n);
+		}
+	}
+}
@@ -0,0 +1,286 @@
+﻿#pragma once
+#include "Eigen/Core"
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <limits>
+
+// 平均場近似(TAP近似)エンジン
+// 可視層と隠れ層の磁化(期待値)を減衰付き不動点反復で求める
+// 各行が一つの解(初期値)に対応し, 行列演算で一括に反復する
+template <class RBMBase>
+class MeanField {
+public:
+	// 1ユニット分の統計量(各要素は行列の各成分に対応)
+	struct Moments {
+		Eigen::MatrixXd mean;  // E[x]
+		Eigen::MatrixXd var;  // Var[x]
+		Eigen::MatrixXd skew;  // 3次キュムラント / 分散(dVar/dm)
+		Eigen::MatrixXd absMean;  // E[|x|]
+		Eigen::MatrixXd logPartition;  // log sum exp(theta x)
+	};
+
+public:
+	int maxIteration = 50;  // 最大反復回数
+	double damping = 0.5;  // 減衰率(旧い磁化を残す割合)
+	double tolerance = 1e-6;  // 収束判定
+	bool tapFlag = true;  // 2次(TAP)の補正項を使うか
+	int realGridSize = 64;  // 隠れ変数が連続値の場合の数値積分の分割数
+
+	Eigen::MatrixXd thetaVis;  // 可視層の有効場 (N x vSize)
+	Eigen::MatrixXd thetaHid;  // 隠れ層の有効場 (N x hSize)
+	Moments visMoments;  // 可視層の統計量
+	Moments hidMoments;  // 隠れ層の統計量
+
+public:
+	MeanField() = default;
+	~MeanField() = default;
+
+	// 可視層の磁化を初期値として与え, 隠れ層の磁化を計算
+	void init(RBMBase & rbm, Eigen::MatrixXd & v_batch);
+
+	// 磁化0から初期化(解1つ)
+	void init(RBMBase & rbm);
+
+	// 減衰付き不動点反復, 反復回数を返す
+	int iterate(RBMBase & rbm);
+
+	// 各解のTAP自由エネルギー
+	Eigen::VectorXd freeEnergyBatch(RBMBase & rbm);
+
+	// 近似自由エネルギー(解のうち最小のもの)
+	double getFreeEnergy(RBMBase & rbm);
+
+	// 近似規格化定数
+	double getNormalConstant(RBMBase & rbm);
+
+	// 可視変数の期待値, E[v_i](解について平均)
+	Eigen::VectorXd expectedValueVis();
+
+	// 隠れ変数の期待値, E[h_j](解について平均)
+	Eigen::VectorXd expectedValueHid();
+
+	// 隠れ変数の絶対値の期待値, E[|h_j|](解について平均)
+	Eigen::VectorXd expectedValueAbsHid();
+
+	// 可視変数と隠れ変数の積の期待値, E[v_i h_j](解について平均)
+	Eigen::MatrixXd expectedValueVisHid(RBMBase & rbm);
+
+	// 隠れ変数の取りうる値(連続値の場合は積分点)
+	std::vector<double> hiddenGrid(RBMBase & rbm);
+
+	// 隠れ変数の基底測度の対数 (hSize x グリッド数)
+	// モデル毎に特殊化する
+	static Eigen::MatrixXd hiddenLogMeasure(RBMBase & rbm, std::vector<double> & grid);
+
+	// 有効場thetaの下でのユニットの統計量を一括計算
+	static Moments calcMoments(Eigen::MatrixXd & theta, std::vector<double> & values, Eigen::MatrixXd & log_measure);
+
+protected:
+	// 隠れ層の有効場を計算
+	void updateThetaHid(RBMBase & rbm);
+
+	// 可視層の有効場を計算
+	void updateThetaVis(RBMBase & rbm);
+};
+
+
+template <class RBMBase>
+void MeanField<RBMBase>::init(RBMBase & rbm, Eigen::MatrixXd & v_batch) {
+	visMoments.mean = v_batch;
+	visMoments.var.setZero(v_batch.rows(), v_batch.cols());
+	visMoments.skew.setZero(v_batch.rows(), v_batch.cols());
+	hidMoments.var.setZero(v_batch.rows(), rbm.getHiddenSize());
+	hidMoments.skew.setZero(v_batch.rows(), rbm.getHiddenSize());
+	thetaVis.setZero(v_batch.rows(), v_batch.cols());
+
+	auto grid = hiddenGrid(rbm);
+	auto log_measure = hiddenLogMeasure(rbm, grid);
+	updateThetaHid(rbm);
+	hidMoments = calcMoments(thetaHid, grid, log_measure);
+}
+
+template <class RBMBase>
+void MeanField<RBMBase>::init(RBMBase & rbm) {
+	Eigen::MatrixXd v_batch = Eigen::MatrixXd::Zero(1, rbm.getVisibleSize());
+	init(rbm, v_batch);
+}
+
+template <class RBMBase>
+int MeanField<RBMBase>::iterate(RBMBase & rbm) {
+	auto grid = hiddenGrid(rbm);
+	auto log_measure_hid = hiddenLogMeasure(rbm, grid);
+	Eigen::MatrixXd log_measure_vis = Eigen::MatrixXd::Zero(rbm.getVisibleSize(), rbm.visibleValueSet.size());
+
+	int t = 0;
+	for (t = 0; t < maxIteration; t++) {
+		Eigen::MatrixXd old_vis = visMoments.mean;
+		Eigen::MatrixXd old_hid = hidMoments.mean;
+
+		// 可視層の更新
+		updateThetaVis(rbm);
+		visMoments = calcMoments(thetaVis, rbm.visibleValueSet, log_measure_vis);
+		visMoments.mean = damping * old_vis + (1.0 - damping) * visMoments.mean;
+
+		// 隠れ層の更新
+		updateThetaHid(rbm);
+		hidMoments = calcMoments(thetaHid, grid, log_measure_hid);
+		hidMoments.mean = damping * old_hid + (1.0 - damping) * hidMoments.mean;
+
+		auto diff = std::max((visMoments.mean - old_vis).cwiseAbs().maxCoeff(), (hidMoments.mean - old_hid).cwiseAbs().maxCoeff());
+		if (diff < tolerance) break;
+	}
+
+	// 減衰なしで1回更新し, 有効場と磁化を整合させる
+	updateThetaVis(rbm);
+	visMoments = calcMoments(thetaVis, rbm.visibleValueSet, log_measure_vis);
+	updateThetaHid(rbm);
+	hidMoments = calcMoments(thetaHid, grid, log_measure_hid);
+
+	return t;
+}
+
+template <class RBMBase>
+void MeanField<RBMBase>::updateThetaHid(RBMBase & rbm) {
+	// theta_h = c + W^T m_v
+	thetaHid.noalias() = visMoments.mean * rbm.params.w;
+	thetaHid.rowwise() += rbm.params.c.transpose();
+
+	// Onsager反作用項, 1/2 sum_i w_ij^2 Var[v_i] dVar[h_j]/dm_j
+	if (tapFlag) {
+		Eigen::MatrixXd w2 = rbm.params.w.cwiseAbs2();
+		thetaHid.array() += 0.5 * (visMoments.var * w2).array() * hidMoments.skew.array();
+	}
+}
+
+template <class RBMBase>
+void MeanField<RBMBase>::updateThetaVis(RBMBase & rbm) {
+	// theta_v = b + W m_h
+	thetaVis.noalias() = hidMoments.mean * rbm.params.w.transpose();
+	thetaVis.rowwise() += rbm.params.b.transpose();
+
+	// Onsager反作用項, 1/2 sum_j w_ij^2 Var[h_j] dVar[v_i]/dm_i
+	if (tapFlag) {
+		Eigen::MatrixXd w2 = rbm.params.w.cwiseAbs2();
+		thetaVis.array() += 0.5 * (hidMoments.var * w2.transpose()).array() * visMoments.skew.array();
+	}
+}
+
+template <class RBMBase>
+typename MeanField<RBMBase>::Moments MeanField<RBMBase>::calcMoments(Eigen::MatrixXd & theta, std::vector<double> & values, Eigen::MatrixXd & log_measure) {
+	auto rows = theta.rows();
+	auto cols = theta.cols();
+
+	// 対数重みの最大値(オーバーフロー対策)
+	Eigen::ArrayXXd max_logit = Eigen::ArrayXXd::Constant(rows, cols, -std::numeric_limits<double>::infinity());
+	for (int k = 0; k < values.size(); k++) {
+		max_logit = max_logit.max((theta.array() * values[k]).rowwise() + log_measure.col(k).transpose().array());
+	}
+
+	Eigen::ArrayXXd z = Eigen::ArrayXXd::Zero(rows, cols);
+	Eigen::ArrayXXd m1 = Eigen::ArrayXXd::Zero(rows, cols);
+	Eigen::ArrayXXd m2 = Eigen::ArrayXXd::Zero(rows, cols);
+	Eigen::ArrayXXd m3 = Eigen::ArrayXXd::Zero(rows, cols);
+	Eigen::ArrayXXd abs_m = Eigen::ArrayXXd::Zero(rows, cols);
+	for (int k = 0; k < values.size(); k++) {
+		auto x = values[k];
+		Eigen::ArrayXXd p = (((theta.array() * x).rowwise() + log_measure.col(k).transpose().array()) - max_logit).exp();
+		z += p;
+		m1 += x * p;
+		m2 += x * x * p;
+		m3 += x * x * x * p;
+		abs_m += std::abs(x) * p;
+	}
+	m1 /= z;
+	m2 /= z;
+	m3 /= z;
+	abs_m /= z;
+
+	Moments moments;
+	Eigen::ArrayXXd var = (m2 - m1.square()).max(0.0);
+	Eigen::ArrayXXd cumulant3 = m3 - 3.0 * m1 * m2 + 2.0 * m1.cube();
+	moments.mean = m1.matrix();
+	moments.var = var.matrix();
+	moments.skew = (var > 1e-12).select(cumulant3 / var, 0.0).matrix();
+	moments.absMean = abs_m.matrix();
+	moments.logPartition = (max_logit + z.log()).matrix();
+
+	return moments;
+}
+
+template <class RBMBase>
+std::vector<double> MeanField<RBMBase>::hiddenGrid(RBMBase & rbm) {
+	if (!rbm.isRealHiddenValue()) return rbm.splitHiddenSet();
+
+	// 連続値は区間の中点で数値積分
+	std::vector<double> grid(realGridSize);
+	auto h_min = rbm.getHiddenMin();
+	auto h_max = rbm.getHiddenMax();
+	auto delta = (h_max - h_min) / realGridSize;
+	for (int k = 0; k < grid.size(); k++) {
+		grid[k] = h_min + (k + 0.5) * delta;
+	}
+
+	return grid;
+}
+
+template <class RBMBase>
+Eigen::VectorXd MeanField<RBMBase>::freeEnergyBatch(RBMBase & rbm) {
+	auto & m_v = visMoments.mean;
+	auto & m_h = hidMoments.mean;
+
+	// 負のエントロピー, sum (theta m - log Z(theta))
+	Eigen::VectorXd energy = (thetaVis.cwiseProduct(m_v) - visMoments.logPartition).rowwise().sum()
+		+ (thetaHid.cwiseProduct(m_h) - hidMoments.logPartition).rowwise().sum();
+
+	// 内部エネルギー
+	energy -= m_v * rbm.params.b;
+	energy -= m_h * rbm.params.c;
+	energy -= (m_v * rbm.params.w).cwiseProduct(m_h).rowwise().sum();
+
+	// TAP補正項
+	if (tapFlag) {
+		Eigen::MatrixXd w2 = rbm.params.w.cwiseAbs2();
+		energy -= 0.5 * (visMoments.var * w2).cwiseProduct(hidMoments.var).rowwise().sum();
+	}
+
+	return energy;
+}
+
+template <class RBMBase>
+double MeanField<RBMBase>::getFreeEnergy(RBMBase & rbm) {
+	return freeEnergyBatch(rbm).minCoeff();
+}
+
+template <class RBMBase>
+double MeanField<RBMBase>::getNormalConstant(RBMBase & rbm) {
+	return exp(-getFreeEnergy(rbm));
+}
+
+template <class RBMBase>
+Eigen::VectorXd MeanField<RBMBase>::expectedValueVis() {
+	return visMoments.mean.colwise().mean().transpose();
+}
+
+template <class RBMBase>
+Eigen::VectorXd MeanField<RBMBase>::expectedValueHid() {
+	return hidMoments.mean.colwise().mean().transpose();
+}
+
+template <class RBMBase>
+Eigen::VectorXd MeanField<RBMBase>::expectedValueAbsHid() {
+	return hidMoments.absMean.colwise().mean().transpose();
+}
+
+template <class RBMBase>
+Eigen::MatrixXd MeanField<RBMBase>::expectedValueVisHid(RBMBase & rbm) {
+	auto n = static_cast<double>(visMoments.mean.rows());
+	Eigen::MatrixXd value = visMoments.mean.transpose() * hidMoments.mean / n;
+
+	// TAP補正項, w_ij Var[v_i] Var[h_j]
+	if (tapFlag) {
+		value += rbm.params.w.cwiseProduct(visMoments.var.transpose() * hidMoments.var / n);
+	}
+
+	return value;
+}
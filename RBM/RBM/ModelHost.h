@@ -0,0 +1,64 @@
+﻿#pragma once
+#include "Checkpoint.h"
+#include <string>
+#include <memory>
+#include <mutex>
+
+// 公開されたチェックポイントを読み取り専用ビューとして共有し, 新しい版が公開されたら差し替える
+// 公開側はrbmckpt::saveModel(一時ファイルに書いてからrenameで置き換え)で書くだけでよい
+// 読み込み側はcurrent()でビューを取り, 定期的にrefresh()を呼ぶ(再起動は要らない)
+// 差し替え後も取得済みのビューは参照が無くなるまで古い版のマッピングを保持する
+// VIEWはopen(path, verify)とgetChecksum()を持つこと(GeneralizedRBMView等)
+template <class VIEW>
+class ModelHost {
+protected:
+	std::string _path;
+	std::shared_ptr<const VIEW> _current;  // atomic_load/atomic_storeでのみ触る
+	size_t _version = 0;  // 差し替えた回数
+	std::mutex _mutex;  // refresh()同士の排他
+
+public:
+	explicit ModelHost(const std::string & path);
+	~ModelHost() = default;
+
+	// 公開されている版のビュー(ロックを取らない)
+	std::shared_ptr<const VIEW> current() const;
+
+	// 新しい版が公開されていれば差し替える(差し替えたらtrue)
+	bool refresh();
+
+	// 差し替えた回数
+	size_t getVersion();
+};
+
+
+template <class VIEW>
+ModelHost<VIEW>::ModelHost(const std::string & path) : _path(path) {
+	std::atomic_store(&_current, VIEW::open(_path, true));
+}
+
+template <class VIEW>
+std::shared_ptr<const VIEW> ModelHost<VIEW>::current() const {
+	return std::atomic_load(&_current);
+}
+
+template <class VIEW>
+bool ModelHost<VIEW>::refresh() {
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	// ヘッダのチェックサムだけ見て, 変わっていたら検証付きで開きなおす
+	{
+		rbmckpt::Reader probe(_path, false);
+		if (probe.header().checksum == current()->getChecksum()) return false;
+	}
+
+	std::atomic_store(&_current, VIEW::open(_path, true));
+	_version++;
+	return true;
+}
+
+template <class VIEW>
+size_t ModelHost<VIEW>::getVersion() {
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _version;
+}
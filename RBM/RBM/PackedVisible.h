@@ -0,0 +1,362 @@
+﻿#pragma once
+#include <vector>
+#include <map>
+#include <cstdint>
+#include <cstddef>
+#include <stdexcept>
+#include <cmath>
+#include "Eigen/Core"
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// 2値の可視変数をビット列(1ワード64変数)で扱う
+// ビットが1なら上側の値(visibleValueSet[1]), 0なら下側の値(visibleValueSet[0])
+namespace rbmpack {
+	typedef uint64_t Word;
+	const size_t WORD_BITS = 64;
+
+	// bit_size変数を詰めるのに必要なワード数
+	inline size_t wordSize(size_t bit_size) {
+		return (bit_size + WORD_BITS - 1) / WORD_BITS;
+	}
+
+	inline int popcount(Word x) {
+#ifdef _MSC_VER
+		return static_cast<int>(__popcnt64(x));
+#else
+		return __builtin_popcountll(x);
+#endif
+	}
+
+	inline int countTrailingZeros(Word x) {
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanForward64(&index, x);
+		return static_cast<int>(index);
+#else
+		return __builtin_ctzll(x);
+#endif
+	}
+
+	// valuesをthresholdより大きければ1としてwordsへ詰める
+	template <class VECTOR>
+	void pack(const VECTOR & values, size_t size, double threshold, Word * words) {
+		for (size_t k = 0; k < wordSize(size); k++) words[k] = 0;
+		for (size_t i = 0; i < size; i++) {
+			if (values[i] > threshold) words[i / WORD_BITS] |= Word(1) << (i % WORD_BITS);
+		}
+	}
+
+	// 立っているビットの添字ごとにfuncを呼ぶ
+	template <class F>
+	void forEachSetBit(const Word * words, size_t size, F func) {
+		for (size_t k = 0; k < wordSize(size); k++) {
+			auto word = words[k];
+			while (word) {
+				func(k * WORD_BITS + countTrailingZeros(word));
+				word &= word - 1;
+			}
+		}
+	}
+
+	inline bool testBit(const Word * words, size_t index) {
+		return (words[index / WORD_BITS] >> (index % WORD_BITS)) & 1;
+	}
+
+	// 1の数
+	inline int countBits(const Word * words, size_t size) {
+		int count = 0;
+		for (size_t k = 0; k < wordSize(size); k++) count += popcount(words[k]);
+		return count;
+	}
+}
+
+
+// 2値データセットをビット列で保持する(1行あたりwordSize(vSize)ワード)
+// 各行は重み(同じパターンのデータ数)を持ち, unique()で重複行をまとめられる
+class PackedDataset {
+protected:
+	size_t _vSize = 0;
+	size_t _wordSize = 0;
+	size_t _size = 0;
+	double _low = -1.0;
+	double _high = 1.0;
+	std::vector<rbmpack::Word> _words;
+	std::vector<double> _weights;
+
+public:
+	PackedDataset() = default;
+	PackedDataset(std::vector<std::vector<double>> & dataset, double low = -1.0, double high = 1.0) {
+		_low = low;
+		_high = high;
+		_size = dataset.size();
+		_vSize = dataset.empty() ? 0 : dataset[0].size();
+		_wordSize = rbmpack::wordSize(_vSize);
+		_words.assign(_size * _wordSize, 0);
+		_weights.assign(_size, 1.0);
+
+		auto threshold = (low + high) / 2.0;
+		for (size_t n = 0; n < _size; n++) {
+			if (dataset[n].size() != _vSize) throw std::runtime_error("PackedDataset: row size mismatch");
+			rbmpack::pack(dataset[n], _vSize, threshold, row(n));
+		}
+	}
+	~PackedDataset() = default;
+
+	// 同じパターンの行を(パターン, データ数)にまとめる(並びは初出順)
+	static PackedDataset unique(std::vector<std::vector<double>> & dataset, double low = -1.0, double high = 1.0) {
+		return PackedDataset(dataset, low, high).unique();
+	}
+
+	PackedDataset unique() const {
+		PackedDataset dataset;
+		dataset._vSize = _vSize;
+		dataset._wordSize = _wordSize;
+		dataset._low = _low;
+		dataset._high = _high;
+
+		std::map<std::vector<rbmpack::Word>, size_t> pattern_map;  // パターン -> まとめた後の行番号
+		for (size_t n = 0; n < _size; n++) {
+			std::vector<rbmpack::Word> pattern(row(n), row(n) + _wordSize);
+			auto it = pattern_map.find(pattern);
+			if (it != pattern_map.end()) {
+				dataset._weights[it->second] += _weights[n];
+				continue;
+			}
+
+			pattern_map.emplace(pattern, dataset._size);
+			dataset._words.insert(dataset._words.end(), pattern.begin(), pattern.end());
+			dataset._weights.push_back(_weights[n]);
+			dataset._size++;
+		}
+
+		return dataset;
+	}
+
+	// 行数(unique()後はパターン数)
+	size_t size() const {
+		return _size;
+	}
+
+	// n行目の重み(データ数)
+	double weight(size_t n) const {
+		return _weights[n];
+	}
+
+	// 重みの総和(元のデータ数)
+	double totalWeight() const {
+		double value = 0.0;
+		for (auto & weight : _weights) value += weight;
+		return value;
+	}
+
+	bool empty() const {
+		return _size == 0;
+	}
+
+	// 可視変数の数
+	size_t getVisibleSize() const {
+		return _vSize;
+	}
+
+	double getLow() const {
+		return _low;
+	}
+
+	double getHigh() const {
+		return _high;
+	}
+
+	// n行目のビット列
+	rbmpack::Word * row(size_t n) {
+		return _words.data() + n * _wordSize;
+	}
+
+	const rbmpack::Word * row(size_t n) const {
+		return _words.data() + n * _wordSize;
+	}
+
+	// n行目を実数値に戻す
+	std::vector<double> unpack(size_t n) const {
+		std::vector<double> data(_vSize);
+		for (size_t i = 0; i < _vSize; i++) {
+			data[i] = rbmpack::testBit(row(n), i) ? _high : _low;
+		}
+		return data;
+	}
+
+	// 全行を実数値に戻す(重みは展開しない)
+	std::vector<std::vector<double>> unpack() const {
+		std::vector<std::vector<double>> dataset(_size);
+		for (size_t n = 0; n < _size; n++) dataset[n] = unpack(n);
+		return dataset;
+	}
+};
+
+
+// ビット列で与えた可視変数からmu, b・vを計算する
+// v_i = low + (high - low) * bit_i なので
+//   mu_j = c_j + low * Σ_i w_ij + (high - low) * Σ_{bit_i = 1} w_ij
+// となり, 乗算なしで1の立っている行だけ足せばよい
+// (重みは実数値なのでXNOR/popcountではなく符号マスク付きの加算)
+// パラメータの写しを持つので, 更新後はsync()しなおすこと
+class PackedVisibleKernel {
+protected:
+	double _low = -1.0;
+	double _high = 1.0;
+	size_t _vSize = 0;
+	Eigen::MatrixXd _weightT;  // w^T, 列iがwのi行目(連続アクセス用)
+	Eigen::VectorXd _weightSum;  // Σ_i w_ij
+	Eigen::VectorXd _vBias;
+	Eigen::VectorXd _hBias;
+	double _biasSum = 0.0;  // Σ_i b_i
+
+public:
+	PackedVisibleKernel() = default;
+
+	template <class RBM>
+	PackedVisibleKernel(RBM & rbm) {
+		sync(rbm);
+	}
+
+	~PackedVisibleKernel() = default;
+
+	// パラメータを写しなおす
+	template <class RBM>
+	void sync(RBM & rbm) {
+		if (rbm.visibleValueSet.size() != 2) throw std::runtime_error("PackedVisibleKernel: visible units must be binary");
+		_low = rbm.visibleValueSet[0];
+		_high = rbm.visibleValueSet[1];
+		_vSize = rbm.getVisibleSize();
+		_weightT = rbm.params.w.transpose();
+		_weightSum = _weightT.rowwise().sum();
+		_vBias = rbm.params.b;
+		_hBias = rbm.params.c;
+		_biasSum = _vBias.sum();
+	}
+
+	double getLow() const {
+		return _low;
+	}
+
+	double getHigh() const {
+		return _high;
+	}
+
+	// データセットの2値がモデルの可視変数の値と一致するか
+	bool isCompatible(const PackedDataset & dataset) const {
+		return dataset.getVisibleSize() == _vSize && dataset.getLow() == _low && dataset.getHigh() == _high;
+	}
+
+	// 実数値の可視変数をビット列に詰める
+	template <class VECTOR>
+	void pack(const VECTOR & values, rbmpack::Word * words) const {
+		rbmpack::pack(values, _vSize, (_low + _high) / 2.0, words);
+	}
+
+	// ビット列を可視層の値に展開
+	template <class VECTOR>
+	void unpack(const rbmpack::Word * words, VECTOR & values) const {
+		for (size_t i = 0; i < _vSize; i++) {
+			values[i] = rbmpack::testBit(words, i) ? _high : _low;
+		}
+	}
+
+	// 隠れ変数に関する外部磁場と相互作用(一括計算)
+	void muVect(const rbmpack::Word * words, Eigen::VectorXd & mu_vect) const {
+		mu_vect = _hBias + _low * _weightSum;
+
+		auto scale = _high - _low;
+		rbmpack::forEachSetBit(words, _vSize, [&](size_t i) {
+			mu_vect.noalias() += scale * _weightT.col(i);
+		});
+	}
+
+	// bとvの内積
+	double visibleDot(const rbmpack::Word * words) const {
+		double acc = 0.0;
+		rbmpack::forEachSetBit(words, _vSize, [&](size_t i) {
+			acc += _vBias(i);
+		});
+
+		return _low * _biasSum + (_high - _low) * acc;
+	}
+
+	// 可視変数の確率(隠れ変数周辺化済み, 分配関数使いまわし)
+	template <class RBM>
+	double probVis(RBM & rbm, const rbmpack::Word * words, double normalize_constant) const {
+		Eigen::VectorXd mu_vect;
+		muVect(words, mu_vect);
+
+		double value = exp(visibleDot(words)) / normalize_constant;
+		for (int j = 0; j < mu_vect.size(); j++) {
+			value *= rbm.miniNormalizeConstantHidden(j, mu_vect(j));
+		}
+
+		return value;
+	}
+};
+
+
+// 重み付きの Σ s, Σ s v, Σ s a, Σ s v a^T をビット列から集計する
+// (aは隠れ変数の期待値など, v a^T は1の立っている列への加算だけで済む)
+// スレッドごとに集計してmerge()する
+class PackedMoments {
+protected:
+	double _low = -1.0;
+	double _high = 1.0;
+	double _scaleSum = 0.0;  // Σ s
+	Eigen::VectorXd _bitSum;  // Σ s bit
+	Eigen::VectorXd _hiddenSum;  // Σ s a
+	Eigen::MatrixXd _bitHiddenSum;  // Σ s a bit^T (隠れ変数 x 可視変数)
+
+public:
+	PackedMoments() = default;
+	PackedMoments(size_t v_size, size_t h_size, double low, double high) {
+		_low = low;
+		_high = high;
+		_bitSum.setZero(v_size);
+		_hiddenSum.setZero(h_size);
+		_bitHiddenSum.setZero(h_size, v_size);
+	}
+	~PackedMoments() = default;
+
+	void add(const rbmpack::Word * words, double scale, const Eigen::VectorXd & hidden) {
+		_scaleSum += scale;
+		_hiddenSum.noalias() += scale * hidden;
+		rbmpack::forEachSetBit(words, static_cast<size_t>(_bitSum.size()), [&](size_t i) {
+			_bitSum(i) += scale;
+			_bitHiddenSum.col(i).noalias() += scale * hidden;
+		});
+	}
+
+	void merge(const PackedMoments & other) {
+		_scaleSum += other._scaleSum;
+		_bitSum += other._bitSum;
+		_hiddenSum += other._hiddenSum;
+		_bitHiddenSum += other._bitHiddenSum;
+	}
+
+	// Σ s
+	double scaleSum() const {
+		return _scaleSum;
+	}
+
+	// Σ s v
+	Eigen::VectorXd visibleSum() const {
+		return Eigen::VectorXd::Constant(_bitSum.size(), _low * _scaleSum) + (_high - _low) * _bitSum;
+	}
+
+	// Σ s a
+	Eigen::VectorXd hiddenSum() const {
+		return _hiddenSum;
+	}
+
+	// Σ s v a^T (可視変数 x 隠れ変数)
+	Eigen::MatrixXd visibleHiddenSum() const {
+		Eigen::MatrixXd value = (_high - _low) * _bitHiddenSum.transpose();
+		value.rowwise() += _low * _hiddenSum.transpose();
+		return value;
+	}
+};
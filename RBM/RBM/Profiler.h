@@ -0,0 +1,244 @@
+﻿#pragma once
+#include <chrono>
+#include <vector>
+#include <string>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <fstream>
+#include <ostream>
+#include <cstdint>
+
+// 学習の計測(スコープ単位の時間と回数のカウンター)
+// RBM_PROFILEを定義したときだけ有効になり, 未定義なら下のマクロは空に展開される
+//
+//   RBM_PROFILE_SCOPE("calcDataMean");         // スコープを抜けるまでの時間
+//   RBM_PROFILE_COUNT(ExpEvaluations, n);      // カウンターにnを加算
+//   RBM_PROFILE_EPOCH(epoch);                  // ここまでを1エポックとして集計
+//   RBM_PROFILE_EXPORT("trace.json", "summary.csv");
+namespace rbmprof {
+
+	enum Counter {
+		Sweeps,  // ブロックギブスサンプリングで層全体を更新した回数
+		ExpEvaluations,  // 分配関数の厳密計算でのexp()の評価回数
+		StatesEnumerated,  // 厳密計算で列挙した状態数
+		BytesCopied,  // モデルのコピーで複製したバイト数
+		CounterSize
+	};
+
+	inline const char * counterName(int counter) {
+		static const char * names[] = { "sweeps", "exp_evaluations", "states_enumerated", "bytes_copied" };
+		return names[counter];
+	}
+
+	// モデルのコピー1回で複製されるおおよそのバイト数(重み, バイアス, ノード)
+	template <class RBM>
+	uint64_t modelBytes(RBM & rbm) {
+		auto size = rbm.params.w.size() + rbm.params.b.size() + rbm.params.c.size() + rbm.nodes.v.size() + rbm.nodes.h.size();
+		return static_cast<uint64_t>(size) * sizeof(double);
+	}
+
+	// 1区間分の記録
+	struct TraceEvent {
+		const char * name;
+		int64_t begin;  // [us]
+		int64_t duration;  // [us]
+	};
+
+	// 区間名毎の集計
+	struct PhaseStat {
+		int64_t total = 0;  // [us]
+		size_t count = 0;
+	};
+
+	// 1エポック分の集計
+	struct EpochSummary {
+		int epoch = 0;
+		std::map<std::string, PhaseStat> phases;
+		uint64_t counters[CounterSize] = {};
+	};
+
+	// スレッド毎の記録バッファ
+	struct ThreadBuffer {
+		size_t tid = 0;
+		std::vector<TraceEvent> events;
+		size_t aggregated = 0;  // 集計済みのイベント数
+		uint64_t counters[CounterSize] = {};
+		std::mutex mutex;  // 集計時のみ他スレッドと競合する
+	};
+
+	class Profiler {
+	public:
+		bool traceFlag = true;  // falseなら集計後にイベントを捨てる(トレースは出力できない)
+
+	protected:
+		std::chrono::steady_clock::time_point _start = std::chrono::steady_clock::now();
+		std::vector<std::unique_ptr<ThreadBuffer>> _buffers;
+		std::vector<EpochSummary> _summaries;
+		std::mutex _mutex;
+
+	public:
+		static Profiler & instance() {
+			static Profiler profiler;
+			return profiler;
+		}
+
+		// 計測開始からの経過時間[us]
+		int64_t now() {
+			return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - _start).count();
+		}
+
+		// 区間を記録
+		void record(const char * name, int64_t begin, int64_t end) {
+			auto & buffer = threadBuffer();
+			std::lock_guard<std::mutex> lock(buffer.mutex);
+			buffer.events.push_back(TraceEvent{ name, begin, end - begin });
+		}
+
+		// カウンターに加算
+		void count(Counter counter, uint64_t value) {
+			auto & buffer = threadBuffer();
+			std::lock_guard<std::mutex> lock(buffer.mutex);
+			buffer.counters[counter] += value;
+		}
+
+		// 前回からの記録を1エポック分として集計
+		void endEpoch(int epoch) {
+			EpochSummary summary;
+			summary.epoch = epoch;
+
+			std::lock_guard<std::mutex> lock(_mutex);
+			for (auto & buffer : _buffers) {
+				std::lock_guard<std::mutex> buffer_lock(buffer->mutex);
+
+				for (auto n = buffer->aggregated; n < buffer->events.size(); n++) {
+					auto & stat = summary.phases[buffer->events[n].name];
+					stat.total += buffer->events[n].duration;
+					stat.count++;
+				}
+				buffer->aggregated = buffer->events.size();
+
+				if (!traceFlag) {
+					buffer->events.clear();
+					buffer->aggregated = 0;
+				}
+
+				for (int c = 0; c < CounterSize; c++) {
+					summary.counters[c] += buffer->counters[c];
+					buffer->counters[c] = 0;
+				}
+			}
+
+			_summaries.push_back(summary);
+		}
+
+		// エポック毎の集計
+		std::vector<EpochSummary> getSummaries() {
+			std::lock_guard<std::mutex> lock(_mutex);
+			return _summaries;
+		}
+
+		// Chrome trace event形式(chrome://tracing, Perfetto)で出力
+		void writeChromeTrace(std::ostream & stream) {
+			std::lock_guard<std::mutex> lock(_mutex);
+			stream << "{\"traceEvents\":[";
+
+			bool first = true;
+			for (auto & buffer : _buffers) {
+				std::lock_guard<std::mutex> buffer_lock(buffer->mutex);
+				for (auto & event : buffer->events) {
+					stream << (first ? "" : ",") << "\n"
+						<< "{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << buffer->tid
+						<< ",\"ts\":" << event.begin << ",\"dur\":" << event.duration << "}";
+					first = false;
+				}
+			}
+
+			stream << "\n],\"displayTimeUnit\":\"ms\"}\n";
+		}
+
+		void writeChromeTrace(const std::string & path) {
+			std::ofstream file(path);
+			writeChromeTrace(file);
+		}
+
+		// エポック毎の集計をCSVで出力
+		// kindはphaseかcounter, valueはphaseなら合計時間[us], counterなら回数
+		void writeSummary(std::ostream & stream) {
+			std::lock_guard<std::mutex> lock(_mutex);
+			stream << "epoch,kind,name,value,count" << "\n";
+
+			for (auto & summary : _summaries) {
+				for (auto & phase : summary.phases) {
+					stream << summary.epoch << ",phase," << phase.first << "," << phase.second.total << "," << phase.second.count << "\n";
+				}
+
+				for (int c = 0; c < CounterSize; c++) {
+					stream << summary.epoch << ",counter," << counterName(c) << "," << summary.counters[c] << ",1" << "\n";
+				}
+			}
+		}
+
+		void writeSummary(const std::string & path) {
+			std::ofstream file(path);
+			writeSummary(file);
+		}
+
+		// 記録を全て破棄
+		void reset() {
+			std::lock_guard<std::mutex> lock(_mutex);
+			for (auto & buffer : _buffers) {
+				std::lock_guard<std::mutex> buffer_lock(buffer->mutex);
+				buffer->events.clear();
+				buffer->aggregated = 0;
+				for (int c = 0; c < CounterSize; c++) buffer->counters[c] = 0;
+			}
+			_summaries.clear();
+		}
+
+	protected:
+		// 呼び出しスレッドのバッファ(初回に登録)
+		ThreadBuffer & threadBuffer() {
+			thread_local ThreadBuffer * buffer = nullptr;
+			if (buffer == nullptr) {
+				std::lock_guard<std::mutex> lock(_mutex);
+				_buffers.emplace_back(new ThreadBuffer());
+				buffer = _buffers.back().get();
+				buffer->tid = _buffers.size() - 1;
+			}
+
+			return *buffer;
+		}
+	};
+
+	// スコープを抜けるまでの時間を記録
+	class ScopedTimer {
+		const char * _name;
+		int64_t _begin;
+
+	public:
+		ScopedTimer(const char * name) : _name(name), _begin(Profiler::instance().now()) {}
+		~ScopedTimer() {
+			auto & profiler = Profiler::instance();
+			profiler.record(_name, _begin, profiler.now());
+		}
+	};
+}
+
+#ifdef RBM_PROFILE
+#define RBM_PROFILE_CONCAT_INNER(a, b) a##b
+#define RBM_PROFILE_CONCAT(a, b) RBM_PROFILE_CONCAT_INNER(a, b)
+#define RBM_PROFILE_SCOPE(name) rbmprof::ScopedTimer RBM_PROFILE_CONCAT(_profileScope, __LINE__)(name)
+#define RBM_PROFILE_COUNT(counter, value) rbmprof::Profiler::instance().count(rbmprof::counter, static_cast<uint64_t>(value))
+#define RBM_PROFILE_EPOCH(epoch) rbmprof::Profiler::instance().endEpoch(epoch)
+#define RBM_PROFILE_EXPORT(trace_path, summary_path) \
+	do { \
+		rbmprof::Profiler::instance().writeChromeTrace(trace_path); \
+		rbmprof::Profiler::instance().writeSummary(summary_path); \
+	} while (0)
+#else
+#define RBM_PROFILE_SCOPE(name)
+#define RBM_PROFILE_COUNT(counter, value)
+#define RBM_PROFILE_EPOCH(epoch)
+#define RBM_PROFILE_EXPORT(trace_path, summary_path)
+#endif
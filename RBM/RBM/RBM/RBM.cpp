@@ -56,8 +56,21 @@ double RBM::getNormalConstant() {
 
 // エネルギー関数を返します
 double RBM::getEnergy() {
-	// まだ必要ないため実装保留
-	throw;
+	Eigen::MatrixXd v_batch = nodes.v.transpose();
+	Eigen::MatrixXd h_batch = nodes.h.transpose();
+	return this->getEnergyBatch(v_batch, h_batch)(0);
+}
+
+// エネルギー関数を一括計算します
+// E(v, h) = -b^T v - mu(v)^T h を行列積でまとめて計算
+Eigen::VectorXd RBM::getEnergyBatch(const Eigen::MatrixXd & v_batch, const Eigen::MatrixXd & h_batch) {
+	// 各行の隠れ変数に関する外部磁場と相互作用, mu = c + W^T v
+	Eigen::MatrixXd mu_batch = v_batch * params.w;
+	mu_batch.rowwise() += params.c.transpose();
+
+	Eigen::VectorXd energy = -(v_batch * params.b) - mu_batch.cwiseProduct(h_batch).rowwise().sum();
+
+	return energy;
 }
 
 
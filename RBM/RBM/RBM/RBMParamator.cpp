@@ -1,4 +1,5 @@
 ﻿#include "RBMParamator.h"
+#include "../Checkpoint.h"
 
 
 // 可視変数の総数を返す
@@ -68,6 +69,27 @@ void RBMParamator::deserialize(std::string js) {
 	this->w = Eigen::Map<Eigen::MatrixXd>(tmp_w.data(), vSize, hSize);
 }
 
+// チェックポイントに登録
+void RBMParamator::writeCheckpoint(rbmckpt::Writer & writer) {
+	writer.setModelType("RBM");
+	writer.add("b", this->b);
+	writer.add("c", this->c);
+	writer.add("w", this->w);
+}
+
+// チェックポイントから復元
+void RBMParamator::readCheckpoint(rbmckpt::Reader & reader) {
+	if (reader.modelType() != "RBM") throw std::runtime_error("RBMParamator: model type mismatch " + reader.modelType());
+	auto ckpt_b = reader.vector("b");
+	auto ckpt_c = reader.vector("c");
+	auto ckpt_w = reader.matrix("w");
+	if (ckpt_b.size() != vSize || ckpt_c.size() != hSize || ckpt_w.rows() != vSize || ckpt_w.cols() != hSize) throw std::runtime_error("RBMParamator: shape mismatch");
+
+	this->b = ckpt_b;
+	this->c = ckpt_c;
+	this->w = ckpt_w;
+}
+
 
 
 
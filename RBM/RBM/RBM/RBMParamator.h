@@ -6,6 +6,11 @@
 #include <string>
 #include <random>
 
+namespace rbmckpt {
+	class Writer;
+	class Reader;
+}
+
 class RBMParamator : RBMParamatorBase {
 private:
     size_t vSize;
@@ -56,4 +61,10 @@ public:
 
 	// パラメータ情報のデシリアライズ
 	void deserialize(std::string js);
+
+	// チェックポイントに登録(配列はコピーしない)
+	void writeCheckpoint(rbmckpt::Writer & writer);
+
+	// チェックポイントから復元(同じ形であること)
+	void readCheckpoint(rbmckpt::Reader & reader);
 };
@@ -94,6 +94,7 @@ inline double Sampler<RBM>::updateByGibbsSamplingHidden(RBM &rbm, int hindex) {
 }
 
 inline Eigen::VectorXd & Sampler<RBM>::updateByBlockedGibbsSamplingVisible(RBM &rbm) {
+	RBM_PROFILE_COUNT(Sweeps, 1);
 
 	for (int i = 0; i < rbm.getVisibleSize(); i++) {
 		updateByGibbsSamplingVisible(rbm, i);
@@ -103,6 +104,7 @@ inline Eigen::VectorXd & Sampler<RBM>::updateByBlockedGibbsSamplingVisible(RBM &
 }
 
 inline Eigen::VectorXd & Sampler<RBM>::updateByBlockedGibbsSamplingHidden(RBM &rbm) {
+	RBM_PROFILE_COUNT(Sweeps, 1);
 	for (int j = 0; j < rbm.getHiddenSize(); j++) {
 		updateByGibbsSamplingHidden(rbm, j);
 	}
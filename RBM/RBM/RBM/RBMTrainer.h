@@ -1,5 +1,6 @@
 ﻿#pragma once
 #include "../Trainer.h"
+#include "../Checkpoint.h"
 #include "RBM.h"
 #include "RBMSampler.h"
 #include "Eigen/Core"
@@ -106,6 +107,11 @@ public:
 
 	// 学習情報から学習(JSON)
 	void trainFromTrainInfo(RBM & rbm, std::string json);
+
+	// 学習状態(反復回数, オプティマイザのモーメント, 乱数, チェイン)のチェックポイント
+	// モデルと合わせてrbmckpt::saveTraining/loadTrainingから使う
+	void writeCheckpoint(rbmckpt::Writer & writer, RBM & rbm);
+	void readCheckpoint(rbmckpt::Reader & reader, RBM & rbm);
 };
 
 template<class OPTIMIZERTYPE>
@@ -179,6 +185,7 @@ inline void Trainer<RBM, OPTIMIZERTYPE>::train(RBM & rbm, std::vector<std::vecto
 // 1回だけ学習
 template<class OPTIMIZERTYPE>
 inline void Trainer<RBM, OPTIMIZERTYPE>::trainOnce(RBM & rbm, std::vector<std::vector<double>> & dataset) {
+	RBM_PROFILE_SCOPE("trainOnce");
 
 	// データインデックス集合
 	std::vector<int> data_indexes(dataset.size());
@@ -205,6 +212,7 @@ inline void Trainer<RBM, OPTIMIZERTYPE>::trainOnce(RBM & rbm, std::vector<std::v
 	updateParams(rbm);
 
 	// Trainer情報更新
+	RBM_PROFILE_EPOCH(_trainCount);
 	_trainCount++;
 }
 
@@ -222,6 +230,8 @@ inline void Trainer<RBM, OPTIMIZERTYPE>::calcContrastiveDivergence(RBM & rbm, st
 
 template<class OPTIMIZERTYPE>
 inline void Trainer<RBM, OPTIMIZERTYPE>::calcDataMean(RBM & rbm, std::vector<std::vector<double>> & dataset, std::vector<int> & data_indexes) {
+	RBM_PROFILE_SCOPE("calcDataMean");
+
 	// 0埋め初期化
 	initDataMean();
 
@@ -243,6 +253,8 @@ inline void Trainer<RBM, OPTIMIZERTYPE>::calcDataMean(RBM & rbm, std::vector<std
 
 template<class OPTIMIZERTYPE>
 inline void Trainer<RBM, OPTIMIZERTYPE>::calcRBMExpectedCD(RBM & rbm, std::vector<std::vector<double>> & dataset, std::vector<int> & data_indexes) {
+	RBM_PROFILE_SCOPE("calcRBMExpectedCD");
+
 	// 0埋め初期化
 	initRBMExpected();
 
@@ -258,7 +270,7 @@ inline void Trainer<RBM, OPTIMIZERTYPE>::calcRBMExpectedCD(RBM & rbm, std::vecto
 		}
 
 		// CD-K
-		Sampler<RBM, OPTIMIZERTYPE> sampler;
+		Sampler<RBM> sampler;
 		for (int k = 0; k < cdk; k++) {
 			sampler.updateByBlockedGibbsSamplingVisible(rbm);
 			sampler.updateByBlockedGibbsSamplingHidden(rbm);
@@ -276,6 +288,8 @@ inline void Trainer<RBM, OPTIMIZERTYPE>::calcRBMExpectedCD(RBM & rbm, std::vecto
 // 勾配の計算
 template<class OPTIMIZERTYPE>
 inline void Trainer<RBM, OPTIMIZERTYPE>::calcGradient(RBM & rbm, std::vector<int> & data_indexes) {
+	RBM_PROFILE_SCOPE("calcGradient");
+
 	// 勾配ベクトルリセット
 	initGradient();
 
@@ -310,6 +324,8 @@ inline void Trainer<RBM, OPTIMIZERTYPE>::updateMomentum(RBM & rbm) {
 // パラメータの更新
 template<class OPTIMIZERTYPE>
 inline void Trainer<RBM, OPTIMIZERTYPE>::updateParams(RBM & rbm) {
+	RBM_PROFILE_SCOPE("updateParams");
+
 	for (int i = 0; i < rbm.getVisibleSize(); i++) {
 		rbm.params.b(i) += momentum.vBias(i);
 
@@ -346,3 +362,28 @@ inline void Trainer<RBM, OPTIMIZERTYPE>::trainFromTrainInfo(RBM & rbm, std::stri
 	cdk = js["cdk"];
 }
 
+template<class OPTIMIZERTYPE>
+void Trainer<RBM, OPTIMIZERTYPE>::writeCheckpoint(rbmckpt::Writer & writer, RBM & rbm) {
+	writer.addScalar("trainer.trainCount", _trainCount);
+	writer.addScalar("trainer.epoch", epoch);
+	writer.addScalar("trainer.batchSize", batchSize);
+	writer.addScalar("trainer.cdk", cdk);
+	writer.addScalar("trainer.learningRate", learningRate);
+	writer.addScalar("trainer.momentumRate", momentumRate);
+	writer.add("trainer.momentum.vBias", momentum.vBias);
+	writer.add("trainer.momentum.hBias", momentum.hBias);
+	writer.add("trainer.momentum.weight", momentum.weight);
+}
+
+template<class OPTIMIZERTYPE>
+void Trainer<RBM, OPTIMIZERTYPE>::readCheckpoint(rbmckpt::Reader & reader, RBM & rbm) {
+	_trainCount = static_cast<int>(reader.scalar("trainer.trainCount"));
+	epoch = static_cast<int>(reader.scalar("trainer.epoch"));
+	batchSize = static_cast<int>(reader.scalar("trainer.batchSize"));
+	cdk = static_cast<int>(reader.scalar("trainer.cdk"));
+	learningRate = reader.scalar("trainer.learningRate");
+	momentumRate = reader.scalar("trainer.momentumRate");
+	momentum.vBias = reader.vector("trainer.momentum.vBias");
+	momentum.hBias = reader.vector("trainer.momentum.hBias");
+	momentum.weight = reader.matrix("trainer.momentum.weight");
+}
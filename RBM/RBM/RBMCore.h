@@ -2,6 +2,10 @@
 
 #include "Sampler.h"
 #include "Trainer.h"
+#include "Checkpoint.h"
+#include "CheckpointScheduler.h"
+#include "ModelHost.h"
+#include "Communicator.h"
 
 #include "RBM/RBM.h"
 #include "RBM/RBMNode.h"
@@ -13,8 +17,14 @@
 #include "GBRBM/GBRBMNode.h"
 #include "GBRBM/GBRBMParamator.h"
 #include "GBRBM/GBRBMSampler.h"
+#include "GBRBM/GBRBMOptimizer.h"
 #include "GBRBM/GBRBMTrainer.h"
 
+#include "ConvolutionalGRBM/ConvolutionalGRBM.h"
+#include "ConvolutionalGRBM/ConvolutionalGRBMParamator.h"
+#include "ConvolutionalGRBM/ConvolutionalGRBMSampler.h"
+#include "ConvolutionalGRBM/ConvolutionalGRBMTrainer.h"
+
 #include "GeneralizedGRBM/GeneralizedGRBM.h"
 #include "GeneralizedGRBM/GeneralizedGRBMNode.h"
 #include "GeneralizedGRBM/GeneralizedGRBMParamator.h"
@@ -26,9 +36,21 @@
 #include "GeneralizedRBM/GeneralizedRBMParamator.h"
 #include "GeneralizedRBM/GeneralizedRBMSampler.h"
 #include "GeneralizedRBM/GeneralizedRBMTrainer.h"
+#include "GeneralizedRBM/GeneralizedRBMFixed.h"
+#include "GeneralizedRBM/GeneralizedRBMFixedSampler.h"
+#include "GeneralizedRBM/GeneralizedRBMFixedTrainer.h"
+#include "GeneralizedRBM/GeneralizedRBMView.h"
+#include "GeneralizedRBM/GeneralizedRBMViewSampler.h"
+
+#include "GeneralizedLowRankRBM/GeneralizedLowRankRBM.h"
+#include "GeneralizedLowRankRBM/GeneralizedLowRankRBMParamator.h"
+#include "GeneralizedLowRankRBM/GeneralizedLowRankRBMSampler.h"
+#include "GeneralizedLowRankRBM/GeneralizedLowRankRBMTrainer.h"
 
 #include "GeneralizedSparseRBM/GeneralizedSparseRBM.h"
 #include "GeneralizedSparseRBM/GeneralizedSparseRBMNode.h"
 #include "GeneralizedSparseRBM/GeneralizedSparseRBMParamator.h"
 #include "GeneralizedSparseRBM/GeneralizedSparseRBMSampler.h"
 #include "GeneralizedSparseRBM/GeneralizedSparseRBMTrainer.h"
+
+#include "GeneralizedFullSparseRBM/GeneralizedFullSparseRBMKernel.h"
@@ -0,0 +1,243 @@
+﻿#pragma once
+#include "Sampler.h"
+#include "Checkpoint.h"
+#include "Eigen/Core"
+#include <vector>
+#include <string>
+#include <random>
+#include <algorithm>
+#include <cmath>
+#include <omp.h>
+
+// レプリカ交換モンテカルロ(パラレルテンパリング)
+// 逆温度betas[k]のレプリカをK個並列にギブスサンプリングし, 隣接レプリカ間で状態を交換する
+// betas[0] = 1.0 のレプリカが元のモデルの分布に従う
+template <class RBMBase>
+class ReplicaExchangeSampler {
+public:
+	std::mt19937 randEngine = std::mt19937();
+	std::vector<double> betas;  // 各レプリカの逆温度(降順)
+	std::vector<RBMBase> replicas;  // 逆温度を掛けたパラメータを持つレプリカ
+	std::vector<Sampler<RBMBase>> samplers;  // レプリカ毎のサンプラー
+
+	std::vector<size_t> swapTrialCount;  // 隣接ペア(k, k+1)の交換試行回数
+	std::vector<size_t> swapAcceptCount;  // 隣接ペア(k, k+1)の交換成立回数
+
+protected:
+	size_t _swapParity = 0;  // 偶数ペアと奇数ペアを交互に交換する
+
+public:
+	ReplicaExchangeSampler();
+	ReplicaExchangeSampler(RBMBase & rbm, size_t replica_size, double beta_min = 0.1);
+	~ReplicaExchangeSampler() = default;
+
+	// 逆温度を等比に配置してレプリカを初期化
+	void init(RBMBase & rbm, size_t replica_size, double beta_min = 0.1);
+
+	// 逆温度を指定してレプリカを初期化
+	void init(RBMBase & rbm, std::vector<double> & beta_set);
+
+	// レプリカ数を返す
+	size_t getReplicaSize();
+
+	// 元のモデルのパラメータをレプリカへ反映(学習でパラメータが更新された後に呼ぶ)
+	void syncParams(RBMBase & rbm);
+
+	// 逆温度betaのパラメータを設定
+	// モデル毎に特殊化する
+	static void temperParams(RBMBase & replica, RBMBase & rbm, double beta);
+
+	// 全レプリカをブロックギブスサンプリングで1回更新
+	void updateReplicas();
+
+	// 隣接レプリカ間の交換を試行
+	void exchangeReplicas(RBMBase & rbm);
+
+	// sweep_num回の(更新 -> 交換)を行い, beta = 1のレプリカの状態をrbm.nodesへ書き戻す
+	void updateByReplicaExchange(RBMBase & rbm, int sweep_num = 1);
+
+	// 隣接ペア毎の交換率
+	std::vector<double> getSwapRate();
+
+	// 交換統計をリセット
+	void resetSwapStats();
+
+	// 持続的なチェインの状態(逆温度, 各レプリカのノードと乱数, 交換統計)のチェックポイント
+	void writeCheckpoint(rbmckpt::Writer & writer, const std::string & prefix);
+
+	// レプリカはrbmから作りなおし, ノードと乱数を上書きする
+	void readCheckpoint(rbmckpt::Reader & reader, const std::string & prefix, RBMBase & rbm);
+};
+
+
+template <class RBMBase>
+ReplicaExchangeSampler<RBMBase>::ReplicaExchangeSampler() {
+	std::random_device rd;
+	this->randEngine = std::mt19937(rd());
+}
+
+template <class RBMBase>
+ReplicaExchangeSampler<RBMBase>::ReplicaExchangeSampler(RBMBase & rbm, size_t replica_size, double beta_min) : ReplicaExchangeSampler() {
+	init(rbm, replica_size, beta_min);
+}
+
+template <class RBMBase>
+void ReplicaExchangeSampler<RBMBase>::init(RBMBase & rbm, size_t replica_size, double beta_min) {
+	std::vector<double> beta_set(std::max<size_t>(replica_size, 1), 1.0);
+
+	// 等比数列 1.0 ... beta_min
+	for (int k = 1; k < beta_set.size(); k++) {
+		beta_set[k] = pow(beta_min, static_cast<double>(k) / static_cast<double>(beta_set.size() - 1));
+	}
+
+	init(rbm, beta_set);
+}
+
+template <class RBMBase>
+void ReplicaExchangeSampler<RBMBase>::init(RBMBase & rbm, std::vector<double> & beta_set) {
+	betas = beta_set;
+	replicas = std::vector<RBMBase>(betas.size(), rbm);
+	samplers = std::vector<Sampler<RBMBase>>(betas.size());
+
+	// サンプラー毎に別の乱数系列を与える
+	for (auto & sampler : samplers) {
+		sampler.randEngine = std::mt19937(this->randEngine());
+	}
+
+	syncParams(rbm);
+	resetSwapStats();
+}
+
+template <class RBMBase>
+size_t ReplicaExchangeSampler<RBMBase>::getReplicaSize() {
+	return replicas.size();
+}
+
+template <class RBMBase>
+void ReplicaExchangeSampler<RBMBase>::syncParams(RBMBase & rbm) {
+	for (int k = 0; k < replicas.size(); k++) {
+		temperParams(replicas[k], rbm, betas[k]);
+	}
+}
+
+template <class RBMBase>
+void ReplicaExchangeSampler<RBMBase>::updateReplicas() {
+	int replica_size = replicas.size();
+
+	// レプリカ毎に1スレッド
+#pragma omp parallel for schedule(static)
+	for (int k = 0; k < replica_size; k++) {
+		samplers[k].updateByBlockedGibbsSamplingVisible(replicas[k]);
+		samplers[k].updateByBlockedGibbsSamplingHidden(replicas[k]);
+	}
+}
+
+template <class RBMBase>
+void ReplicaExchangeSampler<RBMBase>::exchangeReplicas(RBMBase & rbm) {
+	auto replica_size = replicas.size();
+	if (replica_size < 2) return;
+
+	// 全レプリカの状態を行列にまとめ, 元のパラメータ(beta = 1)でのエネルギーを一括計算
+	Eigen::MatrixXd v_batch(replica_size, rbm.getVisibleSize());
+	Eigen::MatrixXd h_batch(replica_size, rbm.getHiddenSize());
+	for (int k = 0; k < replica_size; k++) {
+		v_batch.row(k) = replicas[k].nodes.v.transpose();
+		h_batch.row(k) = replicas[k].nodes.h.transpose();
+	}
+	Eigen::VectorXd energy = rbm.getEnergyBatch(v_batch, h_batch);
+
+	// 隣接ペアの交換確率 min(1, exp((beta_k - beta_{k+1}) (E_k - E_{k+1})))
+	Eigen::Map<Eigen::VectorXd> beta_vect(betas.data(), replica_size);
+	Eigen::ArrayXd log_accept = (beta_vect.head(replica_size - 1) - beta_vect.tail(replica_size - 1)).array()
+		* (energy.head(replica_size - 1) - energy.tail(replica_size - 1)).array();
+
+	std::uniform_real_distribution<double> dist(0.0, 1.0);
+	for (size_t k = _swapParity; k + 1 < replica_size; k += 2) {
+		swapTrialCount[k]++;
+		if (log_accept(k) >= 0.0 || dist(this->randEngine) < exp(log_accept(k))) {
+			std::swap(replicas[k].nodes.v, replicas[k + 1].nodes.v);
+			std::swap(replicas[k].nodes.h, replicas[k + 1].nodes.h);
+			swapAcceptCount[k]++;
+		}
+	}
+
+	_swapParity ^= 1;
+}
+
+template <class RBMBase>
+void ReplicaExchangeSampler<RBMBase>::updateByReplicaExchange(RBMBase & rbm, int sweep_num) {
+	RBM_PROFILE_SCOPE("updateByReplicaExchange");
+
+	for (int s = 0; s < sweep_num; s++) {
+		updateReplicas();
+		exchangeReplicas(rbm);
+	}
+
+	rbm.nodes.v = replicas[0].nodes.v;
+	rbm.nodes.h = replicas[0].nodes.h;
+}
+
+template <class RBMBase>
+std::vector<double> ReplicaExchangeSampler<RBMBase>::getSwapRate() {
+	std::vector<double> rate(swapTrialCount.size(), 0.0);
+
+	for (int k = 0; k < rate.size(); k++) {
+		if (swapTrialCount[k] == 0) continue;
+		rate[k] = static_cast<double>(swapAcceptCount[k]) / static_cast<double>(swapTrialCount[k]);
+	}
+
+	return rate;
+}
+
+template <class RBMBase>
+void ReplicaExchangeSampler<RBMBase>::resetSwapStats() {
+	auto pair_size = replicas.empty() ? 0 : replicas.size() - 1;
+	swapTrialCount.assign(pair_size, 0);
+	swapAcceptCount.assign(pair_size, 0);
+	_swapParity = 0;
+}
+
+template <class RBMBase>
+void ReplicaExchangeSampler<RBMBase>::writeCheckpoint(rbmckpt::Writer & writer, const std::string & prefix) {
+	writer.addVector(prefix + "betas", betas);
+	rbmckpt::addEngine(writer, prefix + "rand", this->randEngine);
+	writer.addScalar(prefix + "swapParity", static_cast<double>(_swapParity));
+	writer.addVector(prefix + "swapTrialCount", std::vector<double>(swapTrialCount.begin(), swapTrialCount.end()));
+	writer.addVector(prefix + "swapAcceptCount", std::vector<double>(swapAcceptCount.begin(), swapAcceptCount.end()));
+
+	for (int k = 0; k < replicas.size(); k++) {
+		auto replica_prefix = prefix + "replica" + std::to_string(k) + ".";
+		writer.add(replica_prefix + "v", replicas[k].nodes.v);
+		writer.add(replica_prefix + "h", replicas[k].nodes.h);
+		rbmckpt::addEngine(writer, replica_prefix + "rand", samplers[k].randEngine);
+	}
+}
+
+template <class RBMBase>
+void ReplicaExchangeSampler<RBMBase>::readCheckpoint(rbmckpt::Reader & reader, const std::string & prefix, RBMBase & rbm) {
+	auto beta_vect = reader.vector(prefix + "betas");
+	std::vector<double> beta_set(beta_vect.data(), beta_vect.data() + beta_vect.size());
+	if (beta_set.empty()) {
+		betas.clear();
+		replicas.clear();
+		samplers.clear();
+		resetSwapStats();
+	}
+	else {
+		init(rbm, beta_set);
+	}
+
+	for (int k = 0; k < replicas.size(); k++) {
+		auto replica_prefix = prefix + "replica" + std::to_string(k) + ".";
+		replicas[k].nodes.v = reader.vector(replica_prefix + "v");
+		replicas[k].nodes.h = reader.vector(replica_prefix + "h");
+		rbmckpt::readEngine(reader, replica_prefix + "rand", samplers[k].randEngine);
+	}
+
+	rbmckpt::readEngine(reader, prefix + "rand", this->randEngine);
+	_swapParity = static_cast<size_t>(reader.scalar(prefix + "swapParity"));
+	auto trial_vect = reader.vector(prefix + "swapTrialCount");
+	auto accept_vect = reader.vector(prefix + "swapAcceptCount");
+	swapTrialCount.assign(trial_vect.data(), trial_vect.data() + trial_vect.size());
+	swapAcceptCount.assign(accept_vect.data(), accept_vect.data() + accept_vect.size());
+}
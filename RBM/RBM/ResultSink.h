@@ -0,0 +1,278 @@
+﻿#pragma once
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <deque>
+#include <cstring>
+#include <cstdint>
+#include <stdexcept>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+// 学習結果1行分
+struct ResultRecord {
+	double kld = 0.0;
+	double loglikelihood = 0.0;
+	int data_size = 0;
+	int v_size = 0;
+	int h_size = 0;
+	std::string rbm_type;  // d: 離散, c: 連続
+	int div_size = 0;
+	std::string train_type;  // exact, cd, pt, mf
+	int epoch = 0;
+	int sparse = 0;  // スパースRBMなら1
+	int try_count = 0;
+	int seed = 0;
+	double reconstruction = 0.0;  // 再構成誤差
+};
+
+// 学習結果の出力先
+// write()は複数スレッドから呼ばれてもよいこと
+class ResultSink {
+public:
+	virtual ~ResultSink() = default;
+
+	// 1行書き込み
+	virtual void write(const ResultRecord & record) = 0;
+
+	// バッファを書き出す
+	virtual void flush() {}
+};
+
+// ストリームへCSVで書き出す
+class StreamResultSink : public ResultSink {
+protected:
+	std::ostream & _stream;
+	std::mutex _mutex;
+	bool _headerFlag = false;
+
+public:
+	StreamResultSink(std::ostream & stream = std::cout) : _stream(stream) {}
+	~StreamResultSink() = default;
+
+	void write(const ResultRecord & record) override {
+		std::lock_guard<std::mutex> lock(_mutex);
+		if (!_headerFlag) {
+			_stream << "kld,loglikelihood,data_size,v_size,h_size,rbm_type,div_size,train_type,epoch,sparse,try_count,seed_num,reconstruction" << "\n";
+			_headerFlag = true;
+		}
+
+		_stream << record.kld << "," << record.loglikelihood << "," << record.data_size << ","
+			<< record.v_size << "," << record.h_size << "," << record.rbm_type << ","
+			<< record.div_size << "," << record.train_type << "," << record.epoch << ","
+			<< record.sparse << "," << record.try_count << "," << record.seed << "," << record.reconstruction << "\n";
+	}
+
+	void flush() override {
+		std::lock_guard<std::mutex> lock(_mutex);
+		_stream.flush();
+	}
+};
+
+// 何もしない(計測のみしたい場合)
+class NullResultSink : public ResultSink {
+public:
+	void write(const ResultRecord & record) override {}
+};
+
+// CSVファイルへ追記
+class CsvResultSink : public ResultSink {
+protected:
+	std::ofstream _file;
+	std::mutex _mutex;
+
+public:
+	CsvResultSink(const std::string & path) {
+		std::ifstream check(path, std::ios::binary | std::ios::ate);
+		auto empty = !check.is_open() || check.tellg() == 0;
+
+		_file.open(path, std::ios::out | std::ios::app);
+		if (!_file) throw std::runtime_error("cannot open " + path);
+
+		if (empty) {
+			_file << "kld,loglikelihood,data_size,v_size,h_size,rbm_type,div_size,train_type,epoch,sparse,try_count,seed_num,reconstruction" << "\n";
+		}
+	}
+	~CsvResultSink() = default;
+
+	void write(const ResultRecord & record) override {
+		std::lock_guard<std::mutex> lock(_mutex);
+		_file << record.kld << "," << record.loglikelihood << "," << record.data_size << ","
+			<< record.v_size << "," << record.h_size << "," << record.rbm_type << ","
+			<< record.div_size << "," << record.train_type << "," << record.epoch << ","
+			<< record.sparse << "," << record.try_count << "," << record.seed << "," << record.reconstruction << "\n";
+	}
+
+	void flush() override {
+		std::lock_guard<std::mutex> lock(_mutex);
+		_file.flush();
+	}
+};
+
+// 固定長レコードのバイナリファイルへ追記
+// ファイル先頭に8バイトのマジック, 以降72バイトのレコードが並ぶ
+class BinaryResultSink : public ResultSink {
+public:
+	struct BinaryRecord {
+		double kld;
+		double loglikelihood;
+		double reconstruction;
+		int32_t data_size;
+		int32_t v_size;
+		int32_t h_size;
+		int32_t div_size;
+		int32_t epoch;
+		int32_t sparse;
+		int32_t try_count;
+		int32_t seed;
+		char rbm_type[4];
+		char train_type[12];
+	};
+	static_assert(sizeof(BinaryRecord) == 72, "BinaryRecord must be 72 bytes");
+
+	static constexpr const char * MAGIC = "RBMRSLT2";
+
+protected:
+	std::ofstream _file;
+	std::mutex _mutex;
+
+public:
+	BinaryResultSink(const std::string & path) {
+		std::ifstream check(path, std::ios::binary | std::ios::ate);
+		auto empty = !check.is_open() || check.tellg() == 0;
+
+		_file.open(path, std::ios::out | std::ios::binary | std::ios::app);
+		if (!_file) throw std::runtime_error("cannot open " + path);
+
+		if (empty) _file.write(MAGIC, 8);
+	}
+	~BinaryResultSink() = default;
+
+	void write(const ResultRecord & record) override {
+		BinaryRecord bin = {};
+		bin.kld = record.kld;
+		bin.loglikelihood = record.loglikelihood;
+		bin.reconstruction = record.reconstruction;
+		bin.data_size = record.data_size;
+		bin.v_size = record.v_size;
+		bin.h_size = record.h_size;
+		bin.div_size = record.div_size;
+		bin.epoch = record.epoch;
+		bin.sparse = record.sparse;
+		bin.try_count = record.try_count;
+		bin.seed = record.seed;
+		strncpy(bin.rbm_type, record.rbm_type.c_str(), sizeof(bin.rbm_type) - 1);
+		strncpy(bin.train_type, record.train_type.c_str(), sizeof(bin.train_type) - 1);
+
+		std::lock_guard<std::mutex> lock(_mutex);
+		_file.write(reinterpret_cast<const char *>(&bin), sizeof(bin));
+	}
+
+	void flush() override {
+		std::lock_guard<std::mutex> lock(_mutex);
+		_file.flush();
+	}
+
+	// 書き出したファイルを読み込む
+	static std::vector<ResultRecord> read(const std::string & path) {
+		std::ifstream file(path, std::ios::in | std::ios::binary);
+		char magic[8];
+		if (!file.read(magic, 8) || memcmp(magic, MAGIC, 8) != 0) throw std::runtime_error("invalid result file: " + path);
+
+		std::vector<ResultRecord> records;
+		BinaryRecord bin;
+		while (file.read(reinterpret_cast<char *>(&bin), sizeof(bin))) {
+			ResultRecord record;
+			record.kld = bin.kld;
+			record.loglikelihood = bin.loglikelihood;
+			record.reconstruction = bin.reconstruction;
+			record.data_size = bin.data_size;
+			record.v_size = bin.v_size;
+			record.h_size = bin.h_size;
+			record.div_size = bin.div_size;
+			record.epoch = bin.epoch;
+			record.sparse = bin.sparse;
+			record.try_count = bin.try_count;
+			record.seed = bin.seed;
+			record.rbm_type = bin.rbm_type;
+			record.train_type = bin.train_type;
+			records.push_back(record);
+		}
+
+		return records;
+	}
+};
+
+// バックグラウンドスレッドで別のシンクへ書き込む
+// write()はキューに積むだけなので学習ループを止めない
+class AsyncResultSink : public ResultSink {
+protected:
+	ResultSink & _sink;
+	std::deque<ResultRecord> _queue;
+	std::mutex _mutex;
+	std::condition_variable _queueCondition;
+	std::condition_variable _doneCondition;
+	bool _stop = false;
+	bool _busy = false;
+	std::thread _thread;
+
+public:
+	AsyncResultSink(ResultSink & sink) : _sink(sink) {
+		_thread = std::thread(&AsyncResultSink::writerLoop, this);
+	}
+
+	~AsyncResultSink() {
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_stop = true;
+		}
+		_queueCondition.notify_all();
+		_thread.join();
+		_sink.flush();
+	}
+
+	void write(const ResultRecord & record) override {
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_queue.push_back(record);
+		}
+		_queueCondition.notify_one();
+	}
+
+	// キューが空になるまで待ってから書き出す
+	void flush() override {
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_doneCondition.wait(lock, [&] { return _queue.empty() && !_busy; });
+		}
+		_sink.flush();
+	}
+
+protected:
+	void writerLoop() {
+		while (true) {
+			std::deque<ResultRecord> batch;
+			{
+				std::unique_lock<std::mutex> lock(_mutex);
+				_queueCondition.wait(lock, [&] { return _stop || !_queue.empty(); });
+				if (_queue.empty() && _stop) return;
+
+				// 溜まっている分をまとめて取り出す
+				batch.swap(_queue);
+				_busy = true;
+			}
+
+			for (auto & record : batch) {
+				_sink.write(record);
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				_busy = false;
+			}
+			_doneCondition.notify_all();
+		}
+	}
+};
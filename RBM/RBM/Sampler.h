@@ -1,4 +1,5 @@
 #pragma once
+#include "Profiler.h"
 
 template <class RBMBase>
 class Sampler {
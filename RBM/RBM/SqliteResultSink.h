@@ -0,0 +1,150 @@
+﻿#pragma once
+#include "ResultSink.h"
+#include <sqlite3.h>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <stdexcept>
+
+// SQLiteへ書き込む
+// WALモードで開き, INSERT文は1つを使い回し, batchSize行毎に1トランザクションでまとめて書き込む
+class SqliteResultSink : public ResultSink {
+public:
+	size_t batchSize = 1000;
+
+protected:
+	sqlite3 * _db = nullptr;
+	sqlite3_stmt * _insert = nullptr;
+	std::vector<ResultRecord> _buffer;
+	std::mutex _mutex;
+
+public:
+	SqliteResultSink(const std::string & path, size_t batch_size = 1000);
+	~SqliteResultSink();
+
+	SqliteResultSink(const SqliteResultSink &) = delete;
+	SqliteResultSink & operator=(const SqliteResultSink &) = delete;
+
+	void write(const ResultRecord & record) override;
+
+	void flush() override;
+
+protected:
+	// SQLを実行
+	void exec(const std::string & sql);
+
+	// エラーなら例外
+	void check(int rc, const char * what);
+
+	// バッファを1トランザクションで書き込む(ロック済みで呼ぶ)
+	void commitBuffer();
+};
+
+
+inline SqliteResultSink::SqliteResultSink(const std::string & path, size_t batch_size) : batchSize(batch_size) {
+	if (sqlite3_open(path.c_str(), &_db) != SQLITE_OK) {
+		std::string message = sqlite3_errmsg(_db);
+		sqlite3_close(_db);
+		throw std::runtime_error("cannot open " + path + ": " + message);
+	}
+
+	exec("PRAGMA journal_mode = WAL");
+	exec("PRAGMA synchronous = NORMAL");
+	exec(
+		"CREATE TABLE IF NOT EXISTS result ("
+		"uid INTEGER PRIMARY KEY AUTOINCREMENT, "
+		"kld REAL, "
+		"loglikelihood REAL, "
+		"data_size INTEGER, "
+		"v_size INTEGER, "
+		"h_size INTEGER, "
+		"rbm_type TEXT, "
+		"div_size INTEGER, "
+		"train_type TEXT, "
+		"epoch INTEGER, "
+		"sparse INTEGER, "
+		"try_count INTEGER, "
+		"seed_num INTEGER, "
+		"reconstruction REAL"
+		")"
+	);
+
+	check(sqlite3_prepare_v2(_db,
+		"INSERT INTO result (kld, loglikelihood, data_size, v_size, h_size, rbm_type, div_size, train_type, epoch, sparse, try_count, seed_num, reconstruction) "
+		"VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)",
+		-1, &_insert, nullptr), "prepare");
+
+	_buffer.reserve(batchSize);
+}
+
+inline SqliteResultSink::~SqliteResultSink() {
+	try {
+		flush();
+	}
+	catch (...) {
+	}
+
+	sqlite3_finalize(_insert);
+	sqlite3_close(_db);
+}
+
+inline void SqliteResultSink::write(const ResultRecord & record) {
+	std::lock_guard<std::mutex> lock(_mutex);
+	_buffer.push_back(record);
+
+	if (_buffer.size() >= batchSize) commitBuffer();
+}
+
+inline void SqliteResultSink::flush() {
+	std::lock_guard<std::mutex> lock(_mutex);
+	commitBuffer();
+}
+
+inline void SqliteResultSink::exec(const std::string & sql) {
+	char * error = nullptr;
+	if (sqlite3_exec(_db, sql.c_str(), nullptr, nullptr, &error) != SQLITE_OK) {
+		std::string message = error ? error : "";
+		sqlite3_free(error);
+		throw std::runtime_error("sqlite: " + message + " (" + sql + ")");
+	}
+}
+
+inline void SqliteResultSink::check(int rc, const char * what) {
+	if (rc != SQLITE_OK && rc != SQLITE_DONE) {
+		throw std::runtime_error(std::string("sqlite ") + what + ": " + sqlite3_errmsg(_db));
+	}
+}
+
+inline void SqliteResultSink::commitBuffer() {
+	if (_buffer.empty()) return;
+
+	exec("BEGIN");
+	try {
+		for (auto & record : _buffer) {
+			sqlite3_reset(_insert);
+			sqlite3_bind_double(_insert, 1, record.kld);
+			sqlite3_bind_double(_insert, 2, record.loglikelihood);
+			sqlite3_bind_int(_insert, 3, record.data_size);
+			sqlite3_bind_int(_insert, 4, record.v_size);
+			sqlite3_bind_int(_insert, 5, record.h_size);
+			sqlite3_bind_text(_insert, 6, record.rbm_type.c_str(), -1, SQLITE_TRANSIENT);
+			sqlite3_bind_int(_insert, 7, record.div_size);
+			sqlite3_bind_text(_insert, 8, record.train_type.c_str(), -1, SQLITE_TRANSIENT);
+			sqlite3_bind_int(_insert, 9, record.epoch);
+			sqlite3_bind_int(_insert, 10, record.sparse);
+			sqlite3_bind_int(_insert, 11, record.try_count);
+			sqlite3_bind_int(_insert, 12, record.seed);
+			sqlite3_bind_double(_insert, 13, record.reconstruction);
+			check(sqlite3_step(_insert), "insert");
+		}
+	}
+	catch (...) {
+		sqlite3_reset(_insert);
+		exec("ROLLBACK");
+		throw;
+	}
+	sqlite3_reset(_insert);
+	exec("COMMIT");
+
+	_buffer.clear();
+}
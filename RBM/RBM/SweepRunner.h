@@ -0,0 +1,210 @@
+﻿#pragma once
+#include "GeneralizedRBM/GeneralizedRBMTrainer.h"
+#include "GeneralizedSparseRBM/GeneralizedSparseRBMTrainer.h"
+#include "GeneralizedRBM/GeneralizedRBMFixedTrainer.h"
+#include "WorkStealingPool.h"
+#include "ResultSink.h"
+#include "EvalScheduler.h"
+#include "rbmutil.h"
+#include <vector>
+#include <string>
+#include <cmath>
+#include <omp.h>
+
+// ハイパーパラメータ掃引の1ジョブ
+struct SweepJob {
+	int hSize = 1;
+	int divSize = 1;  // 0以下なら連続値
+	std::string trainMode = "exact";  // exact, cd, pt, mf
+	std::string rbmType = "rbm";  // rbm, sparse
+	int seed = 0;
+	int tryCount = 0;
+};
+
+// 掃引する格子(直積で展開)
+struct SweepGrid {
+	std::vector<int> hiddenSizes = { 4 };
+	std::vector<int> divSizes = { 1 };
+	std::vector<std::string> trainModes = { "exact" };
+	std::vector<std::string> rbmTypes = { "rbm" };
+	std::vector<int> seeds = { 0 };
+	int tryNum = 1;
+
+	// ジョブ一覧に展開
+	std::vector<SweepJob> expand() {
+		std::vector<SweepJob> jobs;
+
+		for (int t = 0; t < tryNum; t++)
+		for (auto & rbm_type : rbmTypes)
+		for (auto & train_mode : trainModes)
+		for (auto h_size : hiddenSizes)
+		for (auto div_size : divSizes)
+		for (auto seed : seeds) {
+			SweepJob job;
+			job.hSize = h_size;
+			job.divSize = div_size;
+			job.trainMode = train_mode;
+			job.rbmType = rbm_type;
+			job.seed = seed;
+			job.tryCount = t;
+			jobs.push_back(job);
+		}
+
+		return jobs;
+	}
+};
+
+// 全ジョブで共通の学習設定
+struct SweepSetting {
+	int epoch = 1000;
+	int cdk = 1;
+	int batchSize = 100;
+	double learningRate = 0.1;
+	int evalInterval = 1;  // 評価するエポック間隔
+	int threadSize = std::thread::hardware_concurrency();  // ジョブを並列に流すスレッド数
+	int ompThreadSize = 1;  // 1ジョブ内のOpenMPスレッド数
+};
+
+// 全ジョブで共有する生成モデル, データ, 参照分布
+class SweepContext {
+public:
+	GeneralizedRBM generator;
+	std::vector<std::vector<double>> dataset;
+	PackedDataset uniqueDataset;  // datasetの重複行をまとめたもの(exact学習と評価に使う)
+	std::vector<double> visibleValues = { -1.0, 1.0 };
+	std::vector<double> referenceProbs;  // 生成モデルの可視変数の確率表
+
+public:
+	SweepContext() = default;
+	~SweepContext() = default;
+
+	// 生成モデルを作り, データを生成し, 参照分布を一度だけ計算する
+	void init(int v_size, int gen_h_size, int data_size, int seed) {
+		generator = GeneralizedRBM(v_size, gen_h_size);
+		generator.setHiddenMin(-1.0);
+		generator.setHiddenMax(1.0);
+		generator.setHiddenDivSize(1);
+		generator.params.initParamsXavier(seed);
+
+		dataset.clear();
+		for (int i = 0; i < data_size; i++) {
+			dataset.push_back(rbmutil::data_gen<GeneralizedRBM, std::vector<double> >(generator, v_size, seed));
+		}
+
+		uniqueDataset = PackedDataset::unique(dataset, visibleValues[0], visibleValues[1]);
+		referenceProbs = rbmutil::prob_table(generator, visibleValues);
+	}
+};
+
+// ハイパーパラメータ掃引をプロセス内で並列実行する
+class SweepRunner {
+public:
+	SweepSetting setting;
+
+protected:
+	SweepContext & _context;
+	ResultSink & _sink;
+
+public:
+	SweepRunner(SweepContext & context, ResultSink & sink) : _context(context), _sink(sink) {}
+	~SweepRunner() = default;
+
+	// 全ジョブを実行
+	void run(std::vector<SweepJob> & jobs) {
+		auto omp_thread_size = setting.ompThreadSize;
+		WorkStealingPool pool(setting.threadSize, [omp_thread_size] { omp_set_num_threads(omp_thread_size); });
+
+		for (auto & job : jobs) {
+			pool.submit([this, job] { runJob(job); });
+		}
+
+		pool.wait();
+		_sink.flush();
+	}
+
+	// 1ジョブを実行
+	void runJob(const SweepJob & job) {
+		auto v_size = _context.generator.getVisibleSize();
+		if (job.rbmType == "sparse") {
+			train(initModel(GeneralizedSparseRBM(v_size, job.hSize), job), job, 1);
+			return;
+		}
+
+		auto rbm = initModel(GeneralizedRBM(v_size, job.hSize), job);
+#ifdef RBM_FIXED_SIZE
+		if (trainFixed(rbm, job)) return;
+#endif
+		train(rbm, job, 0);
+	}
+
+protected:
+	template <class RBM>
+	RBM initModel(RBM rbm, const SweepJob & job) {
+		rbm.params.initParamsXavier(job.seed);
+		rbm.setHiddenMin(-1.0);
+		rbm.setHiddenMax(1.0);
+		rbm.setHiddenDivSize(job.divSize < 1 ? 1 : job.divSize);
+		rbm.setRealHiddenValue(job.divSize < 1);
+
+		return rbm;
+	}
+
+	// 小さいモデルのexact, cdは固定サイズ版で学習する(範囲外ならfalse)
+	bool trainFixed(GeneralizedRBM & rbm, const SweepJob & job) {
+		if (job.trainMode != "exact" && job.trainMode != "cd") return false;
+
+		return rbmfixed::dispatch(rbm.getVisibleSize(), rbm.getHiddenSize(), [&](auto v_size, auto h_size) {
+			train(FixedGeneralizedRBM<decltype(v_size)::value, decltype(h_size)::value>(rbm), job, 0);
+		});
+	}
+
+	// 1エポック学習
+	template <class TRAINER, class RBM>
+	void trainOnce(TRAINER & trainer, RBM & rbm, const SweepJob & job) {
+		auto & dataset = _context.dataset;
+		if (job.trainMode == "cd") trainer.trainOnceCD(rbm, dataset);
+		else if (job.trainMode == "pt") trainer.trainOncePT(rbm, dataset);
+		else if (job.trainMode == "mf") trainer.trainOnceMF(rbm, dataset);
+		else trainer.trainOnceExact(rbm, _context.uniqueDataset);
+	}
+
+	// 1エポック学習(固定サイズ版はexactとcdのみ)
+	template <int V, int H>
+	void trainOnce(Trainer<FixedGeneralizedRBM<V, H>, OptimizerType::AdaMax> & trainer, FixedGeneralizedRBM<V, H> & rbm, const SweepJob & job) {
+		if (job.trainMode == "cd") trainer.trainOnceCD(rbm, _context.dataset);
+		else trainer.trainOnceExact(rbm, _context.uniqueDataset);
+	}
+
+	template <class RBM>
+	void train(RBM rbm, const SweepJob & job, int sparse) {
+		Trainer<RBM, OptimizerType::AdaMax> trainer(rbm);
+		trainer.epoch = setting.epoch;
+		trainer.cdk = setting.cdk;
+		trainer.batchSize = setting.batchSize;
+		trainer.learningRate = setting.learningRate;
+		trainer.randDevice = std::mt19937(job.seed);
+
+		auto & dataset = _context.dataset;
+		for (int epoch_count = 0; epoch_count < setting.epoch; epoch_count++) {
+			trainOnce(trainer, rbm, job);
+
+			auto last = epoch_count == setting.epoch - 1;
+			if (!last && (epoch_count + 1) % setting.evalInterval != 0) continue;
+
+			// ジョブ自体が並列に走っているので, 評価はこのスレッドで同期的に行う
+			ResultRecord result;
+			EvalScheduler<RBM>::evaluate(rbm, _context.uniqueDataset, _context.referenceProbs, _context.visibleValues, result);
+			result.data_size = dataset.size();
+			result.v_size = rbm.getVisibleSize();
+			result.h_size = rbm.getHiddenSize();
+			result.rbm_type = rbm.isRealHiddenValue() ? "c" : "d";
+			result.div_size = rbm.getHiddenDivSize();
+			result.train_type = job.trainMode;
+			result.epoch = epoch_count;
+			result.sparse = sparse;
+			result.try_count = job.tryCount;
+			result.seed = job.seed;
+			_sink.write(result);
+		}
+	}
+};
@@ -0,0 +1,172 @@
+﻿#pragma once
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <exception>
+
+// ワークスティーリング方式のスレッドプール
+// 各ワーカーは自分のキューの末尾から取り出し, 空なら他ワーカーのキューの先頭から盗む
+class WorkStealingPool {
+	struct WorkerQueue {
+		std::deque<std::function<void()>> tasks;
+		std::mutex mutex;
+	};
+
+protected:
+	std::vector<std::unique_ptr<WorkerQueue>> _queues;
+	std::vector<std::thread> _threads;
+	std::atomic<size_t> _queuedCount{ 0 };  // キューに積まれているタスク数
+	std::atomic<size_t> _pendingCount{ 0 };  // 未完了のタスク数
+	std::atomic<size_t> _submitCount{ 0 };
+	bool _stop = false;
+	std::mutex _mutex;
+	std::condition_variable _taskCondition;
+	std::condition_variable _doneCondition;
+	std::exception_ptr _exception;
+
+public:
+	// thread_init: 各ワーカースレッドの開始時に呼ばれる(OpenMPのスレッド数設定など)
+	WorkStealingPool(size_t thread_size = std::thread::hardware_concurrency(), std::function<void()> thread_init = nullptr);
+	~WorkStealingPool();
+
+	WorkStealingPool(const WorkStealingPool &) = delete;
+	WorkStealingPool & operator=(const WorkStealingPool &) = delete;
+
+	// ワーカー数を返す
+	size_t getThreadSize();
+
+	// タスクを投入
+	void submit(std::function<void()> task);
+
+	// 全タスクの完了を待つ(タスク内の例外はここで再送出)
+	void wait();
+
+protected:
+	// ワーカーのメインループ
+	void workerLoop(size_t index, std::function<void()> thread_init);
+
+	// 自分のキューか他のキューからタスクを取得
+	bool takeTask(size_t index, std::function<void()> & task);
+};
+
+
+inline WorkStealingPool::WorkStealingPool(size_t thread_size, std::function<void()> thread_init) {
+	if (thread_size < 1) thread_size = 1;
+
+	for (int i = 0; i < thread_size; i++) {
+		_queues.emplace_back(new WorkerQueue());
+	}
+
+	for (int i = 0; i < thread_size; i++) {
+		_threads.emplace_back(&WorkStealingPool::workerLoop, this, i, thread_init);
+	}
+}
+
+inline WorkStealingPool::~WorkStealingPool() {
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_stop = true;
+	}
+	_taskCondition.notify_all();
+
+	for (auto & thread : _threads) {
+		thread.join();
+	}
+}
+
+inline size_t WorkStealingPool::getThreadSize() {
+	return _threads.size();
+}
+
+inline void WorkStealingPool::submit(std::function<void()> task) {
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_pendingCount++;
+		_queuedCount++;
+	}
+
+	// ラウンドロビンで各ワーカーのキューへ配る
+	auto index = _submitCount++ % _queues.size();
+	{
+		std::lock_guard<std::mutex> lock(_queues[index]->mutex);
+		_queues[index]->tasks.push_back(std::move(task));
+	}
+
+	_taskCondition.notify_one();
+}
+
+inline void WorkStealingPool::wait() {
+	std::unique_lock<std::mutex> lock(_mutex);
+	_doneCondition.wait(lock, [&] { return _pendingCount == 0; });
+
+	if (_exception) {
+		auto e = _exception;
+		_exception = nullptr;
+		std::rethrow_exception(e);
+	}
+}
+
+inline bool WorkStealingPool::takeTask(size_t index, std::function<void()> & task) {
+	// 自分のキューの末尾
+	{
+		auto & queue = *_queues[index];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (!queue.tasks.empty()) {
+			task = std::move(queue.tasks.back());
+			queue.tasks.pop_back();
+			return true;
+		}
+	}
+
+	// 他のキューの先頭から盗む
+	for (int k = 1; k < _queues.size(); k++) {
+		auto & queue = *_queues[(index + k) % _queues.size()];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (!queue.tasks.empty()) {
+			task = std::move(queue.tasks.front());
+			queue.tasks.pop_front();
+			return true;
+		}
+	}
+
+	return false;
+}
+
+inline void WorkStealingPool::workerLoop(size_t index, std::function<void()> thread_init) {
+	if (thread_init) thread_init();
+
+	while (true) {
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_taskCondition.wait(lock, [&] { return _stop || _queuedCount > 0; });
+			if (_queuedCount == 0 && _stop) return;
+		}
+
+		std::function<void()> task;
+		if (!takeTask(index, task)) continue;
+
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_queuedCount--;
+		}
+
+		try {
+			task();
+		}
+		catch (...) {
+			std::lock_guard<std::mutex> lock(_mutex);
+			if (!_exception) _exception = std::current_exception();
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_pendingCount--;
+			if (_pendingCount == 0) _doneCondition.notify_all();
+		}
+	}
+}
@@ -3,18 +3,17 @@
 #include <fstream>
 #include <cmath>
 #include <random>
+#include <algorithm>
+#include <vector>
 #include "StateCounter.h"
 #include "Sampler.h"
+#include "ReplicaExchangeSampler.h"
+#include "PackedVisible.h"
 #include <omp.h>
 
 namespace rbmutil {
 
 	// generate data from rbm
-	template <class T, class STL>
-	STL data_gen(T & rbm, int update_count) {
-		return rbmutil::data_gen<T, STL>(rbm, update_count, std::random_device()());
-	}
-
 	template <class T, class STL>
 	STL data_gen(T & rbm, int update_count, int seed) {
 		Sampler<T> sampler;
@@ -35,6 +34,26 @@ namespace rbmutil {
 		return dat;
 	}
 
+	template <class T, class STL>
+	STL data_gen(T & rbm, int update_count) {
+		return rbmutil::data_gen<T, STL>(rbm, update_count, std::random_device()());
+	}
+
+	// generate data from rbm by replica exchange (parallel tempering)
+	template <class T, class STL>
+	STL data_gen(T & rbm, ReplicaExchangeSampler<T> & sampler, int update_count) {
+		sampler.syncParams(rbm);
+		sampler.updateByReplicaExchange(rbm, update_count);
+
+		std::vector<double> dat(rbm.getVisibleSize());
+
+		for (int i = 0; i < dat.size(); i++) {
+			dat[i] = rbm.nodes.v(i);
+		}
+
+		return dat;
+	}
+
 	// output stl value to stdout
 	template <class STL>
 	void print_stl(STL & stl) {
@@ -45,9 +64,14 @@ namespace rbmutil {
 		std::cout << stl[stl.size() - 1] << std::endl;
 	}
 
+	template<class RBM>
+	void print_params(RBM & rbm) {
+		rbm.params.printParams();
+	}
+
 	// Kullback–Leibler divergence
 	template <class RBM1, class RBM2, class STL>
-	double kld(RBM1 & rbm1, RBM2 & rbm2, STL & v_val) {
+	double kld(RBM1 & rbm1, RBM2 & rbm2, const STL & v_val) {
 		StateCounter<std::vector<int>> sc(std::vector<int>(rbm1.getVisibleSize(), v_val.size()));
 		auto setting_data_from_state = [&](auto & state_counter, auto & dat) {
 			auto state = state_counter.getState();
@@ -75,7 +99,7 @@ namespace rbmutil {
 			prob[1] = rbm2_replica.probVis(dat);
 
 			value += prob[0] * log(prob[0] / prob[1]);
-			if (isnan(value) || isinf(value)) {
+			if (std::isnan(value) || std::isinf(value)) {
 				volatile auto debug_value = value;
 				volatile auto p1 = prob[0];
 				volatile auto p2 = prob[1];
@@ -100,9 +124,114 @@ namespace rbmutil {
 		return value;
 	}
 
-	template<class RBM>
-	void print_params(RBM & rbm) {
-		rbm.params.printParams();
+	// probability table of visible states (state order follows StateCounter)
+	template <class RBM, class STL>
+	std::vector<double> prob_table(RBM & rbm, STL & v_val) {
+		StateCounter<std::vector<int>> sc(std::vector<int>(rbm.getVisibleSize(), v_val.size()));
+		int max_count = sc.getMaxCount();
+		auto z = rbm.getNormalConstant();
+		std::vector<double> probs(max_count);
+
+#pragma omp parallel for schedule(static)
+		for (int c = 0; c < max_count; c++) {
+			auto sc_replica = sc;
+			sc_replica.innerCounter = c;
+			auto state = sc_replica.getState();
+			std::vector<double> dat(rbm.getVisibleSize());
+			for (int i = 0; i < dat.size(); i++) {
+				dat[i] = v_val[state[i]];
+			}
+
+			auto rbm_replica = rbm;
+			probs[c] = rbm_replica.probVis(dat, z);
+		}
+
+		return probs;
+	}
+
+	// index of visible state in prob_table
+	template <class STL>
+	size_t state_index(std::vector<double> & dat, STL & v_val) {
+		size_t index = 0;
+		size_t base = 1;
+
+		for (int i = 0; i < dat.size(); i++) {
+			auto pos = std::find(v_val.begin(), v_val.end(), dat[i]) - v_val.begin();
+			index += pos * base;
+			base *= v_val.size();
+		}
+
+		return index;
+	}
+
+	// Kullback–Leibler divergence between probability tables
+	inline double kld_from_probs(std::vector<double> & probs1, std::vector<double> & probs2) {
+		double value = 0.0;
+
+		for (int c = 0; c < probs1.size(); c++) {
+			if (probs1[c] <= 0.0) continue;
+			value += probs1[c] * log(probs1[c] / probs2[c]);
+		}
+
+		return value;
+	}
+
+	// reconstruction error: mean of |v - E[v | E[h | v]]|^2 over dataset
+	template <class RBM, class STL>
+	double reconstruction_error(RBM & rbm, std::vector<std::vector<double>> & dataset, STL & v_val) {
+		double value = 0.0;
+
+		for (auto & data : dataset) {
+			for (int i = 0; i < rbm.getVisibleSize(); i++) {
+				rbm.nodes.v(i) = data[i];
+			}
+
+			for (int j = 0; j < rbm.getHiddenSize(); j++) {
+				rbm.nodes.h(j) = rbm.actHidJ(j);
+			}
+
+			for (int i = 0; i < rbm.getVisibleSize(); i++) {
+				double expected = 0.0;
+				for (auto & v : v_val) {
+					expected += v * rbm.condProbVis(i, v);
+				}
+
+				value += (data[i] - expected) * (data[i] - expected);
+			}
+		}
+
+		return dataset.empty() ? 0.0 : value / dataset.size();
+	}
+
+	// reconstruction error over weighted rows (duplicate rows collapsed by PackedDataset::unique)
+	template <class RBM, class STL>
+	double reconstruction_error(RBM & rbm, PackedDataset & dataset, STL & v_val) {
+		double value = 0.0;
+
+		for (size_t n = 0; n < dataset.size(); n++) {
+			auto data = dataset.unpack(n);
+			for (int i = 0; i < rbm.getVisibleSize(); i++) {
+				rbm.nodes.v(i) = data[i];
+			}
+
+			for (int j = 0; j < rbm.getHiddenSize(); j++) {
+				rbm.nodes.h(j) = rbm.actHidJ(j);
+			}
+
+			double error = 0.0;
+			for (int i = 0; i < rbm.getVisibleSize(); i++) {
+				double expected = 0.0;
+				for (auto & v : v_val) {
+					expected += v * rbm.condProbVis(i, v);
+				}
+
+				error += (data[i] - expected) * (data[i] - expected);
+			}
+
+			value += dataset.weight(n) * error;
+		}
+
+		return dataset.empty() ? 0.0 : value / dataset.totalWeight();
 	}
 }
 
@@ -0,0 +1,387 @@
+﻿#include <iostream>
+#include <string>
+#include <vector>
+#include <random>
+#include <boost/program_options.hpp>
+#include "RBMCore.h"
+#include "rbmutil.h"
+#include "Benchmark.h"
+#include "PackedVisible.h"
+
+typedef struct {
+	std::vector<int> vSizes = { 4, 8 };
+	std::vector<int> hSizes = { 4, 8 };
+	int datasize = 100;
+	int cdk = 1;
+	int maxExactSize = 12;  // 状態数が2^nで増えるワークロードを回す上限
+	int maxKldSize = 8;  // kldは状態数の2乗で増える
+	int seed = 0;
+	std::string outputPath = "";
+	std::string baselinePath = "";
+	double threshold = 0.1;
+	bool failOnRegression = false;
+} OPTION;
+
+// コマンドラインオプションの設定
+OPTION get_option(int argc, char** argv, rbmbench::BenchRunner & runner) {
+	namespace po = boost::program_options;
+	po::options_description opt("オプション");
+	opt.add_options()
+		("help,h", "ヘルプを表示")
+		("vsize", po::value<std::vector<int>>()->multitoken()->default_value(std::vector<int>{4, 8}, "4 8"), "visible node sizes")
+		("hsize", po::value<std::vector<int>>()->multitoken()->default_value(std::vector<int>{4, 8}, "4 8"), "hidden node sizes")
+		("datasize", po::value<int>()->default_value(100), "dataset size for epoch workloads")
+		("cdk", po::value<int>()->default_value(1), "cdk")
+		("max_exact_size", po::value<int>()->default_value(12), "skip exponential workloads above this size")
+		("max_kld_size", po::value<int>()->default_value(8), "skip kld above this visible size")
+		("seed", po::value<int>()->default_value(0), "seed value")
+		("repeats", po::value<int>()->default_value(5), "measurement count per workload")
+		("min_time", po::value<double>()->default_value(0.05), "minimum time per measurement(sec)")
+		("filter", po::value<std::string>()->default_value(""), "run workloads whose name/model contains this")
+		("output", po::value<std::string>()->default_value(""), "output csv(empty: stdout)")
+		("baseline", po::value<std::string>()->default_value(""), "baseline csv to compare")
+		("threshold", po::value<double>()->default_value(0.1), "relative slowdown treated as regression")
+		("fail_on_regression", "exit with 1 when a regression is found");
+
+	po::variables_map vm;
+	po::store(po::parse_command_line(argc, argv, opt), vm);
+	po::notify(vm);
+
+	if (vm.count("help")) {
+		std::cout << opt << std::endl;
+		exit(0);
+	}
+
+	OPTION option;
+	try {
+		option.vSizes = vm["vsize"].as<std::vector<int>>();
+		option.hSizes = vm["hsize"].as<std::vector<int>>();
+		option.datasize = vm["datasize"].as<int>();
+		option.cdk = vm["cdk"].as<int>();
+		option.maxExactSize = vm["max_exact_size"].as<int>();
+		option.maxKldSize = vm["max_kld_size"].as<int>();
+		option.seed = vm["seed"].as<int>();
+		option.outputPath = vm["output"].as<std::string>();
+		option.baselinePath = vm["baseline"].as<std::string>();
+		option.threshold = vm["threshold"].as<double>();
+		option.failOnRegression = vm.count("fail_on_regression") > 0;
+
+		runner.repeats = vm["repeats"].as<int>();
+		runner.minTime = vm["min_time"].as<double>();
+		runner.filter = vm["filter"].as<std::string>();
+	}
+	catch (std::exception& e)
+	{
+		std::cout << "exception: " << e.what() << std::endl;
+		std::cout << opt << std::endl;
+		exit(-1l);
+	}
+
+	return option;
+}
+
+// 可視変数が{-1, 1}の一様乱数データ
+std::vector<std::vector<double>> make_discrete_dataset(int v_size, int data_size, int seed) {
+	std::mt19937 mt(seed);
+	std::uniform_int_distribution<int> dist(0, 1);
+	std::vector<std::vector<double>> dataset(data_size, std::vector<double>(v_size));
+	for (auto & data : dataset) {
+		for (auto & value : data) value = dist(mt) ? 1.0 : -1.0;
+	}
+	return dataset;
+}
+
+// 可視変数が標準正規分布のデータ
+std::vector<std::vector<double>> make_real_dataset(int v_size, int data_size, int seed) {
+	std::mt19937 mt(seed);
+	std::normal_distribution<double> dist(0.0, 1.0);
+	std::vector<std::vector<double>> dataset(data_size, std::vector<double>(v_size));
+	for (auto & data : dataset) {
+		for (auto & value : data) value = dist(mt);
+	}
+	return dataset;
+}
+
+// 全モデル共通: 分配関数, ブロックギブス, CD-k 1エポック
+// exact_flagは列挙する変数の数(離散型はV, ガウス型はH)がmaxExactSize以下のときに立てる
+template <class RBM>
+void bench_common(rbmbench::BenchRunner & runner, OPTION & option, const std::string & model, RBM & rbm, std::vector<std::vector<double>> & dataset, bool exact_flag) {
+	int v_size = rbm.getVisibleSize();
+	int h_size = rbm.getHiddenSize();
+
+	if (exact_flag) {
+		runner.run("normal_constant", model, v_size, h_size, [&] {
+			rbmbench::keep(rbm.getNormalConstant());
+		});
+	}
+
+	Sampler<RBM> sampler;
+	runner.run("gibbs_sweep", model, v_size, h_size, [&] {
+		sampler.updateByBlockedGibbsSamplingVisible(rbm);
+		sampler.updateByBlockedGibbsSamplingHidden(rbm);
+	});
+
+	// 学習はパラメータを書き換えるので複製に対して行う
+	auto train_rbm = rbm;
+	Trainer<RBM, OptimizerType::Default> trainer(train_rbm);
+	trainer.cdk = option.cdk;
+	trainer.batchSize = dataset.size();
+	runner.run("cd_epoch", model, v_size, h_size, [&] {
+		trainer.trainOnce(train_rbm, dataset);
+	}, [&] {
+		train_rbm = rbm;
+	});
+}
+
+// 一般化RBM系: 期待値, exact学習, 尤度, mu(ビット列, 重複をまとめたデータとの比較), kld, オプティマイザ
+// (RBM, GBRBM, GeneralizedGRBMは期待値が未実装)
+template <class RBM>
+void bench_generalized(rbmbench::BenchRunner & runner, OPTION & option, const std::string & model, RBM & rbm, std::vector<std::vector<double>> & dataset) {
+	int v_size = rbm.getVisibleSize();
+	int h_size = rbm.getHiddenSize();
+	PackedDataset packed_dataset(dataset, rbm.visibleValueSet[0], rbm.visibleValueSet[1]);
+	auto unique_dataset = packed_dataset.unique();
+
+	if (v_size <= option.maxExactSize) {
+		// 学習と同じく分配関数は1回だけ計算する
+		runner.run("expected_vis", model, v_size, h_size, [&] {
+			auto z = rbm.getNormalConstant();
+			for (int i = 0; i < v_size; i++) rbmbench::keep(rbm.expectedValueVis(i, z));
+		});
+
+		runner.run("expected_hid", model, v_size, h_size, [&] {
+			auto z = rbm.getNormalConstant();
+			for (int j = 0; j < h_size; j++) rbmbench::keep(rbm.expectedValueHid(j, z));
+		});
+
+		runner.run("expected_vishid", model, v_size, h_size, [&] {
+			auto z = rbm.getNormalConstant();
+			for (int i = 0; i < v_size; i++) {
+				for (int j = 0; j < h_size; j++) {
+					rbmbench::keep(rbm.expectedValueVisHid(i, j, z));
+				}
+			}
+		});
+
+		auto train_rbm = rbm;
+		Trainer<RBM, OptimizerType::AdaMax> trainer(train_rbm);
+		trainer.batchSize = dataset.size();
+		runner.run("exact_epoch", model, v_size, h_size, [&] {
+			trainer.trainOnceExact(train_rbm, dataset);
+		}, [&] {
+			train_rbm = rbm;
+		});
+
+		runner.run("exact_epoch_packed", model, v_size, h_size, [&] {
+			trainer.trainOnceExact(train_rbm, packed_dataset);
+		}, [&] {
+			train_rbm = rbm;
+		});
+
+		runner.run("exact_epoch_unique", model, v_size, h_size, [&] {
+			trainer.trainOnceExact(train_rbm, unique_dataset);
+		}, [&] {
+			train_rbm = rbm;
+		});
+
+		runner.run("loglikelihood", model, v_size, h_size, [&] {
+			rbmbench::keep(trainer.logLikeliHood(rbm, dataset));
+		});
+
+		runner.run("loglikelihood_packed", model, v_size, h_size, [&] {
+			rbmbench::keep(trainer.logLikeliHood(rbm, packed_dataset));
+		});
+
+		runner.run("loglikelihood_unique", model, v_size, h_size, [&] {
+			rbmbench::keep(trainer.logLikeliHood(rbm, unique_dataset));
+		});
+	}
+
+	// 可視層からmuを求める処理(データセット1周分)
+	runner.run("mu_dense", model, v_size, h_size, [&] {
+		for (auto & data : dataset) {
+			rbm.nodes.v = Eigen::Map<Eigen::VectorXd>(data.data(), data.size());
+			rbmbench::keep(rbm.muVect().sum());
+		}
+	});
+
+	PackedVisibleKernel kernel(rbm);
+	Eigen::VectorXd mu_vect;
+	runner.run("mu_packed", model, v_size, h_size, [&] {
+		for (size_t n = 0; n < packed_dataset.size(); n++) {
+			kernel.muVect(packed_dataset.row(n), mu_vect);
+			rbmbench::keep(mu_vect.sum());
+		}
+	});
+
+	if (v_size <= option.maxKldSize) {
+		auto other = rbm;
+		other.params.initParamsXavier(option.seed + 1);
+		std::vector<double> v_val = { -1.0, 1.0 };
+		runner.run("kld", model, v_size, h_size, [&] {
+			rbmbench::keep(rbmutil::kld(rbm, other, v_val));
+		});
+	}
+
+	// 勾配は固定の乱数で与える
+	std::mt19937 mt(option.seed);
+	std::uniform_real_distribution<double> dist(-0.01, 0.01);
+	Eigen::MatrixXd grad_w(v_size, h_size);
+	Eigen::VectorXd grad_b(v_size), grad_c(h_size);
+	for (int i = 0; i < v_size; i++) grad_b(i) = dist(mt);
+	for (int j = 0; j < h_size; j++) grad_c(j) = dist(mt);
+	for (int i = 0; i < v_size; i++) for (int j = 0; j < h_size; j++) grad_w(i, j) = dist(mt);
+
+	auto bench_optimizer = [&](auto optimizer, const std::string & name) {
+		auto opt_rbm = rbm;
+		optimizer = decltype(optimizer)(opt_rbm);
+		runner.run(name, model, v_size, h_size, [&] {
+			for (int i = 0; i < v_size; i++) {
+				opt_rbm.params.b(i) += optimizer.getNewParamVBias(grad_b(i), i);
+				for (int j = 0; j < h_size; j++) {
+					opt_rbm.params.w(i, j) += optimizer.getNewParamWeight(grad_w(i, j), i, j);
+				}
+			}
+			for (int j = 0; j < h_size; j++) {
+				opt_rbm.params.c(j) += optimizer.getNewParamHBias(grad_c(j), j);
+			}
+			optimizer.updateOptimizer();
+		});
+	};
+	bench_optimizer(Optimizer<RBM, OptimizerType::Default>(), "optimizer_default");
+	bench_optimizer(Optimizer<RBM, OptimizerType::Momentum>(), "optimizer_momentum");
+	bench_optimizer(Optimizer<RBM, OptimizerType::Adam>(), "optimizer_adam");
+	bench_optimizer(Optimizer<RBM, OptimizerType::AdaMax>(), "optimizer_adamax");
+}
+
+// CD-k 1エポック(サンプリングをdoubleとfloatで比較)
+void bench_single_precision(rbmbench::BenchRunner & runner, OPTION & option, GeneralizedRBM & rbm, std::vector<std::vector<double>> & dataset) {
+	int v_size = rbm.getVisibleSize();
+	int h_size = rbm.getHiddenSize();
+
+	auto bench_cd = [&](const std::string & name, bool single_precision) {
+		auto train_rbm = rbm;
+		Trainer<GeneralizedRBM, OptimizerType::Default> trainer(train_rbm);
+		trainer.cdk = option.cdk;
+		trainer.batchSize = dataset.size();
+		trainer.singlePrecision = single_precision;
+		runner.run(name, "GeneralizedRBM", v_size, h_size, [&] {
+			trainer.trainOnceCD(train_rbm, dataset);
+		}, [&] {
+			train_rbm = rbm;
+		});
+	};
+	bench_cd("cd_epoch_double", false);
+	bench_cd("cd_epoch_single", true);
+}
+
+// 固定サイズ版: GeneralizedRBMと同じワークロード名で計測する
+template <int V, int H>
+void bench_fixed(rbmbench::BenchRunner & runner, OPTION & option, GeneralizedRBM & source, std::vector<std::vector<double>> & dataset) {
+	const std::string model = "FixedGeneralizedRBM";
+	FixedGeneralizedRBM<V, H> rbm(source);
+	auto unique_dataset = PackedDataset::unique(dataset, rbm.visibleValueSet[0], rbm.visibleValueSet[1]);
+
+	if (V <= option.maxExactSize) {
+		runner.run("normal_constant", model, V, H, [&] {
+			rbmbench::keep(rbm.getNormalConstant());
+		});
+
+		auto train_rbm = rbm;
+		Trainer<FixedGeneralizedRBM<V, H>, OptimizerType::AdaMax> trainer(train_rbm);
+		runner.run("exact_epoch_unique", model, V, H, [&] {
+			trainer.trainOnceExact(train_rbm, unique_dataset);
+		}, [&] {
+			train_rbm = rbm;
+		});
+
+		runner.run("loglikelihood_unique", model, V, H, [&] {
+			rbmbench::keep(trainer.logLikeliHood(rbm, unique_dataset));
+		});
+	}
+
+	Sampler<FixedGeneralizedRBM<V, H>> sampler;
+	runner.run("gibbs_sweep", model, V, H, [&] {
+		sampler.updateByBlockedGibbsSamplingVisible(rbm);
+		sampler.updateByBlockedGibbsSamplingHidden(rbm);
+	});
+
+	auto train_rbm = rbm;
+	Trainer<FixedGeneralizedRBM<V, H>, OptimizerType::Default> trainer(train_rbm);
+	trainer.cdk = option.cdk;
+	trainer.batchSize = dataset.size();
+	runner.run("cd_epoch", model, V, H, [&] {
+		trainer.trainOnceCD(train_rbm, dataset);
+	}, [&] {
+		train_rbm = rbm;
+	});
+}
+
+//
+// 各モデルの主要な処理をサイズの格子上で計測し, CSVで出力
+// --baselineで以前の出力と比較する
+//
+int main(int argc, char** argv) {
+	rbmbench::BenchRunner runner;
+	OPTION option = get_option(argc, argv, runner);
+
+	for (auto v_size : option.vSizes) {
+		for (auto h_size : option.hSizes) {
+			auto discrete_dataset = make_discrete_dataset(v_size, option.datasize, option.seed);
+			auto real_dataset = make_real_dataset(v_size, option.datasize, option.seed);
+
+			{
+				RBM rbm(v_size, h_size);
+				auto dataset = discrete_dataset;
+				for (auto & data : dataset) for (auto & value : data) value = value > 0.0 ? 1.0 : 0.0;
+				bench_common(runner, option, "RBM", rbm, dataset, v_size <= option.maxExactSize);
+			}
+			{
+				// ガウス型は可視変数を積分するので隠れ変数の配位を列挙
+				GBRBM rbm(v_size, h_size);
+				bench_common(runner, option, "GBRBM", rbm, real_dataset, h_size <= option.maxExactSize);
+			}
+			{
+				GeneralizedGRBM rbm(v_size, h_size);
+				bench_common(runner, option, "GeneralizedGRBM", rbm, real_dataset, h_size <= option.maxExactSize);
+			}
+			{
+				GeneralizedRBM rbm(v_size, h_size);
+				rbm.setHiddenMin(-1.0);
+				rbm.setHiddenMax(1.0);
+				rbm.setHiddenDivSize(1);
+				rbm.params.initParamsXavier(option.seed);
+				bench_common(runner, option, "GeneralizedRBM", rbm, discrete_dataset, v_size <= option.maxExactSize);
+				bench_generalized(runner, option, "GeneralizedRBM", rbm, discrete_dataset);
+				bench_single_precision(runner, option, rbm, discrete_dataset);
+#ifdef RBM_FIXED_SIZE
+				rbmfixed::dispatch(v_size, h_size, [&](auto fixed_v_size, auto fixed_h_size) {
+					bench_fixed<decltype(fixed_v_size)::value, decltype(fixed_h_size)::value>(runner, option, rbm, discrete_dataset);
+				});
+#endif
+			}
+			{
+				GeneralizedSparseRBM rbm(v_size, h_size);
+				rbm.setHiddenMin(-1.0);
+				rbm.setHiddenMax(1.0);
+				rbm.setHiddenDivSize(1);
+				rbm.params.initParamsXavier(option.seed);
+				bench_common(runner, option, "GeneralizedSparseRBM", rbm, discrete_dataset, v_size <= option.maxExactSize);
+				bench_generalized(runner, option, "GeneralizedSparseRBM", rbm, discrete_dataset);
+			}
+		}
+	}
+
+	if (!option.baselinePath.empty()) {
+		runner.applyBaseline(option.baselinePath);
+		runner.printComparison(std::cerr, option.threshold);
+	}
+
+	if (option.outputPath.empty()) runner.writeCsv(std::cout);
+	else runner.writeCsv(option.outputPath);
+
+	auto regressions = runner.countRegressions(option.threshold);
+	if (regressions > 0) std::cerr << regressions << " regressions" << std::endl;
+
+	return option.failOnRegression && regressions > 0 ? 1 : 0;
+}
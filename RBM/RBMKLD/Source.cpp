@@ -3,21 +3,15 @@
 #include <string>
 #include <sstream>
 #include <cstdlib>
+#include <memory>
 #include <boost/program_options.hpp>
 #include "rbmutil.h"
 #include "RBMCore.h"
 #include "Trainer.h"
 #include "Sampler.h"
-#include "SQLiteCpp/SQLiteCpp.h"
-#include "sqlite3.h"
-
-
-#include "mysql_driver.h"
-#include "mysql_connection.h"
-#include "mysql_error.h"
-#include "cppconn/Statement.h"
-#include "cppconn/prepared_statement.h"
-#include "cppconn/ResultSet.h"
+#include "ResultSink.h"
+#include "SqliteResultSink.h"
+#include "EvalScheduler.h"
 
 typedef struct {
 	int vSize = 5;
@@ -34,43 +28,12 @@ typedef struct {
 	int trainFlag = 0; // 1: exact, 2: cd, 3:exact & cd
 	int rbmFlag = 0;   // 1: normal, 2: sparse, 3:normal & sparse
 	int seed = 0;
+	std::string sinkType = "sqlite";  // sqlite, csv, binary, none
+	std::string outputPath = "./output/sqlite3.db";
+	int evalInterval = 1;  // 評価するエポック間隔
+	int evalThreadSize = 1;  // 評価スレッド数
 } OPTION;
 
-typedef struct {
-	double kld;
-	double loglikelihood;
-	int data_size;
-	int  v_size;
-	int  h_size;
-	std::string rbm_type;
-	int div_size;
-	std::string train_type;
-	int epoch;
-	int sparse;
-	int try_count;
-	int seed = 0;
-} RESULT;
-
-typedef struct {
-	bool isSetValue = false;
-	std::string valuesQuery;
-} QUERY;
-
-
-/**
-// SQLITE3 データベース仕様(仮)
-// +-------------+------+-------------+
-// |             datafile               |
-// +-------------+------+------+------+
-// | uid(UNIQUE) | name | json | time |
-// +-------------+------+------+------+
-//
-//   uid INTEGER PRIMARY KEY AUTOINCREMENT
-//   name TEXT
-//   json BLOB
-//   time TEXT
-//
-**/
 
 /**
 // SQLITE3 データベース仕様(仮)
@@ -89,259 +52,43 @@ typedef struct {
 //   epoch INTEGER
 //   sparse INTEGER (has sparse: 1)
 //   try_count INTEGER
+//   seed_num INTEGER
 **/
 
 
-void make_table(sql::Connection * con);
-QUERY make_sql_result_insert();
-QUERY & make_sql_result_values(QUERY & query, RESULT & result);
-void write_to_db_data_table(sql::Connection * con, std::string & name, std::string & json);
-void write_to_db_result_table(sql::Connection *con, RESULT & result, OPTION & option);
-void write_to_db_result_table(sql::Connection *con, std::string & query);
-
-// パラメータファイル書き込み(SQLITEに)
-template <class RBM>
-void write_params(sql::Connection * con, RBM & rbm, std::string fname);
-
-// 学習情報書き込み(SQLITEに)
-template <class RBM, class Trainer>
-void write_train_info(sql::Connection * con, RBM & rbm, Trainer & trainer, std::string fname);
-
-// (汎化|訓練)誤差情報書き込み(SQLITEに)
-template <class RBMGEN, class RBMTRAIN, class Trainer, class Dataset>
-void write_error_info(sql::Connection * con, RBMGEN & rbm_gen, RBMTRAIN & rbm_train, Trainer & trainer, Dataset & dataset, std::string fname);
+// 出力先の作成
+std::unique_ptr<ResultSink> make_result_sink(OPTION & option);
 
 // 実行ルーチン
-template<class RBM_G, class RBM_T, class DATASET>
-void run(sql::Connection * con, OPTION & option, int try_count, RBM_G & rbm_gen, RBM_T & rbm_train, DATASET & dataset);
+template<class RBM_T, class DATASET>
+void run(ResultSink & sink, OPTION & option, int try_count, std::vector<double> & reference_probs, RBM_T & rbm_train, DATASET & dataset);
 
-template<class RBM_G, class RBM_T, class DATASET>
-void run_sparse(sql::Connection * con, OPTION & option, int try_count, RBM_G & rbm_gen, RBM_T & rbm_train, DATASET & dataset);
+template<class RBM_T, class DATASET>
+void run_sparse(ResultSink & sink, OPTION & option, int try_count, std::vector<double> & reference_probs, RBM_T & rbm_train, DATASET & dataset);
 
 // コマンドラインオプションの設定
 // 対話するかしないかも。
 OPTION get_option(int argc, char** argv);
 
 
-void make_table(sql::Connection *con) {
-	auto stmt = con->createStatement();
-
-	try {
-		stmt->execute("BEGIN TRANSACTION");
-	}
-	catch (std::exception& e)
-	{
-		std::cout << "exception: " << e.what() << std::endl;
-	}
-
-	char *err_msg = NULL;
-	//if (stmt->tableExists("result")) {
-	//	std::string query = "DROP TABLE result;";
-	//	stmt->execute(query);
-	//}
-
-	//if (stmt->tableExists("datafile")) {
-	//	std::string query = "DROP TABLE datafile;";
-	//	stmt->execute(query);
-	//}
-
-	// make train_info table
-	std::string query = "CREATE TABLE datafile (uid INTEGER PRIMARY KEY AUTOINCREMENT, name TEXT, json BLOB, time TEXT);";
-	stmt->execute(query);
-
-	// make result table
-	//   uid INTEGER PRIMARY KEY AUTOINCREMENT
-	//   kld REAL
-	//   loglikelihood REAL
-	//   data_size INTEGER
-	//   v_size INTEGER
-	//   h_size INTEGER
-	//   rbm_type TEXT (d or c)
-	//   div_size INTEGER
-	//   train_type (cd or exact)
-	//   epoch INTEGER
-	//   sparse INTEGER (has sparse: 1)
-	//   try_count INTEGER
-	std::stringstream ss_query;
-	ss_query << "CREATE TABLE result ("
-		<< "uid INTEGER PRIMARY KEY AUTOINCREMENT"
-		<< ", kld REAL"
-		<< ", loglikelihood REAL"
-		<< ", data_size INTEGER"
-		<< ", v_size INTEGER"
-		<< ", h_size INTEGER"
-		<< ", rbm_type TEXT"
-		<< ", div_size INTEGER"
-		<< ", train_type"
-		<< ", epoch INTEGER"
-		<< ", sparse INTEGER"
-		<< ", try_count INTEGER)";
-	stmt->execute(ss_query.str());
-
-	try {
-		stmt->execute("COMMIT");
-	}
-	catch (std::exception& e)
-	{
-		std::cout << "exception: " << e.what() << std::endl;
-	}
-
-	delete stmt;
-
-}
-
-
-QUERY make_sql_result_insert() {
-	QUERY query;
-	query.valuesQuery = "INSERT INTO result(kld, loglikelihood, data_size, v_size, h_size, rbm_type, div_size, train_type, epoch, sparse, try_count, seed_num) VALUES";
-	query.isSetValue = false;
-
-	return query;
-}
-QUERY & make_sql_result_values(QUERY & query, RESULT & result) {
-
-	std::string values_query = "";
-	if (query.isSetValue) {
-		values_query = ", ";
-	}
-
-	values_query += "(";
-	values_query += std::to_string(result.kld);
-	values_query += ", " + std::to_string(result.loglikelihood);
-	values_query += ", " + std::to_string(result.data_size);
-	values_query += ", " + std::to_string(result.v_size);
-	values_query += ", " + std::to_string(result.h_size);
-	values_query += ", " + std::string("\"") + (result.rbm_type) + std::string("\"");
-	values_query += ", " + std::to_string(result.div_size);
-	values_query += ", " + std::string("\"") + (result.train_type) + std::string("\"");
-	values_query += ", " + std::to_string(result.epoch);
-	values_query += ", " + std::to_string(result.sparse);
-	values_query += ", " + std::to_string(result.try_count);
-	values_query += ", " + std::to_string(result.seed);
-	values_query += ")";
-	query.valuesQuery += values_query;
-	query.isSetValue = true;
-
-	return query;
-}
-
-
-
-void write_to_db_data_table(sql::Connection *con, std::string & name, std::string & json) {
-
-	try {
-		std::stringstream ss_query;
-		ss_query << "INSERT INTO datafile(name, json, time) VALUES(?, ?, datetime(CURRENT_TIMESTAMP,'localtime'));";
-		std::string query = ss_query.str();
-
-		auto *prep_stmt = con->prepareStatement(query);
-		prep_stmt->setString(1, name);
-		prep_stmt->setString(2, json);
-		prep_stmt->execute();
-		//if (ret != sqlite_ok) {
-		//	throw;
-		//}
-
-		delete prep_stmt;
-	}
-	catch (std::exception& e)
-	{
-		std::cout << "exception: " << e.what() << std::endl;
-	}
-}
-
-void write_to_db_result_table(sql::Connection *con, RESULT & result, OPTION & option) {
-	try {
-		//   kld REAL
-		//   loglikelihood REAL
-		//   data_size
-		//   v_size INTEGER
-		//   h_size INTEGER
-		//   rbm_type TEXT (d or c)
-		//   div_size INTEGER
-		//   train_type (cd or exact)
-		//   epoch INTEGER
-		//   sparse (has sparse: 1)
-		//   try_count INGERGER
-		std::stringstream ss_query;
-		//	ss_query << "INSERT INTO result (name, json, time) VALUES("  << name << ", " << json << ", )";
-		ss_query << "INSERT INTO result(kld, loglikelihood, data_size, v_size, h_size, rbm_type, div_size, train_type, epoch, sparse, try_count, seed_num) VALUES(?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?);";
-		std::string query = ss_query.str();
-
-		// TODO: ほんとにtry_count??? option読まなくていいの???
-		auto prep_stmt = con->prepareStatement(query);
-		prep_stmt->setDouble(1, result.kld);
-		prep_stmt->setDouble(2, result.loglikelihood);
-		prep_stmt->setInt(3, result.data_size);
-		prep_stmt->setInt(4, result.v_size);
-		prep_stmt->setInt(5, result.h_size);
-		prep_stmt->setString(6, result.rbm_type);
-		prep_stmt->setInt(7, result.div_size);
-		prep_stmt->setString(8, result.train_type);
-		prep_stmt->setInt(9, result.epoch);
-		prep_stmt->setInt(10, result.sparse);
-		prep_stmt->setInt(11, result.try_count);
-		prep_stmt->setInt(12, option.seed);
-		prep_stmt->execute();
-		//if (ret != sqlite_ok) {
-		//	throw;
-		//}
-
-		delete prep_stmt;
-	}
-	catch (std::exception& e)
-	{
-		std::cout << "exception: " << e.what() << std::endl;
-	}
-
-}
-
-void write_to_db_result_table(sql::Connection *con, std::string & query) {
-	try {
-		auto stmt = con->createStatement();
-		stmt->execute(query);
-	}
-	catch (std::exception& e)
-	{
-		std::cout << "exception: " << e.what() << std::endl;
-	}
-
-}
-
-
-
-// パラメータファイル書き込み(SQLITEに)
-template <class RBM>
-void write_params(sql::Connection *con, RBM & rbm, std::string fname) {
-	write_to_db_data_table(db, fname, rbm.params.serialize());
-}
-
-// 学習情報書き込み(SQLITEに)
-template <class RBM, class Trainer>
-void write_train_info(sql::Connection *con, RBM & rbm, Trainer & trainer, std::string fname) {
-	auto js = trainer.trainInfoJson(rbm);
-	write_to_db_data_table(db, fname, js);
-}
-
-// (汎化|訓練)誤差情報書き込み(SQLITEに)
-template <class RBMGEN, class RBMTRAIN, class Trainer, class Dataset>
-void write_error_info(sql::Connection *con, RBMGEN & rbm_gen, RBMTRAIN & rbm_train, Trainer & trainer, Dataset & dataset, std::string fname) {
-	auto js = nlohmann::json();
-	js["kld"] = rbmutil::kld(rbm_gen, rbm_train, std::vector<int>{0, 1});
-	js["logLikelihood"] = trainer.logLikeliHood(rbm_train, dataset);
+std::unique_ptr<ResultSink> make_result_sink(OPTION & option) {
+	if (option.sinkType == "sqlite") return std::unique_ptr<ResultSink>(new SqliteResultSink(option.outputPath));
+	if (option.sinkType == "csv") return std::unique_ptr<ResultSink>(new CsvResultSink(option.outputPath));
+	if (option.sinkType == "binary") return std::unique_ptr<ResultSink>(new BinaryResultSink(option.outputPath));
+	if (option.sinkType == "none") return std::unique_ptr<ResultSink>(new NullResultSink());
 
-	write_to_db(db, fname, js.dump());
+	throw std::runtime_error("unknown sink: " + option.sinkType);
 }
 
 // 実行ルーチン
-template<class RBM_G, class RBM_T, class DATASET>
-void run(sql::Connection *con, OPTION & option, int try_count, RBM_G & rbm_gen, RBM_T & rbm_train, DATASET & dataset) {
+template<class RBM_T, class DATASET>
+void run(ResultSink & sink, OPTION & option, int try_count, std::vector<double> & reference_probs, RBM_T & rbm_train, DATASET & dataset) {
 	if (!(option.rbmFlag == 0)) return;
 
 	std::mt19937 random_device(option.seed);
-	auto stmt = con->createStatement();
-	stmt->execute("START TRANSACTION");
-	QUERY query = make_sql_result_insert();
+
+	// exact学習のデータ項は重複をまとめたパターン数だけ計算すればよい
+	auto unique_dataset = PackedDataset::unique(dataset);
 
 	auto rbm_exact = rbm_train;
 	rbm_exact.params.initParamsXavier(option.seed);
@@ -371,9 +118,12 @@ void run(sql::Connection *con, OPTION & option, int try_count, RBM_G & rbm_gen,
 	rbm_trainer_cd.learningRate = option.learningRate;
 	rbm_trainer_cd.randDevice = random_device;
 
+	// 評価は学習を止めずに別スレッドでスナップショットに対して行う
+	EvalScheduler<GeneralizedRBM> evaluator(sink, dataset, reference_probs, option.evalThreadSize);
+	evaluator.interval = option.evalInterval;
 
 	for (int epoch_count = 0; epoch_count < option.epoch; epoch_count++) {
-		RESULT result;
+		ResultRecord result;
 		result.seed = option.seed;
 
 		std::string rbm_div = option.realFlag ? "c" : std::to_string(option.divSize);
@@ -383,7 +133,7 @@ void run(sql::Connection *con, OPTION & option, int try_count, RBM_G & rbm_gen,
 
 		// Exact
 		if (option.trainFlag == 0) {
-			rbm_trainer_exact.trainOnceExact(rbm_exact, dataset);
+			rbm_trainer_exact.trainOnceExact(rbm_exact, unique_dataset);
 			std::stringstream ss_exact_fname;
 			ss_exact_fname << try_count << "_exact" << "_epoch" << epoch_count << "_div" << rbm_div << ".train.json";
 			//write_train_info(db, rbm_exact, rbm_trainer_exact, ss_exact_fname.str());
@@ -391,19 +141,18 @@ void run(sql::Connection *con, OPTION & option, int try_count, RBM_G & rbm_gen,
 			std::stringstream ss_exact_error_fname;
 			ss_exact_error_fname << try_count << "_error_exact" << "_epoch" << epoch_count << "_div" << rbm_div << ".error.json";
 
-			result.kld = rbmutil::kld(rbm_gen, rbm_exact, std::vector<double>{-1.0, 1.0});
-			result.loglikelihood = rbm_trainer_exact.logLikeliHood(rbm_exact, dataset);
-			result.data_size = dataset.size();
-			result.v_size = rbm_exact.getVisibleSize();
-			result.h_size = rbm_exact.getHiddenSize();
-			result.rbm_type = rbm_exact.isRealHiddenValue() ? "c" : "d";
-			result.div_size = rbm_exact.getHiddenDivSize();
-			result.train_type = "exact";
-			result.epoch = epoch_count;
-			result.sparse = 0;
-			result.try_count = try_count;
-			//write_to_db_result_table(con, result, option);
-			make_sql_result_values(query, result);
+			if (evaluator.isSnapshotEpoch(epoch_count, option.epoch)) {
+				result.data_size = dataset.size();
+				result.v_size = rbm_exact.getVisibleSize();
+				result.h_size = rbm_exact.getHiddenSize();
+				result.rbm_type = rbm_exact.isRealHiddenValue() ? "c" : "d";
+				result.div_size = rbm_exact.getHiddenDivSize();
+				result.train_type = "exact";
+				result.epoch = epoch_count;
+				result.sparse = 0;
+				result.try_count = try_count;
+				evaluator.publish(rbm_exact, result);
+			}
 		}
 
 		// Contrastive Divergence
@@ -416,34 +165,32 @@ void run(sql::Connection *con, OPTION & option, int try_count, RBM_G & rbm_gen,
 			std::stringstream ss_cd_error_fname;
 			ss_cd_error_fname << try_count << "_error_cd" << "_epoch" << epoch_count << "_div" << rbm_div << ".error.json";
 
-			result.kld = rbmutil::kld(rbm_gen, rbm_cd, std::vector<double>{-1.0, 1.0});
-			result.loglikelihood = rbm_trainer_cd.logLikeliHood(rbm_cd, dataset);
-			result.data_size = dataset.size();
-			result.v_size = rbm_cd.getVisibleSize();
-			result.h_size = rbm_cd.getHiddenSize();
-			result.rbm_type = rbm_cd.isRealHiddenValue() ? "c" : "d";
-			result.div_size = rbm_cd.getHiddenDivSize();
-			result.train_type = "cd";
-			result.epoch = epoch_count;
-			result.sparse = 0;
-			result.try_count = try_count;
-			//			write_to_db_result_table(con, result, option);
-			make_sql_result_values(query, result);
+			if (evaluator.isSnapshotEpoch(epoch_count, option.epoch)) {
+				result.data_size = dataset.size();
+				result.v_size = rbm_cd.getVisibleSize();
+				result.h_size = rbm_cd.getHiddenSize();
+				result.rbm_type = rbm_cd.isRealHiddenValue() ? "c" : "d";
+				result.div_size = rbm_cd.getHiddenDivSize();
+				result.train_type = "cd";
+				result.epoch = epoch_count;
+				result.sparse = 0;
+				result.try_count = try_count;
+				evaluator.publish(rbm_cd, result);
+			}
 		}
 	}
-	write_to_db_result_table(con, query.valuesQuery);
-	stmt->execute("COMMIT;");
-	delete stmt;
+
+	evaluator.wait();
 }
 
 // 実行ルーチン
-template<class RBM_G, class RBM_T, class DATASET>
-void run_sparse(sql::Connection *con, OPTION & option, int try_count, RBM_G & rbm_gen, RBM_T & rbm_train, DATASET & dataset) {
+template<class RBM_T, class DATASET>
+void run_sparse(ResultSink & sink, OPTION & option, int try_count, std::vector<double> & reference_probs, RBM_T & rbm_train, DATASET & dataset) {
 	if (!(option.rbmFlag == 1)) return;
 	std::mt19937 random_device(option.seed);
-	auto stmt = con->createStatement();
-	stmt->execute("START TRANSACTION");
-	QUERY query = make_sql_result_insert();
+
+	// exact学習のデータ項は重複をまとめたパターン数だけ計算すればよい
+	auto unique_dataset = PackedDataset::unique(dataset);
 
 
 	auto rbm_exact = rbm_train;
@@ -477,34 +224,36 @@ void run_sparse(sql::Connection *con, OPTION & option, int try_count, RBM_G & rb
 	rbm_trainer_cd.learningRate = option.learningRate;
 	rbm_trainer_cd.randDevice = random_device;
 
+	// 評価は学習を止めずに別スレッドでスナップショットに対して行う
+	EvalScheduler<GeneralizedSparseRBM> evaluator(sink, dataset, reference_probs, option.evalThreadSize);
+	evaluator.interval = option.evalInterval;
 
 
 	for (int epoch_count = 0; epoch_count < option.epoch; epoch_count++) {
-		RESULT result;
+		ResultRecord result;
 		result.seed = option.seed;
 
 		std::string rbm_div = option.realFlag ? "c" : std::to_string(option.divSize);
 
 		// Exact
 		if (option.trainFlag == 0) {
-			rbm_trainer_exact.trainOnceExact(rbm_exact, dataset);
+			rbm_trainer_exact.trainOnceExact(rbm_exact, unique_dataset);
 			std::stringstream ss_exact_fname;
 			ss_exact_fname << try_count << "_exact_sparse" << "_epoch" << epoch_count << "_div" << rbm_div << ".train.json";
 			//write_train_info(db, rbm_exact, rbm_trainer_exact, ss_exact_fname.str());
 
-			result.kld = rbmutil::kld(rbm_gen, rbm_exact, std::vector<double>{-1.0, 1.0});
-			result.loglikelihood = rbm_trainer_exact.logLikeliHood(rbm_exact, dataset);
-			result.data_size = dataset.size();
-			result.v_size = rbm_exact.getVisibleSize();
-			result.h_size = rbm_exact.getHiddenSize();
-			result.rbm_type = rbm_exact.isRealHiddenValue() ? "c" : "d";
-			result.div_size = rbm_exact.getHiddenDivSize();
-			result.train_type = "exact";
-			result.epoch = epoch_count;
-			result.sparse = 1;
-			result.try_count = try_count;
-			//			write_to_db_result_table(con, result, option);
-			make_sql_result_values(query, result);
+			if (evaluator.isSnapshotEpoch(epoch_count, option.epoch)) {
+				result.data_size = dataset.size();
+				result.v_size = rbm_exact.getVisibleSize();
+				result.h_size = rbm_exact.getHiddenSize();
+				result.rbm_type = rbm_exact.isRealHiddenValue() ? "c" : "d";
+				result.div_size = rbm_exact.getHiddenDivSize();
+				result.train_type = "exact";
+				result.epoch = epoch_count;
+				result.sparse = 1;
+				result.try_count = try_count;
+				evaluator.publish(rbm_exact, result);
+			}
 		}
 
 		// Contrastive Divergence
@@ -514,24 +263,22 @@ void run_sparse(sql::Connection *con, OPTION & option, int try_count, RBM_G & rb
 			ss_cd_fname << try_count << "_cd_sparse" << "_epoch" << epoch_count << "_div" << rbm_div << ".train.json";
 			//write_train_info(db, rbm_cd, rbm_trainer_cd, ss_cd_fname.str());
 
-			result.kld = rbmutil::kld(rbm_gen, rbm_cd, std::vector<double>{-1.0, 1.0});
-			result.loglikelihood = rbm_trainer_cd.logLikeliHood(rbm_cd, dataset);
-			result.data_size = dataset.size();
-			result.v_size = rbm_cd.getVisibleSize();
-			result.h_size = rbm_cd.getHiddenSize();
-			result.rbm_type = rbm_cd.isRealHiddenValue() ? "c" : "d";
-			result.div_size = rbm_cd.getHiddenDivSize();
-			result.train_type = "cd";
-			result.epoch = epoch_count;
-			result.sparse = 1;
-			result.try_count = try_count;
-			//write_to_db_result_table(con, result, option);
-			make_sql_result_values(query, result);
+			if (evaluator.isSnapshotEpoch(epoch_count, option.epoch)) {
+				result.data_size = dataset.size();
+				result.v_size = rbm_cd.getVisibleSize();
+				result.h_size = rbm_cd.getHiddenSize();
+				result.rbm_type = rbm_cd.isRealHiddenValue() ? "c" : "d";
+				result.div_size = rbm_cd.getHiddenDivSize();
+				result.train_type = "cd";
+				result.epoch = epoch_count;
+				result.sparse = 1;
+				result.try_count = try_count;
+				evaluator.publish(rbm_cd, result);
+			}
 		}
 	}
-	write_to_db_result_table(con, query.valuesQuery);
-	stmt->execute("COMMIT;");
-	delete stmt;
+
+	evaluator.wait();
 }
 
 
@@ -552,7 +299,11 @@ OPTION get_option(int argc, char** argv) {
 		("divsize", po::value<int>()->default_value(2), "0: real, others: digit")
 		("train_mode", po::value<int>(), "0: Exact, 1: CD")
 		("rbmtype", po::value<int>(), "0: RBM, 1: SRBM")
-		("seed", po::value<int>()->default_value(0), "seed_value");
+		("seed", po::value<int>()->default_value(0), "seed_value")
+		("sink", po::value<std::string>()->default_value("sqlite"), "sqlite, csv, binary, none")
+		("output", po::value<std::string>()->default_value("./output/sqlite3.db"), "output file")
+		("eval_interval", po::value<int>()->default_value(1), "evaluation interval(epoch)")
+		("eval_threads", po::value<int>()->default_value(1), "evaluation threads");
 
 
 	po::variables_map vm;
@@ -580,6 +331,10 @@ OPTION get_option(int argc, char** argv) {
 		option.trainFlag = vm["train_mode"].as<int>();
 		option.rbmFlag = vm["rbmtype"].as<int>();
 		option.seed = vm["seed"].as<int>();
+		option.sinkType = vm["sink"].as<std::string>();
+		option.outputPath = vm["output"].as<std::string>();
+		option.evalInterval = vm["eval_interval"].as<int>();
+		option.evalThreadSize = vm["eval_threads"].as<int>();
 
 		if (option.divSize < 1) option.realFlag = true;
 	}
@@ -601,41 +356,9 @@ int main(int argc, char** argv) {
 	int try_num = 1;
 
 
-	//SQLite::Database db("./output/sqlite3.db", SQLite::OPEN_CREATE | SQLite::OPEN_READWRITE);
-
-	//make_table(db);
-
-
-	auto mysql_host = std::string(std::getenv("KLDMYSQL_HOST"));
-	auto mysql_user = std::string(std::getenv("KLDMYSQL_USER"));
-	auto mysql_passwd = std::string(std::getenv("KLDMYSQL_PASSWD"));
-	std::cout << mysql_user << "@" << mysql_host << std::endl;
-
-	sql::mysql::MySQL_Driver *driver;
-	sql::Connection *con;
-
-	driver = sql::mysql::get_mysql_driver_instance();
-	sql::ConnectOptionsMap connection_properties;
-
-	connection_properties["hostName"] = mysql_host;
-	connection_properties["userName"] = mysql_user;
-	connection_properties["password"] = mysql_passwd;
-	connection_properties["port"] = 3306;
-	connection_properties["OPT_RECONNECT"] = true;
-	connection_properties["CLIENT_COMPRESS"] = true;
-	connection_properties["OPT_CONNECT_TIMEOUT"] = 60;
-
-	auto url = std::string("tcp://") + mysql_host + std::string(":3306");
-	try {
-		con = driver->connect(connection_properties);
-	}
-	catch (std::exception & e) {
-		std::cout << "MySQL Connection Error..." << std::endl;
-		exit(-1);
-	}
-
-	auto stmt = con->createStatement();
-	stmt->execute("USE kld");
+	// 書き込みは別スレッドで行い, 学習ループを止めない
+	auto base_sink = make_result_sink(option);
+	AsyncResultSink sink(*base_sink);
 
 
 	for (int try_count = 0; try_count < try_num; try_count++) {
@@ -652,6 +375,10 @@ int main(int argc, char** argv) {
 			dataset.push_back(rbmutil::data_gen<GeneralizedRBM, std::vector<double> >(rbm_gen, option.vSize, seed_rbm_gen));
 		}
 
+		// 生成モデルの確率表は試行毎に一度だけ計算する
+		std::vector<double> visible_values = { -1.0, 1.0 };
+		auto reference_probs = rbmutil::prob_table(rbm_gen, visible_values);
+
 		//std::cout << "[Generative Model]" << std::endl;
 		//rbmutil::print_params(rbm_gen);
 		std::stringstream ss_gen_fname;
@@ -661,16 +388,15 @@ int main(int argc, char** argv) {
 		auto rbm_train = GeneralizedRBM(option.vSize, option.trainHsize);
 
 		// try rbm 2, 3, 4, 5, cont
-		run(con, option, try_count, rbm_gen, rbm_train, dataset);
+		run(sink, option, try_count, reference_probs, rbm_train, dataset);
 
 
 		// SparseRBM
 		auto rbm_train_sparse = GeneralizedSparseRBM(option.vSize, option.trainHsize);
-		run_sparse(con, option, try_count, rbm_gen, rbm_train_sparse, dataset);
+		run_sparse(sink, option, try_count, reference_probs, rbm_train_sparse, dataset);
 
 		try {
-
-			//db.exec("COMMIT");
+			sink.flush();
 			std::cout << "h" << option.genHsize << "(gen) / h" << option.trainHsize << "(train), cimmit: " << try_count << std::endl;
 		}
 		catch (std::exception& e)
@@ -679,7 +405,8 @@ int main(int argc, char** argv) {
 		}
 	}
 
-	con->close();
+	// RBM_PROFILEを定義してビルドしたときのみ出力される
+	RBM_PROFILE_EXPORT("./output/trace.json", "./output/profile.csv");
 
 	return 0;
 }
\ No newline at end of file
@@ -6,8 +6,8 @@
 #include "RBMCore.h"
 #include "Trainer.h"
 #include "Sampler.h"
-#include "SQLiteCpp/SQLiteCpp.h"
-#include "sqlite3.h"
+#include "ResultSink.h"
+#include "SqliteResultSink.h"
 #include <omp.h>
 
 typedef struct {
@@ -26,35 +26,6 @@ typedef struct {
 	int rbmFlag = 0;   // 1: normal, 2: sparse, 3:normal & sparse
 } OPTION;
 
-typedef struct {
-	double kld;
-	double loglikelihood;
-	int data_size;
-	int  v_size;
-	int  h_size;
-	std::string rbm_type;
-	int div_size;
-	std::string train_type;
-	int epoch;
-	int sparse;
-	int try_count;
-} RESULT;
-
-/**
-// SQLITE3 データベース仕様(仮)
-// +-------------+------+-------------+
-// |             datafile               |
-// +-------------+------+------+------+
-// | uid(UNIQUE) | name | json | time |
-// +-------------+------+------+------+
-//
-//   uid INTEGER PRIMARY KEY AUTOINCREMENT
-//   name TEXT
-//   json BLOB
-//   time TEXT
-//
-**/
-
 /**
 // SQLITE3 データベース仕様(仮)
 // +----------------------------------+
@@ -72,163 +43,13 @@ typedef struct {
 //   epoch INTEGER
 //   sparse INTEGER (has sparse: 1)
 //   try_count INTEGER
+//   seed_num INTEGER
 **/
 
 
-void make_table(SQLite::Database & db) {
-	try {
-		db.exec("BEGIN TRANSACTION");
-	}
-	catch (std::exception& e)
-	{
-		std::cout << "exception: " << e.what() << std::endl;
-	}
-
-	char *err_msg = NULL;
-	if (db.tableExists("result")) {
-		std::string query = "DROP TABLE result;";
-		db.exec(query);
-	}
-
-	if (db.tableExists("datafile")) {
-		std::string query = "DROP TABLE datafile;";
-		db.exec(query);
-	}
-
-	// make train_info table
-	std::string query = "CREATE TABLE datafile (uid INTEGER PRIMARY KEY AUTOINCREMENT, name TEXT, json BLOB, time TEXT);";
-	db.exec(query);
-
-	// make result table
-	//   uid INTEGER PRIMARY KEY AUTOINCREMENT
-	//   kld REAL
-	//   loglikelihood REAL
-	//   data_size INTEGER
-	//   v_size INTEGER
-	//   h_size INTEGER
-	//   rbm_type TEXT (d or c)
-	//   div_size INTEGER
-	//   train_type (cd or exact)
-	//   epoch INTEGER
-	//   sparse INTEGER (has sparse: 1)
-	//   try_count INTEGER
-	std::stringstream ss_query;
-	ss_query << "CREATE TABLE result ("
-		<< "uid INTEGER PRIMARY KEY AUTOINCREMENT"
-		<< ", kld REAL"
-		<< ", loglikelihood REAL"
-		<< ", data_size INTEGER"
-		<< ", v_size INTEGER"
-		<< ", h_size INTEGER"
-		<< ", rbm_type TEXT"
-		<< ", div_size INTEGER"
-		<< ", train_type"
-		<< ", epoch INTEGER"
-		<< ", sparse INTEGER"
-		<< ", try_count INTEGER)";
-	db.exec(ss_query.str());
-
-	try {
-		db.exec("COMMIT");
-	}
-	catch (std::exception& e)
-	{
-		std::cout << "exception: " << e.what() << std::endl;
-	}
-
-}
-
-
-
-void write_to_db_data_table(SQLite::Database & db, std::string & name, std::string & json) {
-	try {
-		std::stringstream ss_query;
-		ss_query << "INSERT INTO datafile(name, json, time) VALUES(?, ?, datetime(CURRENT_TIMESTAMP,'localtime'));";
-		std::string query = ss_query.str();
-
-		SQLite::Statement state(db, query);
-		state.bind(1, name);
-		state.bind(2, json);
-		state.exec();
-		//if (ret != sqlite_ok) {
-		//	throw;
-		//}
-	}
-	catch (std::exception& e)
-	{
-		std::cout << "exception: " << e.what() << std::endl;
-	}
-}
-
-void write_to_db_result_table(SQLite::Database & db, RESULT & result) {
-	try {
-		//   kld REAL
-		//   loglikelihood REAL
-		//   data_size
-		//   v_size INTEGER
-		//   h_size INTEGER
-		//   rbm_type TEXT (d or c)
-		//   div_size INTEGER
-		//   train_type (cd or exact)
-		//   epoch INTEGER
-		//   sparse (has sparse: 1)
-		//   try_count INGERGER
-		std::stringstream ss_query;
-		//	ss_query << "INSERT INTO result (name, json, time) VALUES("  << name << ", " << json << ", )";
-		ss_query << "INSERT INTO result(kld, loglikelihood, data_size, v_size, h_size, rbm_type, div_size, train_type, epoch, sparse, try_count) VALUES(?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?);";
-		std::string query = ss_query.str();
-
-		SQLite::Statement state(db, query);
-		state.bind(1, result.kld);
-		state.bind(2, result.loglikelihood);
-		state.bind(3, result.data_size);
-		state.bind(4, result.v_size);
-		state.bind(5, result.h_size);
-		state.bind(6, result.rbm_type);
-		state.bind(7, result.div_size);
-		state.bind(8, result.train_type);
-		state.bind(9, result.epoch);
-		state.bind(10, result.sparse);
-		state.bind(11, result.try_count);
-		state.exec();
-		//if (ret != sqlite_ok) {
-		//	throw;
-		//}
-	}
-	catch (std::exception& e)
-	{
-		std::cout << "exception: " << e.what() << std::endl;
-	}
-
-}
-
-
-// パラメータファイル書き込み(SQLITEに)
-template <class RBM>
-void write_params(SQLite::Database & db, RBM & rbm, std::string fname) {
-	write_to_db_data_table(db, fname, rbm.params.serialize());
-}
-
-// 学習情報書き込み(SQLITEに)
-template <class RBM, class Trainer>
-void write_train_info(SQLite::Database & db, RBM & rbm, Trainer & trainer, std::string fname) {
-	auto js = trainer.trainInfoJson(rbm);
-	write_to_db_data_table(db, fname, js);
-}
-
-// (汎化|訓練)誤差情報書き込み(SQLITEに)
-template <class RBMGEN, class RBMTRAIN, class Trainer, class Dataset>
-void write_error_info(SQLite::Database & db, RBMGEN & rbm_gen, RBMTRAIN & rbm_train, Trainer & trainer, Dataset & dataset, std::string fname) {
-	auto js = nlohmann::json();
-	js["kld"] = rbmutil::kld(rbm_gen, rbm_train, std::vector<int>{0, 1});
-	js["logLikelihood"] = trainer.logLikeliHood(rbm_train, dataset);
-
-	write_to_db(db, fname, js.dump());
-}
-
 // 実行ルーチン
 template<class RBM_G, class RBM_T, class DATASET>
-void run(SQLite::Database & db, OPTION & option, int try_count, RBM_G & rbm_gen, RBM_T & rbm_train, DATASET & dataset) {
+void run(ResultSink & sink, OPTION & option, int try_count, RBM_G & rbm_gen, RBM_T & rbm_train, DATASET & dataset) {
 	if (!(option.rbmFlag & 1)) return;
 
 
@@ -271,7 +92,7 @@ void run(SQLite::Database & db, OPTION & option, int try_count, RBM_G & rbm_gen,
 
 
 	for (int epoch_count = 0; epoch_count < option.epoch; epoch_count++) {
-		RESULT result;
+		ResultRecord result;
 
 		std::string rbm_div = option.realFlag ? "c" : std::to_string(option.divSize);
 
@@ -296,7 +117,7 @@ void run(SQLite::Database & db, OPTION & option, int try_count, RBM_G & rbm_gen,
 			result.epoch = epoch_count;
 			result.sparse = 0;
 			result.try_count = try_count;
-			write_to_db_result_table(db, result);
+			sink.write(result);
 		}
 
 		// Contrastive Divergence
@@ -320,7 +141,7 @@ void run(SQLite::Database & db, OPTION & option, int try_count, RBM_G & rbm_gen,
 			result.epoch = epoch_count;
 			result.sparse = 0;
 			result.try_count = try_count;
-			write_to_db_result_table(db, result);
+			sink.write(result);
 		}
 	}
 }
@@ -371,19 +192,11 @@ int main(void) {
 	int try_num = 1000;
 
 
-	SQLite::Database db("./output/sqlite3.db", SQLite::OPEN_CREATE | SQLite::OPEN_READWRITE);
-
-	make_table(db);
+	// INSERT文を使い回してまとめてコミットし, 書き込みは別スレッドで行う
+	SqliteResultSink db_sink("./output/sqlite3.db");
+	AsyncResultSink sink(db_sink);
 
 	for (int try_count = 0; try_count < try_num; try_count++) {
-		try {
-			db.exec("BEGIN");
-		}
-		catch (std::exception& e)
-		{
-			std::cout << "exception: " << e.what() << std::endl;
-		}
-
 		auto rbm_gen = GeneralizedRBM(option.vSize, option.hSize);
 		rbm_gen.setHiddenMin(-1.0);
 		rbm_gen.setHiddenMax(1.0);
@@ -409,13 +222,13 @@ int main(void) {
 		// try rbm 2
 		option.realFlag = false;
 		option.divSize = 1;
-		run(db, option, try_count, rbm_gen, rbm_train1, dataset); // H - 5
-		run(db, option, try_count, rbm_gen, rbm_train1, dataset); // H - 0
-		run(db, option, try_count, rbm_gen, rbm_train1, dataset); // H + 5
-		run(db, option, try_count, rbm_gen, rbm_train1, dataset); // H + 10
+		run(sink, option, try_count, rbm_gen, rbm_train1, dataset); // H - 5
+		run(sink, option, try_count, rbm_gen, rbm_train2, dataset); // H - 0
+		run(sink, option, try_count, rbm_gen, rbm_train3, dataset); // H + 5
+		run(sink, option, try_count, rbm_gen, rbm_train4, dataset); // H + 10
 
 		try {
-			db.exec("COMMIT");
+			sink.flush();
 			std::cout << "h10 + " << option.appendH << ", cimmit: " << try_count << std::endl;
 		}
 		catch (std::exception& e)
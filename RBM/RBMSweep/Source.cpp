@@ -0,0 +1,130 @@
+﻿#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <memory>
+#include <boost/program_options.hpp>
+#include "SweepRunner.h"
+#include "ResultSink.h"
+#include "SqliteResultSink.h"
+
+typedef struct {
+	int vSize = 5;
+	int genHsize = 4;
+	int datasize = 100;
+	int seed = 0;
+	SweepGrid grid;
+	SweepSetting setting;
+	std::string sinkType = "stdout";  // stdout, sqlite, csv, binary, none
+	std::string outputPath = "";
+} OPTION;
+
+// コマンドラインオプションの設定
+OPTION get_option(int argc, char** argv) {
+	namespace po = boost::program_options;
+	po::options_description opt("オプション");
+	opt.add_options()
+		("help,h", "ヘルプを表示")
+		("vsize", po::value<int>()->default_value(4), "visible node size")
+		("gen_hsize", po::value<int>()->default_value(4), "hidden node size(gen rbm)")
+		("train_hsize", po::value<std::vector<int>>()->multitoken()->default_value(std::vector<int>{4}, "4"), "hidden node sizes(train rbm)")
+		("datasize", po::value<int>()->default_value(100), "gen datasize")
+		("epoch", po::value<int>()->default_value(1000), "update count")
+		("cdk", po::value<int>()->default_value(1), "cdk")
+		("learning_rate", po::value<double>()->default_value(0.1), "")
+		("divsize", po::value<std::vector<int>>()->multitoken()->default_value(std::vector<int>{2}, "2"), "0: real, others: digit")
+		("train_mode", po::value<std::vector<std::string>>()->multitoken()->default_value(std::vector<std::string>{"exact"}, "exact"), "exact, cd, pt, mf")
+		("rbmtype", po::value<std::vector<std::string>>()->multitoken()->default_value(std::vector<std::string>{"rbm"}, "rbm"), "rbm, sparse")
+		("seed", po::value<std::vector<int>>()->multitoken()->default_value(std::vector<int>{0}, "0"), "seed values(train rbm)")
+		("gen_seed", po::value<int>()->default_value(0), "seed value(gen rbm)")
+		("try_num", po::value<int>()->default_value(1), "try count")
+		("eval_interval", po::value<int>()->default_value(1), "evaluation interval(epoch)")
+		("threads", po::value<int>()->default_value(std::thread::hardware_concurrency()), "parallel jobs")
+		("omp_threads", po::value<int>()->default_value(1), "OpenMP threads per job")
+		("sink", po::value<std::string>()->default_value("stdout"), "stdout, sqlite, csv, binary, none")
+		("output", po::value<std::string>()->default_value("./output/sweep.db"), "output file");
+
+	po::variables_map vm;
+	po::store(po::parse_command_line(argc, argv, opt), vm);
+	po::notify(vm);
+
+	if (vm.count("help")) {
+		std::cout << opt << std::endl;
+		exit(0);
+	}
+
+	OPTION option;
+	try {
+		option.vSize = vm["vsize"].as<int>();
+		option.genHsize = vm["gen_hsize"].as<int>();
+		option.datasize = vm["datasize"].as<int>();
+		option.seed = vm["gen_seed"].as<int>();
+
+		option.grid.hiddenSizes = vm["train_hsize"].as<std::vector<int>>();
+		option.grid.divSizes = vm["divsize"].as<std::vector<int>>();
+		option.grid.trainModes = vm["train_mode"].as<std::vector<std::string>>();
+		option.grid.rbmTypes = vm["rbmtype"].as<std::vector<std::string>>();
+		option.grid.seeds = vm["seed"].as<std::vector<int>>();
+		option.grid.tryNum = vm["try_num"].as<int>();
+
+		option.setting.epoch = vm["epoch"].as<int>();
+		option.setting.cdk = vm["cdk"].as<int>();
+		option.setting.batchSize = option.datasize;
+		option.setting.learningRate = vm["learning_rate"].as<double>();
+		option.setting.evalInterval = vm["eval_interval"].as<int>();
+		option.setting.threadSize = vm["threads"].as<int>();
+		option.setting.ompThreadSize = vm["omp_threads"].as<int>();
+		option.sinkType = vm["sink"].as<std::string>();
+		option.outputPath = vm["output"].as<std::string>();
+	}
+	catch (std::exception& e)
+	{
+		std::cout << "exception: " << e.what() << std::endl;
+		std::cout << opt << std::endl;
+		exit(-1l);
+	}
+
+	return option;
+}
+
+// 出力先の作成
+std::unique_ptr<ResultSink> make_result_sink(OPTION & option) {
+	if (option.sinkType == "stdout") return std::unique_ptr<ResultSink>(new StreamResultSink(std::cout));
+	if (option.sinkType == "sqlite") return std::unique_ptr<ResultSink>(new SqliteResultSink(option.outputPath));
+	if (option.sinkType == "csv") return std::unique_ptr<ResultSink>(new CsvResultSink(option.outputPath));
+	if (option.sinkType == "binary") return std::unique_ptr<ResultSink>(new BinaryResultSink(option.outputPath));
+	if (option.sinkType == "none") return std::unique_ptr<ResultSink>(new NullResultSink());
+
+	throw std::runtime_error("unknown sink: " + option.sinkType);
+}
+
+//
+// ハイパーパラメータの格子を1プロセス内で並列に掃引し,
+// 生成モデルとのカルバックライブラー情報量を出力
+//
+int main(int argc, char** argv) {
+	OPTION option = get_option(argc, argv);
+
+	// 生成モデル, データ, 参照分布は全ジョブで共有
+	SweepContext context;
+	context.init(option.vSize, option.genHsize, option.datasize, option.seed + 12345);
+
+	// 書き込みは別スレッドで行い, ジョブを止めない
+	auto base_sink = make_result_sink(option);
+	AsyncResultSink sink(*base_sink);
+	SweepRunner runner(context, sink);
+	runner.setting = option.setting;
+
+	auto jobs = option.grid.expand();
+	std::cerr << jobs.size() << " jobs, " << runner.setting.threadSize << " threads" << std::endl;
+
+	auto start = std::chrono::steady_clock::now();
+	runner.run(jobs);
+	auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	std::cerr << "done: " << elapsed << " sec" << std::endl;
+
+	// RBM_PROFILEを定義してビルドしたときのみ出力される
+	RBM_PROFILE_EXPORT("./output/trace.json", "./output/profile.csv");
+
+	return 0;
+}